@@ -38,7 +38,6 @@
 #define CGMAX 65536
 static cginfo_t *cgs[CGMAX];
 
-#include "sactcg_stretch.c"
 #include "sactcg_blend.c"
 
 
@@ -122,7 +121,7 @@ int nt_scg_create_reverse(int wNumCG, int wNumSrcCG, int wReverseX, int wReverse
 	if (!src)
 		return NG;
 
-	surface_t *sf = stretch(src->sf, src->sf->width, src->sf->height, (wReverseX << 1) | wReverseY);
+	surface_t *sf = gr_stretch_surface(src->sf, src->sf->width, src->sf->height, (wReverseX << 1) | wReverseY, STRETCH_NEAREST);
 	nt_scg_new(CG_REVERSE, wNumCG, sf);
 	return OK;
 }
@@ -136,7 +135,7 @@ int nt_scg_create_stretch(int wNumCG, int wWidth, int wHeight, int wNumSrcCG) {
 	if (!src)
 		return NG;
 	
-	surface_t *sf = stretch(src->sf, wWidth, wHeight, 0);
+	surface_t *sf = gr_stretch_surface(src->sf, wWidth, wHeight, 0, nact->ags.stretch_filter);
 	nt_scg_new(CG_STRETCH, wNumCG, sf);
 	return OK;
 }
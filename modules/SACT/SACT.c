@@ -146,9 +146,6 @@ static void Init() {
 		smask_init(nact->files.sact01);
 	}
 	
-	// create depth map
-	sact.dmap = sf_create_pixel(sf0->width, sf0->height, 16);
-	
 	// その他 System35 のデフォルト動作の変更
 	ags_setAntialiasedStringMode(TRUE);
 	sys_setHankakuMode(2); // 全角半角変換無し
@@ -2144,10 +2141,11 @@ static void SACT_reset(void) {
 	spxm_clear();
 	ssel_reset();
 	sstr_reset();
+	sp_update_print_stats();
 	sp_reset();
 
 	scg_freeall();
-	sf_free(sact.dmap);
+	stimer_free_all();
 	memset(&sact, 0, sizeof(sact));
 }
 
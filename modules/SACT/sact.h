@@ -36,9 +36,25 @@
 // スプライトの最大数
 #define SPRITEMAX 21845
 
+// スプライトはこの個数ずつページ単位で確保する
+#define SPRITE_PAGE_BITS 6
+#define SPRITE_PAGE_SIZE (1 << SPRITE_PAGE_BITS)
+#define SPRITE_PAGES ((SPRITEMAX + SPRITE_PAGE_SIZE - 1) >> SPRITE_PAGE_BITS)
+
 // CGの最大数
 #define CGMAX 63336
 
+// CGテーブルのページ
+#define CG_PAGE_BITS 8
+#define CG_PAGE_SIZE (1 << CG_PAGE_BITS)
+#define CG_PAGES ((CGMAX + CG_PAGE_SIZE - 1) >> CG_PAGE_BITS)
+
+// タイマーの数とそのページ
+#define STIMER_MAX 65536
+#define STIMER_PAGE_BITS 8
+#define STIMER_PAGE_SIZE (1 << STIMER_PAGE_BITS)
+#define STIMER_PAGES (STIMER_MAX >> STIMER_PAGE_BITS)
+
 // メッセージの最大長さ
 #define MSGBUFMAX 257*10
 
@@ -75,6 +91,8 @@ struct _cginfo {
 	int no;            // CGの番号
 	surface_t *sf;     // CG本体
 	int refcnt;        // 参照カウンタ。０になったら開放してもよい。
+	int serial;        // 作成順の通し番号 (CG番号が再利用されても変わる)
+	struct _cginfo *sfowner;  // sf を他の cginfo_t と共有している場合の持ち主
 };
 typedef struct _cginfo cginfo_t;
 
@@ -202,15 +220,15 @@ struct _sact {
 	// SACTのバージョン
 	int version;
 	
-	// スプライト全体
-	sprite_t *sp[SPRITEMAX];
+	// スプライト全体 (sp_get() でアクセスする)
+	sprite_t *sppage[SPRITE_PAGES];
 	
 	SList *sp_zhide;  // Zキーで消すスプライトのリスト
 	SList *sp_quake;  // Quakeで揺らすスプライトのリスト
 	
 	SList *updatelist; // 再描画するスプライトのリスト
 	
-	cginfo_t *cg[CGMAX]; // cgまたはCG_xxで作った CG
+	cginfo_t **cgpage[CG_PAGES]; // cgまたはCG_xxで作った CG
 	
 	// 座標系の原点
 	MyPoint origin;
@@ -250,7 +268,7 @@ struct _sact {
 	MyRectangle updaterect; // 更新が必要なspriteの領域の和
 	
 	// sact timer
-	stimer_t timer[65536];
+	stimer_t *timerpage[STIMER_PAGES];
 	
 	// DnDに関するもの
 	sprite_t *draggedsp;  // drag中のスプライト
@@ -272,9 +290,6 @@ struct _sact {
 	// 範囲外をクリックしたときの音
 	int numsoundob;
 	
-	// depth map
-	surface_t *dmap;
-	
 	boolean zhiding;  // Zkeyによる隠し中
 	int     zofftime;
 	boolean zdooff;
@@ -35,8 +35,8 @@
 #include "sactcg.h"
 #include "surface.h"
 #include "ngraph.h"
+#include "cache.h"
 
-#include "sactcg_stretch.c"
 #include "sactcg_blend.c"
 
 #define spcg_assert_no(no) \
@@ -45,15 +45,98 @@
     return NG; \
   } \
 
+// 指定番号の CG (無ければ NULL)
+static cginfo_t *scg_lookup(int no) {
+	if ((unsigned)no >= CGMAX) return NULL;
+	cginfo_t **page = sact.cgpage[no >> CG_PAGE_BITS];
+	return page ? page[no & (CG_PAGE_SIZE - 1)] : NULL;
+}
+
+static void scg_store(int no, cginfo_t *info) {
+	if ((unsigned)no >= CGMAX) return;
+	cginfo_t ***page = &sact.cgpage[no >> CG_PAGE_BITS];
+	if (!*page) {
+		if (!info) return;
+		*page = calloc(CG_PAGE_SIZE, sizeof(cginfo_t *));
+		if (!*page)
+			NOMEMERR();
+	}
+	(*page)[no & (CG_PAGE_SIZE - 1)] = info;
+}
+
+/*
+  拡大縮小結果のキャッシュ
+
+  サムネイルのように同じ CG を同じ大きさに何度も拡大縮小する場合に
+  再計算を避ける。元の CG は作成後に変更されないので、元 CG の通し番号と
+  大きさが同じなら結果も同じ。結果の surface も変更されないので、複製
+  せずに共有する。surface はどの CG 番号にも登録されない cginfo_t (owner)
+  が持ち、それを使う CG の sfowner とキャッシュが owner を参照する。
+*/
+#define STRETCH_CACHE_BUDGET (16 * 1024 * 1024)
+
+struct stretch_entry {
+	int serial;        // 元 CG の通し番号
+	int width, height;
+	cginfo_t *owner;
+};
+static cacher *stretch_cache;
+static int cg_serial;
+
+static void stretch_entry_free(struct stretch_entry *e) {
+	scg_deref(e->owner);
+	free(e);
+}
+
+static int surface_bytes(surface_t *sf) {
+	return sf->bytes_per_line * sf->height + (sf->alpha ? sf->width * sf->height : 0);
+}
+
+// 拡大縮小した surface の owner を返す。呼び出し側が参照を1つ持つ。
+static cginfo_t *stretch_cached(cginfo_t *src, int width, int height) {
+	if (!stretch_cache) {
+		stretch_cache = cache_new("stretch", stretch_entry_free);
+		cache_set_budget(stretch_cache, STRETCH_CACHE_BUDGET);
+	}
+	int key = (int)(((unsigned)src->serial * 8191 + width) * 8191 + height);
+	struct stretch_entry *e = cache_lookup(stretch_cache, key);
+	if (e && e->serial == src->serial && e->width == width && e->height == height) {
+		e->owner->refcnt++;
+		return e->owner;
+	}
+	
+	cginfo_t *owner = calloc(1, sizeof(cginfo_t));
+	if (!owner)
+		NOMEMERR();
+	owner->type = CG_STRETCH;
+	owner->sf = gr_stretch_surface(src->sf, width, height, 0, nact->ags.stretch_filter);
+	owner->refcnt = 1;
+	
+	// キーが衝突した場合はキャッシュしない
+	if (!e && owner->sf) {
+		e = malloc(sizeof(struct stretch_entry));
+		if (!e)
+			NOMEMERR();
+		e->serial = src->serial;
+		e->width = width;
+		e->height = height;
+		e->owner = owner;
+		owner->refcnt++;
+		cache_insert(stretch_cache, key, e, surface_bytes(owner->sf), NULL);
+	}
+	return owner;
+}
+
 static cginfo_t *scg_new(enum cgtype type, int no, surface_t *sf) {
 	cginfo_t *info = calloc(1, sizeof(cginfo_t));
 	info->type = type;
 	info->no = no;
 	info->sf = sf;
 	info->refcnt = 1;
+	info->serial = ++cg_serial;
 
 	scg_free(no);
-	sact.cg[no] = info;
+	scg_store(no, info);
 
 	return info;
 }
@@ -72,8 +155,9 @@ static cginfo_t *scg_get(int no) {
 		return NULL;
 	}
 	
-	if (sact.cg[no] != NULL)
-		return sact.cg[no];
+	cginfo_t *info = scg_lookup(no);
+	if (info != NULL)
+		return info;
 
 	surface_t *sf = sf_loadcg_no(no - 1);
 	if (!sf) {
@@ -83,6 +167,17 @@ static cginfo_t *scg_get(int no) {
 	return scg_new(CG_LINKED, no, sf);
 }
 
+/*
+  リンクファイルのCGをバックグラウンドで展開開始
+
+  @param no: CG番号
+*/
+void scg_prefetch(int no) {
+	if (no <= 0 || no >= (CGMAX -1) || scg_lookup(no) != NULL)
+		return;
+	cg_prefetch(no - 1);
+}
+
 cginfo_t *scg_addref(int no) {
 	cginfo_t *info = scg_get(no);
 	if (info)
@@ -94,7 +189,9 @@ void scg_deref(cginfo_t *cg) {
 	if (--cg->refcnt > 0)
 		return;
 
-	if (cg->sf)
+	if (cg->sfowner)
+		scg_deref(cg->sfowner);
+	else if (cg->sf)
 		sf_free(cg->sf);
 	free(cg);
 }
@@ -119,7 +216,7 @@ int scg_create_reverse(int wNumCG, int wNumSrcCG, int wReverseX, int wReverseY)
 	if (!src)
 		return NG;
 
-	surface_t *sf = stretch(src->sf, src->sf->width, src->sf->height, (wReverseX << 1) | wReverseY);
+	surface_t *sf = gr_stretch_surface(src->sf, src->sf->width, src->sf->height, (wReverseX << 1) | wReverseY, STRETCH_NEAREST);
 	scg_new(CG_REVERSE, wNumCG, sf);
 	return OK;
 }
@@ -133,8 +230,9 @@ int scg_create_stretch(int wNumCG, int wWidth, int wHeight, int wNumSrcCG) {
 	if (!src)
 		return NG;
 	
-	surface_t *sf = stretch(src->sf, wWidth, wHeight, 0);
-	scg_new(CG_STRETCH, wNumCG, sf);
+	cginfo_t *owner = stretch_cached(src, wWidth, wHeight);
+	cginfo_t *info = scg_new(CG_STRETCH, wNumCG, owner->sf);
+	info->sfowner = owner;
 	return OK;
 }
 
@@ -264,6 +362,10 @@ int scg_freeall() {
 	for (i = 1; i < CGMAX; i++) {
 		scg_free(i);
 	}
+	for (i = 0; i < CG_PAGES; i++) {
+		free(sact.cgpage[i]);
+		sact.cgpage[i] = NULL;
+	}
 	return OK;
 }
 
@@ -274,11 +376,11 @@ int scg_freeall() {
 int scg_free(int no) {
 	spcg_assert_no(no);
 	
-	cginfo_t *cg = sact.cg[no];
+	cginfo_t *cg = scg_lookup(no);
 	if (!cg) return NG;
 	
 	scg_deref(cg);
-	sact.cg[no] = NULL;
+	scg_store(no, NULL);
 	
 	return OK;
 }
@@ -286,9 +388,10 @@ int scg_free(int no) {
 // CGの種類を取得
 int scg_querytype(int wNumCG, int *ret) {
 	if (wNumCG >= (CGMAX -1)) goto errexit;
-	if (sact.cg[wNumCG] == NULL) goto errexit;
+	cginfo_t *cg = scg_lookup(wNumCG);
+	if (cg == NULL) goto errexit;
 
-	*ret = sact.cg[wNumCG]->type;
+	*ret = cg->type;
 	
 	return OK;
 
@@ -300,11 +403,12 @@ int scg_querytype(int wNumCG, int *ret) {
 // CGの大きさを取得
 int scg_querysize(int wNumCG, int *w, int *h) {
 	if (wNumCG >= (CGMAX -1)) goto errexit;
-	if (sact.cg[wNumCG] == NULL) goto errexit;
-	if (sact.cg[wNumCG]->sf == NULL) goto errexit;
+	cginfo_t *cg = scg_lookup(wNumCG);
+	if (cg == NULL) goto errexit;
+	if (cg->sf == NULL) goto errexit;
 
-	*w = sact.cg[wNumCG]->sf->width;
-	*h = sact.cg[wNumCG]->sf->height;
+	*w = cg->sf->width;
+	*h = cg->sf->height;
 	
 	return OK;
 
@@ -316,10 +420,11 @@ int scg_querysize(int wNumCG, int *w, int *h) {
 // CGのBPPを取得
 int scg_querybpp(int wNumCG, int *ret) {
 	if (wNumCG >= (CGMAX -1)) goto errexit;
-	if (sact.cg[wNumCG] == NULL) goto errexit;
-	if (sact.cg[wNumCG]->sf == NULL) goto errexit;
+	cginfo_t *cg = scg_lookup(wNumCG);
+	if (cg == NULL) goto errexit;
+	if (cg->sf == NULL) goto errexit;
 	
-	*ret = sact.cg[wNumCG]->sf->depth;
+	*ret = cg->sf->depth;
 
 	return OK;
 
@@ -331,10 +436,11 @@ int scg_querybpp(int wNumCG, int *ret) {
 // CGの alphamap が存在するかを取得
 int scg_existalphamap(int wNumCG, int *ret) {
 	if (wNumCG >= (CGMAX -1)) goto errexit;
-	if (sact.cg[wNumCG] == NULL) goto errexit;
-	if (sact.cg[wNumCG]->sf == NULL) goto errexit;
+	cginfo_t *cg = scg_lookup(wNumCG);
+	if (cg == NULL) goto errexit;
+	if (cg->sf == NULL) goto errexit;
 	
-	*ret = sact.cg[wNumCG]->sf->alpha ? 1 : 0;
+	*ret = cg->sf->alpha ? 1 : 0;
 	
  errexit:
 	*ret = 0;
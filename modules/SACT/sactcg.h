@@ -27,6 +27,7 @@
 #include "portab.h"
 #include "sact.h"
 
+extern void scg_prefetch(int no);
 extern cginfo_t *scg_addref(int no);
 extern void scg_deref(cginfo_t *cg);
 extern int scg_create(int wNumCG, int wWidth, int wHeight, int wR, int wG, int wB, int wBlendRate);
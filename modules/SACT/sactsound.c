@@ -73,12 +73,13 @@ int ssnd_init() {
 
 // 指定の番号の効果音をメモリに読み込み
 int ssnd_prepare(int no) {
-	int slot = slt_find(no);
+	if (slt_find(no) != -1)
+		return OK;
 	
-	if (slot == -1) {
-		slot = slt_getnext(no);
-		mus_wav_load(slot, no);
-	}
+	// スロットは再生時に割り当てる。ここではデコードだけを先に済ませておく。
+	// 先読みできない環境 (emscripten など) では従来通りここでロードする。
+	if (mus_wav_prefetch(no) != OK)
+		mus_wav_load(slt_getnext(no), no);
 	
 	return OK;
 }
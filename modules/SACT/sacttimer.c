@@ -26,9 +26,25 @@
 #include <unistd.h>
 
 #include "portab.h"
+#include "system.h"
 #include "sact.h"
 #include "sacttimer.h"
 
+// 指定IDのタイマー。未作成のページは作成する
+static stimer_t *stimer(int id) {
+	if ((unsigned)id >= STIMER_MAX) {
+		WARNING("timer id %d is out of range", id);
+		return NULL;
+	}
+	stimer_t **page = &sact.timerpage[id >> STIMER_PAGE_BITS];
+	if (!*page) {
+		*page = calloc(STIMER_PAGE_SIZE, sizeof(stimer_t));
+		if (!*page)
+			NOMEMERR();
+	}
+	return &(*page)[id & (STIMER_PAGE_SIZE - 1)];
+}
+
 /*
   sact timer subsystem 初期化
 */
@@ -37,10 +53,21 @@ int stimer_init() {
 	return OK;
 }
 
+// 全てのタイマーを破棄
+void stimer_free_all(void) {
+	for (int i = 0; i < STIMER_PAGES; i++) {
+		free(sact.timerpage[i]);
+		sact.timerpage[i] = NULL;
+	}
+}
+
 // 指定IDのタイマーのリセット
 int stimer_reset(int id, int val) {
-	gettimeofday(&(sact.timer[id].tv_base), NULL);
-	sact.timer[id].val = val;
+	stimer_t *t = stimer(id);
+	if (!t) return NG;
+	
+	gettimeofday(&(t->tv_base), NULL);
+	t->val = val;
 	return OK;
 }
 
@@ -48,12 +75,14 @@ int stimer_reset(int id, int val) {
 int stimer_get(int id) {
 	long sec, usec, usec2;
 	struct timeval tv;
-	struct timeval tv_base = sact.timer[id].tv_base;
+	stimer_t *t = stimer(id);
+	if (!t) return 0;
+	struct timeval tv_base = t->tv_base;
 	int division = 10;
 	
 	gettimeofday(&tv, NULL);
 	sec  = tv.tv_sec - tv_base.tv_sec;
 	usec = tv.tv_usec - tv_base.tv_usec;
 	usec2 = sec * (1000l/division)+ usec / 1000l /division;
-	return sact.timer[id].val + usec2;
+	return t->val + usec2;
 }
@@ -35,6 +35,7 @@ typedef struct _stimer stimer_t;
 
 
 extern int stimer_init();
+extern void stimer_free_all(void);
 extern int stimer_reset(int id, int val);
 extern int stimer_get(int id);
 
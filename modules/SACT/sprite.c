@@ -49,13 +49,6 @@ static int compare_spriteno_smallfirst(const void *a, const void *b);
   }                                                                  \
 } while (0)
 
-#define sp_assert_null(no) do {                                      \
-  if (sact.sp[no] == NULL) {                                         \
-    WARNING("sprite %d is NULL", no);                              \
-    return NG;                                                       \
-  }                                                                  \
-} while (0)
-
 
 // スプライトの番号順に更新するためにリストに順番に要れるためのcallbck
 static int compare_spriteno_smallfirst(const void *a, const void *b) {
@@ -93,8 +86,6 @@ static int sp_draw_wall(sprite_t *sp) {
  * @return OK:成功, NG:失敗
  */
 int sp_init() {
-	int i;
-	
 	// DLL用メッセージ表示
 	nact->msgout = smsg_add;
 
@@ -104,19 +95,13 @@ int sp_init() {
 	// main callback
 	nact->callback = spev_main;
 	
-	// いろいろな理由から全てのスプライトをあらかじめ作成しておく
-	for (i = 0; i < SPRITEMAX; i++) {
-		sact.sp[i] = calloc(1, sizeof(sprite_t));
-		sact.sp[i]->no   = i;
-		sact.sp[i]->type = SPRITE_NONE;
-		sact.sp[i]->show = FALSE;
-	}
+	// スプライトは sp_get() で初めて参照されたときにページ単位で作成する
 	
 	// 壁紙(スプライト番号０)はデフォルトへ
 	sp_set_wall_paper(0);
 	
 	// 壁紙を updateリストに追加
-	sact.updatelist = slist_append(sact.updatelist, sact.sp[0]);
+	sact.updatelist = slist_append(sact.updatelist, sp_get(0));
 	
 	return OK;
 }
@@ -125,9 +110,33 @@ int sp_reset(void) {
 	sp_clear_zkey_hidesprite_all();
 	sp_clear_quakesprite_all();
 	sp_free_all();
+	
+	slist_free(sact.updatelist);
+	sact.updatelist = NULL;
+	for (int i = 0; i < SPRITE_PAGES; i++) {
+		free(sact.sppage[i]);
+		sact.sppage[i] = NULL;
+	}
 	return OK;
 }
 
+/*
+  スプライト番号 page * SPRITE_PAGE_SIZE から SPRITE_PAGE_SIZE 個分を作成
+  (sp_get() から呼ばれる)
+*/
+sprite_t *sp_alloc_page(int page) {
+	sprite_t *sp = calloc(SPRITE_PAGE_SIZE, sizeof(sprite_t));
+	if (!sp)
+		NOMEMERR();
+	for (int i = 0; i < SPRITE_PAGE_SIZE; i++) {
+		sp[i].no   = page * SPRITE_PAGE_SIZE + i;
+		sp[i].type = SPRITE_NONE;
+		sp[i].show = FALSE;
+	}
+	sact.sppage[page] = sp;
+	return sp;
+}
+
 /**
  * 新規スプライトの作成
  * @param no: スプライト番号
@@ -141,7 +150,7 @@ int sp_new(int no, int cg1, int cg2, int cg3, int type) {
 	
 	sp_assert_no(no);
 
-	sp = sact.sp[no];
+	sp = sp_get(no);
 
 	if (sp->type != SPRITE_NONE) {
 		sp_free(no);
@@ -153,6 +162,10 @@ int sp_new(int no, int cg1, int cg2, int cg3, int type) {
 	sp->type = type;
 	sp->no   = no;
 	
+	// 2枚目以降のCGは1枚目と並行して展開しておく
+	scg_prefetch(cg2);
+	scg_prefetch(cg3);
+	
 	// set時点でのcgが使用される(draw時ではない)
 	sp->cg1 = cg1 ? scg_addref(cg1) : NULL;
 	sp->cg2 = cg2 ? scg_addref(cg2) : NULL;
@@ -209,7 +222,7 @@ int sp_new_msg(int no, int x, int y, int width, int height) {
 	
 	sp_assert_no(no);
 	
-	sp = sact.sp[no];
+	sp = sp_get(no);
 	
 	if (sp->type != SPRITE_NONE) {
 		sp_free(no);
@@ -243,7 +256,7 @@ int sp_new_msg(int no, int x, int y, int width, int height) {
 
 // 壁紙の設定
 int sp_set_wall_paper(int no) {
-	sprite_t *sp = sact.sp[0];
+	sprite_t *sp = sp_get(0);
 	
 	if (sp->curcg)
 		scg_deref(sp->curcg);
@@ -274,6 +287,11 @@ int sp_free_all() {
 	int i;
 	
 	for (i = 1; i < SPRITEMAX; i++) {
+		// 作成されていないページは飛ばす
+		if (!sact.sppage[i >> SPRITE_PAGE_BITS]) {
+			i |= SPRITE_PAGE_SIZE - 1;
+			continue;
+		}
 		sp_free(i);
 	}
 	return OK;
@@ -285,7 +303,10 @@ int sp_free(int no) {
 	
 	sp_assert_no(no);
 	
-	sp = sact.sp[no];
+	// 一度も参照されていないスプライト
+	if (!sact.sppage[no >> SPRITE_PAGE_BITS]) return OK;
+	
+	sp = sp_get(no);
 
 	// 移動開始していない場合はリストから削除
 	if (!sp->move.moving) {
@@ -337,7 +358,7 @@ int sp_set_show(int wNum, int wCount, int sShow) {
 	
 	for (i = wNum; i < (wNum + wCount); i++) {
 		if (i >= (SPRITEMAX -1)) break;
-		sp = sact.sp[i];
+		sp = sp_get(i);
 		oldstate = sp->show;
 		
 		sp->show = (sShow == 1 ? TRUE : FALSE);
@@ -351,7 +372,7 @@ int sp_set_pos(int wNum, int wX, int wY) {
 	
 	sp_assert_no(wNum);
 	
-	sp = sact.sp[wNum];
+	sp = sp_get(wNum);
 	sp->loc.x = wX - sact.origin.x;
 	sp->loc.y = wY - sact.origin.y;
 	sp->cur.x = sp->loc.x;
@@ -366,7 +387,7 @@ int sp_set_move(int wNum, int wX, int wY) {
 	
 	sp_assert_no(wNum);
 	
-	sp = sact.sp[wNum];
+	sp = sp_get(wNum);
 	sp->move.to.x = wX - sact.origin.x;
 	sp->move.to.y = wY - sact.origin.y;
 	
@@ -386,8 +407,8 @@ int sp_set_move(int wNum, int wX, int wY) {
 int sp_set_movetime(int wNum, int wTime) {
 	sp_assert_no(wNum);
 	
-	sact.sp[wNum]->move.time = wTime * 10;
-	sact.sp[wNum]->move.speed = 0;
+	sp_get(wNum)->move.time = wTime * 10;
+	sp_get(wNum)->move.speed = 0;
 	return OK;
 }
 
@@ -397,8 +418,8 @@ int sp_set_movespeed(int wNum, int wSpeed) {
 	
 	if (wSpeed == 0) wSpeed = 1;
 	
-	sact.sp[wNum]->move.speed = wSpeed;
-	sact.sp[wNum]->move.time = 0;
+	sp_get(wNum)->move.speed = wSpeed;
+	sp_get(wNum)->move.time = 0;
 	
 	return OK;
 }
@@ -408,7 +429,7 @@ int sp_add_zkey_hidesprite(int wNum) {
 	sprite_t *sp;
 	
 	sp_assert_no(wNum);
-	sp = sact.sp[wNum];
+	sp = sp_get(wNum);
 
 	// 登録時点でまだ生成していないスプライトは隠さない
 	//   シェルクレイルでまずいのがあったので中止
@@ -432,7 +453,7 @@ int sp_freeze_sprite(int wNum, int wIndex) {
 	
 	sp_assert_no(wNum);
 	
-	sp = sact.sp[wNum];
+	sp = sp_get(wNum);
 	sp->freezed_state = wIndex;
 
 	oldstate = (void *)sp->curcg;
@@ -451,7 +472,7 @@ int sp_freeze_sprite(int wNum, int wIndex) {
 int sp_thaw_sprite(int wNum) {
 	sp_assert_no(wNum);
 	
-	sact.sp[wNum]->freezed_state = 0;
+	sp_get(wNum)->freezed_state = 0;
 	return OK;
 }
 
@@ -459,7 +480,7 @@ int sp_thaw_sprite(int wNum) {
 int sp_add_quakesprite(int wNum) {
 	sp_assert_no(wNum);
 	
-	sact.sp_quake = slist_append(sact.sp_quake, sact.sp[wNum]);
+	sact.sp_quake = slist_append(sact.sp_quake, sp_get(wNum));
 	return OK;
 }
 
@@ -474,9 +495,9 @@ int sp_clear_quakesprite_all() {
 int sp_set_animeinterval(int wNum, int wTime) {
 	sp_assert_no(wNum);
 
-	if (sact.sp[wNum]->type != SPRITE_ANIME) return NG;
+	if (sp_get(wNum)->type != SPRITE_ANIME) return NG;
 	
-	sact.sp[wNum]->u.anime.interval = wTime * 10;
+	sp_get(wNum)->u.anime.interval = wTime * 10;
 	
 	return OK;
 }
@@ -490,7 +511,7 @@ int sp_set_blendrate(int wNum, int wCount, int rate) {
 	
 	for (i = wNum; i < (wNum + wCount); i++) {
 		if (i >= (SPRITEMAX -1)) break;
-		sp = sact.sp[i];
+		sp = sp_get(i);
 		sp->blendrate = rate;
 	}
 	
@@ -499,8 +520,11 @@ int sp_set_blendrate(int wNum, int wCount, int rate) {
 
 // スプライトが create されているかどうかの取得
 int sp_query_isexist(int wNum, int *ret) {
+	sprite_t *sp;
+	
 	if (wNum >= SPRITEMAX) goto errexit;
-	if (sact.sp[wNum]->type == SPRITE_NONE) goto errexit;
+	sp = sp_peek(wNum);
+	if (!sp || sp->type == SPRITE_NONE) goto errexit;
 	
 	*ret = 1;
 	return OK;
@@ -516,8 +540,8 @@ int sp_query_info(int wNum, int *vtype, int *vcg1, int *vcg2, int *vcg3) {
 	
 	if (wNum >= SPRITEMAX) goto errexit;
 
-	sp = sact.sp[wNum];
-	if (sp->type == SPRITE_NONE) goto errexit;
+	sp = sp_peek(wNum);
+	if (!sp || sp->type == SPRITE_NONE) goto errexit;
 	
 	*vtype = sp->type;
 	*vcg1 = sp->cg1 ? sp->cg1->no : 0;
@@ -536,10 +560,13 @@ int sp_query_info(int wNum, int *vtype, int *vcg1, int *vcg2, int *vcg3) {
 
 // スプライトの表示状態の取得
 int sp_query_show(int wNum, int *vShow) {
+	sprite_t *sp;
+	
 	if (wNum >= SPRITEMAX) goto errexit;
-	if (sact.sp[wNum]->type == SPRITE_NONE) goto errexit;
+	sp = sp_peek(wNum);
+	if (!sp || sp->type == SPRITE_NONE) goto errexit;
 
-	*vShow = sact.sp[wNum]->show ? 1: 0;
+	*vShow = sp->show ? 1: 0;
 	return OK;
 	
  errexit:
@@ -549,11 +576,14 @@ int sp_query_show(int wNum, int *vShow) {
 
 // スプライトの表示位置の取得
 int sp_query_pos(int wNum, int *vx, int *vy) {
+	sprite_t *sp;
+	
 	if (wNum >= SPRITEMAX) goto errexit;
-	if (sact.sp[wNum]->type == SPRITE_NONE) goto errexit;
+	sp = sp_peek(wNum);
+	if (!sp || sp->type == SPRITE_NONE) goto errexit;
 
-	*vx = sact.sp[wNum]->loc.x;
-	*vy = sact.sp[wNum]->loc.y;
+	*vx = sp->loc.x;
+	*vy = sp->loc.y;
 	return OK;
 
  errexit:
@@ -568,9 +598,9 @@ int sp_query_size(int wNum, int *vw, int *vh) {
 	
 	if (wNum >= SPRITEMAX) goto errexit;
 
-	sp = sact.sp[wNum];
+	sp = sp_peek(wNum);
 
-	if (sp->type == SPRITE_NONE) goto errexit;
+	if (!sp || sp->type == SPRITE_NONE) goto errexit;
 
 	*vw = sp->cursize.width;
 	*vh = sp->cursize.height;
@@ -585,11 +615,14 @@ int sp_query_size(int wNum, int *vw, int *vh) {
 
 // テキストスプライトの現在の文字表示位置の取得
 int sp_query_textpos(int wNum, int *vx, int *vy) {
+	sprite_t *sp;
+	
 	if (wNum >= SPRITEMAX) goto errexit;
-	if (sact.sp[wNum]->type != SPRITE_MSG) goto errexit;
+	sp = sp_peek(wNum);
+	if (!sp || sp->type != SPRITE_MSG) goto errexit;
 	
-	*vx = sact.sp[wNum]->u.msg.dspcur.x;
-	*vy = sact.sp[wNum]->u.msg.dspcur.y;
+	*vx = sp->u.msg.dspcur.x;
+	*vy = sp->u.msg.dspcur.y;
 	return OK;
 	
  errexit:
@@ -602,16 +635,20 @@ int sp_query_textpos(int wNum, int *vx, int *vy) {
 int sp_num_setcg(int nNum, int nIndex, int nCG) {
 	sp_assert_no(nNum);
 
-	sact.sp[nNum]->numeral.cg[nIndex] = nCG;
+	sp_get(nNum)->numeral.cg[nIndex] = nCG;
 
 	return OK;
 }
 
 // NumeralXXXのCGの取得
 int sp_num_getcg(int nNum, int nIndex, int *vCG) {
+	sprite_t *sp;
+	
 	sp_assert_no(nNum);
 	
-	*vCG = sact.sp[nNum]->numeral.cg[nIndex];
+	// 未作成のページのスプライトは初期値 (0) のまま
+	sp = sp_peek(nNum);
+	*vCG = sp ? sp->numeral.cg[nIndex] : 0;
 	
 	return OK;
 }
@@ -620,18 +657,21 @@ int sp_num_getcg(int nNum, int nIndex, int *vCG) {
 int sp_num_setpos(int nNum, int nX, int nY) {
 	sp_assert_no(nNum);
 
-	sact.sp[nNum]->numeral.pos.x = nX;
-	sact.sp[nNum]->numeral.pos.y = nY;
+	sp_get(nNum)->numeral.pos.x = nX;
+	sp_get(nNum)->numeral.pos.y = nY;
 
 	return OK;
 }
 
 // NumeralXXXの位置の取得
 int sp_num_getpos(int nNum, int *vX, int *vY) {
+	sprite_t *sp;
+	
 	sp_assert_no(nNum);
 	
-	*vX = sact.sp[nNum]->numeral.pos.x;
-	*vY = sact.sp[nNum]->numeral.pos.y;
+	sp = sp_peek(nNum);
+	*vX = sp ? sp->numeral.pos.x : 0;
+	*vY = sp ? sp->numeral.pos.y : 0;
 	
 	return OK;
 }
@@ -640,16 +680,19 @@ int sp_num_getpos(int nNum, int *vX, int *vY) {
 int sp_num_setspan(int nNum, int nSpan) {
 	sp_assert_no(nNum);
 	
-	sact.sp[nNum]->numeral.span = nSpan;
+	sp_get(nNum)->numeral.span = nSpan;
 	
 	return OK;
 }
 
 // NumeralXXXのスパンの取得
 int sp_num_getspan(int nNum, int *vSpan) {
+	sprite_t *sp;
+	
 	sp_assert_no(nNum);
 
-	*vSpan = sact.sp[nNum]->numeral.span;
+	sp = sp_peek(nNum);
+	*vSpan = sp ? sp->numeral.span : 0;
 
 	return OK;
 }
@@ -673,8 +716,8 @@ int sp_exp_add(int nNumSP1, int nNumSP2) {
 	sp_assert_no(nNumSP1);
 	sp_assert_no(nNumSP2);
 
-	swsp  = sact.sp[nNumSP1];
-	expsp = sact.sp[nNumSP2];
+	swsp  = sp_get(nNumSP1);
+	expsp = sp_get(nNumSP2);
 	
 	swsp->expsp = slist_append(swsp->expsp, expsp);
 	
@@ -687,7 +730,7 @@ int sp_exp_del(int nNum) {
 	
 	sp_assert_no(nNum);
 	
-	sp  = sact.sp[nNum];
+	sp  = sp_get(nNum);
 	
 	slist_free(sp->expsp);
 	sp->expsp = NULL;
@@ -701,7 +744,7 @@ int sp_sound_set(int wNumSP, int wNumWave1, int wNumWave2, int wNumWave3) {
 	
 	sp_assert_no(wNumSP);
 
-	sp  = sact.sp[wNumSP];
+	sp  = sp_get(wNumSP);
 	sp->numsound1 = wNumWave1;
 	sp->numsound2 = wNumWave2;
 	sp->numsound3 = wNumWave3;
@@ -720,18 +763,3 @@ int sp_sound_ob(int wNumWave) {
 	sact.numsoundob = wNumWave;
 	return OK;
 }
-
-/**
- * 指定の座標が現在のスプライトの位置の範囲に入っているか？
- * @param sp: 調べる対象のスプライト
- * @param x,y: 座標
- * @return: TRUE:入っている, FALSE: 入っていない
- */
-boolean sp_is_insprite(sprite_t *sp, int x, int y) {
-	uint8_t *dp;
-	
-	if (x < 0 || y < 0 || x >= sf0->width || y >= sf0->height) return FALSE;
-	
-	dp = GETOFFSET_PIXEL(sact.dmap, x, y);
-	return (*(uint16_t *)dp == sp->no);
-}
@@ -28,6 +28,22 @@
 
 #define DEFAULT_UPDATE sp_draw
 
+extern sprite_t *sp_alloc_page(int page);
+
+// 番号 no (0 <= no < SPRITEMAX) のスプライト。未作成のページは作成する
+static inline sprite_t *sp_get(int no) {
+	sprite_t *page = sact.sppage[no >> SPRITE_PAGE_BITS];
+	if (!page)
+		page = sp_alloc_page(no >> SPRITE_PAGE_BITS);
+	return &page[no & (SPRITE_PAGE_SIZE - 1)];
+}
+
+// 番号 no のスプライト。未作成のページなら作成せずに NULL を返す (問い合わせ用)
+static inline sprite_t *sp_peek(int no) {
+	sprite_t *page = sact.sppage[no >> SPRITE_PAGE_BITS];
+	return page ? &page[no & (SPRITE_PAGE_SIZE - 1)] : NULL;
+}
+
 // in sprite.c
 extern int sp_init();
 extern int sp_reset(void);
@@ -48,7 +64,6 @@ extern int sp_thaw_sprite(int wNum);
 extern int sp_add_quakesprite(int wNum);
 extern int sp_clear_quakesprite_all();
 extern int sp_set_animeinterval(int wNum, int wTime);
-extern boolean sp_is_insprite(sprite_t *sp, int x, int y);
 extern int sp_set_blendrate(int wNum, int wCount, int rate);
 extern int sp_query_isexist(int wNum, int *ret);
 extern int sp_query_info(int wNum, int *vtype, int *vcg1, int *vcg2, int *vcg3);
@@ -75,12 +90,13 @@ extern int sp_update_all(boolean syncscreen);
 extern int sp_update_clipped();
 extern int sp_updateme(sprite_t *sp);
 extern int sp_updateme_part(sprite_t *sp, int x, int y, int w, int h);
+extern void sp_update_print_stats(void);
 
 
 // in sprite_draw.c
 extern int sp_draw(sprite_t *sf);
 extern int sp_draw2(sprite_t *sf, cginfo_t *cg);
-extern void sp_draw_dmap(void* data, void* userdata);
+extern sprite_t *sp_hit_test(int x, int y);
 
 
 // in sprite_msg.c
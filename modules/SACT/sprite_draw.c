@@ -35,47 +35,6 @@
 #include "ngraph.h"
 #include "sprite.h"
 
-static void fill_dmap(int dx ,int dy, int w, int h, uint16_t val);
-static void fill_dmap_mask(surface_t *src, int sx, int sy, int dx ,int dy, int w, int h, uint16_t val);
-
-
-
-// 矩形の depthmap を描画
-static void fill_dmap(int dx ,int dy, int w, int h, uint16_t val) {
-	uint8_t *dp, *dp_;
-	int x, y;
-	
-	dp = dp_ = (GETOFFSET_PIXEL(sact.dmap, dx, dy));
-	
-	for (x = 0; x < w; x++) {
-		*((uint16_t *)dp + x) = val;
-	}
-	dp += sact.dmap->bytes_per_line;
-	
-	for (y = 1; y < h; y++) {
-		memcpy(dp, dp_, w * 2);
-		dp += sact.dmap->bytes_per_line;
-	}
-}
-
-// alphamapにしたがって、alpha値が0より大きいところを指定のdepthとする
-static void fill_dmap_mask(surface_t *src, int sx, int sy, int dx ,int dy, int w, int h, uint16_t val) {
-	uint8_t *sp, *dp;
-	int x, y;
-	
-	dp = GETOFFSET_PIXEL(sact.dmap, dx, dy);
-	sp = GETOFFSET_ALPHA(src, sx, sy);
-	
-	for (y = 0; y < h; y++) {
-		uint8_t *yls = (uint8_t *)(sp + y * src->width);
-		uint16_t *yld = (uint16_t *)(dp + y * sact.dmap->bytes_per_line);
-		for (x = 0; x < w; x++) {
-			if (*yls > 0) *yld = val;
-			yls++; yld++;
-		}
-	}
-}
-
 /*
  指定の sprite (の現在のCG)を surface0 に書く
  @param sp: 描画するスプライト
@@ -143,43 +102,45 @@ int sp_draw2(sprite_t *sp, cginfo_t *cg) {
 }
 
 /*
-  スプライトキー待ち用のdepthmap を更新
+  スプライトキー待ち用の当たり判定
+  座標 (x,y) に表示されている一番手前のスプライトを返す。
+  矩形で候補を絞り、alpha map は矩形内に入った時だけ参照する。
+  @param x,y: 座標
+  @return: スプライト (無い場合は NULL)
 */
-void sp_draw_dmap(void* data, void* userdata) {
-	sprite_t *sp = (sprite_t *)data;
-	cginfo_t *cg;
-	surface_t update;
-	int sx, sy, w, h, dx, dy;
-	
-	// 非表示状態の時は無視
-	if (!sp->show) return;
+sprite_t *sp_hit_test(int x, int y) {
+	SList *node;
+	sprite_t *hit = NULL;
 	
-	// ドラッグ中のスプライトは無視
-	if (sp == sact.draggedsp) return;
+	if (x < 0 || y < 0 || x >= sf0->width || y >= sf0->height) return NULL;
 	
-	cg = sp->curcg;
-	if (cg == NULL) return;
-	if (cg->sf == NULL) return;
-	
-	// depth map を書く領域を確定
-	update.width  = sf0->width;
-	update.height = sf0->height;
-	sx = 0;
-	sy = 0;
-	dx = sp->cur.x;
-	dy = sp->cur.y;
-	w = cg->sf->width;
-	h = cg->sf->height;
-	
-	if (!gr_clip(cg->sf, &sx, &sy, &w, &h, &update, &dx, &dy)) {
-		return;
-	}
-	
-	if (cg->sf->alpha) {
-		fill_dmap_mask(cg->sf, sx, sy, dx, dy, w, h, sp->no);
-	} else {
-		fill_dmap(dx, dy, w, h, sp->no);
+	// updatelist は番号の小さい順(奥から手前)に並んでいる
+	for (node = sact.updatelist; node; node = node->next) {
+		sprite_t *sp = (sprite_t *)node->data;
+		cginfo_t *cg;
+		int sx, sy;
+		
+		if (sp == NULL) continue;
+		
+		// 非表示状態の時は無視
+		if (!sp->show) continue;
+		
+		// ドラッグ中のスプライトは無視
+		if (sp == sact.draggedsp) continue;
+		
+		cg = sp->curcg;
+		if (cg == NULL) continue;
+		if (cg->sf == NULL) continue;
+		
+		sx = x - sp->cur.x;
+		sy = y - sp->cur.y;
+		if (sx < 0 || sy < 0 || sx >= cg->sf->width || sy >= cg->sf->height) continue;
+		
+		// alpha値が0のところは透過
+		if (cg->sf->alpha && *GETOFFSET_ALPHA(cg->sf, sx, sy) == 0) continue;
+		
+		hit = sp;
 	}
 	
-	return;
+	return hit;
 }
@@ -275,6 +275,7 @@ void cb_waitkey_sprite(agsevent_t *e) {
 	SList *node;
 	sprite_t *focused_sp = NULL;   // focus を得ている sprite
 	sprite_t *defocused_sp = NULL; // focus を失った sprite
+	sprite_t *hit_sp;              // カーソル位置の一番手前の sprite
 	int update = 0;
 	
 	// キーイベントは無視
@@ -297,6 +298,8 @@ void cb_waitkey_sprite(agsevent_t *e) {
 		}
 	}
 	
+	hit_sp = sp_hit_test(e->mousex, e->mousey);
+	
 	// forcusを得ている sprite と focusを失った sprite を探す
 	for (node = sact.eventlisteners; node; node = node->next) {
 		sprite_t *sp = (sprite_t *)node->data;
@@ -310,7 +313,7 @@ void cb_waitkey_sprite(agsevent_t *e) {
 		// dragg中の sprite は無視する
 		if (sp == sact.draggedsp) continue;
 		
-		if (focused_sp == NULL && sp_is_insprite(sp, e->mousex, e->mousey)) {
+		if (focused_sp == NULL && sp == hit_sp) {
 			/*
 			  focusを得ている sprite
 			*/
@@ -122,9 +122,6 @@ int sp_keywait(int *vOK, int *vRND, int *vD01, int *vD02, int *vD03, int timeout
 	// とりあえず全更新
 	sp_update_all(TRUE);
 	
-	// depthmap を準備
-	slist_foreach(sact.updatelist, sp_draw_dmap, NULL);
-	
 	sact.waittype = KEYWAIT_SPRITE;
 	sact.waitkey = -1;
 	sact.sp_result_sw  = 0;
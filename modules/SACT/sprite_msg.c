@@ -69,11 +69,9 @@ static boolean is_messagesprite(int wNum) {
 	// check sprite number is sane
 	if (wNum >= (SPRITEMAX -1) || wNum <= 0) return FALSE;
 	
-	// check sprite is set
-	if (sact.sp[wNum] == NULL) return FALSE;
-	
 	// check sprite is message sprite
-	if (sact.sp[wNum]->type != SPRITE_MSG) return FALSE;
+	sprite_t *sp = sp_peek(wNum);
+	if (!sp || sp->type != SPRITE_MSG) return FALSE;
 	
 	return TRUE;
 }
@@ -138,8 +136,8 @@ static int setupmark(int wNum1, int wNum2, struct markinfo *minfo) {
 	
 	if (wNum1 == 0 || wNum2 == 0) return 0;
 	
-	sp1 = sact.sp[wNum1];
-	sp2 = sact.sp[wNum2];
+	sp1 = sp_get(wNum1);
+	sp2 = sp_get(wNum2);
 	if (sp1 == NULL || sp2 == NULL) return 0;
 	
 	if (sp1->cg1) {
@@ -254,7 +252,7 @@ void smsg_out(int wNum, int wSize, int wColorR, int wColorG, int wColorB, int wF
 	if (sact.waitskiplv > 1) wSpeed = 0;
 	
 	// shortcut
-	sp = sact.sp[wNum];
+	sp = sp_get(wNum);
 	
 	// update開始Y座標 (X座標は0固定)
 	uparea.y = sp->u.msg.dspcur.y;
@@ -358,7 +356,7 @@ void smsg_clear(int wNum) {
 	if (!is_messagesprite(wNum)) return;
 	
 	// 表示位置の初期化
-	sp = sact.sp[wNum];
+	sp = sp_get(wNum);
 	sp->u.msg.dspcur.x = 0;
 	sp->u.msg.dspcur.y = 0;
 	
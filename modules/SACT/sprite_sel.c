@@ -77,7 +77,7 @@ static boolean sp_is_insprite2(sprite_t *sp, int x, int y, int margin) {
 // マウスが移動したときの callback
 static void cb_select_move(agsevent_t *e) {
 	int x = e->mousex, y = e->mousey;
-	sprite_t *sp = sact.sp[sact.sel.spno];
+	sprite_t *sp = sp_get(sact.sel.spno);
 	boolean newstate;
 	int newindex;
 	
@@ -115,7 +115,7 @@ static void cb_select_move(agsevent_t *e) {
 // ボタンがリリースされたときの callback
 static void cb_select_release(agsevent_t *e) {
 	int x = e->mousex, y = e->mousey;
-	sprite_t *sp = sact.sp[sact.sel.spno];
+	sprite_t *sp = sp_get(sact.sel.spno);
 	boolean st;
 	int iy;
 	
@@ -172,7 +172,7 @@ static int update_selwindow(sprite_t *sp) {
 
 // 選択ウィンドの準備
 static void setup_selwindow() {
-	sprite_t *sp = sact.sp[sact.sel.spno];
+	sprite_t *sp = sp_get(sact.sel.spno);
 	int i;
 	
 	//選択ウィンド作業 surfaceの生成
@@ -213,7 +213,7 @@ static void setup_selwindow() {
 
 // 選択ウィンドの削除
 static void remove_selwindow() {
-	sprite_t *sp = sact.sp[sact.sel.spno];
+	sprite_t *sp = sp_get(sact.sel.spno);
 
 	// スプライト再描画 callback を元にもどす
 	sp->update = sp_draw;
@@ -318,11 +318,8 @@ int ssel_select(int wNum, int wChoiceSize, int wMenuOutSpc, int wChoiceLineSpace
 	// check sprite number is sane
 	if (wNum >= (SPRITEMAX-1) || wNum <= 0) return ret;
 	
-	// check sprite is set
-	if (sact.sp[wNum] == NULL) return ret;
-	
 	// must be normal sprite
-	if (sact.sp[wNum]->type != SPRITE_NORMAL) return ret;
+	if (sp_get(wNum)->type != SPRITE_NORMAL) return ret;
 	
 	sact.sel.spno = wNum;
 	sact.sel.font_size = wChoiceSize;
@@ -332,14 +329,14 @@ int ssel_select(int wNum, int wChoiceSize, int wMenuOutSpc, int wChoiceLineSpace
 	sact.sel.align      = nAlign;
 
 	// 古い sprite の表示フラグを保存
-	saveflag = sact.sp[wNum]->show;
-	sact.sp[wNum]->show = TRUE;
+	saveflag = sp_get(wNum)->show;
+	sp_get(wNum)->show = TRUE;
 	setup_selwindow();
 	
 	ret = sel_main();
 
 	// 表示フラグを元に戻す
-	sact.sp[wNum]->show = saveflag;
+	sp_get(wNum)->show = saveflag;
 	
 	remove_selwindow();
 	
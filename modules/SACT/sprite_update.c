@@ -25,6 +25,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include "portab.h"
 #include "system.h"
@@ -36,54 +38,160 @@
 #include "ngraph.h"
 #include "sprite.h"
 
-// スプライト再描画間の間に変更のあったスプライトの領域の和
-static SList *updatearea;
+// スプライト再描画の間に変更のあった領域 (互いに重ならない矩形の集合)
+#define DAMAGE_MAX 16
+static MyRectangle damage[DAMAGE_MAX];
+static int nr_damage;
 
-static void disjunction(void* region, void* data);
-static void get_updatearea();
-static void do_update_each(void* data, void* userdata);
+// 描画ピクセル数の統計
+static struct {
+	unsigned long frames;
+	uint64_t damaged_pixels;
+	uint64_t drawn_pixels;
+	uint64_t culled_sprites;
+} stats;
 
-// 領域１と領域２をすべて含む矩形領域を計算
-static void disjunction(void* region, void* data) {
-	MyRectangle *r1 = (MyRectangle *)region;
-	MyRectangle *r2 = (MyRectangle *)data;
-	SDL_UnionRect(r1, r2, r2);
-	free(r1);
+static int rect_area(const MyRectangle *r) {
+	return r->w * r->h;
 }
 
-// 更新の必要なスプライトの領域の和をとってクリッピングする
-static void get_updatearea() {
-	MyRectangle clip = {0, 0, 0, 0};
-	MyRectangle rsf0 = {0, 0, sf0->width, sf0->height};
-	
-	slist_foreach(updatearea, disjunction, &clip);
+static boolean rect_contains(const MyRectangle *outer, const MyRectangle *inner) {
+	return outer->x <= inner->x && outer->y <= inner->y &&
+		inner->x + inner->w <= outer->x + outer->w &&
+		inner->y + inner->h <= outer->y + outer->h;
+}
+
+static void remove_damage(int i) {
+	damage[i] = damage[--nr_damage];
+}
+
+// 更新領域を追加する。重なる(または近接していて併合しても無駄の少ない)
+// 領域とは併合し、常に互いに素な矩形の集合を保つ。
+static void add_damage(const MyRectangle *rect) {
+	MyRectangle r = *rect;
 	
-	slist_free(updatearea);
-	updatearea = NULL;
+	if (SDL_RectEmpty(&r)) return;
 	
-	// surface0との領域の積をとる
-	SDL_IntersectRect(&rsf0, &clip, &sact.updaterect);
+	for (int i = 0; i < nr_damage; ) {
+		MyRectangle u;
+		SDL_UnionRect(&damage[i], &r, &u);
+		if (SDL_HasIntersection(&damage[i], &r) ||
+		    rect_area(&u) <= rect_area(&damage[i]) + rect_area(&r)) {
+			r = u;
+			remove_damage(i);
+			i = 0;  // 大きくなった r で最初から調べ直す
+			continue;
+		}
+		i++;
+	}
 	
-	SACT_DEBUG("clipped area x=%d y=%d w=%d h=%d",
-		sact.updaterect.x, sact.updaterect.y,
-		sact.updaterect.w, sact.updaterect.h);
+	if (nr_damage == DAMAGE_MAX) {
+		// 満杯: 併合して増える面積が最小のものと一緒にする
+		int best = 0, best_growth = INT_MAX;
+		for (int i = 0; i < nr_damage; i++) {
+			MyRectangle u;
+			SDL_UnionRect(&damage[i], &r, &u);
+			int growth = rect_area(&u) - rect_area(&damage[i]);
+			if (growth < best_growth) {
+				best = i;
+				best_growth = growth;
+			}
+		}
+		SDL_UnionRect(&damage[best], &r, &r);
+		remove_damage(best);
+		add_damage(&r);
+		return;
+	}
+	damage[nr_damage++] = r;
+}
+
+// スプライトが描画しうる領域。分からない場合は画面全体
+static boolean sprite_bounds(sprite_t *sp, MyRectangle *r) {
+	if (sp->update == sp_draw) {
+		if (!sp->curcg || !sp->curcg->sf) return FALSE;
+		r->w = sp->curcg->sf->width;
+		r->h = sp->curcg->sf->height;
+	} else if (sp->update == smsg_update) {
+		r->w = sp->cursize.width;
+		r->h = sp->cursize.height;
+	} else {
+		// 壁紙や選択ウィンドなど
+		r->x = r->y = 0;
+		r->w = sf0->width;
+		r->h = sf0->height;
+		return TRUE;
+	}
+	r->x = sp->cur.x;
+	r->y = sp->cur.y;
+	return TRUE;
+}
+
+// 自分の矩形を完全に不透明に塗りつぶすスプライトか
+static boolean sprite_is_opaque(sprite_t *sp) {
+	return sp->update == sp_draw && sp->curcg && sp->curcg->sf &&
+		!sp->curcg->sf->alpha && sp->blendrate == 255;
+}
+
+static void draw_sprite(sprite_t *sp, const MyRectangle *bounds, const MyRectangle *region) {
+	MyRectangle r;
+	if (!SDL_IntersectRect(bounds, region, &r)) return;
 	
-	return;
+	sact.updaterect = *region;
+	sp->update(sp);
+	stats.drawn_pixels += rect_area(&r);
 }
 
-// updatelist に登録してあるすべてのスプライトを更新
-static void do_update_each(void* data, void* userdata) {
-	sprite_t *sp = (sprite_t *)data;
+/*
+  指定の各領域について、updatelist のスプライトを番号順に再描画する。
+  ある領域を完全に覆う不透明なスプライトより下のスプライトは描かない。
+*/
+static void redraw_regions(MyRectangle *regions, int n) {
+	// 領域毎に、描画を開始する updatelist 上の位置
+	int floor[DAMAGE_MAX] = {0};
+	uint64_t drawn = stats.drawn_pixels, damaged = 0;
+	SList *node;
+	int i, k;
 	
-	// 非表示の場合はなにもしない
-	if (!sp->show) return;
+	for (node = sact.updatelist, i = 0; node; node = node->next, i++) {
+		sprite_t *sp = (sprite_t *)node->data;
+		MyRectangle b;
+		if (!sp->show || sp == sact.draggedsp) continue;
+		if (!sprite_is_opaque(sp) || !sprite_bounds(sp, &b)) continue;
+		for (k = 0; k < n; k++) {
+			if (rect_contains(&b, &regions[k]))
+				floor[k] = i;
+		}
+	}
 	
-	if (sp == sact.draggedsp) return; // drag中のスプライトは最後に表示
+	for (node = sact.updatelist, i = 0; node; node = node->next, i++) {
+		sprite_t *sp = (sprite_t *)node->data;
+		MyRectangle b;
+		
+		// 非表示の場合はなにもしない
+		if (!sp->show) continue;
 		
-	// スプライト毎のupdateルーチンの呼び出し
-	if (sp->update) {
-		sp->update(sp);
+		if (sp == sact.draggedsp) continue; // drag中のスプライトは最後に表示
+		
+		if (!sp->update || !sprite_bounds(sp, &b)) continue;
+		
+		for (k = 0; k < n; k++) {
+			if (i < floor[k]) {
+				if (SDL_HasIntersection(&b, &regions[k]))
+					stats.culled_sprites++;
+				continue;
+			}
+			// スプライト毎のupdateルーチンの呼び出し
+			draw_sprite(sp, &b, &regions[k]);
+		}
 	}
+	
+	for (k = 0; k < n; k++)
+		damaged += rect_area(&regions[k]);
+	stats.frames++;
+	stats.damaged_pixels += damaged;
+	
+	SACT_DEBUG("%d regions, %llu/%llu pixels drawn/damaged", n,
+		(unsigned long long)(stats.drawn_pixels - drawn), (unsigned long long)damaged);
 }
 
 /*
@@ -102,14 +210,12 @@ int sp_update_all(boolean syncscreen) {
 	}
 
 	// 画面全体を更新領域に
-	sact.updaterect.x = 0;
-	sact.updaterect.y = 0;
-	sact.updaterect.w = sf0->width;
-	sact.updaterect.h = sf0->height;
+	MyRectangle all = {0, 0, sf0->width, sf0->height};
 	
 	// updatelistに登録してあるスプライトを再描画
 	// updatelistはスプライトの番号順に並んでいる
-	slist_foreach(sact.updatelist, do_update_each, NULL);
+	redraw_regions(&all, 1);
+	sact.updaterect = all;
 
 	// このルーチンが呼ばれるときはスプライトはドラッグ中ではない
 	
@@ -127,49 +233,75 @@ int sp_update_all(boolean syncscreen) {
 
 /*
   画面の一部を更新
-   updateme(_part)で登録した更新が必要なspriteの和の領域をupdate
+   updateme(_part)で登録した更新が必要なspriteの領域をupdate
 */
 int sp_update_clipped() {
-	// 更新領域の確定
-	get_updatearea();
+	MyRectangle rsf0 = {0, 0, sf0->width, sf0->height};
+	MyRectangle regions[DAMAGE_MAX];
+	int n = 0;
 	
-	if (SDL_RectEmpty(&sact.updaterect))
+	// 更新領域の確定 (surface0との領域の積をとる)
+	for (int i = 0; i < nr_damage; i++) {
+		if (SDL_IntersectRect(&rsf0, &damage[i], &regions[n]))
+			n++;
+	}
+	nr_damage = 0;
+	
+	if (n == 0)
 		return OK;
-
+	
 	// 更新領域に入っているスプライトの再描画
-	slist_foreach(sact.updatelist, do_update_each, NULL);
+	redraw_regions(regions, n);
 	
 	// drag中のスプライトを最後に描画
 	if (sact.draggedsp) {
-		sact.draggedsp->update(sact.draggedsp);
+		MyRectangle b;
+		if (sprite_bounds(sact.draggedsp, &b)) {
+			for (int k = 0; k < n; k++)
+				draw_sprite(sact.draggedsp, &b, &regions[k]);
+		}
 	}
 	
 	// 更新領域を Window に転送
-	ags_updateArea(sact.updaterect.x, sact.updaterect.y, sact.updaterect.w, sact.updaterect.h);
+	sact.updaterect = regions[0];
+	for (int k = 0; k < n; k++) {
+		MyRectangle *r = &regions[k];
+		SACT_DEBUG("clipped area x=%d y=%d w=%d h=%d", r->x, r->y, r->w, r->h);
+		ags_updateArea(r->x, r->y, r->w, r->h);
+		SDL_UnionRect(&sact.updaterect, r, &sact.updaterect);
+	}
 	
 	return OK;
 }
 
+/*
+  描画統計の表示
+*/
+void sp_update_print_stats(void) {
+	if (!stats.frames)
+		return;
+	NOTICE("SACT sprites: %lu frames, %llu/%llu pixels drawn/damaged (%.1f%%), %llu sprites culled",
+	       stats.frames,
+	       (unsigned long long)stats.drawn_pixels,
+	       (unsigned long long)stats.damaged_pixels,
+	       stats.damaged_pixels ? stats.drawn_pixels * 100.0 / stats.damaged_pixels : 0.0,
+	       (unsigned long long)stats.culled_sprites);
+	memset(&stats, 0, sizeof(stats));
+}
+
 /*
   sprite全体の更新を登録
   @param sp: 更新するスプライト
 */
 int sp_updateme(sprite_t *sp) {
-	MyRectangle *r;
-	
 	if (sp == NULL) return NG;
 	if (sp->cursize.width == 0 || sp->cursize.height == 0) return NG;
 	
-	r = malloc(sizeof(MyRectangle));
-	r->x = sp->cur.x;
-	r->y = sp->cur.y;
-	r->w = sp->cursize.width;
-	r->h = sp->cursize.height;
-	
-	updatearea = slist_append(updatearea, r);
+	MyRectangle r = {sp->cur.x, sp->cur.y, sp->cursize.width, sp->cursize.height};
+	add_damage(&r);
 	
 	SACT_DEBUG("x = %d, y = %d, spno = %d w=%d,h=%d",
-		r->x, r->y, sp->no, r->w, r->h);
+		r.x, r.y, sp->no, r.w, r.h);
 	
 	return OK;
 }
@@ -183,21 +315,14 @@ int sp_updateme(sprite_t *sp) {
   @param h: 更新領域高さ
 */
 int sp_updateme_part(sprite_t *sp, int x, int y, int w, int h) {
-	MyRectangle *r;
-	
 	if (sp == NULL) return NG;
 	if (w == 0 || h == 0) return NG;
 	
-	r = malloc(sizeof(MyRectangle));
-	r->x = sp->cur.x + x;
-	r->y = sp->cur.y + y;
-	r->w = w;
-	r->h = h;
-	
-	updatearea = slist_append(updatearea, r);
+	MyRectangle r = {sp->cur.x + x, sp->cur.y + y, w, h};
+	add_damage(&r);
 	
 	SACT_DEBUG("x = %d, y = %d, spno = %d w=%d,h=%d",
-		r->x, r->y, sp->no, r->w, r->h);
+		r.x, r.y, sp->no, r.w, r.h);
 	
 	return OK;
 }
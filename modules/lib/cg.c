@@ -62,43 +62,16 @@ static CG_TYPE check_cgformat(uint8_t *data) {
 }
 
 /**
- * ファイル等から読み込んだCGデータをsurfaceに展開
+ * 展開済みのCGデータからsurfaceを作成
  *
- * @param b: データ列
- * @return CG が展開された surface
- *         未知の形式のときは NULL が返る
+ * @param cg: 展開済みのCG
+ * @return CG が描画された surface
+ *         PMS/QNT/WebP 以外のときは NULL が返る
  */
-surface_t *sf_getcg(void *b, size_t size) {
+static surface_t *cgdata_to_surface(cgdata *cg) {
 	surface_t *sf = NULL;
-	int type;
-	cgdata *cg = NULL;
 	
-	type = check_cgformat(b);
-	switch(type) {
-	case ALCG_PMS8:
-		cg = pms256_extract(b);
-		break;
-	case ALCG_PMS16:
-		cg = pms64k_extract(b);
-		break;
-	case ALCG_QNT:
-		cg = qnt_extract(b);
-		break;
-#ifdef HAVE_WEBP
-	case ALCG_WEBP:
-		cg = webp_extract(b, size);
-		break;
-#endif
-	default:
-		break;
-	}
-	
-	if (cg == NULL) {
-		WARNING("Unknown Cg Type");
-		return NULL;
-	}
-	
-	switch(type) {
+	switch(cg->type) {
 	case ALCG_PMS8:
 		sf = sf_create_alpha(cg->width, cg->height);
 		gr_draw_amap(sf, cg->x, cg->y, cg->pic, cg->width, cg->height, cg->width);
@@ -126,7 +99,58 @@ surface_t *sf_getcg(void *b, size_t size) {
 			gr_drawimage24(sf, cg, cg->x, cg->y);
 		}
 		break;
+	default:
+		break;
+	}
+	return sf;
+}
+
+/**
+ * ファイル等から読み込んだCGデータを展開
+ *
+ * @param b: データ列
+ * @return 展開された CG
+ *         未知の形式のときは NULL が返る
+ */
+static cgdata *extract(void *b, size_t size) {
+	cgdata *cg = NULL;
+	
+	switch(check_cgformat(b)) {
+	case ALCG_PMS8:
+		cg = pms256_extract(b);
+		break;
+	case ALCG_PMS16:
+		cg = pms64k_extract(b);
+		break;
+	case ALCG_QNT:
+		cg = qnt_extract(b);
+		break;
+#ifdef HAVE_WEBP
+	case ALCG_WEBP:
+		cg = webp_extract(b, size);
+		break;
+#endif
+	default:
+		break;
 	}
+	return cg;
+}
+
+/**
+ * ファイル等から読み込んだCGデータをsurfaceに展開
+ *
+ * @param b: データ列
+ * @return CG が展開された surface
+ *         未知の形式のときは NULL が返る
+ */
+surface_t *sf_getcg(void *b, size_t size) {
+	cgdata *cg = extract(b, size);
+	if (cg == NULL) {
+		WARNING("Unknown Cg Type");
+		return NULL;
+	}
+	
+	surface_t *sf = cgdata_to_surface(cg);
 	cgdata_free(cg);
 	return sf;
 }
@@ -140,14 +164,38 @@ surface_t *sf_getcg(void *b, size_t size) {
 surface_t *sf_loadcg_no(int no) {
 	dridata *dfile;
 	surface_t *sf;
+	cgdata *cg;
+	
+	/* バックグラウンドで展開済みならそれを使う */
+	if (NULL != (cg = cg_prefetch_take(no))) {
+		sf = cgdata_to_surface(cg);
+		cgdata_free(cg);
+		if (sf)
+			return sf;
+	}
+	
+	/* ディスクキャッシュにあればそれを使う */
+	if (NULL != (cg = cg_diskcache_load(no))) {
+		sf = cgdata_to_surface(cg);
+		cgdata_free(cg);
+		if (sf)
+			return sf;
+	}
 	
 	if (NULL == (dfile = ald_getdata(DRIFILE_CG, no))) {
 		return NULL;
 	}
 	
-	sf = sf_getcg(dfile->data, dfile->size);
+	cg = extract(dfile->data, dfile->size);
 	
 	ald_freedata(dfile);
 
+	if (cg == NULL) {
+		WARNING("Unknown Cg Type");
+		return NULL;
+	}
+	cg_diskcache_store(no, cg);
+	sf = cgdata_to_surface(cg);
+	cgdata_free(cg);
 	return sf;
 }
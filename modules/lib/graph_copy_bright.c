@@ -6,9 +6,11 @@
 #include "surface.h"
 #include "ngraph.h"
 #include "ags.h"
+#include "graph_kernel.h"
 
 void gr_copy_bright(surface_t *dst, int dx, int dy, surface_t *src, int sx, int sy, int width, int height, int lv) {
-	int x, y;
+	const gr_kernel_t *k = gr_kernel();
+	int y;
 	uint8_t *sp, *dp;
 	
 	if (!gr_clip(src, &sx, &sy, &width, &height, dst, &dx, &dy)) return;
@@ -20,36 +22,19 @@ void gr_copy_bright(surface_t *dst, int dx, int dy, surface_t *src, int sx, int
 	
 	switch(dst->depth) {
 	case 16:
-		{
-			uint16_t *yls, *yld;
-			
-			for (y = 0; y < height; y++) {
-				yls = (uint16_t *)(sp + y * src->bytes_per_line);
-				yld = (uint16_t *)(dp + y * dst->bytes_per_line);
-				
-				for (x = 0; x < width; x++) {
-					*yld = ALPHALEVEL16(*yls, lv);
-					yls++; yld++;
-				}
-			}
+		for (y = 0; y < height; y++) {
+			k->bright16((uint16_t *)(dp + y * dst->bytes_per_line),
+				    (uint16_t *)(sp + y * src->bytes_per_line),
+				    width, lv);
 		}
 		break;
 	case 24:
 	case 32:
-	{
-		uint32_t *yls, *yld;
-		
 		for (y = 0; y < height; y++) {
-			yls = (uint32_t *)(sp + y * src->bytes_per_line);
-			yld = (uint32_t *)(dp + y * dst->bytes_per_line);
-			
-			for (x = 0; x < width; x++) {
-				*yld = ALPHALEVEL24(*yls, lv);
-				yls++; yld++;
-			}
+			k->bright32((uint32_t *)(dp + y * dst->bytes_per_line),
+				    (uint32_t *)(sp + y * src->bytes_per_line),
+				    width, lv);
 		}
 		break;
 	}
-	}
 }
-
@@ -0,0 +1,684 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "portab.h"
+#include "ags.h"
+#include "graph_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GR_KERNEL_X86
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GR_KERNEL_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * SIMD 版の共通の考え方
+ *
+ * ALPHABLEND の b + (((f - b) * a) >> 8) は (f * a + b * (256 - a)) >> 8 と
+ * 等しく (0 <= a <= 256)、途中の値は 255 * 256 に収まるので符号無し 16bit
+ * の積和で正確に計算できる。a * lv / 255 は (x + 1 + (x >> 8)) >> 8 で
+ * 割り算なしに求まる (0 <= x <= 255 * 255)。
+ * この範囲を外れる lv は scalar 版に任せる。
+ */
+#define DIV255(x) (((x) + 1 + ((x) >> 8)) >> 8)
+
+/******************************************************************************
+ * scalar
+ */
+static void scalar_blend16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n, int lv) {
+	for (int x = 0; x < n; x++)
+		w[x] = ALPHABLEND16(s[x], d[x], lv);
+}
+
+static void scalar_blend32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n, int lv) {
+	for (int x = 0; x < n; x++)
+		w[x] = ALPHABLEND24(s[x], d[x], lv);
+}
+
+static void scalar_blend_amap16(uint16_t *w, const uint16_t *s, const uint16_t *d, const uint8_t *a, int n, int lv) {
+	for (int x = 0; x < n; x++)
+		w[x] = ALPHABLEND16(s[x], d[x], (a[x] * lv) / 255);
+}
+
+static void scalar_blend_amap32(uint32_t *w, const uint32_t *s, const uint32_t *d, const uint8_t *a, int n, int lv) {
+	for (int x = 0; x < n; x++)
+		w[x] = ALPHABLEND24(s[x], d[x], (a[x] * lv) / 255);
+}
+
+static void scalar_bright16(uint16_t *d, const uint16_t *s, int n, int lv) {
+	for (int x = 0; x < n; x++)
+		d[x] = ALPHALEVEL16(s[x], lv);
+}
+
+static void scalar_bright32(uint32_t *d, const uint32_t *s, int n, int lv) {
+	for (int x = 0; x < n; x++)
+		d[x] = ALPHALEVEL24(s[x], lv);
+}
+
+static void scalar_screen16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n) {
+	for (int x = 0; x < n; x++)
+		w[x] = SUTURADD16(s[x], d[x]);
+}
+
+static void scalar_screen32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n) {
+	for (int x = 0; x < n; x++)
+		w[x] = SUTURADD24(s[x], d[x]);
+}
+
+static void scalar_saturadd8(uint8_t *d, const uint8_t *s, int n) {
+	for (int x = 0; x < n; x++)
+		d[x] = (uint8_t)min(255, s[x] + d[x]);
+}
+
+static const gr_kernel_t kernel_scalar = {
+	"scalar",
+	scalar_blend16, scalar_blend32,
+	scalar_blend_amap16, scalar_blend_amap32,
+	scalar_bright16, scalar_bright32,
+	scalar_screen16, scalar_screen32,
+	scalar_saturadd8,
+};
+
+#ifdef GR_KERNEL_X86
+/******************************************************************************
+ * SSE2
+ */
+static inline TARGET_SSE2 __m128i sse2_mix(__m128i f, __m128i b, __m128i a) {
+	__m128i na = _mm_sub_epi16(_mm_set1_epi16(256), a);
+	return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(f, a), _mm_mullo_epi16(b, na)), 8);
+}
+
+static inline TARGET_SSE2 __m128i sse2_div255(__m128i x) {
+	__m128i t = _mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8));
+	return _mm_srli_epi16(t, 8);
+}
+
+// RGB565 を 16bit x 8 の各成分に分解 (PIXR16 等と同じ)
+static inline TARGET_SSE2 __m128i sse2_r16(__m128i p) {
+	return _mm_srli_epi16(_mm_and_si128(p, _mm_set1_epi16((short)RMASK16)), 8);
+}
+static inline TARGET_SSE2 __m128i sse2_g16(__m128i p) {
+	return _mm_srli_epi16(_mm_and_si128(p, _mm_set1_epi16(GMASK16)), 3);
+}
+static inline TARGET_SSE2 __m128i sse2_b16(__m128i p) {
+	return _mm_slli_epi16(_mm_and_si128(p, _mm_set1_epi16(BMASK16)), 3);
+}
+// PIX16 と同じ
+static inline TARGET_SSE2 __m128i sse2_pix16(__m128i r, __m128i g, __m128i b) {
+	r = _mm_slli_epi16(_mm_and_si128(r, _mm_set1_epi16(0xf8)), 8);
+	g = _mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(0xfc)), 3);
+	b = _mm_srli_epi16(b, 3);
+	return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+static inline TARGET_SSE2 __m128i sse2_blend16_8(__m128i vs, __m128i vd, __m128i va) {
+	return sse2_pix16(sse2_mix(sse2_r16(vs), sse2_r16(vd), va),
+			  sse2_mix(sse2_g16(vs), sse2_g16(vd), va),
+			  sse2_mix(sse2_b16(vs), sse2_b16(vd), va));
+}
+
+// 4ピクセル分の alpha を各ピクセルの4チャンネルに広げる
+static inline TARGET_SSE2 void sse2_alpha4(const uint8_t *a, int lv, __m128i *lo, __m128i *hi) {
+	int32_t a4;
+	memcpy(&a4, a, 4);
+	__m128i va = _mm_unpacklo_epi8(_mm_cvtsi32_si128(a4), _mm_setzero_si128());
+	if (lv != 255)
+		va = sse2_div255(_mm_mullo_epi16(va, _mm_set1_epi16(lv)));
+	va = _mm_unpacklo_epi16(va, va);
+	*lo = _mm_unpacklo_epi32(va, va);
+	*hi = _mm_unpackhi_epi32(va, va);
+}
+
+static TARGET_SSE2 void sse2_blend16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m128i va = _mm_set1_epi16(lv);
+		for (; x + 8 <= n; x += 8) {
+			__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+			__m128i vd = _mm_loadu_si128((const __m128i *)(d + x));
+			_mm_storeu_si128((__m128i *)(w + x), sse2_blend16_8(vs, vd, va));
+		}
+	}
+	scalar_blend16(w + x, s + x, d + x, n - x, lv);
+}
+
+static TARGET_SSE2 void sse2_blend32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i mask = _mm_set1_epi32(0x00ffffff);
+		__m128i va = _mm_set1_epi16(lv);
+		for (; x + 4 <= n; x += 4) {
+			__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+			__m128i vd = _mm_loadu_si128((const __m128i *)(d + x));
+			__m128i lo = sse2_mix(_mm_unpacklo_epi8(vs, zero), _mm_unpacklo_epi8(vd, zero), va);
+			__m128i hi = sse2_mix(_mm_unpackhi_epi8(vs, zero), _mm_unpackhi_epi8(vd, zero), va);
+			_mm_storeu_si128((__m128i *)(w + x), _mm_and_si128(_mm_packus_epi16(lo, hi), mask));
+		}
+	}
+	scalar_blend32(w + x, s + x, d + x, n - x, lv);
+}
+
+static TARGET_SSE2 void sse2_blend_amap16(uint16_t *w, const uint16_t *s, const uint16_t *d, const uint8_t *a, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 255) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i vlv = _mm_set1_epi16(lv);
+		for (; x + 8 <= n; x += 8) {
+			__m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(a + x)), zero);
+			if (lv != 255)
+				va = sse2_div255(_mm_mullo_epi16(va, vlv));
+			__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+			__m128i vd = _mm_loadu_si128((const __m128i *)(d + x));
+			_mm_storeu_si128((__m128i *)(w + x), sse2_blend16_8(vs, vd, va));
+		}
+	}
+	scalar_blend_amap16(w + x, s + x, d + x, a + x, n - x, lv);
+}
+
+static TARGET_SSE2 void sse2_blend_amap32(uint32_t *w, const uint32_t *s, const uint32_t *d, const uint8_t *a, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 255) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i mask = _mm_set1_epi32(0x00ffffff);
+		for (; x + 4 <= n; x += 4) {
+			__m128i alo, ahi;
+			sse2_alpha4(a + x, lv, &alo, &ahi);
+			__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+			__m128i vd = _mm_loadu_si128((const __m128i *)(d + x));
+			__m128i lo = sse2_mix(_mm_unpacklo_epi8(vs, zero), _mm_unpacklo_epi8(vd, zero), alo);
+			__m128i hi = sse2_mix(_mm_unpackhi_epi8(vs, zero), _mm_unpackhi_epi8(vd, zero), ahi);
+			_mm_storeu_si128((__m128i *)(w + x), _mm_and_si128(_mm_packus_epi16(lo, hi), mask));
+		}
+	}
+	scalar_blend_amap32(w + x, s + x, d + x, a + x, n - x, lv);
+}
+
+static TARGET_SSE2 void sse2_bright16(uint16_t *d, const uint16_t *s, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m128i vlv = _mm_set1_epi16(lv);
+		for (; x + 8 <= n; x += 8) {
+			__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+			__m128i r = _mm_srli_epi16(_mm_mullo_epi16(sse2_r16(vs), vlv), 8);
+			__m128i g = _mm_srli_epi16(_mm_mullo_epi16(sse2_g16(vs), vlv), 8);
+			__m128i b = _mm_srli_epi16(_mm_mullo_epi16(sse2_b16(vs), vlv), 8);
+			_mm_storeu_si128((__m128i *)(d + x), sse2_pix16(r, g, b));
+		}
+	}
+	scalar_bright16(d + x, s + x, n - x, lv);
+}
+
+static TARGET_SSE2 void sse2_bright32(uint32_t *d, const uint32_t *s, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i mask = _mm_set1_epi32(0x00ffffff);
+		__m128i vlv = _mm_set1_epi16(lv);
+		for (; x + 4 <= n; x += 4) {
+			__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+			__m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(vs, zero), vlv), 8);
+			__m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(vs, zero), vlv), 8);
+			_mm_storeu_si128((__m128i *)(d + x), _mm_and_si128(_mm_packus_epi16(lo, hi), mask));
+		}
+	}
+	scalar_bright32(d + x, s + x, n - x, lv);
+}
+
+static TARGET_SSE2 void sse2_screen16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n) {
+	__m128i max = _mm_set1_epi16(255);
+	int x = 0;
+	for (; x + 8 <= n; x += 8) {
+		__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+		__m128i vd = _mm_loadu_si128((const __m128i *)(d + x));
+		__m128i r = _mm_min_epi16(_mm_add_epi16(sse2_r16(vs), sse2_r16(vd)), max);
+		__m128i g = _mm_min_epi16(_mm_add_epi16(sse2_g16(vs), sse2_g16(vd)), max);
+		__m128i b = _mm_min_epi16(_mm_add_epi16(sse2_b16(vs), sse2_b16(vd)), max);
+		_mm_storeu_si128((__m128i *)(w + x), sse2_pix16(r, g, b));
+	}
+	scalar_screen16(w + x, s + x, d + x, n - x);
+}
+
+static TARGET_SSE2 void sse2_screen32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n) {
+	__m128i mask = _mm_set1_epi32(0x00ffffff);
+	int x = 0;
+	for (; x + 4 <= n; x += 4) {
+		__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+		__m128i vd = _mm_loadu_si128((const __m128i *)(d + x));
+		_mm_storeu_si128((__m128i *)(w + x), _mm_and_si128(_mm_adds_epu8(vs, vd), mask));
+	}
+	scalar_screen32(w + x, s + x, d + x, n - x);
+}
+
+static TARGET_SSE2 void sse2_saturadd8(uint8_t *d, const uint8_t *s, int n) {
+	int x = 0;
+	for (; x + 16 <= n; x += 16) {
+		__m128i vs = _mm_loadu_si128((const __m128i *)(s + x));
+		__m128i vd = _mm_loadu_si128((const __m128i *)(d + x));
+		_mm_storeu_si128((__m128i *)(d + x), _mm_adds_epu8(vs, vd));
+	}
+	scalar_saturadd8(d + x, s + x, n - x);
+}
+
+static const gr_kernel_t kernel_sse2 = {
+	"sse2",
+	sse2_blend16, sse2_blend32,
+	sse2_blend_amap16, sse2_blend_amap32,
+	sse2_bright16, sse2_bright32,
+	sse2_screen16, sse2_screen32,
+	sse2_saturadd8,
+};
+
+/******************************************************************************
+ * AVX2
+ *
+ * unpack/pack は 128bit レーン毎に働くので、32bpp では各レーンが SSE2 版と
+ * 同じ並びになる。端数は SSE2 版に任せる。
+ */
+static inline TARGET_AVX2 __m256i avx2_mix(__m256i f, __m256i b, __m256i a) {
+	__m256i na = _mm256_sub_epi16(_mm256_set1_epi16(256), a);
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(f, a), _mm256_mullo_epi16(b, na)), 8);
+}
+
+static inline TARGET_AVX2 __m256i avx2_div255(__m256i x) {
+	__m256i t = _mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8));
+	return _mm256_srli_epi16(t, 8);
+}
+
+static inline TARGET_AVX2 __m256i avx2_r16(__m256i p) {
+	return _mm256_srli_epi16(_mm256_and_si256(p, _mm256_set1_epi16((short)RMASK16)), 8);
+}
+static inline TARGET_AVX2 __m256i avx2_g16(__m256i p) {
+	return _mm256_srli_epi16(_mm256_and_si256(p, _mm256_set1_epi16(GMASK16)), 3);
+}
+static inline TARGET_AVX2 __m256i avx2_b16(__m256i p) {
+	return _mm256_slli_epi16(_mm256_and_si256(p, _mm256_set1_epi16(BMASK16)), 3);
+}
+static inline TARGET_AVX2 __m256i avx2_pix16(__m256i r, __m256i g, __m256i b) {
+	r = _mm256_slli_epi16(_mm256_and_si256(r, _mm256_set1_epi16(0xf8)), 8);
+	g = _mm256_slli_epi16(_mm256_and_si256(g, _mm256_set1_epi16(0xfc)), 3);
+	b = _mm256_srli_epi16(b, 3);
+	return _mm256_or_si256(_mm256_or_si256(r, g), b);
+}
+
+static inline TARGET_AVX2 __m256i avx2_blend16_16(__m256i vs, __m256i vd, __m256i va) {
+	return avx2_pix16(avx2_mix(avx2_r16(vs), avx2_r16(vd), va),
+			  avx2_mix(avx2_g16(vs), avx2_g16(vd), va),
+			  avx2_mix(avx2_b16(vs), avx2_b16(vd), va));
+}
+
+// 8ピクセル分の alpha を unpacklo/hi の並びに合わせて各チャンネルに広げる
+static inline TARGET_AVX2 void avx2_alpha8(const uint8_t *a, int lv, __m256i *lo, __m256i *hi) {
+	const __m256i ctl_lo = _mm256_setr_epi8(
+		0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5,
+		0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5);
+	const __m256i ctl_hi = _mm256_setr_epi8(
+		8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13,
+		8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13);
+	// a0..a3 が下位レーン、a4..a7 が上位レーンに入る
+	__m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)a));
+	if (lv != 255)
+		va = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(va, _mm256_set1_epi32(lv)), _mm256_set1_epi32(0x8081)), 23);
+	*lo = _mm256_shuffle_epi8(va, ctl_lo);
+	*hi = _mm256_shuffle_epi8(va, ctl_hi);
+}
+
+static TARGET_AVX2 void avx2_blend16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m256i va = _mm256_set1_epi16(lv);
+		for (; x + 16 <= n; x += 16) {
+			__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+			__m256i vd = _mm256_loadu_si256((const __m256i *)(d + x));
+			_mm256_storeu_si256((__m256i *)(w + x), avx2_blend16_16(vs, vd, va));
+		}
+	}
+	sse2_blend16(w + x, s + x, d + x, n - x, lv);
+}
+
+static TARGET_AVX2 void avx2_blend32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m256i zero = _mm256_setzero_si256();
+		__m256i mask = _mm256_set1_epi32(0x00ffffff);
+		__m256i va = _mm256_set1_epi16(lv);
+		for (; x + 8 <= n; x += 8) {
+			__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+			__m256i vd = _mm256_loadu_si256((const __m256i *)(d + x));
+			__m256i lo = avx2_mix(_mm256_unpacklo_epi8(vs, zero), _mm256_unpacklo_epi8(vd, zero), va);
+			__m256i hi = avx2_mix(_mm256_unpackhi_epi8(vs, zero), _mm256_unpackhi_epi8(vd, zero), va);
+			_mm256_storeu_si256((__m256i *)(w + x), _mm256_and_si256(_mm256_packus_epi16(lo, hi), mask));
+		}
+	}
+	sse2_blend32(w + x, s + x, d + x, n - x, lv);
+}
+
+static TARGET_AVX2 void avx2_blend_amap16(uint16_t *w, const uint16_t *s, const uint16_t *d, const uint8_t *a, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 255) {
+		__m256i vlv = _mm256_set1_epi16(lv);
+		for (; x + 16 <= n; x += 16) {
+			__m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + x)));
+			if (lv != 255)
+				va = avx2_div255(_mm256_mullo_epi16(va, vlv));
+			__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+			__m256i vd = _mm256_loadu_si256((const __m256i *)(d + x));
+			_mm256_storeu_si256((__m256i *)(w + x), avx2_blend16_16(vs, vd, va));
+		}
+	}
+	sse2_blend_amap16(w + x, s + x, d + x, a + x, n - x, lv);
+}
+
+static TARGET_AVX2 void avx2_blend_amap32(uint32_t *w, const uint32_t *s, const uint32_t *d, const uint8_t *a, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 255) {
+		__m256i zero = _mm256_setzero_si256();
+		__m256i mask = _mm256_set1_epi32(0x00ffffff);
+		for (; x + 8 <= n; x += 8) {
+			__m256i alo, ahi;
+			avx2_alpha8(a + x, lv, &alo, &ahi);
+			__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+			__m256i vd = _mm256_loadu_si256((const __m256i *)(d + x));
+			__m256i lo = avx2_mix(_mm256_unpacklo_epi8(vs, zero), _mm256_unpacklo_epi8(vd, zero), alo);
+			__m256i hi = avx2_mix(_mm256_unpackhi_epi8(vs, zero), _mm256_unpackhi_epi8(vd, zero), ahi);
+			_mm256_storeu_si256((__m256i *)(w + x), _mm256_and_si256(_mm256_packus_epi16(lo, hi), mask));
+		}
+	}
+	sse2_blend_amap32(w + x, s + x, d + x, a + x, n - x, lv);
+}
+
+static TARGET_AVX2 void avx2_bright16(uint16_t *d, const uint16_t *s, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m256i vlv = _mm256_set1_epi16(lv);
+		for (; x + 16 <= n; x += 16) {
+			__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+			__m256i r = _mm256_srli_epi16(_mm256_mullo_epi16(avx2_r16(vs), vlv), 8);
+			__m256i g = _mm256_srli_epi16(_mm256_mullo_epi16(avx2_g16(vs), vlv), 8);
+			__m256i b = _mm256_srli_epi16(_mm256_mullo_epi16(avx2_b16(vs), vlv), 8);
+			_mm256_storeu_si256((__m256i *)(d + x), avx2_pix16(r, g, b));
+		}
+	}
+	sse2_bright16(d + x, s + x, n - x, lv);
+}
+
+static TARGET_AVX2 void avx2_bright32(uint32_t *d, const uint32_t *s, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		__m256i zero = _mm256_setzero_si256();
+		__m256i mask = _mm256_set1_epi32(0x00ffffff);
+		__m256i vlv = _mm256_set1_epi16(lv);
+		for (; x + 8 <= n; x += 8) {
+			__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+			__m256i lo = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(vs, zero), vlv), 8);
+			__m256i hi = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(vs, zero), vlv), 8);
+			_mm256_storeu_si256((__m256i *)(d + x), _mm256_and_si256(_mm256_packus_epi16(lo, hi), mask));
+		}
+	}
+	sse2_bright32(d + x, s + x, n - x, lv);
+}
+
+static TARGET_AVX2 void avx2_screen16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n) {
+	__m256i max = _mm256_set1_epi16(255);
+	int x = 0;
+	for (; x + 16 <= n; x += 16) {
+		__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+		__m256i vd = _mm256_loadu_si256((const __m256i *)(d + x));
+		__m256i r = _mm256_min_epi16(_mm256_add_epi16(avx2_r16(vs), avx2_r16(vd)), max);
+		__m256i g = _mm256_min_epi16(_mm256_add_epi16(avx2_g16(vs), avx2_g16(vd)), max);
+		__m256i b = _mm256_min_epi16(_mm256_add_epi16(avx2_b16(vs), avx2_b16(vd)), max);
+		_mm256_storeu_si256((__m256i *)(w + x), avx2_pix16(r, g, b));
+	}
+	sse2_screen16(w + x, s + x, d + x, n - x);
+}
+
+static TARGET_AVX2 void avx2_screen32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n) {
+	__m256i mask = _mm256_set1_epi32(0x00ffffff);
+	int x = 0;
+	for (; x + 8 <= n; x += 8) {
+		__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+		__m256i vd = _mm256_loadu_si256((const __m256i *)(d + x));
+		_mm256_storeu_si256((__m256i *)(w + x), _mm256_and_si256(_mm256_adds_epu8(vs, vd), mask));
+	}
+	sse2_screen32(w + x, s + x, d + x, n - x);
+}
+
+static TARGET_AVX2 void avx2_saturadd8(uint8_t *d, const uint8_t *s, int n) {
+	int x = 0;
+	for (; x + 32 <= n; x += 32) {
+		__m256i vs = _mm256_loadu_si256((const __m256i *)(s + x));
+		__m256i vd = _mm256_loadu_si256((const __m256i *)(d + x));
+		_mm256_storeu_si256((__m256i *)(d + x), _mm256_adds_epu8(vs, vd));
+	}
+	sse2_saturadd8(d + x, s + x, n - x);
+}
+
+static const gr_kernel_t kernel_avx2 = {
+	"avx2",
+	avx2_blend16, avx2_blend32,
+	avx2_blend_amap16, avx2_blend_amap32,
+	avx2_bright16, avx2_bright32,
+	avx2_screen16, avx2_screen32,
+	avx2_saturadd8,
+};
+#endif /* GR_KERNEL_X86 */
+
+#ifdef GR_KERNEL_NEON
+/******************************************************************************
+ * NEON
+ */
+static inline uint16x8_t neon_mix(uint16x8_t f, uint16x8_t b, uint16x8_t a) {
+	uint16x8_t na = vsubq_u16(vdupq_n_u16(256), a);
+	return vshrq_n_u16(vmlaq_u16(vmulq_u16(f, a), b, na), 8);
+}
+
+static inline uint16x8_t neon_r16(uint16x8_t p) {
+	return vshrq_n_u16(vandq_u16(p, vdupq_n_u16(RMASK16)), 8);
+}
+static inline uint16x8_t neon_g16(uint16x8_t p) {
+	return vshrq_n_u16(vandq_u16(p, vdupq_n_u16(GMASK16)), 3);
+}
+static inline uint16x8_t neon_b16(uint16x8_t p) {
+	return vshlq_n_u16(vandq_u16(p, vdupq_n_u16(BMASK16)), 3);
+}
+static inline uint16x8_t neon_pix16(uint16x8_t r, uint16x8_t g, uint16x8_t b) {
+	r = vshlq_n_u16(vandq_u16(r, vdupq_n_u16(0xf8)), 8);
+	g = vshlq_n_u16(vandq_u16(g, vdupq_n_u16(0xfc)), 3);
+	b = vshrq_n_u16(b, 3);
+	return vorrq_u16(vorrq_u16(r, g), b);
+}
+
+static inline uint16x8_t neon_blend16_8(uint16x8_t vs, uint16x8_t vd, uint16x8_t va) {
+	return neon_pix16(neon_mix(neon_r16(vs), neon_r16(vd), va),
+			  neon_mix(neon_g16(vs), neon_g16(vd), va),
+			  neon_mix(neon_b16(vs), neon_b16(vd), va));
+}
+
+// 4ピクセル分 (16byte) の 32bpp を a_lo, a_hi で合成
+static inline uint8x16_t neon_blend32_4(uint8x16_t vs, uint8x16_t vd, uint16x8_t alo, uint16x8_t ahi) {
+	uint16x8_t lo = neon_mix(vmovl_u8(vget_low_u8(vs)), vmovl_u8(vget_low_u8(vd)), alo);
+	uint16x8_t hi = neon_mix(vmovl_u8(vget_high_u8(vs)), vmovl_u8(vget_high_u8(vd)), ahi);
+	uint8x16_t r = vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+	return vandq_u8(r, vreinterpretq_u8_u32(vdupq_n_u32(0x00ffffff)));
+}
+
+static void neon_blend16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		uint16x8_t va = vdupq_n_u16(lv);
+		for (; x + 8 <= n; x += 8)
+			vst1q_u16(w + x, neon_blend16_8(vld1q_u16(s + x), vld1q_u16(d + x), va));
+	}
+	scalar_blend16(w + x, s + x, d + x, n - x, lv);
+}
+
+static void neon_blend32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		uint16x8_t va = vdupq_n_u16(lv);
+		for (; x + 4 <= n; x += 4) {
+			uint8x16_t vs = vld1q_u8((const uint8_t *)(s + x));
+			uint8x16_t vd = vld1q_u8((const uint8_t *)(d + x));
+			vst1q_u8((uint8_t *)(w + x), neon_blend32_4(vs, vd, va, va));
+		}
+	}
+	scalar_blend32(w + x, s + x, d + x, n - x, lv);
+}
+
+static void neon_blend_amap16(uint16_t *w, const uint16_t *s, const uint16_t *d, const uint8_t *a, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 255) {
+		uint16x8_t vlv = vdupq_n_u16(lv);
+		for (; x + 8 <= n; x += 8) {
+			uint16x8_t va = vmovl_u8(vld1_u8(a + x));
+			if (lv != 255) {
+				uint16x8_t t = vmulq_u16(va, vlv);
+				va = vshrq_n_u16(vaddq_u16(vaddq_u16(t, vdupq_n_u16(1)), vshrq_n_u16(t, 8)), 8);
+			}
+			vst1q_u16(w + x, neon_blend16_8(vld1q_u16(s + x), vld1q_u16(d + x), va));
+		}
+	}
+	scalar_blend_amap16(w + x, s + x, d + x, a + x, n - x, lv);
+}
+
+static void neon_blend_amap32(uint32_t *w, const uint32_t *s, const uint32_t *d, const uint8_t *a, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 255) {
+		for (; x + 4 <= n; x += 4) {
+			uint16_t a0 = DIV255(a[x    ] * lv);
+			uint16_t a1 = DIV255(a[x + 1] * lv);
+			uint16_t a2 = DIV255(a[x + 2] * lv);
+			uint16_t a3 = DIV255(a[x + 3] * lv);
+			uint16x8_t alo = vcombine_u16(vdup_n_u16(a0), vdup_n_u16(a1));
+			uint16x8_t ahi = vcombine_u16(vdup_n_u16(a2), vdup_n_u16(a3));
+			uint8x16_t vs = vld1q_u8((const uint8_t *)(s + x));
+			uint8x16_t vd = vld1q_u8((const uint8_t *)(d + x));
+			vst1q_u8((uint8_t *)(w + x), neon_blend32_4(vs, vd, alo, ahi));
+		}
+	}
+	scalar_blend_amap32(w + x, s + x, d + x, a + x, n - x, lv);
+}
+
+static void neon_bright16(uint16_t *d, const uint16_t *s, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		uint16x8_t vlv = vdupq_n_u16(lv);
+		for (; x + 8 <= n; x += 8) {
+			uint16x8_t vs = vld1q_u16(s + x);
+			uint16x8_t r = vshrq_n_u16(vmulq_u16(neon_r16(vs), vlv), 8);
+			uint16x8_t g = vshrq_n_u16(vmulq_u16(neon_g16(vs), vlv), 8);
+			uint16x8_t b = vshrq_n_u16(vmulq_u16(neon_b16(vs), vlv), 8);
+			vst1q_u16(d + x, neon_pix16(r, g, b));
+		}
+	}
+	scalar_bright16(d + x, s + x, n - x, lv);
+}
+
+static void neon_bright32(uint32_t *d, const uint32_t *s, int n, int lv) {
+	int x = 0;
+	if (lv >= 0 && lv <= 256) {
+		uint16x8_t vlv = vdupq_n_u16(lv);
+		uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(0x00ffffff));
+		for (; x + 4 <= n; x += 4) {
+			uint8x16_t vs = vld1q_u8((const uint8_t *)(s + x));
+			uint16x8_t lo = vshrq_n_u16(vmulq_u16(vmovl_u8(vget_low_u8(vs)), vlv), 8);
+			uint16x8_t hi = vshrq_n_u16(vmulq_u16(vmovl_u8(vget_high_u8(vs)), vlv), 8);
+			vst1q_u8((uint8_t *)(d + x), vandq_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)), mask));
+		}
+	}
+	scalar_bright32(d + x, s + x, n - x, lv);
+}
+
+static void neon_screen16(uint16_t *w, const uint16_t *s, const uint16_t *d, int n) {
+	uint16x8_t max = vdupq_n_u16(255);
+	int x = 0;
+	for (; x + 8 <= n; x += 8) {
+		uint16x8_t vs = vld1q_u16(s + x);
+		uint16x8_t vd = vld1q_u16(d + x);
+		uint16x8_t r = vminq_u16(vaddq_u16(neon_r16(vs), neon_r16(vd)), max);
+		uint16x8_t g = vminq_u16(vaddq_u16(neon_g16(vs), neon_g16(vd)), max);
+		uint16x8_t b = vminq_u16(vaddq_u16(neon_b16(vs), neon_b16(vd)), max);
+		vst1q_u16(w + x, neon_pix16(r, g, b));
+	}
+	scalar_screen16(w + x, s + x, d + x, n - x);
+}
+
+static void neon_screen32(uint32_t *w, const uint32_t *s, const uint32_t *d, int n) {
+	uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(0x00ffffff));
+	int x = 0;
+	for (; x + 4 <= n; x += 4) {
+		uint8x16_t vs = vld1q_u8((const uint8_t *)(s + x));
+		uint8x16_t vd = vld1q_u8((const uint8_t *)(d + x));
+		vst1q_u8((uint8_t *)(w + x), vandq_u8(vqaddq_u8(vs, vd), mask));
+	}
+	scalar_screen32(w + x, s + x, d + x, n - x);
+}
+
+static void neon_saturadd8(uint8_t *d, const uint8_t *s, int n) {
+	int x = 0;
+	for (; x + 16 <= n; x += 16)
+		vst1q_u8(d + x, vqaddq_u8(vld1q_u8(s + x), vld1q_u8(d + x)));
+	scalar_saturadd8(d + x, s + x, n - x);
+}
+
+static const gr_kernel_t kernel_neon = {
+	"neon",
+	neon_blend16, neon_blend32,
+	neon_blend_amap16, neon_blend_amap32,
+	neon_bright16, neon_bright32,
+	neon_screen16, neon_screen32,
+	neon_saturadd8,
+};
+#endif /* GR_KERNEL_NEON */
+
+int gr_kernel_list(const gr_kernel_t **list, int max) {
+	int n = 0;
+	
+	if (n < max) list[n++] = &kernel_scalar;
+#ifdef GR_KERNEL_X86
+	__builtin_cpu_init();
+	if (n < max && __builtin_cpu_supports("sse2")) list[n++] = &kernel_sse2;
+	if (n < max && __builtin_cpu_supports("sse2") && __builtin_cpu_supports("avx2")) list[n++] = &kernel_avx2;
+#endif
+#ifdef GR_KERNEL_NEON
+	if (n < max) list[n++] = &kernel_neon;
+#endif
+	return n;
+}
+
+const gr_kernel_t *gr_kernel(void) {
+	static const gr_kernel_t *selected;
+	
+	if (!selected) {
+		const gr_kernel_t *list[4];
+		int n = gr_kernel_list(list, 4);
+		selected = list[n - 1];
+	}
+	return selected;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __GRAPH_KERNEL_H__
+#define __GRAPH_KERNEL_H__
+
+#include <stdint.h>
+
+/*
+ * 1ライン分のピクセル演算カーネル
+ *
+ * gre_Blend 等の関数は矩形のクリップとライン毎のアドレス計算だけを行い、
+ * 実際の演算はここのカーネルに任せる。実装は起動時に CPU の機能を見て
+ * 選択される (AVX2 > SSE2 > NEON > scalar)。どの実装も scalar 版
+ * (ags.h の ALPHABLEND16 等のマクロ) と 1ピクセルも違わない結果を返す。
+ *
+ * w と d は同じライン (in-place) でも良いが、ずれて重なってはいけない。
+ * 32bpp の結果の最上位バイトは常に 0。
+ */
+typedef struct {
+	const char *name;
+	
+	// w = ALPHABLEND(s, d, lv)
+	void (*blend16)(uint16_t *w, const uint16_t *s, const uint16_t *d, int n, int lv);
+	void (*blend32)(uint32_t *w, const uint32_t *s, const uint32_t *d, int n, int lv);
+	
+	// w = ALPHABLEND(s, d, a * lv / 255)
+	void (*blend_amap16)(uint16_t *w, const uint16_t *s, const uint16_t *d, const uint8_t *a, int n, int lv);
+	void (*blend_amap32)(uint32_t *w, const uint32_t *s, const uint32_t *d, const uint8_t *a, int n, int lv);
+	
+	// d = ALPHALEVEL(s, lv)
+	void (*bright16)(uint16_t *d, const uint16_t *s, int n, int lv);
+	void (*bright32)(uint32_t *d, const uint32_t *s, int n, int lv);
+	
+	// w = SUTURADD(s, d)
+	void (*screen16)(uint16_t *w, const uint16_t *s, const uint16_t *d, int n);
+	void (*screen32)(uint32_t *w, const uint32_t *s, const uint32_t *d, int n);
+	
+	// d = min(255, d + s)  (alpha map)
+	void (*saturadd8)(uint8_t *d, const uint8_t *s, int n);
+} gr_kernel_t;
+
+// 現在の CPU で使える最速の実装
+extern const gr_kernel_t *gr_kernel(void);
+
+// 現在の CPU で使える全ての実装 (先頭は scalar)。テスト用
+extern int gr_kernel_list(const gr_kernel_t **list, int max);
+
+#endif /* __GRAPH_KERNEL_H__ */
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "graph_kernel.h"
+#include "unittest.h"
+
+#define MAXLEN 67
+
+static const int levels[] = { 0, 1, 2, 64, 127, 128, 129, 200, 254, 255, 256 };
+
+static uint32_t seed = 12345;
+
+static uint32_t rnd(void) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8 | seed << 24;
+}
+
+static void fill_random(void *buf, size_t size) {
+	uint8_t *p = buf;
+	for (size_t i = 0; i < size; i++)
+		p[i] = rnd();
+	// 飽和や 0 の境界を踏むように、端の値を混ぜておく
+	for (size_t i = 0; i < size; i += 7)
+		p[i] = (i & 8) ? 0xff : 0x00;
+}
+
+#define ASSERT_SAME(actual, expected, size, k, op, lv, n)	\
+	assert_same(actual, expected, size, k, op, lv, n, __FILE__, __LINE__)
+
+static void assert_same(const void *actual, const void *expected, size_t size, const gr_kernel_t *k, const char *op, int lv, int n, const char *file, int line) {
+	if (memcmp(actual, expected, size)) {
+		fprintf(stderr, "%s:%d %s.%s differs from scalar (lv=%d, n=%d)\n", file, line, k->name, op, lv, n);
+		exit(1);
+	}
+}
+
+static void check_kernel(const gr_kernel_t *ref, const gr_kernel_t *k) {
+	uint16_t s16[MAXLEN], d16[MAXLEN], w16[MAXLEN], e16[MAXLEN];
+	uint32_t s32[MAXLEN], d32[MAXLEN], w32[MAXLEN], e32[MAXLEN];
+	uint8_t a[MAXLEN], s8[MAXLEN], w8[MAXLEN], e8[MAXLEN];
+	
+	for (int n = 0; n <= MAXLEN; n++) {
+		for (int i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+			int lv = levels[i];
+			
+			fill_random(s16, sizeof(s16)); fill_random(d16, sizeof(d16));
+			fill_random(s32, sizeof(s32)); fill_random(d32, sizeof(d32));
+			fill_random(a, sizeof(a)); fill_random(s8, sizeof(s8));
+			
+			ref->blend16(e16, s16, d16, n, lv);
+			k->blend16(w16, s16, d16, n, lv);
+			ASSERT_SAME(w16, e16, n * 2, k, "blend16", lv, n);
+			ref->blend32(e32, s32, d32, n, lv);
+			k->blend32(w32, s32, d32, n, lv);
+			ASSERT_SAME(w32, e32, n * 4, k, "blend32", lv, n);
+			
+			if (lv <= 255) {
+				ref->blend_amap16(e16, s16, d16, a, n, lv);
+				k->blend_amap16(w16, s16, d16, a, n, lv);
+				ASSERT_SAME(w16, e16, n * 2, k, "blend_amap16", lv, n);
+				ref->blend_amap32(e32, s32, d32, a, n, lv);
+				k->blend_amap32(w32, s32, d32, a, n, lv);
+				ASSERT_SAME(w32, e32, n * 4, k, "blend_amap32", lv, n);
+			}
+			
+			ref->bright16(e16, s16, n, lv);
+			k->bright16(w16, s16, n, lv);
+			ASSERT_SAME(w16, e16, n * 2, k, "bright16", lv, n);
+			ref->bright32(e32, s32, n, lv);
+			k->bright32(w32, s32, n, lv);
+			ASSERT_SAME(w32, e32, n * 4, k, "bright32", lv, n);
+			
+			ref->screen16(e16, s16, d16, n);
+			k->screen16(w16, s16, d16, n);
+			ASSERT_SAME(w16, e16, n * 2, k, "screen16", 0, n);
+			ref->screen32(e32, s32, d32, n);
+			k->screen32(w32, s32, d32, n);
+			ASSERT_SAME(w32, e32, n * 4, k, "screen32", 0, n);
+			
+			memcpy(e8, a, sizeof(a));
+			memcpy(w8, a, sizeof(a));
+			ref->saturadd8(e8, s8, n);
+			k->saturadd8(w8, s8, n);
+			ASSERT_SAME(w8, e8, n, k, "saturadd8", 0, n);
+			
+			// in-place (gre_Blend(sf0, .., sf0, ..) の形)
+			memcpy(e32, d32, sizeof(d32));
+			memcpy(w32, d32, sizeof(d32));
+			ref->blend32(e32, s32, e32, n, lv);
+			k->blend32(w32, s32, w32, n, lv);
+			ASSERT_SAME(w32, e32, n * 4, k, "blend32 (in-place)", lv, n);
+		}
+	}
+}
+
+// 全ての alpha 値と lv の組み合わせ
+static void check_alpha_levels(const gr_kernel_t *ref, const gr_kernel_t *k) {
+	uint32_t s32[256], d32[256], w32[256], e32[256];
+	uint16_t s16[256], d16[256], w16[256], e16[256];
+	uint8_t a[256];
+	
+	for (int i = 0; i < 256; i++) {
+		a[i] = i;
+		s32[i] = 0xffffffff;
+		d32[i] = 0x00000000;
+		s16[i] = 0xffff;
+		d16[i] = 0x0000;
+	}
+	for (int lv = 0; lv <= 255; lv++) {
+		ref->blend_amap32(e32, s32, d32, a, 256, lv);
+		k->blend_amap32(w32, s32, d32, a, 256, lv);
+		ASSERT_SAME(w32, e32, sizeof(e32), k, "blend_amap32", lv, 256);
+		ref->blend_amap32(e32, d32, s32, a, 256, lv);
+		k->blend_amap32(w32, d32, s32, a, 256, lv);
+		ASSERT_SAME(w32, e32, sizeof(e32), k, "blend_amap32", lv, 256);
+		ref->blend_amap16(e16, s16, d16, a, 256, lv);
+		k->blend_amap16(w16, s16, d16, a, 256, lv);
+		ASSERT_SAME(w16, e16, sizeof(e16), k, "blend_amap16", lv, 256);
+	}
+}
+
+void graph_kernel_test(void) {
+	const gr_kernel_t *list[8];
+	int n = gr_kernel_list(list, 8);
+	
+	ASSERT_TRUE(n >= 1);
+	ASSERT_STRCMP(list[0]->name, "scalar");
+	ASSERT_EQUAL_PTR(gr_kernel(), list[n - 1]);
+	
+	for (int i = 1; i < n; i++) {
+		check_kernel(list[0], list[i]);
+		check_alpha_levels(list[0], list[i]);
+	}
+}
@@ -7,10 +7,12 @@
 #include "surface.h"
 #include "ngraph.h"
 #include "ags.h"
+#include "graph_kernel.h"
 
 int gr_saturadd_alpha_map(surface_t *dst, int dx, int dy, surface_t *src, int sx, int sy, int sw, int sh) {
+	const gr_kernel_t *k = gr_kernel();
 	uint8_t *sp, *dp;
-	int x, y;
+	int y;
 	
 	if (FALSE == gr_clip(src, &sx, &sy, &sw, &sh, dst, &dx, &dy)) {
 		return NG;
@@ -30,13 +32,7 @@ int gr_saturadd_alpha_map(surface_t *dst, int dx, int dy, surface_t *src, int sx
 	dp = GETOFFSET_ALPHA(dst, dx, dy);
 	
 	for (y = 0; y < sh; y++) {
-		uint8_t *yls = sp + y * src->width;
-		uint8_t *yld = dp + y * dst->width;
-		for (x = 0; x < sw; x++) {
-			int s = *yls, d = *yld;
-			*yld = (uint8_t)(min(255, (s + d)));
-			yls++; yld++;
-		}
+		k->saturadd8(dp + y * dst->width, sp + y * src->width, sw);
 	}
 	
 	return OK;
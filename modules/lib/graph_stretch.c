@@ -4,85 +4,399 @@
 #include <string.h>
 
 #include "portab.h"
+#include "system.h"
 #include "surface.h"
 #include "ngraph.h"
 #include "ags.h"
+#include "graph_kernel.h"
 
-void gr_copy_stretch(surface_t *dst, int dx, int dy, int dw, int dh, surface_t *src, int sx, int sy, int sw, int sh) {
-	float    a1, a2, xd, yd;
-	int      *row, *col;
-	int      x, y;
-	uint8_t  *sp, *dp;
-	
-	if (!gr_clip_xywh(dst, &dx, &dy, &dw, &dh)) return;
-	if (!gr_clip_xywh(src, &sx, &sy, &sw, &sh)) return;
-	
-	sp = GETOFFSET_PIXEL(src, sx, sy);
-	dp = GETOFFSET_PIXEL(dst, dx, dy);
-	
-	a1  = (float)sw / (float)dw;
-	a2  = (float)sh / (float)dh;
-	
-	// src width と dst width が同じときに問題があるので+1
-	row = calloc(dw+1, sizeof(int));
-	// 1おおきくして初期化しないと col[dw-1]とcol[dw]が同じになる
-	// 可能性がある。
-	col = calloc(dh+1, sizeof(int));
-	
-	for (yd = 0.0, y = 0; y < dh; y++) {
-		col[y] = yd; yd += a2;
-	}
-	
-	for (xd = 0.0, x = 0; x < dw; x++) {
-		row[x] = xd; xd += a1;
-	}
-	
-	switch(dst->depth) {
-	case 16:
-	{
-		uint16_t *yls, *yld;
-		uint8_t *_yls, *_yld;
-		
-		for (y = 0; y < dh; y++) {
-			yls = (uint16_t *)(sp + *(y + col) * src->bytes_per_line);
-			yld = (uint16_t *)(dp +   y        * dst->bytes_per_line);
-			for (x = 0; x < dw; x++) {
-				*(yld + x) = *(yls + *(row + x));
-			}
-			_yld = (uint8_t *)yld;
-			while(*(col + y) == *(col + y + 1)) {
-				_yls = _yld;
-				_yld += dst->bytes_per_line;
-				memcpy(_yld, _yls, dw * 2);
-				y++;
-			}
+/*
+  1軸分の座標テーブル
+
+  (src の長さ, dst の長さ, 反転, フィルタ) 毎に作って使い回す。
+  ズーム効果のように同じ大きさの拡大縮小を毎フレーム行う場合に
+  テーブルを作り直さずに済む。
+
+  NEAREST:  idx0 = 参照する src の座標
+  BILINEAR: idx0, idx1 の間を frac (idx1 の重み, 0-255) で補間
+  AREA:     idx0 <= x < idx1 の範囲を平均
+*/
+typedef struct {
+	int slen, dlen;
+	boolean mirror;
+	enum stretch_filter filter;
+	int *idx0;
+	int *idx1;
+	uint8_t *frac;
+	unsigned lru;
+} stretch_axis_t;
+
+#define AXIS_CACHE_SIZE 8
+static stretch_axis_t axis_cache[AXIS_CACHE_SIZE];
+static unsigned axis_clock;
+
+// 従来と同じ float の累積で座標を求める (結果を変えないため)
+static void axis_nearest(stretch_axis_t *a) {
+	float step = (float)a->slen / (float)a->dlen;
+	float pos;
+	int i;
+
+	if (a->mirror) {
+		for (pos = a->slen - step, i = 0; i < a->dlen; i++) {
+			a->idx0[i] = pos; pos -= step;
 		}
+	} else {
+		for (pos = 0.0, i = 0; i < a->dlen; i++) {
+			a->idx0[i] = pos; pos += step;
+		}
+	}
+	for (i = 0; i < a->dlen; i++) {
+		a->idx0[i] = max(0, min(a->slen - 1, a->idx0[i]));
+	}
+}
+
+// dst のピクセル中心に対応する src の位置を 16.16 の固定小数点で求める
+static void axis_bilinear(stretch_axis_t *a) {
+	int i;
+
+	for (i = 0; i < a->dlen; i++) {
+		int64_t pos = ((int64_t)(2 * i + 1) * a->slen << 16) / (2 * a->dlen) - 0x8000;
+		int i0, i1;
+
+		if (pos < 0) pos = 0;
+		i0 = pos >> 16;
+		i1 = i0 + 1;
+		if (i1 >= a->slen) {
+			i0 = i1 = a->slen - 1;
+			pos = 0;
+		}
+		a->frac[i] = (pos >> 8) & 0xff;
+		if (a->mirror) {
+			i0 = a->slen - 1 - i0;
+			i1 = a->slen - 1 - i1;
+		}
+		a->idx0[i] = i0;
+		a->idx1[i] = i1;
+	}
+}
+
+// 拡大の場合は範囲が1ピクセルになるので最近傍と同じ
+static void axis_area(stretch_axis_t *a) {
+	int i;
+
+	for (i = 0; i < a->dlen; i++) {
+		int s0 = (int64_t)i * a->slen / a->dlen;
+		int s1 = (int64_t)(i + 1) * a->slen / a->dlen;
+
+		if (s1 <= s0) s1 = s0 + 1;
+		if (a->mirror) {
+			int t = s0;
+			s0 = a->slen - s1;
+			s1 = a->slen - t;
+		}
+		a->idx0[i] = s0;
+		a->idx1[i] = s1;
+	}
+}
+
+static stretch_axis_t *get_axis(int slen, int dlen, boolean mirror, enum stretch_filter filter) {
+	stretch_axis_t *a, *victim = &axis_cache[0];
+
+	axis_clock++;
+	for (a = axis_cache; a < axis_cache + AXIS_CACHE_SIZE; a++) {
+		if (a->idx0 && a->slen == slen && a->dlen == dlen &&
+		    a->mirror == mirror && a->filter == filter) {
+			a->lru = axis_clock;
+			return a;
+		}
+		if (a->lru < victim->lru) victim = a;
+	}
+
+	a = victim;
+	free(a->idx0);
+	free(a->idx1);
+	free(a->frac);
+	a->slen = slen;
+	a->dlen = dlen;
+	a->mirror = mirror;
+	a->filter = filter;
+	a->idx0 = malloc(sizeof(int) * dlen);
+	a->idx1 = malloc(sizeof(int) * dlen);
+	a->frac = malloc(dlen);
+	if (!a->idx0 || !a->idx1 || !a->frac) {
+		NOMEMERR();
+	}
+
+	switch (filter) {
+	case STRETCH_BILINEAR:
+		axis_bilinear(a);
+		break;
+	case STRETCH_AREA:
+		axis_area(a);
+		break;
+	default:
+		axis_nearest(a);
 		break;
 	}
-	case 24:
-	case 32:
+	a->lru = axis_clock;
+	return a;
+}
+
+static void stretch_nearest(uint8_t *dp, int dpitch, uint8_t *sp, int spitch, int bpp, stretch_axis_t *ax, stretch_axis_t *ay) {
+	int x, y, dw = ax->dlen;
+
+	for (y = 0; y < ay->dlen; y++) {
+		uint8_t *dl = dp + y * dpitch;
+		uint8_t *sl = sp + ay->idx0[y] * spitch;
+
+		// 同じ src の行は直前の行をコピー
+		if (y > 0 && ay->idx0[y] == ay->idx0[y - 1]) {
+			memcpy(dl, dl - dpitch, dw * bpp);
+			continue;
+		}
+		switch (bpp) {
+		case 1:
+			for (x = 0; x < dw; x++)
+				dl[x] = sl[ax->idx0[x]];
+			break;
+		case 2:
+			for (x = 0; x < dw; x++)
+				((uint16_t *)dl)[x] = ((uint16_t *)sl)[ax->idx0[x]];
+			break;
+		case 4:
+			for (x = 0; x < dw; x++)
+				((uint32_t *)dl)[x] = ((uint32_t *)sl)[ax->idx0[x]];
+			break;
+		}
+	}
+}
+
+// src の1行を横方向に補間する
+static void hlerp(uint8_t *dl, uint8_t *sl, int bpp, stretch_axis_t *ax) {
+	int x;
+
+	switch (bpp) {
+	case 1:
+		for (x = 0; x < ax->dlen; x++) {
+			int p0 = sl[ax->idx0[x]], p1 = sl[ax->idx1[x]];
+			dl[x] = p0 + (((p1 - p0) * ax->frac[x]) >> 8);
+		}
+		break;
+	case 2:
+	{
+		uint16_t *s = (uint16_t *)sl, *d = (uint16_t *)dl;
+		for (x = 0; x < ax->dlen; x++)
+			d[x] = ALPHABLEND16(s[ax->idx1[x]], s[ax->idx0[x]], ax->frac[x]);
+		break;
+	}
+	case 4:
 	{
-		uint32_t *yls, *yld;
-		uint8_t  *_yls, *_yld;
-		
-		for (y = 0; y < dh; y++) {
-			yls = (uint32_t *)(sp + *(y + col) * src->bytes_per_line);
-			yld = (uint32_t *)(dp +   y        * dst->bytes_per_line);
+		uint32_t *s = (uint32_t *)sl, *d = (uint32_t *)dl;
+		for (x = 0; x < ax->dlen; x++)
+			d[x] = ALPHABLEND24(s[ax->idx1[x]], s[ax->idx0[x]], ax->frac[x]);
+		break;
+	}
+	}
+}
+
+/*
+  横方向に補間した2行を縦方向に補間する。
+  縦方向は ALPHABLEND そのものなので graph_kernel の blend を使う。
+*/
+static void stretch_bilinear(uint8_t *dp, int dpitch, uint8_t *sp, int spitch, int bpp, stretch_axis_t *ax, stretch_axis_t *ay) {
+	const gr_kernel_t *k = gr_kernel();
+	int x, y, dw = ax->dlen;
+	uint8_t *row0 = malloc(dw * bpp);
+	uint8_t *row1 = malloc(dw * bpp);
+	int r0 = -1, r1 = -1;
+
+	if (!row0 || !row1) {
+		NOMEMERR();
+	}
+
+	for (y = 0; y < ay->dlen; y++) {
+		uint8_t *dl = dp + y * dpitch;
+		int y0 = ay->idx0[y], y1 = ay->idx1[y], fy = ay->frac[y];
+
+		if (y0 != r0) {
+			if (y0 == r1) {
+				uint8_t *t = row0;
+				row0 = row1; row1 = t;
+				r0 = r1; r1 = -1;
+			} else {
+				hlerp(row0, sp + y0 * spitch, bpp, ax);
+				r0 = y0;
+			}
+		}
+		if (y1 != r1) {
+			hlerp(row1, sp + y1 * spitch, bpp, ax);
+			r1 = y1;
+		}
+
+		switch (bpp) {
+		case 1:
+			for (x = 0; x < dw; x++)
+				dl[x] = row0[x] + (((row1[x] - row0[x]) * fy) >> 8);
+			break;
+		case 2:
+			k->blend16((uint16_t *)dl, (uint16_t *)row1, (uint16_t *)row0, dw, fy);
+			break;
+		case 4:
+			k->blend32((uint32_t *)dl, (uint32_t *)row1, (uint32_t *)row0, dw, fy);
+			break;
+		}
+	}
+
+	free(row0);
+	free(row1);
+}
+
+static void stretch_area(uint8_t *dp, int dpitch, uint8_t *sp, int spitch, int bpp, stretch_axis_t *ax, stretch_axis_t *ay) {
+	int dw = ax->dlen;
+	int x, y, sx, sy;
+	int *sum = malloc(sizeof(int) * dw * 3);
+
+	if (!sum) {
+		NOMEMERR();
+	}
+
+	for (y = 0; y < ay->dlen; y++) {
+		uint8_t *dl = dp + y * dpitch;
+		int ny = ay->idx1[y] - ay->idx0[y];
+
+		memset(sum, 0, sizeof(int) * dw * 3);
+		for (sy = ay->idx0[y]; sy < ay->idx1[y]; sy++) {
+			uint8_t *sl = sp + sy * spitch;
 			for (x = 0; x < dw; x++) {
-				*(yld + x) = *(yls+ *(row + x));
+				int *c = sum + x * 3;
+				for (sx = ax->idx0[x]; sx < ax->idx1[x]; sx++) {
+					switch (bpp) {
+					case 1:
+						c[0] += sl[sx];
+						break;
+					case 2:
+					{
+						uint16_t p = ((uint16_t *)sl)[sx];
+						c[0] += PIXR16(p); c[1] += PIXG16(p); c[2] += PIXB16(p);
+						break;
+					}
+					case 4:
+					{
+						uint32_t p = ((uint32_t *)sl)[sx];
+						c[0] += PIXR24(p); c[1] += PIXG24(p); c[2] += PIXB24(p);
+						break;
+					}
+					}
+				}
 			}
-			_yld = (uint8_t *)yld;
-			while(*(col + y) == *(col + y + 1)) {
-				_yls = _yld;
-				_yld += dst->bytes_per_line;
-				memcpy(_yld, _yls, dw * 4);
-				y++;
+		}
+		for (x = 0; x < dw; x++) {
+			int n = ny * (ax->idx1[x] - ax->idx0[x]);
+			int *c = sum + x * 3;
+			int r = (c[0] + n / 2) / n;
+			int g = (c[1] + n / 2) / n;
+			int b = (c[2] + n / 2) / n;
+			switch (bpp) {
+			case 1:
+				dl[x] = r;
+				break;
+			case 2:
+				((uint16_t *)dl)[x] = PIX16(r, g, b);
+				break;
+			case 4:
+				((uint32_t *)dl)[x] = PIX24(r, g, b);
+				break;
 			}
 		}
+	}
+
+	free(sum);
+}
+
+/*
+  sw x sh の領域を dw x dh に拡大縮小する
+  @param bpp: 1ピクセルのバイト数 (alpha map は 1)
+  @param mirror: 1: 上下反転, 2: 左右反転
+*/
+static void stretch_copy(uint8_t *dp, int dpitch, int dw, int dh, uint8_t *sp, int spitch, int sw, int sh, int bpp, int mirror, enum stretch_filter filter) {
+	stretch_axis_t *ax, *ay;
+
+	if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+
+	ax = get_axis(sw, dw, (mirror & 2) != 0, filter);
+	ay = get_axis(sh, dh, (mirror & 1) != 0, filter);
+
+	switch (filter) {
+	case STRETCH_BILINEAR:
+		stretch_bilinear(dp, dpitch, sp, spitch, bpp, ax, ay);
+		break;
+	case STRETCH_AREA:
+		stretch_area(dp, dpitch, sp, spitch, bpp, ax, ay);
+		break;
+	default:
+		stretch_nearest(dp, dpitch, sp, spitch, bpp, ax, ay);
 		break;
 	}
+}
+
+static int depth_to_bpp(int depth) {
+	switch (depth) {
+	case 8:  return 1;
+	case 16: return 2;
+	case 24:
+	case 32: return 4;
 	}
-	
-	free(row);
-	free(col);
+	return 0;
+}
+
+void gr_copy_stretch(surface_t *dst, int dx, int dy, int dw, int dh, surface_t *src, int sx, int sy, int sw, int sh) {
+	enum stretch_filter filter = nact->ags.stretch_filter;
+	uint8_t *sp, *dp;
+	int bpp;
+
+	if (!gr_clip_xywh(dst, &dx, &dy, &dw, &dh)) return;
+	if (!gr_clip_xywh(src, &sx, &sy, &sw, &sh)) return;
+
+	bpp = depth_to_bpp(dst->depth);
+	if (bpp == 0) return;
+	if (bpp == 1) filter = STRETCH_NEAREST; // パレットは補間できない
+
+	sp = GETOFFSET_PIXEL(src, sx, sy);
+	dp = GETOFFSET_PIXEL(dst, dx, dy);
+
+	stretch_copy(dp, dst->bytes_per_line, dw, dh, sp, src->bytes_per_line, sw, sh, bpp, 0, filter);
+}
+
+/*
+  src 全体を dw x dh に拡大縮小した surface を作成する
+  @param mirror: 1: 上下反転, 2: 左右反転
+*/
+surface_t *gr_stretch_surface(surface_t *src, int dw, int dh, int mirror, enum stretch_filter filter) {
+	surface_t *dst;
+	int bpp = depth_to_bpp(src->depth);
+
+	if (!src->pixel) {
+		dst = sf_create_alpha(dw, dh);
+		dst->depth = src->depth;
+		dst->bytes_per_pixel = src->bytes_per_pixel;
+		dst->bytes_per_line = dw * src->bytes_per_pixel;
+	} else if (src->alpha) {
+		dst = sf_create_surface(dw, dh, src->depth);
+	} else {
+		dst = sf_create_pixel(dw, dh, src->depth);
+	}
+
+	// 8bpp (パレット) は補間できないので最近傍
+	if (src->pixel && bpp) {
+		stretch_copy(dst->pixel, dst->bytes_per_line, dw, dh,
+				  src->pixel, src->bytes_per_line, src->width, src->height,
+				  bpp, mirror, bpp == 1 ? STRETCH_NEAREST : filter);
+	}
+	if (src->alpha) {
+		stretch_copy(dst->alpha, dst->width, dw, dh,
+				  src->alpha, src->width, src->width, src->height,
+				  1, mirror, filter);
+	}
+
+	return dst;
 }
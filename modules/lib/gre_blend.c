@@ -6,10 +6,12 @@
 #include "surface.h"
 #include "ngraph.h"
 #include "ags.h"
+#include "graph_kernel.h"
 
 int gre_Blend(surface_t *write, int wx, int wy, surface_t *dst, int dx, int dy, surface_t *src, int sx, int sy, int width, int height, int lv) {
+	const gr_kernel_t *k = gr_kernel();
 	uint8_t *sp, *dp, *wp;
-	int x, y;
+	int y;
 	
 	wp = GETOFFSET_PIXEL(write, wx, wy);
 	sp = GETOFFSET_PIXEL(src,   sx, sy);
@@ -17,39 +19,23 @@ int gre_Blend(surface_t *write, int wx, int wy, surface_t *dst, int dx, int dy,
 	
 	switch(dst->depth) {
 	case 16:
-		{
-			uint16_t *yls, *yld, *ylw;
-			
-			for (y = 0; y < height; y++) {
-				yls = (uint16_t *)(sp + y * src->bytes_per_line);
-				yld = (uint16_t *)(dp + y * dst->bytes_per_line);
-				ylw = (uint16_t *)(wp + y * write->bytes_per_line);
-				
-				for (x = 0; x < width; x++) {
-					*ylw = ALPHABLEND16(*yls, *yld, lv);
-					yls++; yld++; ylw++;
-				}
-			}
-		}	
+		for (y = 0; y < height; y++) {
+			k->blend16((uint16_t *)(wp + y * write->bytes_per_line),
+				   (uint16_t *)(sp + y * src->bytes_per_line),
+				   (uint16_t *)(dp + y * dst->bytes_per_line),
+				   width, lv);
+		}
 		break;
 	case 24:
 	case 32:
-	{
-		uint32_t *yls, *yld, *ylw;
-		
 		for (y = 0; y < height; y++) {
-			yls = (uint32_t *)(sp + y * src->bytes_per_line);
-			yld = (uint32_t *)(dp + y * dst->bytes_per_line);
-			ylw = (uint32_t *)(wp + y * write->bytes_per_line);
-			
-			for (x = 0; x < width; x++) {
-				*ylw = ALPHABLEND24(*yls, *yld, lv);
-				yls++; yld++; ylw++;
-			}
+			k->blend32((uint32_t *)(wp + y * write->bytes_per_line),
+				   (uint32_t *)(sp + y * src->bytes_per_line),
+				   (uint32_t *)(dp + y * dst->bytes_per_line),
+				   width, lv);
 		}
 		break;
 	}
-	}
 	
 	return OK;
 }
@@ -28,7 +28,7 @@ static int compare_func(const void *a, const void *b) {
 	return *(int*)a - *(int*)b;
 }
 
-int main() {
+void list_test(void) {
 	int data1 = 1;
 	int data2 = 2;
 
@@ -147,6 +147,4 @@ int main() {
 
 		slist_free(l);
 	}
-
-	return 0;
 }
@@ -66,6 +66,7 @@ extern int gre_BlendScreen(surface_t *write, int wx, int wy, surface_t *dst, int
 
 /* in graph_stretch.c */
 extern void gr_copy_stretch(surface_t *dst, int dx, int dy, int dw, int dh, surface_t *src, int sx, int sy, int sw, int sh);
+extern surface_t *gr_stretch_surface(surface_t *src, int dw, int dh, int mirror, enum stretch_filter filter);
 
 
 /* in graph_cg.c */
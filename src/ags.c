@@ -530,6 +530,8 @@ void ags_alpha_setPixel(int x, int y, int w, int h, uint8_t *b) {
 
 void ags_runEffect(int duration_ms, boolean cancelable, ags_EffectStepFunc step, void *arg) {
 	unsigned wflags = cancelable ? KEYWAIT_CANCELABLE : KEYWAIT_NONCANCELABLE;
+	if (sdl_isHeadless())
+		duration_ms = 0;  // 途中経過は誰も見ていない
 	int start = sdl_getTicks();
 	for (int t = 0; t < duration_ms; t = sdl_getTicks() - start) {
 		step(arg, (double)t / duration_ms);
@@ -657,7 +659,8 @@ void ags_setCursorLocation(int x, int y, boolean is_dibgeo) {
 		
 		for (i = 0; i < 8; i++) {
 			sdl_setCursorLocation(dx[i], dy[i]);
-			usleep(cursor_move_time * 1000 / 8);
+			if (!sdl_isHeadless())
+				usleep(cursor_move_time * 1000 / 8);
 		}
 		break;
 	default:
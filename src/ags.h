@@ -100,6 +100,13 @@ enum agsevent_button {
 	AGSEVENT_BUTTON_RIGHT,
 };
 
+// CG の拡大縮小で使うフィルタ
+enum stretch_filter {
+	STRETCH_NEAREST,  // 最近傍 (従来の動作)
+	STRETCH_BILINEAR, // 双線形補間
+	STRETCH_AREA,     // 面積平均 (縮小向け)
+};
+
 enum mouse_warp_mode {
 	MOUSE_WARP_DISABLED,
 	MOUSE_WARP_DIRECT,
@@ -122,6 +129,7 @@ struct _ags {
 	void (*eventcb)(agsevent_t *e); /* deliver event */
 
 	boolean noantialias; /* antialias を使用しない */
+	enum stretch_filter stretch_filter; /* 拡大縮小のフィルタ */
 	boolean noimagecursor; /* リソースファイルのカーソルを読みこまない */
 };
 typedef struct _ags ags_t;
@@ -22,7 +22,12 @@
 /* $Id: ald_manager.c,v 1.3 2001/05/08 05:36:07 chikama Exp $ */
 
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL_mutex.h>
+#include <SDL_rwops.h>
 #include "portab.h"
+#include "system.h"
 #include "dri.h"
 #include "cache.h"
 #include "ald_manager.h"
@@ -33,16 +38,20 @@
 /* drifiles object */
 static drifiles *dri[DRIFILETYPEMAX];
 
+/* ald_getdata() and ald_freedata() may be called from cg prefetch threads */
+static SDL_mutex *mutex;
+
 /* cache handler for dri file */
 static cacher *cacheid;
+/* cache budget in MB (0: default) */
+static int cache_size;
 
 /*
  * free dridata 
  *   dfile: dridata to be free
 */
 static void ald_free(dridata *dfile) {
-	free(dfile->data_raw);
-	free(dfile);
+	dri_freedata(dfile);
 }
 
 /*
@@ -68,7 +77,8 @@ dridata *ald_getdata(DRIFILETYPE type, int no) {
 	if (dri[type]->mmapped) return dri_getdata(dri[type], no);
 	
 	/* not mmapped */
-	if (NULL == (ddata = (dridata *)cache_foreach(cacheid, (type << 16) + no))) {
+	SDL_LockMutex(mutex);
+	if (NULL == (ddata = (dridata *)cache_lookup(cacheid, (type << 16) + no))) {
 		ddata = dri_getdata(dri[type], no);
 		if (ddata != NULL) {
 			ddata->refcnt = 0;
@@ -77,6 +87,7 @@ dridata *ald_getdata(DRIFILETYPE type, int no) {
 	}
 	if (ddata != NULL)
 		ddata->refcnt++;
+	SDL_UnlockMutex(mutex);
 	
 	return ddata;
 }
@@ -90,18 +101,136 @@ void ald_freedata(dridata *data) {
 	if (data == NULL) return;
 	
 	if (data->a->mmapped) {
-		free(data);
+		dri_freedata(data);
 	} else {
+		SDL_LockMutex(mutex);
 		data->refcnt--;
+		SDL_UnlockMutex(mutex);
+	}
+}
+
+/* SDL_RWops over a range of an archive volume, with its own file handle */
+struct range_rw {
+	FILE *fp;
+	long base;
+	Sint64 size;
+	Sint64 pos;
+};
+
+static Sint64 range_size(SDL_RWops *rw) {
+	struct range_rw *r = rw->hidden.unknown.data1;
+	return r->size;
+}
+
+static Sint64 range_seek(SDL_RWops *rw, Sint64 offset, int whence) {
+	struct range_rw *r = rw->hidden.unknown.data1;
+	switch (whence) {
+	case RW_SEEK_SET: break;
+	case RW_SEEK_CUR: offset += r->pos; break;
+	case RW_SEEK_END: offset += r->size; break;
+	default: return SDL_SetError("Unknown value for 'whence'");
 	}
+	if (offset < 0 || offset > r->size)
+		return SDL_SetError("Seek out of range");
+	r->pos = offset;
+	return offset;
+}
+
+static size_t range_read(SDL_RWops *rw, void *ptr, size_t size, size_t maxnum) {
+	struct range_rw *r = rw->hidden.unknown.data1;
+	if (size == 0)
+		return 0;
+	size_t num = min(maxnum, (size_t)(r->size - r->pos) / size);
+	if (num == 0 || fseek(r->fp, r->base + r->pos, SEEK_SET) != 0)
+		return 0;
+	num = fread(ptr, size, num, r->fp);
+	r->pos += num * size;
+	return num;
+}
+
+static size_t range_write(SDL_RWops *rw, const void *ptr, size_t size, size_t num) {
+	SDL_SetError("Read-only stream");
+	return 0;
+}
+
+static int range_close(SDL_RWops *rw) {
+	struct range_rw *r = rw->hidden.unknown.data1;
+	fclose(r->fp);
+	free(r);
+	SDL_FreeRW(rw);
+	return 0;
+}
+
+/*
+ * Open a stream that reads dri data directly from the archive, without
+ * loading the whole data into memory. The stream does not share the
+ * archive's file handle and may be read from another thread.
+ *   type: data type
+ *   no  : file no ( >= 0 )
+ *   return: stream, or NULL if the data does not exist
+*/
+SDL_RWops *ald_open_rw(DRIFILETYPE type, int no) {
+	if (no < 0 || type >= DRIFILETYPEMAX || dri[type] == NULL)
+		return NULL;
+	drifiles *d = dri[type];
+
+	int disk, size;
+	uint32_t offset;
+	if (mutex)
+		SDL_LockMutex(mutex);
+	boolean found = dri_getlocation(d, no, &disk, &offset, &size);
+	if (mutex)
+		SDL_UnlockMutex(mutex);
+	if (!found)
+		return NULL;
+
+	if (d->mmapped)
+		return SDL_RWFromConstMem(d->mmap[disk]->addr + offset, size);
+
+	FILE *fp = fopen(d->fnames[disk], "rb");
+	if (!fp)
+		return NULL;
+	struct range_rw *r = calloc(1, sizeof(struct range_rw));
+	SDL_RWops *rw = SDL_AllocRW();
+	if (!r || !rw)
+		NOMEMERR();
+	r->fp = fp;
+	r->base = offset;
+	r->size = size;
+	rw->size = range_size;
+	rw->seek = range_seek;
+	rw->read = range_read;
+	rw->write = range_write;
+	rw->close = range_close;
+	rw->type = SDL_RWOPS_UNKNOWN;
+	rw->hidden.unknown.data1 = r;
+	return rw;
 }
 
 void ald_init(int type, const char **file, int cnt, boolean use_mmap) {
 	if (type >= DRIFILETYPEMAX || cnt <= 0)
 		return;
 	dri[type] = dri_init(file, cnt, use_mmap);
-	if (!dri[type]->mmapped) {
-		cacheid = cache_new(ald_free);
+	if (!dri[type]->mmapped && !cacheid) {
+		mutex = SDL_CreateMutex();
+		cacheid = cache_new("ald", ald_free);
+		if (cache_size)
+			cache_set_budget(cacheid, (size_t)cache_size << 20);
+	}
+}
+
+/*
+ * Set the size of cache for non-mmapped archives
+ *   mb: cache size in MB
+ */
+void ald_set_cache_size(int mb) {
+	if (mb <= 0)
+		return;
+	cache_size = mb;
+	if (cacheid) {
+		SDL_LockMutex(mutex);
+		cache_set_budget(cacheid, (size_t)mb << 20);
+		SDL_UnlockMutex(mutex);
 	}
 }
 
@@ -110,3 +239,32 @@ int ald_get_maxno(DRIFILETYPE type) {
 		return 0;
 	return dri[type]->nr_files;
 }
+
+/*
+ * Get a hash of the names, sizes and modification times of the archive
+ * volumes, which changes when any volume is replaced.
+ *   type: data type
+ */
+uint32_t ald_get_signature(DRIFILETYPE type) {
+	uint32_t h = 2166136261u;  // FNV-1a
+	if (type >= DRIFILETYPEMAX || !dri[type])
+		return h;
+	for (int i = 0; i < DRIFILEMAX; i++) {
+		const char *fname = dri[type]->fnames[i];
+		if (!fname)
+			continue;
+		struct stat st;
+		uint64_t attrs[3] = {i, 0, 0};
+		if (stat(fname, &st) == 0) {
+			attrs[1] = st.st_size;
+			attrs[2] = st.st_mtime;
+		}
+		const char *base = strrchr(fname, '/');
+		base = base ? base + 1 : fname;
+		for (const char *p = base; *p; p++)
+			h = (h ^ (uint8_t)*p) * 16777619u;
+		for (int j = 0; j < sizeof(attrs); j++)
+			h = (h ^ ((uint8_t *)attrs)[j]) * 16777619u;
+	}
+	return h;
+}
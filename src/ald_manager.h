@@ -24,6 +24,7 @@
 #ifndef __ALD_MANAGER__
 #define __ALD_MANAGER__
 
+#include <SDL_rwops.h>
 #include "portab.h"
 #include "dri.h"
 
@@ -41,7 +42,10 @@ typedef enum {
 void ald_init(int type, const char **file, int cnt, boolean use_mmap);
 dridata *ald_getdata(DRIFILETYPE type, int no);
 void ald_freedata(dridata *data);
+SDL_RWops *ald_open_rw(DRIFILETYPE type, int no);
 int ald_get_maxno(DRIFILETYPE type);
+uint32_t ald_get_signature(DRIFILETYPE type);
+void ald_set_cache_size(int mb);
 
 #endif /* !__ALD_MANAGER__ */
 
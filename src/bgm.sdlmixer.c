@@ -35,47 +35,295 @@
 #include "bgi.h"
 #include "music_private.h"
 #include "ald_manager.h"
+#include "LittleEndian.h"
 
 static DRIFILETYPE dri_type;
 static int base_no;
 static int current_no;
 static Mix_Music *mix_music;
-static dridata* dfile;
 static Uint32 start_time;
 
+/*
+ * PCM の WAVE はアーカイブから直接読みながら、オーディオスレッドで少しずつ
+ * ミキサーの形式に変換して再生する (Mix_HookMusic)。BGI/smpl のループ位置は
+ * サンプル単位で処理する。それ以外の形式 (OGG など) は Mix_Music で再生する。
+ */
+#define FEED_FRAMES 4096
+
+struct bgm_stream {
+	SDL_RWops *rw;
+	SDL_AudioStream *cvt;  // ソースの形式 -> ミキサーの形式
+	SDL_mutex *lock;       // 音量・フェードの状態を保護する
+	int frame_size;        // ソースの 1 サンプルフレームのバイト数
+	Sint64 data_offset;    // rw 中の PCM データの位置
+	int nr_frames;         // PCM データのフレーム数
+	int pos;               // 次に読むフレーム
+	int loop_start;        // ループ先頭 (フレーム)
+	int loop_end;          // ループ終端 (フレーム)
+	int loops_left;        // 残りループ回数 (-1: 無限)
+	bool flushed;          // データの終わりまで cvt に入れた
+	SDL_atomic_t finished; // 再生が終了した
+
+	int out_rate;
+	int out_channels;
+	SDL_atomic_t played;   // 出力したフレーム数
+
+	// 音量 (0-MIX_MAX_VOLUME)。fade_len フレームかけて vol から fade_to へ変化する。
+	int vol;
+	int fade_from, fade_to;
+	int fade_pos, fade_len;
+	bool stop_after_fade;
+
+	Uint8 buf[FEED_FRAMES * 4];
+};
+
+static struct bgm_stream *stream;
+
+// ソースの PCM を最大 FEED_FRAMES フレーム cvt に入れる。入れるものが無ければ false。
+static bool stream_feed(struct bgm_stream *s) {
+	if (s->flushed)
+		return false;
+
+	int end = s->loops_left ? s->loop_end : s->nr_frames;
+	if (s->pos >= end) {
+		if (s->loops_left) {
+			if (s->loops_left > 0)
+				s->loops_left--;
+			s->pos = s->loop_start;
+		} else {
+			SDL_AudioStreamFlush(s->cvt);
+			s->flushed = true;
+			return SDL_AudioStreamAvailable(s->cvt) > 0;
+		}
+		end = s->loops_left ? s->loop_end : s->nr_frames;
+	}
+
+	int frames = min(end - s->pos, FEED_FRAMES);
+	if (SDL_RWseek(s->rw, s->data_offset + (Sint64)s->pos * s->frame_size, RW_SEEK_SET) < 0)
+		frames = 0;
+	else
+		frames = SDL_RWread(s->rw, s->buf, s->frame_size, frames);
+	if (frames <= 0) {
+		// 読めなかった場合はそこでデータが終わったものとする
+		s->nr_frames = s->loop_end = s->pos;
+		s->loops_left = 0;
+		SDL_AudioStreamFlush(s->cvt);
+		s->flushed = true;
+		return SDL_AudioStreamAvailable(s->cvt) > 0;
+	}
+	s->pos += frames;
+	return SDL_AudioStreamPut(s->cvt, s->buf, frames * s->frame_size) == 0;
+}
+
+static void stream_apply_volume(struct bgm_stream *s, Sint16 *samples, int frames) {
+	SDL_LockMutex(s->lock);
+	for (int i = 0; i < frames; i++) {
+		if (s->fade_pos < s->fade_len) {
+			s->fade_pos++;
+			s->vol = s->fade_from + (s->fade_to - s->fade_from) * s->fade_pos / s->fade_len;
+		} else if (s->stop_after_fade) {
+			SDL_AtomicSet(&s->finished, 1);
+			memset(samples, 0, (frames - i) * s->out_channels * sizeof(Sint16));
+			break;
+		}
+		if (s->vol == MIX_MAX_VOLUME) {
+			samples += s->out_channels;
+			continue;
+		}
+		for (int c = 0; c < s->out_channels; c++, samples++)
+			*samples = *samples * s->vol / MIX_MAX_VOLUME;
+	}
+	SDL_UnlockMutex(s->lock);
+}
+
+// オーディオスレッドから呼ばれる
+static void stream_callback(void *udata, Uint8 *out, int len) {
+	struct bgm_stream *s = udata;
+	if (SDL_AtomicGet(&s->finished)) {
+		memset(out, 0, len);
+		return;
+	}
+
+	int filled = 0;
+	while (filled < len) {
+		if (SDL_AudioStreamAvailable(s->cvt) == 0 && !stream_feed(s))
+			break;
+		int n = SDL_AudioStreamGet(s->cvt, out + filled, len - filled);
+		if (n < 0)
+			break;
+		filled += n;
+	}
+	if (filled < len) {
+		memset(out + filled, 0, len - filled);
+		SDL_AtomicSet(&s->finished, 1);
+	}
+
+	int frames = filled / (s->out_channels * sizeof(Sint16));
+	stream_apply_volume(s, (Sint16 *)out, frames);
+	SDL_AtomicAdd(&s->played, frames);
+}
+
+// RIFF WAVE のヘッダを読み、PCM データの位置と smpl チャンクのループ位置を得る
+static bool parse_wave(SDL_RWops *rw, SDL_AudioSpec *spec, Sint64 *data_offset, int *data_size, int *loop_start, int *loop_end) {
+	Uint8 hdr[12];
+	if (SDL_RWread(rw, hdr, 12, 1) != 1 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4))
+		return false;
+
+	bool has_fmt = false;
+	*data_size = -1;
+	*loop_start = *loop_end = -1;
+	Uint8 chunk[8];
+	while (SDL_RWread(rw, chunk, 8, 1) == 1) {
+		Uint32 size = LittleEndian_getDW(chunk, 4);
+		Sint64 next = SDL_RWtell(rw) + size + (size & 1);
+		if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+			Uint8 fmt[16];
+			if (SDL_RWread(rw, fmt, 16, 1) != 1)
+				return false;
+			int tag = LittleEndian_getW(fmt, 0);
+			int bits = LittleEndian_getW(fmt, 14);
+			if (tag != 1 || (bits != 8 && bits != 16))
+				return false;  // PCM のみ
+			spec->channels = LittleEndian_getW(fmt, 2);
+			spec->freq = LittleEndian_getDW(fmt, 4);
+			spec->format = bits == 8 ? AUDIO_U8 : AUDIO_S16LSB;
+			if (spec->channels < 1 || spec->channels > 2 || spec->freq <= 0)
+				return false;
+			has_fmt = true;
+		} else if (!memcmp(chunk, "data", 4)) {
+			*data_offset = SDL_RWtell(rw);
+			*data_size = size;
+		} else if (!memcmp(chunk, "smpl", 4) && size >= 60) {
+			Uint8 smpl[60];
+			if (SDL_RWread(rw, smpl, 60, 1) != 1)
+				return false;
+			if (LittleEndian_getDW(smpl, 28) > 0) {  // number of loops
+				*loop_start = LittleEndian_getDW(smpl, 44);
+				*loop_end = LittleEndian_getDW(smpl, 48) + 1;
+			}
+		}
+		if (SDL_RWseek(rw, next, RW_SEEK_SET) < 0)
+			break;
+	}
+	return has_fmt && *data_size >= 0;
+}
+
+static void free_stream(struct bgm_stream *s) {
+	SDL_FreeAudioStream(s->cvt);
+	SDL_DestroyMutex(s->lock);
+	SDL_RWclose(s->rw);
+	free(s);
+}
+
+static struct bgm_stream *open_stream(SDL_RWops *rw, int no) {
+	int out_rate, out_channels;
+	Uint16 out_format;
+	if (!Mix_QuerySpec(&out_rate, &out_format, &out_channels) || out_format != AUDIO_S16SYS)
+		return NULL;
+
+	SDL_AudioSpec spec;
+	Sint64 data_offset;
+	int data_size, smpl_start, smpl_end;
+	if (!parse_wave(rw, &spec, &data_offset, &data_size, &smpl_start, &smpl_end))
+		return NULL;
+
+	struct bgm_stream *s = calloc(1, sizeof(struct bgm_stream));
+	if (!s)
+		NOMEMERR();
+	s->rw = rw;
+	s->cvt = SDL_NewAudioStream(spec.format, spec.channels, spec.freq, out_format, out_channels, out_rate);
+	s->lock = SDL_CreateMutex();
+	if (!s->cvt || !s->lock) {
+		WARNING("Cannot create audio stream: %s", SDL_GetError());
+		if (s->cvt)
+			SDL_FreeAudioStream(s->cvt);
+		if (s->lock)
+			SDL_DestroyMutex(s->lock);
+		free(s);
+		return NULL;
+	}
+	s->frame_size = SDL_AUDIO_BITSIZE(spec.format) / 8 * spec.channels;
+	s->data_offset = data_offset;
+	s->nr_frames = data_size / s->frame_size;
+	s->out_rate = out_rate;
+	s->out_channels = out_channels;
+
+	// ループ位置は BGI を優先し、無ければ smpl チャンク、それも無ければ全体をループする
+	bgi_t *bgi = dri_type == DRIFILE_BGM ? bgi_find(no) : NULL;
+	if (bgi) {
+		s->loop_start = bgi->looptop;
+		s->loop_end = bgi->len > 0 ? bgi->len : s->nr_frames;
+		s->loops_left = bgi->loopno > 0 ? bgi->loopno : -1;
+	} else if (smpl_start >= 0) {
+		s->loop_start = smpl_start;
+		s->loop_end = smpl_end;
+		s->loops_left = -1;
+	} else {
+		s->loop_start = 0;
+		s->loop_end = s->nr_frames;
+		s->loops_left = -1;
+	}
+	s->loop_end = min(s->loop_end, s->nr_frames);
+	if (s->loop_start < 0 || s->loop_start >= s->loop_end)
+		s->loop_start = 0;
+	if (s->loop_end <= 0)
+		s->loops_left = 0;
+	return s;
+}
+
+static void set_fade(struct bgm_stream *s, int time, int vol, bool stop) {
+	SDL_LockMutex(s->lock);
+	s->fade_from = s->vol;
+	s->fade_to = vol;
+	s->fade_pos = 0;
+	s->fade_len = time * s->out_rate / 100;  // time は 10ms 単位
+	if (!s->fade_len)
+		s->vol = vol;
+	s->stop_after_fade = stop;
+	SDL_UnlockMutex(s->lock);
+}
+
 static void free_music() {
 	current_no = 0;
+	if (stream) {
+		Mix_HookMusic(NULL, NULL);
+		free_stream(stream);
+		stream = NULL;
+	}
 	if (mix_music) {
 		Mix_FreeMusic(mix_music);
 		mix_music = NULL;
 	}
-	if (dfile) {
-		ald_freedata(dfile);
-		dfile = NULL;
-	}
 }
 
-static Mix_Music *bgm_load(int no) {
+static bool bgm_load(int no) {
 	free_music();
 
 	int ald_no = no + base_no - 1;
-	dfile = ald_getdata(dri_type, ald_no);
-	if (dfile == NULL) {
+	SDL_RWops *rw = ald_open_rw(dri_type, ald_no);
+	if (rw == NULL) {
 		WARNING("Failed to open BGM %d", ald_no);
-		return NULL;
+		return false;
 	}
 
-	SDL_RWops *rwops = SDL_RWFromConstMem(dfile->data, dfile->size);
+	stream = open_stream(rw, no);
+	if (stream) {
+		current_no = no;
+		return true;
+	}
 
-	mix_music = Mix_LoadMUS_RW(rwops, SDL_TRUE /* freesrc */);
+	if (SDL_RWseek(rw, 0, RW_SEEK_SET) < 0) {
+		SDL_RWclose(rw);
+		return false;
+	}
+	mix_music = Mix_LoadMUS_RW(rw, SDL_TRUE /* freesrc */);
 	if (mix_music == NULL) {
 		WARNING("Failed to load BGM %d: %s", ald_no, SDL_GetError());
 		free_music();
-		return NULL;
+		return false;
 	}
-
 	current_no = no;
-	return mix_music;
+	return true;
 }
 
 int musbgm_init(DRIFILETYPE type, int base) {
@@ -103,8 +351,15 @@ int musbgm_play(int no, int time, int vol) {
 	if (!bgm_load(no))
 		return NG;
 
-	// We don't use the loop information in the BGI file, but SDL_mixer
-	// understands loop info in the WAVE's "smpl" chunk.
+	if (stream) {
+		stream->vol = 0;
+		set_fade(stream, time, vol * MIX_MAX_VOLUME / 100, false);
+		Mix_HookMusic(stream_callback, stream);
+		return OK;
+	}
+
+	// Non-PCM data is played by SDL_mixer, which understands loop info in
+	// the WAVE's "smpl" chunk and OGG's LOOPSTART tags but not the BGI file.
 
 	Mix_VolumeMusic(vol * MIX_MAX_VOLUME / 100);
 	if (Mix_FadeInMusic(mix_music, -1, time * 10) != 0) {
@@ -117,8 +372,16 @@ int musbgm_play(int no, int time, int vol) {
 }
 
 int musbgm_stop(int no, int time) {
-	if (no == current_no)
-		Mix_FadeOutMusic(time * 10);
+	if (no != current_no)
+		return OK;
+	if (stream) {
+		if (time)
+			set_fade(stream, time, 0, true);
+		else
+			free_music();
+		return OK;
+	}
+	Mix_FadeOutMusic(time * 10);
 	return OK;
 }
 
@@ -126,6 +389,11 @@ int musbgm_fade(int no, int time, int vol) {
 	if (no != current_no)
 		return NG;
 
+	if (stream) {
+		set_fade(stream, time, vol * MIX_MAX_VOLUME / 100, false);
+		return OK;
+	}
+
 	// SDL_mixer doesn't provide arbitrary fading, so just set the volume immediately.
 	Mix_VolumeMusic(vol * MIX_MAX_VOLUME / 100);
 	return OK;
@@ -135,6 +403,9 @@ int musbgm_getpos(int no) {
 	if (!musbgm_isplaying(no))
 		return 0;
 
+	if (stream)
+		return (Sint64)SDL_AtomicGet(&stream->played) * 100 / stream->out_rate;
+
 	// FIXME: This is not correct after loop
 	return (SDL_GetTicks() - start_time) / 10;
 }
@@ -148,9 +419,12 @@ int musbgm_getlen(int no) {
 }
 
 int musbgm_isplaying(int no) {
-	return no == current_no && Mix_PlayingMusic();
+	if (no != current_no)
+		return FALSE;
+	if (stream)
+		return !SDL_AtomicGet(&stream->finished);
+	return Mix_PlayingMusic();
 }
-
 int musbgm_stopall(int time) {
 	return musbgm_stop(current_no, time);
 }
@@ -23,64 +23,161 @@
 
 #include "config.h"
 #include <stdio.h>
-#include <limits.h>
 #include <stdlib.h>
 #include "portab.h"
+#include "system.h"
 #include "cache.h"
 
-/* maximum cache size (in MB) */
+/* default maximum cache size per cache handler (in MB) */
 #ifndef CACHE_TOTALSIZE
 #define CACHE_TOTALSIZE 20
 #endif
 
-static int     totalsize;     /* total size in cache */
-static int dummyfalse = 0; /* dummy in_use flag */
-static int dummytrue  = 1;  /* dummy in_use flag */
+#define INITIAL_BUCKETS 64
+
+/* all cache handlers, for statistics */
+static cacher *cachers;
 
 /*
  * static methods
 */
-static void remove_in_cache(cacher *id);
+static unsigned int hash_key(cacher *id, int key);
+static cacheinfo *find(cacher *id, int key);
+static void rehash(cacher *id);
+static void lru_unlink(cacheinfo *i);
+static void lru_push_front(cacher *id, cacheinfo *i);
+static void remove_in_cache(cacher *id, cacheinfo *i);
+static void evict(cacher *id, cacheinfo *keep);
+
+/*
+ * Calculate hash bucket index of key (Fibonacci hashing)
+*/
+static unsigned int hash_key(cacher *id, int key) {
+	return ((uint32_t)key * 2654435761u) & (id->nr_buckets - 1);
+}
+
+/*
+ * Find data in hash table
+*/
+static cacheinfo *find(cacher *id, int key) {
+	cacheinfo *i = id->buckets[hash_key(id, key)];
+	
+	while (i != NULL && i->key != key) {
+		i = i->hnext;
+	}
+	return i;
+}
+
+/*
+ * Double the number of hash buckets
+*/
+static void rehash(cacher *id) {
+	cacheinfo **old = id->buckets;
+	int old_nr = id->nr_buckets;
+	
+	id->nr_buckets *= 2;
+	id->buckets = calloc(id->nr_buckets, sizeof(cacheinfo *));
+	if (!id->buckets)
+		NOMEMERR();
+	
+	for (int n = 0; n < old_nr; n++) {
+		cacheinfo *i = old[n];
+		while (i) {
+			cacheinfo *next = i->hnext;
+			unsigned int h = hash_key(id, i->key);
+			i->hnext = id->buckets[h];
+			id->buckets[h] = i;
+			i = next;
+		}
+	}
+	free(old);
+}
+
+static void lru_unlink(cacheinfo *i) {
+	i->prev->next = i->next;
+	i->next->prev = i->prev;
+}
+
+static void lru_push_front(cacher *id, cacheinfo *i) {
+	i->prev = &id->lru;
+	i->next = id->lru.next;
+	id->lru.next->prev = i;
+	id->lru.next = i;
+}
 
 /*
  * Remove data in cache
  *   id: cache handler
+ *   i : data to be removed
 */
-static void remove_in_cache(cacher *id) {
-	cacheinfo *ip = id->top;
-	cacheinfo *ic = ip->next;
-	if (!ic)
-		return;
+static void remove_in_cache(cacher *id, cacheinfo *i) {
+	cacheinfo **p = &id->buckets[hash_key(id, i->key)];
 	
-	while(ic->next != NULL) {
-		if (!*ic->in_use) {
-			totalsize -= ic->size;
-			ip->next = ic->next;
-			id->free_(ic->data);
-			free(ic);
-		} else {
-			ip = ic;
+	while (*p != i)
+		p = &(*p)->hnext;
+	*p = i->hnext;
+	
+	lru_unlink(i);
+	id->totalsize -= i->size;
+	id->nr_entries--;
+	id->free_(i->data);
+	free(i);
+}
+
+/*
+ * Remove least recently used data until the cache fits in the budget.
+ * Data which is in use is skipped.
+ *   id  : cache handler
+ *   keep: data that must not be removed (may be NULL)
+*/
+static void evict(cacher *id, cacheinfo *keep) {
+	cacheinfo *i = id->lru.prev;
+	
+	while (id->totalsize > id->budget && i != &id->lru) {
+		cacheinfo *prev = i->prev;
+		if (i != keep && !*i->in_use) {
+			remove_in_cache(id, i);
+			id->stats.evictions++;
 		}
-		ic = ip->next;
+		i = prev;
 	}
-	return;
 }
 
 /* 
  * Create new cache object
+ *   name       : cache name (for statistics)
  *   delcallback: callback function for delete cache data object
  *   return: new cache handler
 */
-cacher *cache_new(void *delcallback) {
+cacher *cache_new(const char *name, void *delcallback) {
 	cacher *c = calloc(1, sizeof(cacher));
+	if (!c)
+		NOMEMERR();
 	
-	c->top = calloc(1, sizeof(cacheinfo));
-	c->top->next = NULL;
-	c->top->in_use = &dummytrue;
+	c->name = name;
 	c->free_ = delcallback;
+	c->nr_buckets = INITIAL_BUCKETS;
+	c->buckets = calloc(c->nr_buckets, sizeof(cacheinfo *));
+	if (!c->buckets)
+		NOMEMERR();
+	c->lru.next = c->lru.prev = &c->lru;
+	c->budget = (size_t)CACHE_TOTALSIZE << 20;
+	
+	c->link = cachers;
+	cachers = c;
 	return c;
 }
 
+/*
+ * Change the maximum total size of cached data
+ *   id   : cache handler
+ *   bytes: new budget in bytes
+*/
+void cache_set_budget(cacher *id, size_t bytes) {
+	id->budget = bytes;
+	evict(id, NULL);
+}
+
 /*
  * Insert data to cache
  *   id    : cache handler
@@ -90,27 +187,27 @@ cacher *cache_new(void *delcallback) {
  *   in_use: in_use mark pointer, if in_use is nonzero, dont remove from cache
 */
 void cache_insert(cacher *id, int key, void *data, int size, int *in_use) {
-	cacheinfo *i = id->top;
-	
-	if (CACHE_TOTALSIZE <= (totalsize >> 20)) {
-		remove_in_cache(id);
-	}
-	
-	while(i->next != NULL) {
-		i = i->next;
-	}
+	static int notused = 0;
+	cacheinfo *i = calloc(1, sizeof(cacheinfo));
+	if (!i)
+		NOMEMERR();
 	
 	i->key = key;
 	i->data = data;
 	i->size = size;
-	i->next = calloc(1, sizeof(cacheinfo));
-	i->next->next = NULL;
-	if (in_use) {
-		i->in_use = in_use;
-	} else {
-		i->in_use = &dummyfalse;
-	}
-	totalsize += size;
+	i->in_use = in_use ? in_use : &notused;
+	
+	if (id->nr_entries >= id->nr_buckets)
+		rehash(id);
+	unsigned int h = hash_key(id, key);
+	i->hnext = id->buckets[h];
+	id->buckets[h] = i;
+	lru_push_front(id, i);
+	id->nr_entries++;
+	id->totalsize += size;
+	
+	/* the new data is returned to the caller, so don't evict it */
+	evict(id, i);
 }
 
 /*
@@ -119,14 +216,46 @@ void cache_insert(cacher *id, int key, void *data, int size, int *in_use) {
  *   key: data search key
  *   return: pointer to cached data
 */
-void *cache_foreach(cacher *id, int key) {
-	cacheinfo *i = id->top;
+void *cache_lookup(cacher *id, int key) {
+	cacheinfo *i = find(id, key);
 	
-	while(i != NULL) {
-		if (i->key == key) {
-			return i->data;
-		}
-		i = i->next;
+	if (i == NULL) {
+		id->stats.misses++;
+		return NULL;
+	}
+	lru_unlink(i);
+	lru_push_front(id, i);
+	id->stats.hits++;
+	return i->data;
+}
+
+/*
+ * Check if data is in cache, without updating LRU order and statistics
+ *   id : cache handler
+ *   key: data search key
+*/
+boolean cache_contains(cacher *id, int key) {
+	return find(id, key) != NULL;
+}
+
+/*
+ * Find data in cache, without updating LRU order and statistics
+ *   id : cache handler
+ *   key: data search key
+ *   return: cached data, or NULL if not found
+*/
+void *cache_peek(cacher *id, int key) {
+	cacheinfo *i = find(id, key);
+	return i ? i->data : NULL;
+}
+
+/*
+ * Print statistics of all cache handlers
+*/
+void cache_print_stats(void) {
+	for (cacher *c = cachers; c; c = c->link) {
+		NOTICE("cache %s: %d entries, %zu/%zu KB, hit %lu, miss %lu, evict %lu",
+		       c->name, c->nr_entries, c->totalsize >> 10, c->budget >> 10,
+		       c->stats.hits, c->stats.misses, c->stats.evictions);
 	}
-	return NULL;
 }
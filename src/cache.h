@@ -24,27 +24,50 @@
 #ifndef __CASHE__
 #define __CASHE__
 
+#include <stddef.h>
 #include "portab.h"
 
 /* cache controlr infomartion */
 struct _cacheinfo {
 	int key;            /* key of data */
 	int size;           /* data size */
-	struct _cacheinfo *next; /* next data */
 	int *in_use;    /* if *in_use is nonzero, dont remove from cache */
 	void *data;         /* real data */
+	struct _cacheinfo *hnext;  /* next data in the same hash bucket */
+	struct _cacheinfo *prev;   /* LRU list (more recently used) */
+	struct _cacheinfo *next;   /* LRU list (less recently used) */
 };
 typedef struct _cacheinfo cacheinfo;
 
+/* cache statistics */
+struct _cachestats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+};
+typedef struct _cachestats cachestats;
+
 /* cache handler */
 struct _cacher {
+	const char *name;        /* name for statistics */
 	void (*free_)(void *);   /* free data callback */
-	struct _cacheinfo *top; /* pointer to data */
+	cacheinfo **buckets;     /* hash table */
+	int nr_buckets;          /* number of buckets (power of 2) */
+	int nr_entries;          /* number of cached data */
+	cacheinfo lru;           /* LRU list head, lru.next is the most recent */
+	size_t totalsize;        /* total size of cached data */
+	size_t budget;           /* maximum total size (in bytes) */
+	cachestats stats;
+	struct _cacher *link;    /* next cache handler (for statistics) */
 };
 typedef struct _cacher cacher;
 
-extern cacher *cache_new(void *delcallback);
+extern cacher *cache_new(const char *name, void *delcallback);
+extern void    cache_set_budget(cacher *id, size_t bytes);
 extern void    cache_insert(cacher *id, int key, void *data, int size, int *in_use);
-extern void   *cache_foreach(cacher *id, int key);
+extern void   *cache_lookup(cacher *id, int key);
+extern boolean cache_contains(cacher *id, int key);
+extern void   *cache_peek(cacher *id, int key);
+extern void    cache_print_stats(void);
 
 #endif /* !__CASHE__ */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "cache.h"
+#include "unittest.h"
+
+static int nr_freed;
+
+static void free_data(void *data) {
+	nr_freed++;
+	free(data);
+}
+
+static void *new_data(int key) {
+	int *p = malloc(sizeof(int));
+	*p = key;
+	return p;
+}
+
+static void lookup_test(void) {
+	cacher *c = cache_new("test", free_data);
+	for (int i = 0; i < 1000; i++)
+		cache_insert(c, i, new_data(i), 1, NULL);
+	for (int i = 0; i < 1000; i++) {
+		int *p = cache_lookup(c, i);
+		ASSERT_TRUE(p != NULL);
+		ASSERT_EQUAL(*p, i);
+	}
+	ASSERT_NULL(cache_lookup(c, 1000));
+	ASSERT_TRUE(cache_contains(c, 999));
+	ASSERT_FALSE(cache_contains(c, 1000));
+	ASSERT_EQUAL(c->stats.hits, 1000);
+	ASSERT_EQUAL(c->stats.misses, 1);
+}
+
+static void lru_test(void) {
+	cacher *c = cache_new("test", free_data);
+	cache_set_budget(c, 3);
+	nr_freed = 0;
+	cache_insert(c, 1, new_data(1), 1, NULL);
+	cache_insert(c, 2, new_data(2), 1, NULL);
+	cache_insert(c, 3, new_data(3), 1, NULL);
+	// Touch 1 so that 2 becomes the least recently used one.
+	ASSERT_TRUE(cache_lookup(c, 1) != NULL);
+	cache_insert(c, 4, new_data(4), 1, NULL);
+	ASSERT_EQUAL(nr_freed, 1);
+	ASSERT_NULL(cache_lookup(c, 2));
+	ASSERT_TRUE(cache_lookup(c, 1) != NULL);
+	ASSERT_TRUE(cache_lookup(c, 3) != NULL);
+	ASSERT_TRUE(cache_lookup(c, 4) != NULL);
+	ASSERT_EQUAL(c->stats.evictions, 1);
+
+	// Data larger than the budget stays until the next insertion.
+	cache_insert(c, 5, new_data(5), 10, NULL);
+	ASSERT_TRUE(cache_lookup(c, 5) != NULL);
+	ASSERT_EQUAL(c->nr_entries, 1);
+	cache_insert(c, 6, new_data(6), 1, NULL);
+	ASSERT_NULL(cache_lookup(c, 5));
+	ASSERT_TRUE(cache_lookup(c, 6) != NULL);
+}
+
+static void in_use_test(void) {
+	cacher *c = cache_new("test", free_data);
+	int pinned = 1;
+	cache_set_budget(c, 2);
+	nr_freed = 0;
+	cache_insert(c, 1, new_data(1), 1, &pinned);
+	cache_insert(c, 2, new_data(2), 1, NULL);
+	cache_insert(c, 3, new_data(3), 1, NULL);
+	cache_insert(c, 4, new_data(4), 1, NULL);
+	ASSERT_EQUAL(nr_freed, 2);
+	ASSERT_TRUE(cache_lookup(c, 1) != NULL);
+	ASSERT_TRUE(cache_lookup(c, 4) != NULL);
+
+	// Unpinned data can be evicted by a budget change.
+	pinned = 0;
+	cache_set_budget(c, 1);
+	ASSERT_NULL(cache_lookup(c, 1));
+	ASSERT_TRUE(cache_lookup(c, 4) != NULL);
+}
+
+static void peek_test(void) {
+	cacher *c = cache_new("test", free_data);
+	cache_set_budget(c, 2);
+	cache_insert(c, 1, new_data(1), 1, NULL);
+	cache_insert(c, 2, new_data(2), 1, NULL);
+	unsigned long hits = c->stats.hits;
+	ASSERT_TRUE(cache_peek(c, 1) != NULL);
+	ASSERT_NULL(cache_peek(c, 3));
+	ASSERT_EQUAL(c->stats.hits, hits);
+
+	// Peeking does not make 1 the most recently used.
+	cache_insert(c, 3, new_data(3), 1, NULL);
+	ASSERT_NULL(cache_peek(c, 1));
+	ASSERT_TRUE(cache_peek(c, 2) != NULL);
+}
+
+void cache_test(void) {
+	lookup_test();
+	lru_test();
+	in_use_test();
+	peek_test();
+}
@@ -28,7 +28,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "portab.h"
+#include "system.h"
 #include "variable.h"
 #include "scenario.h"
 #include "nact.h"
@@ -101,8 +103,8 @@ int *getVariable(void) {
 	return getVar(sl_getc(), NULL);
 }
 
-/* 計算式の評価後の値が返る */
-int getCaliValue(void) {
+/* 計算式をその場で解釈して評価する */
+int interpretCaliValue(void) {
 	register int ingVal,edVal,rstVal;
 	int c0,c1;
 	int *bufc = cali;
@@ -206,9 +208,8 @@ int getCaliValue(void) {
 			case 0x77: /* * */
 				ingVal = *--cali;
 				edVal  = *--cali;
-				rstVal = edVal * ingVal;
-				if (rstVal > CALI_MAX_VAL) { *cali = CALI_OF; }
-				else                       { *cali = rstVal;  }
+				if ((long long)edVal * ingVal > CALI_MAX_VAL) { *cali = CALI_OF; }
+				else { *cali = edVal * ingVal; }
 				cali++;
 				break;
 			case 0x76: /* XOR */
@@ -254,3 +255,349 @@ int getCaliValue(void) {
 
 	return c0;
 }
+
+/*
+ * Compiled expressions
+ *
+ * Each expression is compiled on first evaluation into an instruction array
+ * with decoded operands, and cached per scenario page. The page keeps a map
+ * from script address to compiled expression, so later evaluations find the
+ * instructions with a single array lookup instead of re-tokenizing the SCO
+ * bytes. Expressions that the interpreter would reject (or evaluate with an
+ * unbalanced stack) are remembered as not compilable and always go through
+ * interpretCaliValue(), so errors are reported exactly as before.
+ *
+ * Variable references are compiled the same way, for the pre-decoded
+ * commands in cmd_check.c.
+ */
+
+enum cali_op {
+	OP_CONST,
+	OP_VAR,
+	OP_VAR_INDEXED,
+	OP_MOD,
+	OP_LE,
+	OP_GE,
+	OP_NE,
+	OP_GT,
+	OP_LT,
+	OP_EQ,
+	OP_SUB,
+	OP_ADD,
+	OP_DIV,
+	OP_MUL,
+	OP_XOR,
+	OP_OR,
+	OP_AND,
+};
+
+struct cali_insn {
+	int op;
+	int arg;   /* constant value or variable number */
+	int addr;  /* address after the variable opcode, for warnings */
+};
+
+struct compiled_expr {
+	int end;        /* address after the expression */
+	int code;       /* index into page_cache.insns */
+	int len;        /* number of instructions (-1: not compilable) */
+	bool variable;  /* compiled as a variable reference */
+};
+
+struct page_cache {
+	int *map;       /* address -> index into exprs + 1 (0: not compiled yet) */
+	int size;       /* page size */
+	struct compiled_expr *exprs;
+	int nr_exprs;
+	int max_exprs;
+	struct cali_insn *insns;
+	int nr_insns;
+	int max_insns;
+};
+
+#define COMPILE_MAX_INSNS 128
+#define COMPILE_MAX_DEPTH 32
+
+static struct page_cache *page_caches;
+static int nr_page_caches;
+static struct page_cache *cur_cache;  /* cache of cur_page */
+static int cur_page = -1;
+
+static struct page_cache *get_page_cache(int page) {
+	if (page == cur_page)
+		return cur_cache;
+	if (page >= nr_page_caches) {
+		int n = page + 1 > nr_page_caches * 2 ? page + 1 : nr_page_caches * 2;
+		page_caches = realloc(page_caches, n * sizeof(struct page_cache));
+		if (!page_caches)
+			NOMEMERR();
+		memset(page_caches + nr_page_caches, 0, (n - nr_page_caches) * sizeof(struct page_cache));
+		nr_page_caches = n;
+	}
+	cur_page = page;
+	cur_cache = &page_caches[page];
+	if (!cur_cache->map) {
+		cur_cache->size = sl_getPageSize();
+		cur_cache->map = calloc(cur_cache->size + 1, sizeof(int));
+		if (!cur_cache->map)
+			NOMEMERR();
+	}
+	return cur_cache;
+}
+
+/* シナリオの再初期化時にキャッシュを捨てる */
+void cali_reset(void) {
+	for (int i = 0; i < nr_page_caches; i++) {
+		free(page_caches[i].map);
+		free(page_caches[i].exprs);
+		free(page_caches[i].insns);
+	}
+	free(page_caches);
+	page_caches = NULL;
+	nr_page_caches = 0;
+	cur_cache = NULL;
+	cur_page = -1;
+}
+
+static int compile(int p, int limit, struct cali_insn *code, int *n, int base);
+
+/*
+ * Compile the variable reference whose first byte c0 was read from p - 1,
+ * mirroring getVar().
+ *   return: address after the reference, or -1 if not compilable
+ */
+static int compile_var(int p, int c0, int limit, struct cali_insn *code, int *n, int base) {
+	struct cali_insn insn = { .op = OP_VAR, .addr = p };
+	if ((c0 & 0x40) == 0) {
+		insn.arg = c0 & 0x3f;
+	} else {
+		int c1 = sl_getcAt(p++);
+		if (c0 != 0xc0) {
+			insn.arg = (c0 & 0x3f) * 256 + c1;
+		} else if (c1 == 1) {
+			insn.op = OP_VAR_INDEXED;
+			insn.arg = sl_getcAt(p) << 8 | sl_getcAt(p + 1);
+			p = compile(p + 2, limit, code, n, base);
+			if (p < 0 || *n >= COMPILE_MAX_INSNS)
+				return -1;
+		} else if (c1 >= 0x40) {
+			insn.arg = c1;
+		} else {
+			return -1;
+		}
+	}
+	code[(*n)++] = insn;
+	return p;
+}
+
+/*
+ * Compile the expression at p, mirroring interpretCaliValue().
+ *   base: stack depth below this (sub)expression
+ *   return: address after the terminator, or -1 if not compilable
+ */
+static int compile(int p, int limit, struct cali_insn *code, int *n, int base) {
+	int depth = 0;
+	int c0, c1;
+
+	for (;;) {
+		if (p >= limit || *n >= COMPILE_MAX_INSNS || base + depth > COMPILE_MAX_DEPTH)
+			return -1;
+		if ((c0 = sl_getcAt(p++)) == CALI_TERMINATER)
+			break;
+		struct cali_insn insn = { .addr = p };
+
+		if (c0 & 0x80) { /* variable */
+			c1 = sl_getcAt(p);
+			if (c0 == 0xc0 && c1 != 1 && c1 < 0x34) {
+				p++;
+				switch (c1) {
+				case 2: insn.op = OP_MOD; break;
+				case 3: insn.op = OP_LE; break;
+				case 4: insn.op = OP_GE; break;
+				default: return -1;
+				}
+				if (depth < 2)
+					return -1;
+				depth--;
+				code[(*n)++] = insn;
+				continue;
+			}
+			p = compile_var(p, c0, limit, code, n, base + depth);
+			if (p < 0)
+				return -1;
+			depth++;
+			continue;
+		} else if (c0 >= 0x74 && c0 <= 0x7e) {
+			static const int ops[] = {
+				OP_AND, OP_OR, OP_XOR, OP_MUL, OP_DIV, OP_ADD, OP_SUB, OP_EQ, OP_LT, OP_GT, OP_NE
+			};
+			insn.op = ops[c0 - 0x74];
+			if (depth < 2)
+				return -1;
+			depth--;
+		} else {
+			insn.op = OP_CONST;
+			if ((c0 & 0x40) == 0) { /* WORD const */
+				c1 = sl_getcAt(p++);
+				if (c0 == 0) {
+					if (c1 <= 0x33)
+						return -1;
+				} else {
+					c1 += (c0 & 0x3f) * 256;
+				}
+				insn.arg = c1;
+			} else { /* byte const 0-33h */
+				insn.arg = c0 & 0x3f;
+			}
+			depth++;
+		}
+		code[(*n)++] = insn;
+	}
+	return depth == 1 ? p : -1;
+}
+
+static int *ref_var(const struct cali_insn *insn, int index) {
+	int *t = v_ref_indexed(insn->arg, index, NULL);
+	if (!t) {
+		if (index < 0)
+			WARNING("%03d:%05x: Out of bounds array access: %s", sl_getPage(), insn->addr, v_name(insn->arg));
+		else
+			WARNING("%03d:%05x: Out of bounds index access: %s[%d]", sl_getPage(), insn->addr, v_name(insn->arg), index);
+	}
+	return t;
+}
+
+static int load_var(const struct cali_insn *insn, int index) {
+	int *t = ref_var(insn, index);
+	return t ? *t : 0;
+}
+
+static int run(const struct cali_insn *code, int len) {
+	int stack[COMPILE_MAX_DEPTH + 1];
+	int *sp = stack;
+
+	for (const struct cali_insn *insn = code; insn < code + len; insn++) {
+		switch (insn->op) {
+		case OP_CONST: *sp++ = insn->arg; continue;
+		case OP_VAR:   *sp++ = load_var(insn, -1); continue;
+		case OP_VAR_INDEXED: sp[-1] = load_var(insn, sp[-1]); continue;
+		case OP_MOD: sp--; sp[-1] = sp[0] == 0 ? CALI_NaN : sp[-1] % sp[0]; continue;
+		case OP_LE:  sp--; sp[-1] = sp[-1] <= sp[0] ? CALI_TRUE : CALI_FALSE; continue;
+		case OP_GE:  sp--; sp[-1] = sp[-1] >= sp[0] ? CALI_TRUE : CALI_FALSE; continue;
+		case OP_NE:  sp--; sp[-1] = sp[-1] != sp[0] ? CALI_TRUE : CALI_FALSE; continue;
+		case OP_GT:  sp--; sp[-1] = sp[-1] >  sp[0] ? CALI_TRUE : CALI_FALSE; continue;
+		case OP_LT:  sp--; sp[-1] = sp[-1] <  sp[0] ? CALI_TRUE : CALI_FALSE; continue;
+		case OP_EQ:  sp--; sp[-1] = sp[-1] == sp[0] ? CALI_TRUE : CALI_FALSE; continue;
+		case OP_SUB: sp--; sp[-1] = sp[-1] - sp[0] < CALI_MIN_VAL ? CALI_SubNG : sp[-1] - sp[0]; continue;
+		case OP_ADD: sp--; sp[-1] = sp[-1] + sp[0] > CALI_MAX_VAL ? CALI_OF : sp[-1] + sp[0]; continue;
+		case OP_DIV: sp--; sp[-1] = sp[0] == 0 ? CALI_NaN : sp[-1] / sp[0]; continue;
+		case OP_MUL: sp--; sp[-1] = (long long)sp[-1] * sp[0] > CALI_MAX_VAL ? CALI_OF : sp[-1] * sp[0]; continue;
+		case OP_XOR: sp--; sp[-1] ^= sp[0]; continue;
+		case OP_OR:  sp--; sp[-1] |= sp[0]; continue;
+		case OP_AND: sp--; sp[-1] &= sp[0]; continue;
+		}
+	}
+	return stack[0];
+}
+
+/*
+ * Compile the expression (or variable reference) at addr in the current
+ * page, or return the cached one.
+ *   return: handle of the compiled expression, or -1 if not compilable
+ */
+static int lookup_compiled(struct page_cache *pc, int addr, bool variable) {
+	if (addr < 0 || addr >= pc->size)
+		return -1;
+	if (pc->map[addr]) {
+		int handle = pc->map[addr] - 1;
+		struct compiled_expr *e = &pc->exprs[handle];
+		return e->len >= 0 && e->variable == variable ? handle : -1;
+	}
+
+	if (pc->nr_exprs == pc->max_exprs) {
+		pc->max_exprs = pc->max_exprs ? pc->max_exprs * 2 : 64;
+		pc->exprs = realloc(pc->exprs, pc->max_exprs * sizeof(struct compiled_expr));
+		if (!pc->exprs)
+			NOMEMERR();
+	}
+	int handle = pc->nr_exprs++;
+	pc->map[addr] = handle + 1;
+	struct compiled_expr *e = &pc->exprs[handle];
+	e->variable = variable;
+
+	struct cali_insn code[COMPILE_MAX_INSNS];
+	int n = 0;
+	if (variable) {
+		int c0 = sl_getcAt(addr);
+		e->end = c0 & 0x80 ? compile_var(addr + 1, c0, pc->size, code, &n, 0) : -1;
+	} else {
+		e->end = compile(addr, pc->size, code, &n, 0);
+	}
+	if (e->end < 0) {
+		e->len = -1;
+		return -1;
+	}
+	if (pc->nr_insns + n > pc->max_insns) {
+		pc->max_insns = max(pc->max_insns * 2, pc->nr_insns + n);
+		pc->insns = realloc(pc->insns, pc->max_insns * sizeof(struct cali_insn));
+		if (!pc->insns)
+			NOMEMERR();
+	}
+	memcpy(pc->insns + pc->nr_insns, code, n * sizeof(struct cali_insn));
+	e->code = pc->nr_insns;
+	e->len = n;
+	pc->nr_insns += n;
+	return handle;
+}
+
+/*
+ * Pre-decoded operands: cali_decodeValue() and cali_decodeVariable() return
+ * a handle of the compiled operand at addr in the current page (or -1), and
+ * store the address after it in *end. Handles stay valid until cali_reset()
+ * and are evaluated with cali_value() and cali_variable() without touching
+ * the script pointer.
+ */
+int cali_decodeValue(int addr, int *end) {
+	struct page_cache *pc = get_page_cache(sl_getPage());
+	int handle = lookup_compiled(pc, addr, false);
+	if (handle >= 0)
+		*end = pc->exprs[handle].end;
+	return handle;
+}
+
+int cali_decodeVariable(int addr, int *end) {
+	struct page_cache *pc = get_page_cache(sl_getPage());
+	int handle = lookup_compiled(pc, addr, true);
+	if (handle >= 0)
+		*end = pc->exprs[handle].end;
+	return handle;
+}
+
+int cali_value(int handle) {
+	struct page_cache *pc = get_page_cache(sl_getPage());
+	const struct compiled_expr *e = &pc->exprs[handle];
+	const struct cali_insn *code = pc->insns + e->code;
+	if (e->len == 1 && code->op == OP_CONST)
+		return code->arg;
+	return run(code, e->len);
+}
+
+int *cali_variable(int handle) {
+	struct page_cache *pc = get_page_cache(sl_getPage());
+	const struct compiled_expr *e = &pc->exprs[handle];
+	const struct cali_insn *code = pc->insns + e->code;
+	int index = e->len > 1 ? run(code, e->len - 1) : -1;
+	return ref_var(&code[e->len - 1], index);
+}
+
+/* 計算式の評価後の値が返る */
+int getCaliValue(void) {
+	int end;
+	if (sl_getPage() < 0)
+		return interpretCaliValue();
+	int handle = cali_decodeValue(sl_getIndex(), &end);
+	if (handle < 0)
+		return interpretCaliValue();
+	sl_jmpNear(end);
+	return cali_value(handle);
+}
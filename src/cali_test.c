@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "nact.h"
+#include "scenario.h"
+#include "variable.h"
+#include "unittest.h"
+
+// Fake scenario page. The expression under test starts at address 1.
+static uint8_t page[1024];
+static int page_size;
+
+const uint8_t *sl_sco = page;
+int sl_page;
+int sl_index;
+
+static NACTINFO nactprv;
+NACTINFO *nact = &nactprv;
+
+int sl_getcAt(int adr) {
+	return sl_sco[adr];
+}
+
+int sl_getPageSize(void) {
+	return page_size;
+}
+
+void sl_jmpNear(int address) {
+	sl_index = address;
+}
+
+static void set_expr(const uint8_t *expr, int len) {
+	page[0] = 0;
+	memcpy(page + 1, expr, len);
+	page_size = len + 1;
+	cali_reset();
+}
+
+// Runs the expression through interpretCaliValue() and the compiled code
+// (first and cached evaluation), and returns the common result.
+static int eval(const uint8_t *expr, int len) {
+	set_expr(expr, len);
+	sl_index = 1;
+	int expected = interpretCaliValue();
+	int end = sl_index;
+	ASSERT_EQUAL(end, len + 1);
+
+	int compiled_end;
+	ASSERT_TRUE(cali_decodeValue(1, &compiled_end) >= 0);
+	ASSERT_EQUAL(compiled_end, end);
+	for (int i = 0; i < 2; i++) {
+		sl_index = 1;
+		ASSERT_EQUAL(getCaliValue(), expected);
+		ASSERT_EQUAL(sl_index, end);
+	}
+	return expected;
+}
+
+#define EVAL(...) eval((const uint8_t[]){__VA_ARGS__}, sizeof((const uint8_t[]){__VA_ARGS__}))
+
+// constants
+#define B(n) (0x40 | (n))                  // 0 - 0x33
+#define W(n) ((n) >> 8), ((n) & 0xff)      // 0x34 - 0x3fff
+// variables
+#define V(n) (0x80 | (n))                  // 0 - 0x3f
+#define VW(n) (0xc0 | (n) >> 8), ((n) & 0xff)  // 0x100 - 0x3fff
+#define VB(n) 0xc0, (n)                    // 0x40 - 0xff
+#define VI(n) 0xc0, 1, ((n) >> 8), ((n) & 0xff)  // followed by an index expression
+// operators
+#define AND 0x74
+#define OR  0x75
+#define XOR 0x76
+#define MUL 0x77
+#define DIV 0x78
+#define ADD 0x79
+#define SUB 0x7a
+#define EQ  0x7b
+#define LT  0x7c
+#define GT  0x7d
+#define NE  0x7e
+#define MOD 0xc0, 2
+#define LE  0xc0, 3
+#define GE  0xc0, 4
+#define END 0x7f
+
+static void operator_test(void) {
+	ASSERT_EQUAL(EVAL(B(7), END), 7);
+	ASSERT_EQUAL(EVAL(W(0x34), END), 0x34);
+	ASSERT_EQUAL(EVAL(W(0x3fff), END), 0x3fff);
+	ASSERT_EQUAL(EVAL(B(2), B(3), B(4), MUL, ADD, END), 14);
+	ASSERT_EQUAL(EVAL(B(10), B(4), SUB, B(3), SUB, END), 3);
+	ASSERT_EQUAL(EVAL(B(3), B(10), SUB, END), 0);
+	ASSERT_EQUAL(EVAL(W(300), W(300), MUL, END), 65535);
+	ASSERT_EQUAL(EVAL(W(0x3fff), B(5), MUL, B(1), ADD, END), 65535);
+	ASSERT_EQUAL(EVAL(W(0x3fff), B(5), MUL, W(0x3fff), B(5), MUL, MUL, END), 65535);
+	ASSERT_EQUAL(EVAL(B(17), B(5), DIV, END), 3);
+	ASSERT_EQUAL(EVAL(B(17), B(0), DIV, END), 0);
+	ASSERT_EQUAL(EVAL(B(17), B(5), MOD, END), 2);
+	ASSERT_EQUAL(EVAL(B(17), B(0), MOD, END), 0);
+	ASSERT_EQUAL(EVAL(B(12), B(10), AND, B(1), OR, B(3), XOR, END), 10);
+	ASSERT_EQUAL(EVAL(B(1), B(2), LT, B(2), B(1), GT, EQ, END), 1);
+	ASSERT_EQUAL(EVAL(B(1), B(2), NE, B(2), B(2), LE, B(3), B(2), GE, AND, AND, END), 1);
+}
+
+static void variable_test(void) {
+	sysVar[5] = 100;
+	sysVar[0x50] = 200;
+	sysVar[0x150] = 300;
+	sysVar[0x152] = 7;
+	ASSERT_EQUAL(EVAL(V(5), END), 100);
+	ASSERT_EQUAL(EVAL(VB(0x50), END), 200);
+	ASSERT_EQUAL(EVAL(VW(0x150), V(5), ADD, END), 400);
+	ASSERT_EQUAL(EVAL(VI(0x150), B(2), END, END), 7);
+	ASSERT_EQUAL(EVAL(VI(0x150), B(1), B(1), ADD, END, B(1), SUB, END), 6);
+	// Out of bounds access evaluates to 0 with a warning.
+	ASSERT_EQUAL(EVAL(VI(0x150), W(0x3fff), B(5), MUL, END, B(1), ADD, END), 1);
+}
+
+static void variable_ref_test(void) {
+	static const uint8_t ref[] = {VI(0x150), V(5), B(2), DIV, END};
+	set_expr(ref, sizeof(ref));
+	sl_index = 1;
+	int *expected = getVariable();
+	int end = sl_index;
+
+	int compiled_end;
+	int handle = cali_decodeVariable(1, &compiled_end);
+	ASSERT_TRUE(handle >= 0);
+	ASSERT_EQUAL(compiled_end, end);
+	ASSERT_EQUAL_PTR(cali_variable(handle), expected);
+	ASSERT_EQUAL_PTR(expected, &sysVar[0x150 + 50]);
+
+	// A value handle is not a variable handle.
+	ASSERT_TRUE(cali_decodeValue(1, &compiled_end) < 0);
+}
+
+static void uncompilable_test(void) {
+	int end;
+	// unbalanced stack
+	static const uint8_t extra[] = {B(1), B(2), END};
+	set_expr(extra, sizeof(extra));
+	ASSERT_TRUE(cali_decodeValue(1, &end) < 0);
+	static const uint8_t missing[] = {B(1), ADD, END};
+	set_expr(missing, sizeof(missing));
+	ASSERT_TRUE(cali_decodeValue(1, &end) < 0);
+	// no terminator in the page
+	static const uint8_t unterminated[] = {B(1), B(2), ADD};
+	set_expr(unterminated, sizeof(unterminated));
+	ASSERT_TRUE(cali_decodeValue(1, &end) < 0);
+}
+
+/*
+ * Differential test: random well-formed expressions must give the same
+ * results through interpretCaliValue() and the compiled code.
+ */
+static uint32_t rand_state = 12345;
+
+static int rnd(int n) {
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 8) % n;
+}
+
+static int gen_operand(uint8_t *p, int depth) {
+	uint8_t *top = p;
+	int n;
+	switch (depth > 0 ? rnd(8) : rnd(5)) {
+	case 0:
+		*p++ = B(rnd(0x34));
+		break;
+	case 1:
+		n = 0x34 + rnd(0x4000 - 0x34);
+		*p++ = n >> 8;
+		*p++ = n & 0xff;
+		break;
+	case 2:
+		*p++ = V(rnd(0x40));
+		break;
+	case 3:
+		*p++ = 0xc0;
+		*p++ = 0x40 + rnd(0xc0);
+		break;
+	case 4:
+		n = 0x100 + rnd(0x3f00);
+		*p++ = 0xc0 | n >> 8;
+		*p++ = n & 0xff;
+		break;
+	case 5:
+		n = rnd(0x4000);
+		*p++ = 0xc0;
+		*p++ = 1;
+		*p++ = n >> 8;
+		*p++ = n & 0xff;
+		p += gen_operand(p, depth - 1);
+		*p++ = END;
+		break;
+	default:
+		p += gen_operand(p, depth - 1);
+		p += gen_operand(p, depth - 1);
+		if ((n = rnd(14)) < 11) {
+			*p++ = 0x74 + n;
+		} else {
+			*p++ = 0xc0;
+			*p++ = n - 9;
+		}
+		break;
+	}
+	return p - top;
+}
+
+static void random_test(void) {
+	for (int i = 0; i < 0x4000; i++)
+		sysVar[i] = rnd(8) ? rnd(0x100) : rnd(0x10000);
+	for (int i = 0; i < 5000; i++) {
+		uint8_t expr[512];
+		int len = gen_operand(expr, 4);
+		expr[len++] = END;
+		eval(expr, len);
+	}
+}
+
+void cali_test(void) {
+	operator_test();
+	variable_test();
+	variable_ref_test();
+	uncompilable_test();
+	random_test();
+	cali_reset();
+}
@@ -34,9 +34,13 @@
 #include "bmp.h"
 #include "qnt.h"
 #include "jpeg.h"
+#ifdef HAVE_WEBP
+#include "webp.h"
+#endif
 #include "ald_manager.h"
 #include "filecheck.h"
 #include "cache.h"
+#include "mmap.h"
 
 /* VSPのパレット展開バンク */
 int cg_vspPB;
@@ -57,6 +61,8 @@ static MyPoint        loc_where, loc_where0;
 
 /* extracted cg data cache control object */
 static cacher *cacheid;
+/* cache budget in MB (0: default) */
+static int cache_size;
 
 /* static methods */
 static CG_TYPE check_cgformat(uint8_t *data);
@@ -87,6 +93,10 @@ static CG_TYPE check_cgformat(uint8_t *data) {
 		return ALCG_VSP;
 	} else if (jpeg_checkfmt(data) && nact->ags.world_depth >= 15) {
 		return ALCG_JPEG;
+#ifdef HAVE_WEBP
+	} else if (webp_checkfmt(data) && nact->ags.world_depth >= 15) {
+		return ALCG_WEBP;
+#endif
 	}
 	WARNING("Unknown Cg Type");
 	return ALCG_UNKNOWN;
@@ -112,6 +122,11 @@ static void set_vspbank(uint8_t *pic, int bank, int width, int height) {
  *  cg: freeing data object
 */
 void cgdata_free(cgdata *cg) {
+	if (cg->mapping) {
+		unmap_file(cg->mapping);
+		free(cg);
+		return;
+	}
 	if (cg->pic) free(cg->pic);
 	if (cg->pal) free(cg->pal);
 	if (cg->alpha) free(cg->alpha);
@@ -178,26 +193,14 @@ static void display_cg(cgdata *cg, int x, int y, int sprite_color, bool alpha_bl
 }
 
 /*
- * Load cg data from file or cache
- *  no: file no ( >= 0)
+ * Extract cg data
+ *  This may be called from cg prefetch threads.
+ *  dfile: compressed cg data
  *  return: cg object(extracted)
 */
-static cgdata *loader(int no) {
-	dridata *dfile;
+cgdata *cg_extract(dridata *dfile) {
 	cgdata *cg = NULL;
-
-	/* search in cache */
-	if (NULL != (cg = (cgdata *)cache_foreach(cacheid, no))) return cg;
-	
-	/* read from file */
-	if (NULL == (dfile = ald_getdata(DRIFILE_CG, no))) return NULL;
-	
-	/* update load cg counter */
-	if (cg_loadCountVar != NULL) {
-		(*(cg_loadCountVar + no + 1))++;
-	}
 	
-	/* extract cg */
 	switch (check_cgformat(dfile->data)) {
 	case ALCG_VSP:
 		cg = vsp_extract(dfile->data);
@@ -220,29 +223,91 @@ static cgdata *loader(int no) {
 	case ALCG_JPEG:
 		cg = jpeg_extract(dfile->data, dfile->size);
 		break;
+#ifdef HAVE_WEBP
+	case ALCG_WEBP:
+		cg = webp_extract(dfile->data, dfile->size);
+		break;
+#endif
 	default:
 		break;
 	}
+	return cg;
+}
+
+/*
+ * Load cg data from file or cache
+ *  no: file no ( >= 0)
+ *  return: cg object(extracted)
+*/
+static cgdata *loader(int no) {
+	dridata *dfile;
+	cgdata *cg = NULL;
+
+	/* search in cache */
+	if (NULL != (cg = (cgdata *)cache_lookup(cacheid, no))) return cg;
+	
+	/* extracted in background or in disk cache? */
+	if (NULL == (cg = cg_prefetch_take(no)) &&
+		NULL == (cg = cg_diskcache_load(no))) {
+		/* read from file */
+		if (NULL == (dfile = ald_getdata(DRIFILE_CG, no))) return NULL;
+		
+		/* extract cg */
+		cg = cg_extract(dfile);
+		
+		/* ok to free */
+		ald_freedata(dfile);
+
+		if (cg)
+			cg_diskcache_store(no, cg);
+	}
+	
+	/* update load cg counter */
+	if (cg_loadCountVar != NULL) {
+		(*(cg_loadCountVar + no + 1))++;
+	}
+	
 	/* insert to cache */
 	if (cg) {
 		int size = cg->width * cg->height * (cg->depth / 8);
 		cache_insert(cacheid, no, cg, size, NULL);
 	}
 	
-	/* ok to free */
-	ald_freedata(dfile);
-	
 	return cg;
 }
 
+/*
+ * Check if extracted cg data is in cache
+ *  no: file no ( >= 0)
+*/
+boolean cg_is_cached(int no) {
+	return cacheid && cache_contains(cacheid, no);
+}
+
 /*
  * Initilize cache
 */
 void cg_init(void) {
-	cacheid = cache_new(cgdata_free);
+	cacheid = cache_new("cg", cgdata_free);
+	if (cache_size)
+		cache_set_budget(cacheid, (size_t)cache_size << 20);
+	cg_diskcache_init();
+	cg_prefetch_init();
 	cg_reset();
 }
 
+/*
+ * Set the size of extracted cg cache
+ *   mb: cache size in MB
+*/
+void cg_set_cache_size(int mb) {
+	if (mb <= 0)
+		return;
+	cache_size = mb;
+	if (cacheid)
+		cache_set_budget(cacheid, (size_t)mb << 20);
+}
+
 void cg_reset(void) {
 	cg_vspPB = -1;
 	cg_fflg = 7;
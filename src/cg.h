@@ -26,6 +26,7 @@
 
 #include "portab.h"
 #include "graphics.h"
+#include "dri.h"
 
 /*
  * available cg format id
@@ -59,6 +60,8 @@ typedef struct {
 	
 	int vsp_bank;    // palette bank for vsp
 	int pms_bank;    // palette bank for pms
+
+	void *mapping;   // mmap_t of the disk cache file that pic/alpha/pal point into
 } cgdata;
 
 /*
@@ -81,6 +84,21 @@ extern int  cg_load_with_filename(char *fname_utf8, int x, int y);
 extern void cg_get_info(int no, MyRectangle *info);
 extern void cg_clear_display_loc();
 extern void cgdata_free(cgdata *cg);
+extern void cg_set_cache_size(int mb);
+extern cgdata *cg_extract(dridata *dfile);
+extern boolean cg_is_cached(int no);
+
+/* cg_diskcache.c */
+extern void cg_diskcache_set_dir(const char *dir);
+extern void cg_diskcache_init(void);
+extern cgdata *cg_diskcache_load(int no);
+extern void cg_diskcache_store(int no, cgdata *cg);
+
+/* cg_prefetch.c */
+extern void cg_prefetch_init(void);
+extern void cg_prefetch(int no);
+extern cgdata *cg_prefetch_take(int no);
+extern void cg_prefetch_scan(void);
 
 extern int cg_vspPB;
 extern int cg_fflg;
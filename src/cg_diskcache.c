@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/*
+ * On-disk cache of extracted CGs.
+ *
+ * Extracted QNT/PMS/JPEG/WebP images are written to
+ * <dir>/cg<signature>_<no>.dat, where the signature is derived from the
+ * names, sizes and modification times of the CG archive volumes, so
+ * replacing an archive invalidates the cache. On lookup the file is
+ * memory-mapped and the returned cgdata points into the mapping.
+ *
+ * The directory is kept under CACHE_BUDGET bytes. Cache hits update the
+ * modification time of the file, and the least recently used files are
+ * removed when a write exceeds the budget. Files for other signatures are
+ * removed at startup.
+ *
+ * These functions may be called from cg prefetch threads.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include <SDL_mutex.h>
+
+#include "portab.h"
+#include "system.h"
+#include "nact.h"
+#include "cg.h"
+#include "mmap.h"
+#include "ald_manager.h"
+
+#define CACHE_MAGIC "XCGC"
+#define CACHE_VERSION 1
+
+#define ALIGN16(n) (((n) + 15) & ~15)
+
+#define CACHE_BUDGET ((size_t)512 * 1024 * 1024)
+// Pruning removes files until the cache is this small, so that it doesn't
+// run on every write once the budget is reached.
+#define PRUNE_TARGET (CACHE_BUDGET / 4 * 3)
+
+struct cache_header {
+	char     magic[4];
+	uint32_t version;
+	uint32_t signature;
+	int32_t  no;
+	int32_t  type, x, y, width, height, depth, vsp_bank, pms_bank;
+	uint32_t pic_size, alpha_size, pal_size;
+};
+
+/* cache directory (NULL: disabled) */
+static char *cache_dir;
+/* signature of the CG archive */
+static uint32_t signature;
+/* total size of the cache files, protected by mutex */
+static size_t cache_bytes;
+static SDL_mutex *mutex;
+
+struct cache_file {
+	char *name;
+	time_t mtime;
+	size_t size;
+};
+
+/*
+ * Enable the disk cache
+ *   dir: directory to store cached CGs
+ */
+void cg_diskcache_set_dir(const char *dir) {
+	free(cache_dir);
+	cache_dir = dir && *dir ? strdup(dir) : NULL;
+}
+
+static void cache_path(char *buf, size_t size, int no) {
+	snprintf(buf, size, "%s/cg%08x_%d.dat", cache_dir, signature, no);
+}
+
+/*
+ * List the cache files of the current signature. At startup, files of
+ * other signatures and temporary files left by interrupted writes are
+ * removed.
+ *   files: receives the list (the caller frees it), or NULL
+ *   return: total size of the cache files
+ */
+static size_t scan_dir(struct cache_file **files, int *nr_files, boolean startup) {
+	if (files) {
+		*files = NULL;
+		*nr_files = 0;
+	}
+	DIR *d = opendir(cache_dir);
+	if (!d)
+		return 0;
+
+	size_t total = 0;
+	int cap = 0;
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL) {
+		unsigned sig;
+		int no, n = 0;
+		if (sscanf(entry->d_name, "cg%8x_%d.dat%n", &sig, &no, &n) != 2 || !n)
+			continue;  // not ours
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s", cache_dir, entry->d_name);
+		if (entry->d_name[n] || sig != signature) {
+			if (startup)
+				remove(path);
+			continue;
+		}
+		struct stat st;
+		if (stat(path, &st) < 0)
+			continue;
+		total += st.st_size;
+		if (!files)
+			continue;
+		if (*nr_files == cap) {
+			cap = cap ? cap * 2 : 256;
+			*files = realloc(*files, cap * sizeof(struct cache_file));
+			if (!*files)
+				NOMEMERR();
+		}
+		(*files)[(*nr_files)++] = (struct cache_file){strdup(entry->d_name), st.st_mtime, st.st_size};
+	}
+	closedir(d);
+	return total;
+}
+
+static int compare_mtime(const void *a, const void *b) {
+	const struct cache_file *fa = a, *fb = b;
+	return fa->mtime < fb->mtime ? -1 : fa->mtime > fb->mtime;
+}
+
+/* Remove the least recently used files. Called with the mutex held. */
+static void prune(void) {
+	struct cache_file *files;
+	int nr_files;
+	size_t total = scan_dir(&files, &nr_files, FALSE);
+	qsort(files, nr_files, sizeof(struct cache_file), compare_mtime);
+	for (int i = 0; i < nr_files; i++) {
+		if (total > PRUNE_TARGET) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s/%s", cache_dir, files[i].name);
+			// Fails on Windows if the file is mapped; it is retried next time.
+			if (remove(path) == 0)
+				total -= files[i].size;
+		}
+		free(files[i].name);
+	}
+	free(files);
+	cache_bytes = total;
+}
+
+/*
+ * Prepare the cache directory. Must be called after the CG archive is
+ * registered and before prefetch threads start.
+ */
+void cg_diskcache_init(void) {
+	if (!cache_dir)
+		return;
+	signature = ald_get_signature(DRIFILE_CG);
+#ifdef _WIN32
+	int rv = _mkdir(cache_dir);
+#else
+	int rv = mkdir(cache_dir, 0755);
+#endif
+	if (rv < 0 && errno != EEXIST) {
+		WARNING("%s: %s", cache_dir, strerror(errno));
+		cg_diskcache_set_dir(NULL);
+		return;
+	}
+	if (!mutex)
+		mutex = SDL_CreateMutex();
+	cache_bytes = scan_dir(NULL, NULL, TRUE);
+	if (cache_bytes > CACHE_BUDGET)
+		prune();
+}
+
+static size_t pixel_bytes(int width, int height, int depth) {
+	return (size_t)width * height * (depth / 8);
+}
+
+/* Buffer sizes match what the decoders allocate, as some readers rely on the padding */
+static size_t pic_buffer_size(const cgdata *cg) {
+	return pixel_bytes(cg->width + 10, cg->height + 10, cg->depth);
+}
+
+/*
+ * Look up a cached CG
+ *   no: file no ( >= 0)
+ *   return: cg object whose pixels are backed by the cache file, or NULL
+ */
+cgdata *cg_diskcache_load(int no) {
+	if (!cache_dir)
+		return NULL;
+
+	char path[1024];
+	cache_path(path, sizeof(path), no);
+	struct stat st;
+	if (stat(path, &st) < 0 || st.st_size < sizeof(struct cache_header))
+		return NULL;
+
+	mmap_t *m = map_file(path);
+	if (!m)
+		return NULL;
+	const struct cache_header *h = m->addr;
+	size_t off_pic = ALIGN16(sizeof(struct cache_header));
+	size_t off_alpha = ALIGN16(off_pic + h->pic_size);
+	size_t off_pal = ALIGN16(off_alpha + h->alpha_size);
+	if (memcmp(h->magic, CACHE_MAGIC, 4) || h->version != CACHE_VERSION ||
+		h->signature != signature || h->no != no ||
+		off_pal + h->pal_size > (size_t)st.st_size ||
+		h->width <= 0 || h->height <= 0 ||
+		h->pic_size < pixel_bytes(h->width, h->height, h->depth) ||
+		(h->alpha_size && h->alpha_size < pixel_bytes(h->width, h->height, 8)) ||
+		(h->pal_size && h->pal_size != sizeof(Palette256)) ||
+		// check_cgformat() rejects high color formats in 256 color mode.
+		(h->depth > 8 && nact->ags.world_depth < 15)) {
+		unmap_file(m);
+		return NULL;
+	}
+
+	cgdata *cg = calloc(1, sizeof(cgdata));
+	if (!cg)
+		NOMEMERR();
+	cg->type = h->type;
+	cg->x = h->x;
+	cg->y = h->y;
+	cg->width = h->width;
+	cg->height = h->height;
+	cg->depth = h->depth;
+	cg->vsp_bank = h->vsp_bank;
+	cg->pms_bank = h->pms_bank;
+	uint8_t *base = m->addr;
+	cg->pic = h->pic_size ? base + off_pic : NULL;
+	cg->alpha = h->alpha_size ? base + off_alpha : NULL;
+	cg->pal = h->pal_size ? (Palette256 *)(base + off_pal) : NULL;
+	cg->mapping = m;
+
+	// Mark the file as recently used.
+	utime(path, NULL);
+	return cg;
+}
+
+static boolean write_padded(FILE *fp, const void *data, size_t len, size_t padded_len) {
+	static const uint8_t zeros[256];
+	if (len && fwrite(data, len, 1, fp) != 1)
+		return FALSE;
+	for (size_t n = padded_len - len; n > 0; ) {
+		size_t chunk = n < sizeof(zeros) ? n : sizeof(zeros);
+		if (fwrite(zeros, chunk, 1, fp) != 1)
+			return FALSE;
+		n -= chunk;
+	}
+	return TRUE;
+}
+
+/*
+ * Store an extracted CG in the cache
+ *   no: file no ( >= 0)
+ *   cg: extracted cg object
+ */
+void cg_diskcache_store(int no, cgdata *cg) {
+	if (!cache_dir || cg->mapping || !cg->pic)
+		return;
+	switch (cg->type) {
+	case ALCG_PMS8:
+	case ALCG_PMS16:
+	case ALCG_QNT:
+	case ALCG_JPEG:
+	case ALCG_WEBP:
+		break;
+	default:
+		// VSP pixels are modified in place by cg_load(), and BMP is cheap
+		// to extract.
+		return;
+	}
+
+	struct cache_header h = {
+		.magic = CACHE_MAGIC,
+		.version = CACHE_VERSION,
+		.signature = signature,
+		.no = no,
+		.type = cg->type,
+		.x = cg->x,
+		.y = cg->y,
+		.width = cg->width,
+		.height = cg->height,
+		.depth = cg->depth,
+		.vsp_bank = cg->vsp_bank,
+		.pms_bank = cg->pms_bank,
+		.pic_size = pic_buffer_size(cg),
+		.alpha_size = cg->alpha ? pixel_bytes(cg->width + 10, cg->height + 10, 8) : 0,
+		.pal_size = cg->pal ? sizeof(Palette256) : 0,
+	};
+	size_t off_pic = ALIGN16(sizeof(h));
+	size_t off_alpha = ALIGN16(off_pic + h.pic_size);
+	size_t off_pal = ALIGN16(off_alpha + h.alpha_size);
+
+	char path[1024], tmp_path[1040];
+	cache_path(path, sizeof(path), no);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%p.tmp", path, (void *)cg);
+	FILE *fp = fopen(tmp_path, "wb");
+	if (!fp)
+		return;
+	boolean ok =
+		write_padded(fp, &h, sizeof(h), off_pic) &&
+		write_padded(fp, cg->pic, pixel_bytes(cg->width, cg->height, cg->depth), off_alpha - off_pic) &&
+		write_padded(fp, cg->alpha, cg->alpha ? pixel_bytes(cg->width, cg->height, 8) : 0, off_pal - off_alpha) &&
+		write_padded(fp, cg->pal, h.pal_size, h.pal_size);
+	if (fclose(fp) != 0)
+		ok = FALSE;
+#ifdef _WIN32
+	if (ok)
+		remove(path);
+#endif
+	if (!ok || rename(tmp_path, path) != 0) {
+		WARNING("cannot write %s", path);
+		remove(tmp_path);
+		return;
+	}
+
+	SDL_LockMutex(mutex);
+	cache_bytes += off_pal + h.pal_size;
+	if (cache_bytes > CACHE_BUDGET)
+		prune();
+	SDL_UnlockMutex(mutex);
+}
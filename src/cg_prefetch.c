@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Background CG extraction.
+ *
+ * The interpreter thread requests CG numbers with cg_prefetch(), and worker
+ * threads read and extract them. Extracted data is kept in the pending list
+ * until cg_prefetch_take() hands it over to the loader. Only the interpreter
+ * thread touches the pending list and the cg cache.
+ */
+
+#include <stdlib.h>
+#include <SDL.h>
+
+#include "portab.h"
+#include "system.h"
+#include "cg.h"
+#include "ald_manager.h"
+#include "msgqueue.h"
+#include "scenario.h"
+
+#define MAX_WORKERS 4
+#define MAX_PENDING 16
+
+// How far the scenario scanner looks ahead from the current address.
+#define SCAN_WINDOW 0x1000
+#define SCAN_MAX    4
+
+enum job_state {
+	JOB_QUEUED,
+	JOB_RUNNING,
+	JOB_CANCELED,  // taken back by the interpreter thread before it started
+};
+
+struct job {
+	int no;
+	cgdata *cg;
+	SDL_atomic_t state;
+	bool done;  // result has been received by the interpreter thread
+};
+
+static int nr_workers;
+static struct msgq *requests;  // interpreter -> workers
+static struct msgq *results;   // workers -> interpreter
+
+// Requested jobs in request order. Accessed only by the interpreter thread.
+static struct job *pending[MAX_PENDING];
+static int nr_pending;
+
+static int worker(void *data) {
+	for (;;) {
+		struct job *job = msgq_dequeue(requests);
+		if (!SDL_AtomicCAS(&job->state, JOB_QUEUED, JOB_RUNNING)) {
+			// Canceled; the interpreter thread has forgotten this job.
+			free(job);
+			continue;
+		}
+		job->cg = cg_diskcache_load(job->no);
+		dridata *dfile = job->cg ? NULL : ald_getdata(DRIFILE_CG, job->no);
+		if (dfile) {
+			job->cg = cg_extract(dfile);
+			ald_freedata(dfile);
+			if (job->cg)
+				cg_diskcache_store(job->no, job->cg);
+		}
+		msgq_enqueue(results, job);
+	}
+	return 0;
+}
+
+static void receive_result(struct job *job) {
+	job->done = true;
+}
+
+static void poll_results(void) {
+	while (!msgq_isempty(results))
+		receive_result(msgq_dequeue(results));
+}
+
+static void remove_pending(int i) {
+	nr_pending--;
+	for (; i < nr_pending; i++)
+		pending[i] = pending[i + 1];
+}
+
+static int find_pending(int no) {
+	for (int i = 0; i < nr_pending; i++) {
+		if (pending[i]->no == no)
+			return i;
+	}
+	return -1;
+}
+
+void cg_prefetch_init(void) {
+#ifndef __EMSCRIPTEN__
+	if (nr_workers)
+		return;
+	requests = msgq_new();
+	results = msgq_new();
+	int n = min(max(SDL_GetCPUCount() - 1, 1), MAX_WORKERS);
+	for (int i = 0; i < n; i++) {
+		SDL_Thread *thread = SDL_CreateThread(worker, "CG prefetch", NULL);
+		if (!thread) {
+			WARNING("SDL_CreateThread failed: %s", SDL_GetError());
+			break;
+		}
+		SDL_DetachThread(thread);
+		nr_workers++;
+	}
+#endif
+}
+
+/*
+ * Request background extraction of a cg
+ *   no: file no ( >= 0)
+ */
+void cg_prefetch(int no) {
+	if (!nr_workers || no < 0 || no >= ald_get_maxno(DRIFILE_CG))
+		return;
+	if (cg_is_cached(no) || find_pending(no) >= 0)
+		return;
+
+	poll_results();
+	if (nr_pending == MAX_PENDING) {
+		// Discard the oldest result that nobody has taken.
+		int i;
+		for (i = 0; i < nr_pending; i++) {
+			if (pending[i]->done)
+				break;
+		}
+		if (i == nr_pending)
+			return;  // workers are busy
+		if (pending[i]->cg)
+			cgdata_free(pending[i]->cg);
+		free(pending[i]);
+		remove_pending(i);
+	}
+
+	struct job *job = calloc(1, sizeof(struct job));
+	if (!job)
+		NOMEMERR();
+	job->no = no;
+	pending[nr_pending++] = job;
+	msgq_enqueue(requests, job);
+}
+
+/*
+ * Take the result of background extraction. Waits only if a worker is
+ * extracting the cg right now; a request that no worker has started yet is
+ * canceled, and the caller extracts the cg by itself.
+ *   no: file no ( >= 0)
+ *   return: extracted cg (the caller owns it), or NULL if the cg has not
+ *           been extracted in background or could not be extracted
+ */
+cgdata *cg_prefetch_take(int no) {
+	int i = find_pending(no);
+	if (i < 0)
+		return NULL;
+
+	struct job *job = pending[i];
+	if (!job->done && SDL_AtomicCAS(&job->state, JOB_QUEUED, JOB_CANCELED)) {
+		// The worker that dequeues the job frees it.
+		remove_pending(i);
+		return NULL;
+	}
+	while (!job->done)
+		receive_result(msgq_dequeue(results));
+	remove_pending(i);
+
+	cgdata *cg = job->cg;
+	free(job);
+	return cg;
+}
+
+/*
+ * Parse a constant CALI expression
+ *   return: length of the expression, or 0 if it is not a constant
+ */
+static int const_cali(const uint8_t *p, int *val) {
+	if (p[0] >= 0x40 && p[0] <= 0x73) {
+		*val = p[0] & 0x3f;
+		return p[1] == 0x7f ? 2 : 0;
+	}
+	if (p[0] < 0x40) {
+		if (p[0] == 0) {
+			if (p[1] <= 0x33)
+				return 0;
+			*val = p[1];
+		} else {
+			*val = (p[0] & 0x3f) << 8 | p[1];
+		}
+		return p[2] == 0x7f ? 3 : 0;
+	}
+	return 0;
+}
+
+/*
+ * Look ahead in the current scenario page for cg loading commands
+ * (G0 / G1 with a constant cg number) and prefetch them.
+ */
+void cg_prefetch_scan(void) {
+	if (!nr_workers || !sl_sco)
+		return;
+
+	const uint8_t *sco = sl_sco;
+	int end = min(sl_getPageSize(), sl_getIndex() + SCAN_WINDOW) - 5;
+	int found = 0;
+	for (int i = sl_getIndex(); i < end && found < SCAN_MAX; i++) {
+		if (sco[i] != 'G' || sco[i + 1] > 1)
+			continue;
+		int no;
+		if (!const_cali(sco + i + 2, &no) || no == 0)
+			continue;
+		cg_prefetch(no - 1);
+		found++;
+	}
+}
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "portab.h"
 #include "cmd_check.h"
@@ -46,10 +47,7 @@ static void commandsDEC() {
 }
 
 /* 変数の代入 */
-static void letVar(int type) {
-	int *varno = getVariable();
-	int val    = getCaliValue();
-
+static void assign(int type, int *varno, int val) {
 	if (varno == NULL) {
 		WARNING("varno is NULL");
 		return;
@@ -83,6 +81,12 @@ static void letVar(int type) {
 	// printf("letvar %p=%d\n",varno, val);
 }
 
+static void letVar(int type) {
+	int *varno = getVariable();
+	int val    = getCaliValue();
+	assign(type, varno, val);
+}
+
 /* データテーブルの設定 */
 static void getDataTableAdr() {
 	int index  = sl_getaddr();
@@ -98,24 +102,7 @@ static void getDataTableAdr() {
 }
 
 /* < ループ開始 */
-static void loopStart() {
-	int p1 = sl_getc();
-	int exitadr, limit, direction, step;
-	int *var;
-	
-	if (p1 == 0) {
-		sl_getc();
-		sl_getc();
-	} else if (p1 != 1) {
-		undeferr();
-	}
-	
-	exitadr   = sl_getaddr();
-	var       = getCaliVariable();
-	limit     = getCaliValue();
-	direction = getCaliValue();
-	step      = getCaliValue();
-	
+static void loop(int p1, int exitadr, int *var, int limit, int direction, int step) {
 	if (direction == 0) {
 		/* dec */
 		if (p1 == 1) {
@@ -144,6 +131,26 @@ static void loopStart() {
 	return;
 }
 
+static void loopStart() {
+	int p1 = sl_getc();
+	int exitadr, limit, direction, step;
+	int *var;
+	
+	if (p1 == 0) {
+		sl_getc();
+		sl_getc();
+	} else if (p1 != 1) {
+		undeferr();
+	}
+	
+	exitadr   = sl_getaddr();
+	var       = getCaliVariable();
+	limit     = getCaliValue();
+	direction = getCaliValue();
+	step      = getCaliValue();
+	loop(p1, exitadr, var, limit, direction, step);
+}
+
 static void undeferr() {
 	SYSERROR("Undefined Command:@ %03d,%05x", sl_getPage(), sl_getIndex());
 }
@@ -173,6 +180,201 @@ static void message(int c0) {
 	}
 }
 
+/*
+ * Pre-decoded commands
+ *
+ * Variable assignments, INC/DEC, conditionals and loops take only variable
+ * and expression operands. They are decoded on first execution into a
+ * per-page array indexed by script address, with the operands compiled by
+ * cali.c, so that later executions run without parsing any operand bytes.
+ * Commands that cannot be decoded are remembered and always take the
+ * ordinary path in exec_command(), which reports the errors.
+ */
+enum {
+	DC_FAIL,  /* not decodable */
+	DC_LET,
+	DC_INC,
+	DC_DEC,
+	DC_IF,
+	DC_LOOP,
+};
+
+struct decoded_cmd {
+	int type;
+	int op;      /* type of letVar(), or p1 of loopStart() */
+	int end;     /* address after the command */
+	int addr;    /* jump address */
+	int var;     /* operand handles of cali.c */
+	int val[3];
+};
+
+struct cmd_page {
+	int *map;    /* address -> index into cmds + 1 (0: not decoded yet) */
+	int size;    /* page size */
+	struct decoded_cmd *cmds;
+	int nr_cmds;
+	int max_cmds;
+};
+
+static struct cmd_page *cmd_pages;
+static int nr_cmd_pages;
+
+/* シナリオの再初期化時にキャッシュを捨てる */
+void cmd_check_reset(void) {
+	for (int i = 0; i < nr_cmd_pages; i++) {
+		free(cmd_pages[i].map);
+		free(cmd_pages[i].cmds);
+	}
+	free(cmd_pages);
+	cmd_pages = NULL;
+	nr_cmd_pages = 0;
+}
+
+static struct cmd_page *get_cmd_page(int page) {
+	if (page >= nr_cmd_pages) {
+		int n = page + 1 > nr_cmd_pages * 2 ? page + 1 : nr_cmd_pages * 2;
+		cmd_pages = realloc(cmd_pages, n * sizeof(struct cmd_page));
+		if (!cmd_pages)
+			NOMEMERR();
+		memset(cmd_pages + nr_cmd_pages, 0, (n - nr_cmd_pages) * sizeof(struct cmd_page));
+		nr_cmd_pages = n;
+	}
+	struct cmd_page *cp = &cmd_pages[page];
+	if (!cp->map) {
+		cp->size = sl_getPageSize();
+		cp->map = calloc(cp->size + 1, sizeof(int));
+		if (!cp->map)
+			NOMEMERR();
+	}
+	return cp;
+}
+
+/* variable operand followed by the terminator, like getCaliVariable() */
+static int decode_variable(int p, int *end) {
+	int var = cali_decodeVariable(p, &p);
+	if (var < 0 || sl_getcAt(p) != 0x7f)
+		return -1;
+	*end = p + 1;
+	return var;
+}
+
+/* Decode the command c0 whose operands start at p. */
+static void decode(struct decoded_cmd *cmd, int c0, int p) {
+	cmd->type = DC_FAIL;
+	switch (c0) {
+	case '!':
+	case 0x10: case 0x11: case 0x12: case 0x13:
+	case 0x14: case 0x15: case 0x16: case 0x17:
+		if ((cmd->var = cali_decodeVariable(p, &p)) < 0 ||
+			(cmd->val[0] = cali_decodeValue(p, &p)) < 0)
+			return;
+		cmd->type = DC_LET;
+		cmd->op = c0;
+		break;
+	case '{':
+		if ((cmd->val[0] = cali_decodeValue(p, &p)) < 0)
+			return;
+		cmd->addr = sl_getdAt(p);
+		p += 4;
+		cmd->type = DC_IF;
+		break;
+	case '<':
+		cmd->op = sl_getcAt(p++);
+		if (cmd->op == 0)
+			p += 2;
+		else if (cmd->op != 1)
+			return;
+		cmd->addr = sl_getdAt(p);
+		p += 4;
+		if ((cmd->var = decode_variable(p, &p)) < 0)
+			return;
+		for (int i = 0; i < 3; i++) {
+			if ((cmd->val[i] = cali_decodeValue(p, &p)) < 0)
+				return;
+		}
+		cmd->type = DC_LOOP;
+		break;
+	case '/':
+		c0 = sl_getcAt(p++);
+		if ((cmd->var = decode_variable(p, &p)) < 0)
+			return;
+		cmd->type = c0 == 0x06 ? DC_INC : DC_DEC;
+		break;
+	default:
+		return;
+	}
+	cmd->end = p;
+}
+
+/* Runs the command c0 from its decoded form. Returns FALSE if it has none. */
+static boolean exec_decoded(int c0) {
+	switch (c0) {
+	case '!':
+	case 0x10: case 0x11: case 0x12: case 0x13:
+	case 0x14: case 0x15: case 0x16: case 0x17:
+	case '{':
+	case '<':
+		break;
+	case '/':
+		if (sl_getcAt(sl_getIndex()) == 0x06 || sl_getcAt(sl_getIndex()) == 0x07)
+			break;
+		return FALSE;
+	default:
+		return FALSE;
+	}
+	if (sl_getPage() < 0)
+		return FALSE;
+
+	struct cmd_page *cp = get_cmd_page(sl_getPage());
+	int addr = sl_getIndex() - 1;
+	if (addr >= cp->size)
+		return FALSE;
+	if (!cp->map[addr]) {
+		if (cp->nr_cmds == cp->max_cmds) {
+			cp->max_cmds = cp->max_cmds ? cp->max_cmds * 2 : 64;
+			cp->cmds = realloc(cp->cmds, cp->max_cmds * sizeof(struct decoded_cmd));
+			if (!cp->cmds)
+				NOMEMERR();
+		}
+		decode(&cp->cmds[cp->nr_cmds], c0, addr + 1);
+		cp->map[addr] = ++cp->nr_cmds;
+	}
+	const struct decoded_cmd *cmd = &cp->cmds[cp->map[addr] - 1];
+	if (cmd->type == DC_FAIL)
+		return FALSE;
+
+	sl_jmpNear(cmd->end);
+	int *var;
+	switch (cmd->type) {
+	case DC_LET:
+		var = cali_variable(cmd->var);
+		assign(cmd->op, var, cali_value(cmd->val[0]));
+		break;
+	case DC_INC:
+		var = cali_variable(cmd->var);
+		if (var && *var < 65535) (*var)++;
+		break;
+	case DC_DEC:
+		var = cali_variable(cmd->var);
+		if (var && *var > 0) (*var)--;
+		break;
+	case DC_IF:
+		if (!cali_value(cmd->val[0]))
+			sl_jmpNear(cmd->addr);
+		break;
+	case DC_LOOP:
+		{
+			var = cali_variable(cmd->var);
+			int limit = cali_value(cmd->val[0]);
+			int direction = cali_value(cmd->val[1]);
+			int step = cali_value(cmd->val[2]);
+			loop(cmd->op, cmd->addr, var, limit, direction, step);
+		}
+		break;
+	}
+	return TRUE;
+}
+
 void exec_command(void) {
 	DEBUG_MESSAGE("%d:%x\n", sl_getPage(), sl_getIndex());
 
@@ -186,6 +388,8 @@ void exec_command(void) {
 		message(c0);
 		return;
 	}
+	if (exec_decoded(c0))
+		return;
 
 	switch(c0) {
 	case 0:
@@ -36,6 +36,7 @@ void commandG0() {
 	}
 	
 	cg_load(num - 1, -1);
+	cg_prefetch_scan();
 	
 	DEBUG_COMMAND("G %d:",num);
 }
@@ -51,6 +52,7 @@ void commandG1() {
 	}
 	
 	cg_load(num - 1, sprite);
+	cg_prefetch_scan();
 	
 	DEBUG_COMMAND("G %d,%d:",num,sprite);
 }
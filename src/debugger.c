@@ -18,7 +18,7 @@
  */
 
 #include <assert.h>
-#include <setjmp.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include "debugger.h"
@@ -70,214 +70,40 @@ int dbg_lookup_var(const char *name) {
 	return -1;
 }
 
-static const char *eval_input;
-static jmp_buf eval_jmp_buf;
-static char *eval_result;
-static size_t eval_result_size;
-static int eval_expr(void);
-
-static void eval_error(char *format, ...) {
-	va_list args;
-	va_start(args, format);
-	vsnprintf(eval_result, eval_result_size, format, args);
-	va_end(args);
-
-	longjmp(eval_jmp_buf, 1);
-}
-
-static char next_char(void) {
-	while (isspace(*eval_input))
-		eval_input++;
-	return *eval_input;
+static boolean eval_condition(const CompiledExpr *cond) {
+	int val;
+	return dbg_execute_expr(cond, &val, NULL, 0) && val;
 }
 
-static boolean consume(char c) {
-	if (next_char() != c)
+boolean dbg_evaluate(const char *expr, char *result, size_t result_size) {
+	CompiledExpr *e = dbg_compile_expr(expr, result, result_size);
+	if (!e)
 		return false;
-	eval_input++;
-	return true;
-}
-
-static void expect(char c) {
-	if (next_char() != c)
-		eval_error("syntax error");
-	eval_input++;
-}
-
-static int clamp(int val) {
-	return val > 0xffff ? 0xffff
-		: val < 0 ? 0
-		: val;
-}
-
-static boolean is_identifier(uint8_t c) {
-	return isalnum(c) || !isascii(c) || c == '_' || c == '.';
-}
-
-static int parse_number(void) {
-	int base = 10;
-	if (eval_input[0] == '0' && tolower(eval_input[1]) == 'x') {
-		base = 16;
-		eval_input += 2;
-	} else if (eval_input[0] == '0' && tolower(eval_input[1]) == 'b') {
-		base = 2;
-		eval_input += 2;
-	}
-	char *p;
-	long val = strtol(eval_input, &p, base);
-	eval_input = p;
-	return clamp(val);
-}
-
-static int eval_variable(void) {
-	const char *top = eval_input;
-	while (is_identifier(*eval_input))
-		eval_input++;
-	if (top == eval_input)
-		eval_error("syntax error");
-
-	char *buf = alloca(eval_input - top + 1);
-	strncpy(buf, top, eval_input - top);
-	buf[eval_input - top] = '\0';
-	int var = dbg_lookup_var(buf);
-	if (var < 0)
-		eval_error("unknown variable \"%s\"", buf);
-	int *store;
-	if (consume('[')) {
-		int index = eval_expr();
-		expect(']');
-		store = v_ref_indexed(var, index, NULL);
-	} else {
-		store = v_ref(var, NULL);
-	}
-	if (!store)
-		eval_error("out of bounds array access");
-	return *store;
-}
-
-static int eval_prim(void) {
-	if (consume('(')) {
-		int val = eval_expr();
-		expect(')');
-		return val;
-	}
-	if (isdigit(next_char()))
-		return parse_number();
-
-	return eval_variable();
-}
-
-static int eval_mul(void) {
-	int val = eval_prim();
-	for (;;) {
-		if (consume('*')) {
-			val = clamp(val * eval_prim());
-		} else if (consume('/')) {
-			int rhs = eval_prim();
-			val = rhs ? val / rhs : 0;
-		} else if (consume('%')) {
-			int rhs = eval_prim();
-			val = rhs ? val % rhs : 0;
-		} else {
-			break;
-		}
-	}
-	return val;
-}
-
-static int eval_add(void) {
-	int val = eval_mul();
-	for (;;) {
-		if (consume('+'))
-			val = clamp(val + eval_mul());
-		else if (consume('-'))
-			val = clamp(val - eval_mul());
-		else
-			break;
-	}
-	return val;
-}
-
-static int eval_bit(void) {
-	int val = eval_add();
-	for (;;) {
-		if (consume('&'))
-			val = val & eval_add();
-		else if (consume('|'))
-			val = val | eval_add();
-		else if (consume('^'))
-			val = val ^ eval_add();
-		else
-			break;
-	}
-	return val;
-}
-
-static int eval_compare(void) {
-	int val = eval_bit();
-	for (;;) {
-		if (consume('<')) {
-			if (consume('='))
-				val = val <= eval_bit() ? 1 : 0;
-			else
-				val = val < eval_bit() ? 1 : 0;
-		} else if (consume('>')) {
-			if (consume('='))
-				val = val >= eval_bit() ? 1 : 0;
-			else
-				val = val > eval_bit() ? 1 : 0;
-		} else {
-			break;
-		}
-	}
-	return val;
-}
-
-static int eval_expr(void) {
-	int val = eval_compare();
-	for (;;) {
-		if (consume('=')) {
-			val = val == eval_compare() ? 1 : 0;
-		} else if (consume('\\')) {
-			val = val != eval_compare() ? 1 : 0;
-		} else {
-			break;
-		}
-	}
-	return val;
+	int val;
+	boolean ok = dbg_execute_expr(e, &val, result, result_size);
+	if (ok)
+		snprintf(result, result_size, "%d", val);
+	free(e);
+	return ok;
 }
 
-static int eval_condition(const char *expr) {
-	eval_input = expr;
-	eval_result = NULL;
-	eval_result_size = 0;
-	if (!setjmp(eval_jmp_buf)) {
-		return eval_expr();
-	} else {
-		return 0;
-	}
-}
+/*
+ * Physical breakpoints are indexed by (page, addr), so that a BREAKPOINT
+ * instruction finds its breakpoints without scanning all of them.
+ */
+#define BP_HASH_BITS 8
+static PhysicalBreakpoint *phys_table[1 << BP_HASH_BITS];
 
-boolean dbg_evaluate(const char *expr, char *result, size_t result_size) {
-	eval_input = expr;
-	eval_result = result;
-	eval_result_size = result_size;
-	if (!setjmp(eval_jmp_buf)) {
-		int val = eval_expr();
-		expect('\0');
-		snprintf(result, result_size, "%d", val);
-		return true;
-	} else {
-		return false;
-	}
+static PhysicalBreakpoint **phys_bucket(int page, int addr) {
+	uint32_t key = (uint32_t)page << 20 ^ (uint32_t)addr;
+	return &phys_table[(key * 2654435761u) >> (32 - BP_HASH_BITS)];
 }
 
 static PhysicalBreakpoint *find_physical_breakpoint(int page, int addr) {
-	for (Breakpoint *bp = breakpoints; bp; bp = bp->next) {
-		if (bp->phys->page == page && bp->phys->addr == addr)
-			return bp->phys;
-	}
-	return NULL;
+	PhysicalBreakpoint *phys = *phys_bucket(page, addr);
+	while (phys && (phys->page != page || phys->addr != addr))
+		phys = phys->hnext;
+	return phys;
 }
 
 Breakpoint *dbg_set_breakpoint(int page, int addr, boolean is_internal) {
@@ -301,6 +127,9 @@ Breakpoint *dbg_set_breakpoint(int page, int addr, boolean is_internal) {
 		phys->addr = addr;
 		phys->refcnt = 1;
 		phys->restore_op = dfile->data[addr];
+		PhysicalBreakpoint **bucket = phys_bucket(page, addr);
+		phys->hnext = *bucket;
+		*bucket = phys;
 	}
 
 	Breakpoint *bp = calloc(1, sizeof(Breakpoint));
@@ -309,6 +138,8 @@ Breakpoint *dbg_set_breakpoint(int page, int addr, boolean is_internal) {
 	bp->dfile = dfile;
 	bp->next = breakpoints;
 	breakpoints = bp;
+	bp->phys_next = phys->bps;
+	phys->bps = bp;
 
 	dfile->data[addr] = BREAKPOINT;
 
@@ -316,23 +147,81 @@ Breakpoint *dbg_set_breakpoint(int page, int addr, boolean is_internal) {
 }
 
 boolean dbg_set_breakpoint_condition(Breakpoint *bp, const char *condition, char *err, size_t errsize) {
-	if (!dbg_evaluate(condition, err, errsize))
+	CompiledExpr *code = dbg_compile_expr(condition, err, errsize);
+	if (!code)
 		return false;
 	if (bp->condition)
 		free(bp->condition);
+	free(bp->cond_code);
 	bp->condition = strdup(condition);
+	bp->cond_code = code;
 	return true;
 }
 
+/*
+ * Hit condition: an optional operator (==, >=, >, <=, < or %) followed by
+ * a number. A number alone means ">=".
+ */
+boolean dbg_set_breakpoint_hit_condition(Breakpoint *bp, const char *condition, char *err, size_t errsize) {
+	static const struct {
+		const char *str;
+		HitConditionOp op;
+	} ops[] = {
+		{"==", HIT_EQ}, {">=", HIT_GE}, {"<=", HIT_LE},
+		{">", HIT_GT}, {"<", HIT_LT}, {"%", HIT_MOD}, {"=", HIT_EQ},
+	};
+	const char *p = condition;
+	while (isspace(*p))
+		p++;
+	HitConditionOp op = HIT_GE;
+	for (int i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+		size_t len = strlen(ops[i].str);
+		if (!strncmp(p, ops[i].str, len)) {
+			op = ops[i].op;
+			p += len;
+			break;
+		}
+	}
+	char *endp;
+	long val = strtol(p, &endp, 10);
+	while (isspace(*endp))
+		endp++;
+	if (endp == p || *endp || val < 0 || (op == HIT_MOD && val == 0)) {
+		snprintf(err, errsize, "invalid hit condition \"%s\"", condition);
+		return false;
+	}
+	bp->hit_op = op;
+	bp->hit_value = val;
+	return true;
+}
+
+Breakpoint *dbg_get_breakpoints(void) {
+	return breakpoints;
+}
+
 static Breakpoint *breakpoint_free(Breakpoint *bp) {
-	assert(bp->dfile->data[bp->phys->addr] == BREAKPOINT);
-	assert(bp->phys->refcnt > 0);
-	if (--bp->phys->refcnt == 0) {
-		bp->dfile->data[bp->phys->addr] = bp->phys->restore_op;
-		free(bp->phys);
+	PhysicalBreakpoint *phys = bp->phys;
+	assert(bp->dfile->data[phys->addr] == BREAKPOINT);
+	assert(phys->refcnt > 0);
+	for (Breakpoint **p = &phys->bps; *p; p = &(*p)->phys_next) {
+		if (*p == bp) {
+			*p = bp->phys_next;
+			break;
+		}
+	}
+	if (--phys->refcnt == 0) {
+		bp->dfile->data[phys->addr] = phys->restore_op;
+		for (PhysicalBreakpoint **p = phys_bucket(phys->page, phys->addr); *p; p = &(*p)->hnext) {
+			if (*p == phys) {
+				*p = phys->hnext;
+				break;
+			}
+		}
+		free(phys);
 	}
 	if (bp->condition)
 		free(bp->condition);
+	free(bp->cond_code);
 	ald_freedata(bp->dfile);
 	Breakpoint *next = bp->next;
 	free(bp);
@@ -359,23 +248,39 @@ void dbg_delete_breakpoints_in_page(int page) {
 	}
 }
 
+static boolean check_hit_condition(Breakpoint *bp) {
+	switch (bp->hit_op) {
+	case HIT_EQ:  return bp->hits == bp->hit_value;
+	case HIT_GE:  return bp->hits >= bp->hit_value;
+	case HIT_GT:  return bp->hits > bp->hit_value;
+	case HIT_LE:  return bp->hits <= bp->hit_value;
+	case HIT_LT:  return bp->hits < bp->hit_value;
+	case HIT_MOD: return bp->hits % bp->hit_value == 0;
+	default:      return true;
+	}
+}
+
 uint8_t dbg_handle_breakpoint(int page, int addr) {
-	uint8_t restore_op = BREAKPOINT;
-	for (Breakpoint *bp = breakpoints; bp; bp = bp->next) {
-		if (bp->phys->page != page || bp->phys->addr != addr)
+	PhysicalBreakpoint *phys = find_physical_breakpoint(page, addr);
+	if (!phys)
+		SYSERROR("Illegal BREAKPOINT instruction");
+	uint8_t restore_op = phys->restore_op;
+	for (Breakpoint *bp = phys->bps; bp; bp = bp->phys_next) {
+		if (bp->cond_code && !eval_condition(bp->cond_code))
 			continue;
-		restore_op = bp->phys->restore_op;
-		if (bp->condition && !eval_condition(bp->condition))
+		bp->hits++;
+		if (!check_hit_condition(bp))
 			continue;
 
 		dbg_state = bp->no == INTERNAL_BREAKPOINT_NO ?
 			DBG_STOPPED_NEXT : DBG_STOPPED_BREAKPOINT;
 
+		// Breakpoints after this one at the same location are neither
+		// evaluated nor counted in this pass, so their `hits` fall behind.
+		// bp may be gone after dbg_main(), so we can't resume the loop.
 		dbg_main(bp->no);  // this may destroy bp
 		return restore_op;
 	}
-	if (restore_op == BREAKPOINT)
-		SYSERROR("Illegal BREAKPOINT instruction");
 	return restore_op;
 }
 
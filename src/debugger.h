@@ -47,7 +47,6 @@ void dbg_main(int bp_no);
 void dbg_onsleep(void);
 uint8_t dbg_handle_breakpoint(int page, int addr);
 boolean dbg_console_vprintf(int lv, const char *format, va_list ap);
-void dbg_post_command(void *data);
 
 #else // ENABLE_DEBUGGER
 
@@ -58,7 +57,6 @@ void dbg_post_command(void *data);
 #define dbg_onsleep()
 #define dbg_handle_breakpoint(page, addr) BREAKPOINT
 #define dbg_console_vprintf(lv, format, ap) false
-#define dbg_post_command(data)
 
 #endif // ENABLE_DEBUGGER
 
@@ -34,6 +34,7 @@
 #include "sdl_core.h"
 #include "system.h"
 #include "nact.h"
+#include "profiler.h"
 #include "variable.h"
 
 #define THREAD_ID 1
@@ -49,7 +50,7 @@ static const char ebf_warnings[] = "warnings";
 static bool initialized;
 static char *symbols_path;
 static char *src_dir;
-static struct msgq *queue;
+static struct spscq *queue;  // debugger thread -> main
 static bool break_on_warnings;
 
 cJSON *create_source(const char *name) {
@@ -89,7 +90,7 @@ static void emit_terminated_event(void) {
 	send_json(event);
 }
 
-static void emit_stopped_event(void) {
+static void emit_stopped_event(int bp_no) {
 	const char *reason;
 	switch (dbg_state) {
 	case DBG_STOPPED_ENTRY: reason = "entry"; break;
@@ -107,6 +108,11 @@ static void emit_stopped_event(void) {
 	cJSON_AddItemToObjectCS(event, "body", body = cJSON_CreateObject());
 	cJSON_AddStringToObject(body, "reason", reason);
 	cJSON_AddNumberToObject(body, "threadId", THREAD_ID);  // needed?
+	if (dbg_state == DBG_STOPPED_BREAKPOINT && bp_no > 0) {
+		cJSON *ids;
+		cJSON_AddItemToObjectCS(body, "hitBreakpointIds", ids = cJSON_CreateArray());
+		cJSON_AddItemToArray(ids, cJSON_CreateNumber(bp_no));
+	}
 	send_json(event);
 }
 
@@ -135,6 +141,7 @@ static void cmd_initialize(cJSON *args, cJSON *resp) {
 	cJSON_AddBoolToObject(resp, "success", true);
 	cJSON_AddItemToObjectCS(resp, "body", body = cJSON_CreateObject());
 	cJSON_AddBoolToObject(body, "supportsConditionalBreakpoints", true);
+	cJSON_AddBoolToObject(body, "supportsHitConditionalBreakpoints", true);
 	cJSON_AddBoolToObject(body, "supportsConfigurationDoneRequest", true);
 	cJSON_AddBoolToObject(body, "supportsEvaluateForHovers", true);
 	cJSON_AddBoolToObject(body, "supportsSetVariable", true);
@@ -253,6 +260,15 @@ static void cmd_setBreakpoints(cJSON *args, cJSON *resp) {
 				continue;
 			}
 		}
+		cJSON *hitCondition = cJSON_GetObjectItemCaseSensitive(srcbp, "hitCondition");
+		if (cJSON_IsString(hitCondition)) {
+			if (!dbg_set_breakpoint_hit_condition(bp, hitCondition->valuestring, message, sizeof(message))) {
+				dbg_delete_breakpoint(bp->no);
+				cJSON_AddBoolToObject(item, "verified", false);
+				cJSON_AddStringToObject(item, "message", message);
+				continue;
+			}
+		}
 
 		line_no = dsym_addr2line(symbols, page, addr);
 		cJSON_AddNumberToObject(item, "id", bp->no);
@@ -262,6 +278,50 @@ static void cmd_setBreakpoints(cJSON *args, cJSON *resp) {
 	}
 }
 
+// Non-standard request: returns the hit count of each breakpoint.
+static void cmd_breakpointHitCounts(cJSON *args, cJSON *resp) {
+	cJSON *body, *bps;
+	cJSON_AddBoolToObject(resp, "success", true);
+	cJSON_AddItemToObjectCS(resp, "body", body = cJSON_CreateObject());
+	cJSON_AddItemToObjectCS(body, "breakpoints", bps = cJSON_CreateArray());
+	for (Breakpoint *bp = dbg_get_breakpoints(); bp; bp = bp->next) {
+		if (bp->no <= 0)
+			continue;  // internal breakpoint
+		cJSON *item = cJSON_CreateObject();
+		cJSON_AddItemToArray(bps, item);
+		cJSON_AddNumberToObject(item, "id", bp->no);
+		cJSON_AddNumberToObject(item, "hitCount", bp->hits);
+	}
+}
+
+// Non-standard request: starts the scenario profiler.
+static void cmd_startProfiling(cJSON *args, cJSON *resp) {
+	prof_start();
+	cJSON_AddBoolToObject(resp, "success", prof_active);
+}
+
+// Non-standard request: stops the scenario profiler. The profile is written
+// to args.path if given, otherwise returned as body.folded.
+static void cmd_stopProfiling(cJSON *args, cJSON *resp) {
+	prof_stop();
+	cJSON *path = cJSON_GetObjectItemCaseSensitive(args, "path");
+	if (cJSON_IsString(path)) {
+		if (!prof_write(path->valuestring)) {
+			cJSON_AddBoolToObject(resp, "success", false);
+			cJSON_AddStringToObject(resp, "message", "xsystem35: Cannot write profile");
+			return;
+		}
+		cJSON_AddBoolToObject(resp, "success", true);
+		return;
+	}
+	cJSON *body;
+	char *folded = prof_folded();
+	cJSON_AddBoolToObject(resp, "success", true);
+	cJSON_AddItemToObjectCS(resp, "body", body = cJSON_CreateObject());
+	cJSON_AddStringToObject(body, "folded", folded);
+	free(folded);
+}
+
 static void cmd_setExceptionBreakpoints(cJSON *args, cJSON *resp) {
 	cJSON *filters = cJSON_GetObjectItemCaseSensitive(args, "filters");
 	break_on_warnings = false;
@@ -526,6 +586,12 @@ static boolean handle_request(cJSON *request) {
 		cmd_setBreakpoints(args, resp);
 	} else if (!strcmp(command->valuestring, "setExceptionBreakpoints")) {
 		cmd_setExceptionBreakpoints(args, resp);
+	} else if (!strcmp(command->valuestring, "breakpointHitCounts")) {
+		cmd_breakpointHitCounts(args, resp);
+	} else if (!strcmp(command->valuestring, "startProfiling")) {
+		cmd_startProfiling(args, resp);
+	} else if (!strcmp(command->valuestring, "stopProfiling")) {
+		cmd_stopProfiling(args, resp);
 	} else if (!strcmp(command->valuestring, "threads")) {
 		cmd_threads(args, resp);
 	} else if (!strcmp(command->valuestring, "scopes")) {
@@ -567,19 +633,21 @@ static int read_command_thread(void *data) {
 			}
 			char *buf = malloc(content_length);
 			fread(buf, content_length, 1, stdin);
-			sdl_post_debugger_command(buf);
+			spscq_enqueue(queue, buf);
+			sdl_post_debugger_command();
 			content_length = -1;
 		} else {
 			fprintf(stderr, "Unknown Debug Adapter Protocol header: %s", header);
 		}
 	}
-	sdl_post_debugger_command(NULL);  // end of messages
+	spscq_enqueue(queue, NULL);  // end of messages
+	sdl_post_debugger_command();
 	return 0;
 }
 
 static void dbg_dap_init(const char *path) {
 	symbols_path = strdup(path);
-	queue = msgq_new();
+	queue = spscq_new(64);
 
 #ifdef _WIN32
 	_setmode(_fileno(stdin), _O_BINARY);
@@ -592,8 +660,8 @@ static void dbg_dap_init(const char *path) {
 		SDL_Event e;
 		SDL_WaitEvent(&e);
 		sdl_handle_event(&e);
-		while (!msgq_isempty(queue)) {
-			char *msg = msgq_dequeue(queue);
+		while (!spscq_isempty(queue)) {
+			char *msg = spscq_dequeue(queue);
 			if (!msg)
 				return;
 			handle_message(msg);
@@ -606,7 +674,7 @@ static void dbg_dap_quit(void) {
 }
 
 static void dbg_dap_repl(int bp_no) {
-	emit_stopped_event();
+	emit_stopped_event(bp_no);
 	dbg_state = DBG_RUNNING;
 
 	boolean continue_repl = true;
@@ -614,8 +682,8 @@ static void dbg_dap_repl(int bp_no) {
 		SDL_Event e;
 		SDL_WaitEvent(&e);
 		sdl_handle_event(&e);
-		while (!msgq_isempty(queue)) {
-			char *msg = msgq_dequeue(queue);
+		while (!spscq_isempty(queue)) {
+			char *msg = spscq_dequeue(queue);
 			if (!msg)
 				return;
 			continue_repl = handle_message(msg);
@@ -624,8 +692,8 @@ static void dbg_dap_repl(int bp_no) {
 }
 
 static void dbg_dap_onsleep(void) {
-	while (!msgq_isempty(queue)) {
-		char *msg = msgq_dequeue(queue);
+	while (!spscq_isempty(queue)) {
+		char *msg = spscq_dequeue(queue);
 		if (!msg)
 			break;
 		handle_message(msg);
@@ -634,10 +702,6 @@ static void dbg_dap_onsleep(void) {
 		dbg_main(0);
 }
 
-void dbg_post_command(void *data) {
-	msgq_enqueue(queue, data);
-}
-
 DebuggerImpl dbg_dap_impl = {
 	.init = dbg_dap_init,
 	.quit = dbg_dap_quit,
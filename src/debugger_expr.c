@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ctype.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debugger_private.h"
+#include "system.h"
+#include "variable.h"
+
+/*
+ * Expressions are compiled into a small stack machine code, so that
+ * breakpoint conditions are parsed only once and not on every hit.
+ */
+enum {
+	OP_END,
+	OP_NUM,    // push the operand
+	OP_VAR,    // push the variable of the operand
+	OP_INDEX,  // replace the top with the array element of the operand
+	OP_MUL,
+	OP_DIV,
+	OP_MOD,
+	OP_ADD,
+	OP_SUB,
+	OP_AND,
+	OP_OR,
+	OP_XOR,
+	OP_LE,
+	OP_LT,
+	OP_GE,
+	OP_GT,
+	OP_EQ,
+	OP_NE,
+};
+
+// Expressions that need a deeper stack are rejected at compile time.
+#define MAX_STACK_DEPTH 64
+
+struct compiled_expr {
+	int len;
+	int code[];
+};
+
+static const char *eval_input;
+static jmp_buf eval_jmp_buf;
+static char *eval_result;
+static size_t eval_result_size;
+static void compile_expr(void);
+
+// code buffer of the expression being compiled
+static struct {
+	int *code;
+	int len;
+	int cap;
+	int depth;
+} cbuf;
+
+static void eval_error(char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	vsnprintf(eval_result, eval_result_size, format, args);
+	va_end(args);
+
+	longjmp(eval_jmp_buf, 1);
+}
+
+static void emit(int op, int operand) {
+	if (cbuf.len + 2 > cbuf.cap) {
+		cbuf.cap = cbuf.cap ? cbuf.cap * 2 : 64;
+		cbuf.code = realloc(cbuf.code, cbuf.cap * sizeof(int));
+		if (!cbuf.code)
+			NOMEMERR();
+	}
+	cbuf.code[cbuf.len++] = op;
+	switch (op) {
+	case OP_NUM:
+	case OP_VAR:
+		cbuf.code[cbuf.len++] = operand;
+		if (++cbuf.depth > MAX_STACK_DEPTH)
+			eval_error("expression too complex");
+		break;
+	case OP_INDEX:
+		cbuf.code[cbuf.len++] = operand;
+		break;
+	case OP_END:
+		break;
+	default:  // binary operators
+		cbuf.depth--;
+		break;
+	}
+}
+
+static char next_char(void) {
+	while (isspace(*eval_input))
+		eval_input++;
+	return *eval_input;
+}
+
+static boolean consume(char c) {
+	if (next_char() != c)
+		return false;
+	eval_input++;
+	return true;
+}
+
+static void expect(char c) {
+	if (next_char() != c)
+		eval_error("syntax error");
+	eval_input++;
+}
+
+static int clamp(long long val) {
+	return val > 0xffff ? 0xffff
+		: val < 0 ? 0
+		: val;
+}
+
+static boolean is_identifier(uint8_t c) {
+	return isalnum(c) || !isascii(c) || c == '_' || c == '.';
+}
+
+static int parse_number(void) {
+	int base = 10;
+	if (eval_input[0] == '0' && tolower(eval_input[1]) == 'x') {
+		base = 16;
+		eval_input += 2;
+	} else if (eval_input[0] == '0' && tolower(eval_input[1]) == 'b') {
+		base = 2;
+		eval_input += 2;
+	}
+	char *p;
+	long val = strtol(eval_input, &p, base);
+	eval_input = p;
+	return clamp(val);
+}
+
+static void compile_variable(void) {
+	const char *top = eval_input;
+	while (is_identifier(*eval_input))
+		eval_input++;
+	if (top == eval_input)
+		eval_error("syntax error");
+
+	char *buf = alloca(eval_input - top + 1);
+	strncpy(buf, top, eval_input - top);
+	buf[eval_input - top] = '\0';
+	int var = dbg_lookup_var(buf);
+	if (var < 0)
+		eval_error("unknown variable \"%s\"", buf);
+	if (consume('[')) {
+		compile_expr();
+		expect(']');
+		emit(OP_INDEX, var);
+	} else {
+		emit(OP_VAR, var);
+	}
+}
+
+static void compile_prim(void) {
+	if (consume('(')) {
+		compile_expr();
+		expect(')');
+		return;
+	}
+	if (isdigit(next_char())) {
+		emit(OP_NUM, parse_number());
+		return;
+	}
+	compile_variable();
+}
+
+static void compile_mul(void) {
+	compile_prim();
+	for (;;) {
+		int op;
+		if (consume('*'))
+			op = OP_MUL;
+		else if (consume('/'))
+			op = OP_DIV;
+		else if (consume('%'))
+			op = OP_MOD;
+		else
+			break;
+		compile_prim();
+		emit(op, 0);
+	}
+}
+
+static void compile_add(void) {
+	compile_mul();
+	for (;;) {
+		int op;
+		if (consume('+'))
+			op = OP_ADD;
+		else if (consume('-'))
+			op = OP_SUB;
+		else
+			break;
+		compile_mul();
+		emit(op, 0);
+	}
+}
+
+static void compile_bit(void) {
+	compile_add();
+	for (;;) {
+		int op;
+		if (consume('&'))
+			op = OP_AND;
+		else if (consume('|'))
+			op = OP_OR;
+		else if (consume('^'))
+			op = OP_XOR;
+		else
+			break;
+		compile_add();
+		emit(op, 0);
+	}
+}
+
+static void compile_compare(void) {
+	compile_bit();
+	for (;;) {
+		int op;
+		if (consume('<'))
+			op = consume('=') ? OP_LE : OP_LT;
+		else if (consume('>'))
+			op = consume('=') ? OP_GE : OP_GT;
+		else
+			break;
+		compile_bit();
+		emit(op, 0);
+	}
+}
+
+static void compile_expr(void) {
+	compile_compare();
+	for (;;) {
+		int op;
+		if (consume('='))
+			op = OP_EQ;
+		else if (consume('\\'))
+			op = OP_NE;
+		else
+			break;
+		compile_compare();
+		emit(op, 0);
+	}
+}
+
+// Returns NULL and stores an error message in `err` if `expr` is invalid.
+CompiledExpr *dbg_compile_expr(const char *expr, char *err, size_t errsize) {
+	eval_input = expr;
+	eval_result = err;
+	eval_result_size = errsize;
+	cbuf.len = cbuf.depth = 0;
+	if (setjmp(eval_jmp_buf))
+		return NULL;
+	compile_expr();
+	expect('\0');
+	emit(OP_END, 0);
+
+	CompiledExpr *e = malloc(sizeof(CompiledExpr) + cbuf.len * sizeof(int));
+	if (!e)
+		NOMEMERR();
+	e->len = cbuf.len;
+	memcpy(e->code, cbuf.code, cbuf.len * sizeof(int));
+	return e;
+}
+
+boolean dbg_execute_expr(const CompiledExpr *e, int *result, char *err, size_t errsize) {
+	int stack[MAX_STACK_DEPTH];
+	int sp = 0;
+	for (const int *pc = e->code;;) {
+		int op = *pc++;
+		if (op == OP_END)
+			break;
+		if (op == OP_NUM) {
+			stack[sp++] = *pc++;
+			continue;
+		}
+		if (op == OP_VAR || op == OP_INDEX) {
+			int var = *pc++;
+			int *store = op == OP_VAR ? v_ref(var, NULL) : v_ref_indexed(var, stack[--sp], NULL);
+			if (!store) {
+				if (err)
+					snprintf(err, errsize, "out of bounds array access");
+				return false;
+			}
+			stack[sp++] = *store;
+			continue;
+		}
+		int rhs = stack[--sp];
+		int *val = &stack[sp - 1];
+		switch (op) {
+		case OP_MUL: *val = clamp((long long)*val * rhs); break;
+		case OP_DIV: *val = rhs ? *val / rhs : 0; break;
+		case OP_MOD: *val = rhs ? *val % rhs : 0; break;
+		case OP_ADD: *val = clamp((long long)*val + rhs); break;
+		case OP_SUB: *val = clamp((long long)*val - rhs); break;
+		case OP_AND: *val = *val & rhs; break;
+		case OP_OR:  *val = *val | rhs; break;
+		case OP_XOR: *val = *val ^ rhs; break;
+		case OP_LE:  *val = *val <= rhs ? 1 : 0; break;
+		case OP_LT:  *val = *val < rhs ? 1 : 0; break;
+		case OP_GE:  *val = *val >= rhs ? 1 : 0; break;
+		case OP_GT:  *val = *val > rhs ? 1 : 0; break;
+		case OP_EQ:  *val = *val == rhs ? 1 : 0; break;
+		case OP_NE:  *val = *val != rhs ? 1 : 0; break;
+		}
+	}
+	*result = stack[0];
+	return true;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "debugger_private.h"
+#include "variable.h"
+#include "unittest.h"
+
+// Fake symbols for system variables VAR0 to VAR3. Like VAR[i], ARR[i]
+// refers to the i-th variable after ARR.
+static const char *var_names[] = {"A", "B", "C", "ARR"};
+
+int dbg_lookup_var(const char *name) {
+	for (int i = 0; i < sizeof(var_names) / sizeof(var_names[0]); i++) {
+		if (!strcmp(name, var_names[i]))
+			return i;
+	}
+	return -1;
+}
+
+static boolean eval(const char *expr, int *result, char *err) {
+	CompiledExpr *e = dbg_compile_expr(expr, err, 64);
+	if (!e)
+		return false;
+	boolean ok = dbg_execute_expr(e, result, err, 64);
+	free(e);
+	return ok;
+}
+
+static int value(const char *expr) {
+	char err[64];
+	int result = -1;
+	ASSERT_TRUE(eval(expr, &result, err));
+	return result;
+}
+
+static void error(const char *expr, const char *message) {
+	char err[64];
+	int result;
+	ASSERT_FALSE(eval(expr, &result, err));
+	ASSERT_STRCMP(err, message);
+}
+
+static void literal_test(void) {
+	ASSERT_EQUAL(value("42"), 42);
+	ASSERT_EQUAL(value(" 0x1F "), 31);
+	ASSERT_EQUAL(value("0b101"), 5);
+	ASSERT_EQUAL(value("65536"), 0xffff);
+	ASSERT_EQUAL(value("99999999999"), 0xffff);
+}
+
+static void precedence_test(void) {
+	ASSERT_EQUAL(value("2+3*4"), 14);
+	ASSERT_EQUAL(value("(2+3)*4"), 20);
+	ASSERT_EQUAL(value("10-4-3"), 3);
+	ASSERT_EQUAL(value("100/10/5"), 2);
+	ASSERT_EQUAL(value("17%5*2"), 4);
+	ASSERT_EQUAL(value("1+2&6"), 2);
+	ASSERT_EQUAL(value("4|1^5"), 0);
+	ASSERT_EQUAL(value("1|2<3"), 0);
+	ASSERT_EQUAL(value("1<2=1"), 1);
+	ASSERT_EQUAL(value("3>=3\\0"), 1);
+	ASSERT_EQUAL(value("2<=1"), 0);
+	ASSERT_EQUAL(value("2>1"), 1);
+}
+
+static void clamp_test(void) {
+	ASSERT_EQUAL(value("65535+1"), 0xffff);
+	ASSERT_EQUAL(value("65535*65535"), 0xffff);
+	ASSERT_EQUAL(value("1-2"), 0);
+	ASSERT_EQUAL(value("1-2+5"), 5);
+	ASSERT_EQUAL(value("7/0"), 0);
+	ASSERT_EQUAL(value("7%0"), 0);
+}
+
+static void variable_test(void) {
+	memset(sysVar, 0, 8 * sizeof(int));
+	sysVar[0] = 3;
+	sysVar[1] = 100;
+	sysVar[3] = 10;
+	sysVar[4] = 11;
+	sysVar[5] = 12;
+	ASSERT_EQUAL(value("A*B"), 300);
+	ASSERT_EQUAL(value("ARR[0]"), 10);
+	ASSERT_EQUAL(value("ARR[A-1]+ARR"), 22);
+	ASSERT_EQUAL(value("A[ARR[1]-B+1]"), 100);  // ARR[1]-B clamps to 0
+	ASSERT_EQUAL(value("B=100"), 1);
+	error("ARR[65535]", "out of bounds array access");
+}
+
+static void error_test(void) {
+	error("1+", "syntax error");
+	error("(1", "syntax error");
+	error("1 2", "syntax error");
+	error("FOO", "unknown variable \"FOO\"");
+
+	// The stack depth is bounded at compile time.
+	char expr[512] = "";
+	for (int i = 0; i < 70; i++)
+		strcat(expr, "1+(");
+	strcat(expr, "1");
+	for (int i = 0; i < 70; i++)
+		strcat(expr, ")");
+	error(expr, "expression too complex");
+}
+
+void debugger_expr_test(void) {
+	literal_test();
+	precedence_test();
+	clamp_test();
+	variable_test();
+	error_test();
+}
@@ -25,18 +25,38 @@
 
 extern struct debug_symbols *symbols;
 
-typedef struct {
+typedef struct physical_breakpoint {
+	struct physical_breakpoint *hnext;  // next in the same hash bucket
+	struct breakpoint *bps;  // breakpoints at this location
 	int page;
 	int addr;
 	int refcnt;
 	uint8_t restore_op;
 } PhysicalBreakpoint;
 
+// Bytecode of a compiled expression
+typedef struct compiled_expr CompiledExpr;
+
+typedef enum {
+	HIT_ALWAYS,
+	HIT_EQ,  // hits == hit_value
+	HIT_GE,  // hits >= hit_value
+	HIT_GT,  // hits > hit_value
+	HIT_LE,  // hits <= hit_value
+	HIT_LT,  // hits < hit_value
+	HIT_MOD, // hits % hit_value == 0
+} HitConditionOp;
+
 typedef struct breakpoint {
 	struct breakpoint *next;
+	struct breakpoint *phys_next;  // next breakpoint at the same location
 	PhysicalBreakpoint *phys;
 	int no;
 	char *condition;
+	CompiledExpr *cond_code;
+	HitConditionOp hit_op;
+	int hit_value;
+	int hits;  // number of times the breakpoint was hit with its condition met
 	dridata *dfile;  // keeps modified scenario page alive in the cache
 } Breakpoint;
 
@@ -69,6 +89,8 @@ Breakpoint *dbg_set_breakpoint(int page, int addr, boolean is_internal);
 boolean dbg_delete_breakpoint(int no);
 void dbg_delete_breakpoints_in_page(int page);
 boolean dbg_set_breakpoint_condition(Breakpoint *bp, const char *condition, char *err, size_t errsize);
+boolean dbg_set_breakpoint_hit_condition(Breakpoint *bp, const char *condition, char *err, size_t errsize);
+Breakpoint *dbg_get_breakpoints(void);
 void dbg_stepin(void);
 void dbg_stepout(void);
 void dbg_next(void);
@@ -76,4 +98,8 @@ int dbg_lookup_var(const char *name);
 boolean dbg_evaluate(const char *expr, char *result, size_t result_size);
 StackTrace *dbg_stack_trace(void);
 
+// debugger_expr.c
+CompiledExpr *dbg_compile_expr(const char *expr, char *err, size_t errsize);
+boolean dbg_execute_expr(const CompiledExpr *e, int *result, char *err, size_t errsize);
+
 #endif // __DEBUGGER_PRIVATE_H__
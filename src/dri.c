@@ -26,6 +26,9 @@
 #include <stdlib.h>
 #include <errno.h>
 #include "portab.h"
+#ifdef HAVE_PREAD
+#include <unistd.h>
+#endif
 #include "system.h"
 #include "LittleEndian.h"
 #include "dri.h"
@@ -75,8 +78,98 @@ static bool read_index(int disk, drifiles *d, FILE *fp) {
 	return true;
 }
 
+/*
+ * Non-mmapped archives are read through a readahead window. Sequential
+ * entry numbers are usually stored contiguously, so the window is widened
+ * while the access pattern is sequential.
+ */
+#define READAHEAD_MIN (64 * 1024)
+#define READAHEAD_MAX (512 * 1024)
+
+/*
+ * Entry buffers are pooled by power-of-two size classes so that loading
+ * and evicting entries does not hit malloc every time. Buffers bigger than
+ * the largest class are not pooled. The pool is not thread-safe; callers
+ * (ald_manager) serialize access to non-mmapped archives.
+ */
+#define POOL_MIN_SHIFT 12  /* 4KB */
+#define POOL_MAX_SHIFT 22  /* 4MB */
+#define POOL_DEPTH 4       /* free buffers kept per size class */
+
+static struct {
+	void *bufs[POOL_DEPTH];
+	int n;
+} pool[POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1];
+
+static void *pool_alloc(int size, int *bufsize) {
+	int shift = POOL_MIN_SHIFT;
+	while (shift <= POOL_MAX_SHIFT && (1 << shift) < size)
+		shift++;
+	if (shift > POOL_MAX_SHIFT) {
+		*bufsize = 0;
+		return malloc(size);
+	}
+	*bufsize = 1 << shift;
+	int c = shift - POOL_MIN_SHIFT;
+	if (pool[c].n)
+		return pool[c].bufs[--pool[c].n];
+	return malloc(*bufsize);
+}
+
+static void pool_free(void *buf, int bufsize) {
+	if (bufsize) {
+		int c = 0;
+		while ((1 << (POOL_MIN_SHIFT + c)) < bufsize)
+			c++;
+		if (pool[c].n < POOL_DEPTH) {
+			pool[c].bufs[pool[c].n++] = buf;
+			return;
+		}
+	}
+	free(buf);
+}
+
+/* Reads up to len bytes at offset. Returns the number of bytes read. */
+static int read_at(drifiles *d, int disk, uint32_t offset, void *buf, int len) {
+#ifdef HAVE_PREAD
+	int fd = fileno(d->fp[disk]);
+	int done = 0;
+	while (done < len) {
+		ssize_t n = pread(fd, (uint8_t *)buf + done, len - done, offset + done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	return done;
+#else
+	if (fseek(d->fp[disk], offset, SEEK_SET) != 0)
+		return 0;
+	return fread(buf, 1, len, d->fp[disk]);
+#endif
+}
+
+/* Returns a pointer to [offset, offset+len) if it is in the readahead window */
+static uint8_t *window_get(drifiles *d, int disk, uint32_t offset, int len) {
+	if (!d->ra.buf || d->ra.disk != disk || offset < d->ra.offset)
+		return NULL;
+	if ((uint64_t)offset + len > (uint64_t)d->ra.offset + d->ra.length)
+		return NULL;
+	return d->ra.buf + (offset - d->ra.offset);
+}
+
+static void window_fill(drifiles *d, int disk, uint32_t offset, int len) {
+	if (!d->ra.buf)
+		d->ra.buf = malloc(READAHEAD_MAX);
+	d->ra.disk = disk;
+	d->ra.offset = offset;
+	d->ra.length = read_at(d, disk, offset, d->ra.buf, len);
+}
+
 drifiles *dri_init(const char **file, int cnt, boolean use_mmap) {
 	drifiles *d = calloc(1, sizeof(drifiles));
+	d->ra.last_no = -1;
 #ifndef HAVE_MEMORY_MAPPED_FILE
 	use_mmap = FALSE;
 #endif
@@ -98,16 +191,25 @@ drifiles *dri_init(const char **file, int cnt, boolean use_mmap) {
 			continue;
 		}
 		d->fnames[i] = strdup(file[i]);
-		fclose(fp);
-
-		if (use_mmap) {
-			mmap_t *m = map_file(file[i]);
-			if (!m) {
-				use_mmap = d->mmapped = FALSE;
-				i = 0; /* retry */
-			} else {
-				d->mmap[i] = m;
-				d->mmapped = TRUE;
+		d->fp[i] = fp;
+	}
+
+	if (use_mmap) {
+		d->mmapped = TRUE;
+		for (int i = 0; i < cnt && d->mmapped; i++) {
+			if (!d->fnames[i])
+				continue;
+			if (!(d->mmap[i] = map_file(d->fnames[i])))
+				d->mmapped = FALSE;
+		}
+		for (int i = 0; i < cnt; i++) {
+			if (d->mmapped) {
+				if (d->fp[i])
+					fclose(d->fp[i]);
+				d->fp[i] = NULL;
+			} else if (d->mmap[i]) {
+				unmap_file(d->mmap[i]);
+				d->mmap[i] = NULL;
 			}
 		}
 	}
@@ -120,31 +222,43 @@ dridata *dri_getdata(drifiles *d, int no) {
 	int disk = d->disk[no] - 1;
 
 	uint8_t *data;
-	int ptr, size;
+	int ptr, size, bufsize = 0;
 	if (d->mmapped) {
 		data = d->mmap[disk]->addr + d->offset[no];
 		ptr  = LittleEndian_getDW(data, 0);
 		size = LittleEndian_getDW(data, 4);
 	} else {
-		FILE *fp = fopen(d->fnames[disk], "rb");
-		if (!fp)
-			return NULL;
-		uint8_t entry_header[8];
-		fseek(fp, d->offset[no], SEEK_SET);
-		if (fread(entry_header, sizeof(entry_header), 1, fp) != 1) {
-			fclose(fp);
+		if (!d->fp[disk])
 			return NULL;
+		uint32_t offset = d->offset[no];
+		int window = no == d->ra.last_no + 1 ? READAHEAD_MAX : READAHEAD_MIN;
+		d->ra.last_no = no;
+
+		uint8_t *entry_header = window_get(d, disk, offset, 8);
+		if (!entry_header) {
+			window_fill(d, disk, offset, window);
+			if (!(entry_header = window_get(d, disk, offset, 8)))
+				return NULL;
 		}
 		ptr  = LittleEndian_getDW(entry_header, 0);
 		size = LittleEndian_getDW(entry_header, 4);
-		data = malloc(ptr + size);
-		memcpy(data, entry_header, sizeof(entry_header));
-		if (fread(data + sizeof(entry_header), ptr + size - sizeof(entry_header), 1, fp) != 1) {
-			free(data);
-			fclose(fp);
+		if (ptr < 8 || size < 0 || ptr + size < ptr)
 			return NULL;
+
+		data = pool_alloc(ptr + size, &bufsize);
+		if (!data)
+			NOMEMERR();
+		int avail = d->ra.offset + d->ra.length - offset;
+		if (avail >= ptr + size) {
+			memcpy(data, entry_header, ptr + size);
+		} else {
+			memcpy(data, entry_header, avail);
+			int rest = ptr + size - avail;
+			if (read_at(d, disk, offset + avail, data + avail, rest) != rest) {
+				pool_free(data, bufsize);
+				return NULL;
+			}
 		}
-		fclose(fp);
 	}
 	
 	dridata *dfile = calloc(1, sizeof(dridata));
@@ -152,6 +266,49 @@ dridata *dri_getdata(drifiles *d, int no) {
 	dfile->data = data + ptr;  /* real data */
 	dfile->size = size;
 	dfile->name = data + 16;
+	dfile->bufsize = bufsize;
 	dfile->a = d; /* archive file */
 	return dfile;
 }
+
+/*
+ * Get the location of the data of an entry in the archive volume
+ *   d     : archive
+ *   no    : entry no
+ *   disk  : volume index (returned)
+ *   offset: offset of the data in the volume (returned)
+ *   size  : size of the data (returned)
+ *   return: TRUE if the entry exists
+*/
+boolean dri_getlocation(drifiles *d, int no, int *disk, uint32_t *offset, int *size) {
+	if (no < 0 || no >= d->nr_files || !d->disk[no] || !d->offset[no])
+		return FALSE;
+	int dsk = d->disk[no] - 1;
+
+	uint8_t hdr[8];
+	if (d->mmapped) {
+		memcpy(hdr, d->mmap[dsk]->addr + d->offset[no], 8);
+	} else {
+		if (!d->fp[dsk] || read_at(d, dsk, d->offset[no], hdr, 8) != 8)
+			return FALSE;
+	}
+	int ptr = LittleEndian_getDW(hdr, 0);
+	int sz  = LittleEndian_getDW(hdr, 4);
+	if (ptr < 8 || sz < 0 || ptr + sz < ptr)
+		return FALSE;
+
+	*disk = dsk;
+	*offset = d->offset[no] + ptr;
+	*size = sz;
+	return TRUE;
+}
+
+/*
+ * free dridata returned by dri_getdata()
+ *   dfile: dridata to be free
+*/
+void dri_freedata(dridata *dfile) {
+	if (!dfile->a->mmapped)
+		pool_free(dfile->data_raw, dfile->bufsize);
+	free(dfile);
+}
@@ -24,6 +24,7 @@
 #ifndef __DRI__
 #define __DRI__
 
+#include <stdio.h>
 #include "portab.h"
 #include "mmap.h"
 
@@ -33,9 +34,19 @@ struct _drifiles {
 	boolean  mmapped;
 	mmap_t   *mmap[DRIFILEMAX];
 	char     *fnames[DRIFILEMAX];
+	FILE     *fp[DRIFILEMAX]; /* kept open while not mmapped */
 	int      nr_files; // upper limit on how many files could be referenced by this archive
 	uint8_t  *disk;    // file numbers
 	uint32_t *offset;  // offsets in file
+
+	/* readahead window for non-mmapped archives */
+	struct {
+		uint8_t  *buf;
+		int      disk;
+		uint32_t offset;
+		int      length;
+		int      last_no;
+	} ra;
 };
 typedef struct _drifiles drifiles;
 
@@ -45,11 +56,14 @@ struct _dridata {
 	char    *data;     /* real data */
 	char    *name;     /* not used */
 	int     refcnt;    /* reference count */
+	int     bufsize;   /* size of pooled data_raw buffer (0: not pooled) */
 	drifiles *a;       /* archive file obj */
 };
 typedef struct _dridata dridata;
 
 extern drifiles *dri_init(const char **file, int cnt, boolean use_mmap);
 extern dridata  *dri_getdata(drifiles *d, int no);
+extern void      dri_freedata(dridata *dfile);
+extern boolean   dri_getlocation(drifiles *d, int no, int *disk, uint32_t *offset, int *size);
 
 #endif /* !__DRI__ */
@@ -474,6 +474,10 @@ void ags_eCopyArea(int sx, int sy, int w, int h, int dx, int dy, int sw, int opt
 			w = update.w;
 			h = update.h;
 		}
+		if (sdl_isHeadless()) {
+			eCopyUpdateArea(dx, dy, w, h, dx, dy);
+			return;
+		}
 	}
 	
 	switch(sw) {
@@ -21,6 +21,8 @@
 
 #include <limits.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL.h>
 #include <SDL_ttf.h>
 #ifdef __EMSCRIPTEN__
@@ -31,11 +33,38 @@
 #include "system.h"
 #include "font.h"
 #include "sdl_private.h"
+#include "utfsjis.h"
+
+/*
+ * グリフのカバレッジマスク (0-255) のキャッシュ。
+ * マスクは GLYPH_ATLAS_W x GLYPH_ATLAS_H のアトラスページに棚詰めで格納する。
+ */
+#define GLYPH_ATLAS_W 512
+#define GLYPH_ATLAS_H 512
+#define GLYPH_ATLAS_MAX_PAGES 16
+
+typedef struct {
+	int      code;     /* 0 = empty slot */
+	int      w, h;
+	int      advance;
+	uint8_t *mask;     /* pitch is GLYPH_ATLAS_W */
+} Glyph;
+
+typedef struct {
+	Glyph   *slots;    /* open addressing */
+	int      nr_slots;
+	int      nr_glyphs;
+	uint8_t *pages[GLYPH_ATLAS_MAX_PAGES];
+	int      nr_pages;
+	int      shelf_x, shelf_y, shelf_h;
+	boolean  full;
+} GlyphCache;
 
 typedef struct {
 	int      size;
 	int      type;
 	TTF_Font *id;
+	GlyphCache *glyphs[2]; /* [antialias] */
 } FontTable;
 
 #define FONTTABLEMAX 256
@@ -48,6 +77,11 @@ static struct {
 	boolean antialiase_on;
 	const char *name[FONTTYPEMAX];
 	int face[FONTTYPEMAX];
+	struct {
+		unsigned hits;
+		unsigned misses;
+		unsigned uncached_strings;
+	} stats;
 } this;
 
 static void font_insert(int size, int type, TTF_Font *font) {
@@ -117,12 +151,246 @@ SDL_Surface *font_get_glyph(const char *str_utf8) {
 	return fs;
 }
 
+static void glyph_cache_clear(GlyphCache *gc) {
+	for (int i = 0; i < gc->nr_pages; i++)
+		free(gc->pages[i]);
+	free(gc->slots);
+	memset(gc, 0, sizeof(GlyphCache));
+}
+
+static Glyph *glyph_slot(GlyphCache *gc, int code) {
+	unsigned i = (unsigned)code * 2654435769u;
+	for (i &= gc->nr_slots - 1; ; i = (i + 1) & (gc->nr_slots - 1)) {
+		Glyph *g = &gc->slots[i];
+		if (g->code == code || g->code == 0)
+			return g;
+	}
+}
+
+static void glyph_cache_grow(GlyphCache *gc) {
+	Glyph *old = gc->slots;
+	int old_n = gc->nr_slots;
+	gc->nr_slots = old_n ? old_n * 2 : 256;
+	gc->slots = calloc(gc->nr_slots, sizeof(Glyph));
+	if (!gc->slots)
+		NOMEMERR();
+	for (int i = 0; i < old_n; i++) {
+		if (old[i].code)
+			*glyph_slot(gc, old[i].code) = old[i];
+	}
+	free(old);
+}
+
+/* アトラス上に w x h の領域を確保する */
+static uint8_t *atlas_alloc(GlyphCache *gc, int w, int h) {
+	if (w > GLYPH_ATLAS_W || h > GLYPH_ATLAS_H)
+		return NULL;
+	if (gc->nr_pages && gc->shelf_x + w > GLYPH_ATLAS_W) {
+		gc->shelf_x = 0;
+		gc->shelf_y += gc->shelf_h;
+		gc->shelf_h = 0;
+	}
+	if (!gc->nr_pages || gc->shelf_y + h > GLYPH_ATLAS_H) {
+		if (gc->nr_pages == GLYPH_ATLAS_MAX_PAGES)
+			return NULL;
+		gc->pages[gc->nr_pages] = calloc(GLYPH_ATLAS_W * GLYPH_ATLAS_H, 1);
+		if (!gc->pages[gc->nr_pages])
+			NOMEMERR();
+		gc->nr_pages++;
+		gc->shelf_x = gc->shelf_y = gc->shelf_h = 0;
+	}
+	uint8_t *p = gc->pages[gc->nr_pages - 1] + gc->shelf_y * GLYPH_ATLAS_W + gc->shelf_x;
+	gc->shelf_x += w;
+	if (gc->shelf_h < h)
+		gc->shelf_h = h;
+	return p;
+}
+
+/* 一文字を描画してカバレッジマスクをアトラスへ格納する */
+static boolean render_glyph(GlyphCache *gc, Glyph *g, int code) {
+	int minx, maxx, miny, maxy, advance;
+	if (TTF_GlyphMetrics(fontset->id, code, &minx, &maxx, &miny, &maxy, &advance) < 0)
+		return FALSE;
+
+	// Render as a one-character string so that the glyph is positioned in
+	// the same way as in TTF_RenderUTF8_*().
+	char utf8[4];
+	if (code <= 0x7f) {
+		utf8[0] = code;
+		utf8[1] = '\0';
+	} else if (code <= 0x7ff) {
+		utf8[0] = 0xc0 | code >> 6;
+		utf8[1] = 0x80 | (code & 0x3f);
+		utf8[2] = '\0';
+	} else {
+		utf8[0] = 0xe0 | code >> 12;
+		utf8[1] = 0x80 | (code >> 6 & 0x3f);
+		utf8[2] = 0x80 | (code & 0x3f);
+		utf8[3] = '\0';
+	}
+	SDL_Color white = {255, 255, 255, 255};
+	SDL_Surface *fs = this.antialiase_on
+		? TTF_RenderUTF8_Blended(fontset->id, utf8, white)
+		: TTF_RenderUTF8_Solid(fontset->id, utf8, white);
+	if (!fs)
+		return FALSE;
+
+	uint8_t *mask = atlas_alloc(gc, fs->w, fs->h);
+	if (!mask) {
+		gc->full = TRUE;
+		SDL_FreeSurface(fs);
+		return FALSE;
+	}
+	for (int y = 0; y < fs->h; y++) {
+		uint8_t *sp = (uint8_t *)fs->pixels + y * fs->pitch;
+		uint8_t *dp = mask + y * GLYPH_ATLAS_W;
+		for (int x = 0; x < fs->w; x++) {
+			if (fs->format->BytesPerPixel == 1) {
+				dp[x] = sp[x] ? 255 : 0;
+			} else {
+				Uint8 r, g, b, a;
+				SDL_GetRGBA(((Uint32 *)sp)[x], fs->format, &r, &g, &b, &a);
+				dp[x] = a;
+			}
+		}
+	}
+
+	g->code = code;
+	g->w = fs->w;
+	g->h = fs->h;
+	g->advance = advance;
+	g->mask = mask;
+	gc->nr_glyphs++;
+	SDL_FreeSurface(fs);
+	return TRUE;
+}
+
+static boolean glyph_lookup(int code, Glyph *result) {
+	GlyphCache **gcp = &fontset->glyphs[this.antialiase_on ? 1 : 0];
+	if (!*gcp) {
+		*gcp = calloc(1, sizeof(GlyphCache));
+		if (!*gcp)
+			NOMEMERR();
+	}
+	GlyphCache *gc = *gcp;
+
+	if (gc->nr_slots) {
+		Glyph *g = glyph_slot(gc, code);
+		if (g->code) {
+			this.stats.hits++;
+			*result = *g;
+			return TRUE;
+		}
+	}
+	this.stats.misses++;
+	if (gc->full)
+		return FALSE;
+	if ((gc->nr_glyphs + 1) * 2 > gc->nr_slots)
+		glyph_cache_grow(gc);
+	Glyph *g = glyph_slot(gc, code);
+	if (!render_glyph(gc, g, code))
+		return FALSE;
+	*result = *g;
+	return TRUE;
+}
+
+/*
+ * カバレッジマスクを色 col で DIB に描画
+ *   aa_cache: 8bpp アンチエイリアス用の混色キャッシュ (256*8)
+*/
+static void draw_mask(int dstx, int dsty, const Glyph *g, uint8_t col) {
+	SDL_Rect r = {dstx, dsty, g->w, g->h};
+	SDL_Rect clip = {0, 0, sdl_dib->w, sdl_dib->h};
+	if (!SDL_IntersectRect(&r, &clip, &r))
+		return;
+	int bpp = sdl_dib->format->BytesPerPixel;
+	Uint32 pixel = SDL_MapRGB(sdl_dib->format, sdl_col[col].r, sdl_col[col].g, sdl_col[col].b);
+
+	for (int y = r.y; y < r.y + r.h; y++) {
+		const uint8_t *sp = g->mask + (y - dsty) * GLYPH_ATLAS_W + (r.x - dstx);
+		uint8_t *dp = (uint8_t *)sdl_dib->pixels + y * sdl_dib->pitch + r.x * bpp;
+		for (int x = 0; x < r.w; x++, sp++, dp += bpp) {
+			int a = *sp;
+			if (!a)
+				continue;
+			if (bpp == 1) {
+				// SDL can't blit ARGB to an indexed bitmap properly, so we do it ourselves.
+				int alpha = this.antialiase_on ? a >> 5 : 7; // reduce bit depth
+				if (!alpha) {
+					// Transparent, do nothing
+				} else if (alpha == 7) {
+					*dp = col; // Fully opaque
+				} else {
+					// find nearest color in palette
+					*dp = sdl_nearest_color(
+						(sdl_col[col].r * alpha + sdl_col[*dp].r * (7 - alpha)) / 7,
+						(sdl_col[col].g * alpha + sdl_col[*dp].g * (7 - alpha)) / 7,
+						(sdl_col[col].b * alpha + sdl_col[*dp].b * (7 - alpha)) / 7);
+				}
+				continue;
+			}
+
+			Uint32 p = pixel;
+			if (a != 255) {
+				Uint32 d = bpp == 2 ? *(Uint16 *)dp : *(Uint32 *)dp;
+				Uint8 dr, dg, db;
+				SDL_GetRGB(d, sdl_dib->format, &dr, &dg, &db);
+				p = SDL_MapRGB(sdl_dib->format,
+							   (sdl_col[col].r * a + dr * (255 - a) + 127) / 255,
+							   (sdl_col[col].g * a + dg * (255 - a) + 127) / 255,
+							   (sdl_col[col].b * a + db * (255 - a) + 127) / 255);
+			}
+			if (bpp == 2)
+				*(Uint16 *)dp = p;
+			else
+				*(Uint32 *)dp = p;
+		}
+	}
+}
+
+/* キャッシュされたグリフを並べて文字列を描画する。できなければ FALSE */
+static boolean draw_cached_string(int x, int y, const char *str_utf8, uint8_t cl, SDL_Rect *r_dst) {
+	GlyphCache *gc = fontset->glyphs[this.antialiase_on ? 1 : 0];
+	if (gc && gc->full) {
+		// Start over rather than evicting individual glyphs.
+		glyph_cache_clear(gc);
+	}
+
+	Glyph glyphs[256];
+	int n = 0;
+	int w = 0, h = 0;
+	int prev = 0;
+	boolean kerning = TTF_GetFontKerning(fontset->id);
+	const char *p = str_utf8;
+	while (*p) {
+		if (n == sizeof(glyphs) / sizeof(glyphs[0]))
+			return FALSE;
+		int code = utf8_next_codepoint(&p);
+		if (code > 0xffff || !glyph_lookup(code, &glyphs[n]))
+			return FALSE;
+		if (kerning && prev)
+			w += TTF_GetFontKerningSizeGlyphs(fontset->id, prev, code);
+		// Store the pen position in the local copy.
+		glyphs[n].code = w;
+		w += glyphs[n].advance;
+		if (h < glyphs[n].h)
+			h = glyphs[n].h;
+		prev = code;
+		n++;
+	}
+	if (n && w < glyphs[n - 1].code + glyphs[n - 1].w)
+		w = glyphs[n - 1].code + glyphs[n - 1].w;
+
+	for (int i = 0; i < n; i++)
+		draw_mask(x + glyphs[i].code, y, &glyphs[i], cl);
+
+	*r_dst = (SDL_Rect){x, y, w, h};
+	return TRUE;
+}
+
 // SDL can't blit ARGB to an indexed bitmap properly, so we do it ourselves.
 static void sdl_drawAntiAlias_8bpp(int dstx, int dsty, SDL_Surface *src, uint8_t col)
 {
-	Uint8 cache[256*7];
-	memset(cache, 0, 256);
-
 	for (int y = 0; y < src->h && dsty + y < sdl_dib->h; y++) {
 		if (dsty + y < 0)
 			continue;
@@ -136,17 +404,12 @@ static void sdl_drawAntiAlias_8bpp(int dstx, int dsty, SDL_Surface *src, uint8_t
 				// Transparent, do nothing
 			} else if (alpha == 7) {
 				*dp = col; // Fully opaque
-			} else if (cache[*dp] & 1 << alpha) {
-				*dp = cache[alpha << 8 | *dp]; // use cached value
 			} else {
 				// find nearest color in palette
-				cache[*dp] |= 1 << alpha;
-				int c = sdl_nearest_color(
+				*dp = sdl_nearest_color(
 					(sdl_col[col].r * alpha + sdl_col[*dp].r * (7 - alpha)) / 7,
 					(sdl_col[col].g * alpha + sdl_col[*dp].g * (7 - alpha)) / 7,
 					(sdl_col[col].b * alpha + sdl_col[*dp].b * (7 - alpha)) / 7);
-				cache[alpha << 8 | *dp] = c;
-				*dp = c;
 			}
 			sp += src->format->BytesPerPixel;
 			dp++;
@@ -164,29 +427,33 @@ SDL_Rect font_draw_glyph(int x, int y, const char *str_utf8, uint8_t cl) {
 	if (!fontset)
 		return r_dst;
 	
-	if (this.antialiase_on) {
-		fs = TTF_RenderUTF8_Blended(fontset->id, str_utf8, sdl_col[cl]);
-	} else {
-		fs = TTF_RenderUTF8_Solid(fontset->id, str_utf8, sdl_col[cl]);
-	}
-	if (!fs) {
-		WARNING("Text rendering failed: %s", TTF_GetError());
-		return r_dst;
-	}
-	
-	TTF_SizeUTF8(fontset->id, str_utf8, &w, &h);
 	// Center vertically to the box.
 	y -= (TTF_FontHeight(fontset->id) - fontset->size) / 2;
-	r_dst = (SDL_Rect){x, y, w, h};
-	
-	if (sdl_dib->format->BitsPerPixel == 8 && this.antialiase_on) {
-		sdl_drawAntiAlias_8bpp(x, y, fs, cl);
-	} else {
-		r_src = (SDL_Rect){0, 0, w, h};
-		SDL_BlitSurface(fs, &r_src, sdl_dib, &r_dst);
+
+	if (!draw_cached_string(x, y, str_utf8, cl, &r_dst)) {
+		this.stats.uncached_strings++;
+		if (this.antialiase_on) {
+			fs = TTF_RenderUTF8_Blended(fontset->id, str_utf8, sdl_col[cl]);
+		} else {
+			fs = TTF_RenderUTF8_Solid(fontset->id, str_utf8, sdl_col[cl]);
+		}
+		if (!fs) {
+			WARNING("Text rendering failed: %s", TTF_GetError());
+			return r_dst;
+		}
+
+		TTF_SizeUTF8(fontset->id, str_utf8, &w, &h);
+		r_dst = (SDL_Rect){x, y, w, h};
+
+		if (sdl_dib->format->BitsPerPixel == 8 && this.antialiase_on) {
+			sdl_drawAntiAlias_8bpp(x, y, fs, cl);
+		} else {
+			r_src = (SDL_Rect){0, 0, w, h};
+			SDL_BlitSurface(fs, &r_src, sdl_dib, &r_dst);
+		}
+		SDL_FreeSurface(fs);
 	}
 
-	SDL_FreeSurface(fs);
 	if (r_dst.y < 0) {
 		r_dst.h += r_dst.y;
 		r_dst.y = 0;
@@ -194,6 +461,24 @@ SDL_Rect font_draw_glyph(int x, int y, const char *str_utf8, uint8_t cl) {
 	return r_dst;
 }
 
+void font_print_stats(void) {
+	unsigned total = this.stats.hits + this.stats.misses;
+	if (!total)
+		return;
+	int glyphs = 0, pages = 0;
+	for (int i = 0; i < fontcnt; i++) {
+		for (int j = 0; j < 2; j++) {
+			if (fonttbl[i].glyphs[j]) {
+				glyphs += fonttbl[i].glyphs[j]->nr_glyphs;
+				pages += fonttbl[i].glyphs[j]->nr_pages;
+			}
+		}
+	}
+	NOTICE("glyph cache: %u hits, %u misses (%.1f%% hit), %d glyphs in %d atlas pages, %u uncached strings",
+		   this.stats.hits, this.stats.misses, this.stats.hits * 100.0 / total,
+		   glyphs, pages, this.stats.uncached_strings);
+}
+
 void font_init(void) {
 	this.antialiase_on = FALSE;
 	
@@ -38,6 +38,7 @@ extern boolean font_get_antialias(void);
 extern void font_select(int type, int size);
 extern struct SDL_Surface *font_get_glyph(const char *str_utf8);
 extern SDL_Rect font_draw_glyph(int x, int y, const char *str_utf8, uint8_t col);
+extern void font_print_stats(void);
 
 #ifdef __EMSCRIPTEN__
 extern int load_mincho_font(void);
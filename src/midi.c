@@ -32,6 +32,7 @@
 static char *dev;
 static char default_mode = 'e';
 static int subdev = -1;
+static char *cachedir;
 
 #ifdef __EMSCRIPTEN__
 extern mididevice_t midi_emscripten;
@@ -53,6 +54,11 @@ extern mididevice_t midi_rawmidi;
 extern mididevice_t midi_portmidi;
 #endif
 
+#ifdef ENABLE_MIDI_SYNTH
+extern mididevice_t midi_synth;
+extern void midi_synth_set_cachedir(const char *dir);
+#endif
+
 int midi_init(mididevice_t *midi) {
 	int ret = NG;
 
@@ -82,6 +88,14 @@ int midi_init(mididevice_t *midi) {
 #ifdef ENABLE_MIDI_PORTMIDI
 		ret = midi_portmidi.init(NULL, subdev);
 		memcpy(midi, &midi_portmidi, sizeof(mididevice_t));
+#endif
+		break;
+	case 'w':
+#ifdef ENABLE_MIDI_SYNTH
+		/* dev is the SoundFont file (NULL: built-in sounds) */
+		midi_synth_set_cachedir(cachedir);
+		ret = midi_synth.init(dev, 0);
+		memcpy(midi, &midi_synth, sizeof(mididevice_t));
 #endif
 	case '0':
 		break;
@@ -116,6 +130,10 @@ void midi_set_output_device(int mode) {
 		default_mode = 'p';
 		subdev = mode >> 8;
 		break;
+	case 'w':
+		/* software synthesizer */
+		default_mode = 'w';
+		break;
 	case '0':
 		/* disable midi */
 		default_mode = '0';
@@ -124,3 +142,8 @@ void midi_set_output_device(int mode) {
 		break;
 	}
 }
+
+void midi_set_cachedir(char *dir) {
+	if (cachedir) free(cachedir);
+	cachedir = strdup(dir);
+}
@@ -54,5 +54,6 @@ struct mididevice {
 extern int  midi_init(mididevice_t *);
 extern void midi_set_devicename(char *);
 extern void midi_set_output_device(int mode);
+extern void midi_set_cachedir(char *dir);
 
 #endif /* __MIDI_H__ */
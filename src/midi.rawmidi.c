@@ -110,7 +110,7 @@ static boolean enabled = FALSE;
 static int midifd = -1;
 static char *mididevname;
 static SDL_Thread *thread;
-static struct msgq *queue;
+static struct spscq *queue;
 static int start_time;
 
 static char cmd_pause[] = "pause";
@@ -240,13 +240,13 @@ static void *midi_mainloop(struct midiinfo *midi) {
 			uint32_t target_time = last_time + ticks2ms(delta, midi->division, tempo);
 			uint32_t current_time = SDL_GetTicks();
 			while (current_time < target_time) {
-				cmd = msgq_dequeue_timeout(queue, target_time - current_time);
+				cmd = spscq_dequeue_timeout(queue, target_time - current_time);
 				if (cmd == cmd_stop)
 					return cmd;
 
 				if (cmd == cmd_pause) {
 					while (TRUE) {
-						cmd = msgq_dequeue(queue);
+						cmd = spscq_dequeue(queue);
 						if (cmd == cmd_stop)
 							return cmd;
 						if (cmd == cmd_unpause)
@@ -381,7 +381,7 @@ static int midi_thread(void *data) {
 	midifd = -1;
 
 	while (cmd != cmd_stop)
-		cmd = msgq_dequeue(queue);
+		cmd = spscq_dequeue(queue);
 	return 0;
 }
 
@@ -415,7 +415,7 @@ static int midi_start(int no, int loop, char *data, int datalen) {
 	}
 #endif
 
-	queue = msgq_new();
+	queue = spscq_new(16);
 	thread = SDL_CreateThread(midi_thread, "MIDI", midi);
 
 	start_time = SDL_GetTicks();
@@ -428,10 +428,10 @@ static int midi_stop() {
 		return OK;
 	}
 	
-	msgq_enqueue(queue, cmd_stop);
+	spscq_enqueue(queue, cmd_stop);
 	SDL_WaitThread(thread, NULL);
 	thread = NULL;
-	msgq_free(queue);
+	spscq_free(queue);
 	queue = NULL;
 	
 	return OK;
@@ -440,14 +440,14 @@ static int midi_stop() {
 static int midi_pause(void) {
 	if (!enabled || !queue) return OK;
 	
-	msgq_enqueue(queue, cmd_pause);
+	spscq_enqueue(queue, cmd_pause);
 	return OK;
 }
 
 static int midi_unpause(void) {
 	if (!enabled || !queue) return OK;
 	
-	msgq_enqueue(queue, cmd_unpause);
+	spscq_enqueue(queue, cmd_unpause);
 	return OK;
 }
 
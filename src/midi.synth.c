@@ -0,0 +1,733 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/*
+ * MIDI playback with the built-in software synthesizer (midisynth.c).
+ *
+ * Tracks whose sys35 markers don't depend on flags set by the game are
+ * rendered once to PCM by a worker thread, and the sys35 loop is located
+ * as a pair of sample positions. Playback then only copies the rendered
+ * PCM into the mixer, and the result is kept in a cache (and optionally
+ * written to disk as a WAVE file with a "smpl" loop). Other tracks are
+ * synthesized in real time in the audio callback.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_mixer.h>
+
+#include "portab.h"
+#include "system.h"
+#include "midi.h"
+#include "midifile.h"
+#include "midisynth.h"
+#include "midiseq.h"
+#include "cache.h"
+#include "mmap.h"
+#include "ald_manager.h"
+#include "LittleEndian.h"
+
+static int midi_initilize(char *pname, int subdev);
+static int midi_exit(void);
+static int midi_reset(void);
+static int midi_start(int no, int loop, char *data, int datalen);
+static int midi_stop();
+static int midi_pause(void);
+static int midi_unpause(void);
+static int midi_get_playing_info(midiplaystate *st);
+static int midi_getflag(int mode, int index);
+static int midi_setflag(int mode, int index, int val);
+static int midi_setvol(int vol);
+static int midi_getvol();
+static int midi_fadestart(int time, int volume, int stop);
+static boolean midi_fading();
+
+#define midi midi_synth
+mididevice_t midi = {
+	midi_initilize,
+	midi_exit,
+	midi_reset,
+	midi_start,
+	midi_stop,
+	midi_pause,
+	midi_unpause,
+	midi_get_playing_info,
+	midi_getflag,
+	midi_setflag,
+	midi_setvol,
+	midi_getvol,
+	midi_fadestart,
+	midi_fading
+};
+#undef midi
+
+#define CHUNK_FRAMES 32768
+#define RENDER_CACHE_SIZE (64 * 1024 * 1024)
+// A rendering never exceeds the cache budget (about 6 minutes at 44.1kHz).
+#define MAX_CHUNKS (RENDER_CACHE_SIZE / (CHUNK_FRAMES * 4))
+#define FEED_FRAMES 1024
+
+static struct {
+	char midi_variable[128];
+	char midi_flag[128];
+} flags;
+
+static struct soundbank *bank;
+static cacher *render_cache;
+static char *cache_dir;
+static int out_rate, out_channels;
+
+/* Pre-rendered PCM (interleaved stereo) */
+struct rendered {
+	int16_t *chunks[MAX_CHUNKS];  // CHUNK_FRAMES frames each
+	mmap_t *map;                  // disk cache file; chunks point into it
+	SDL_atomic_t frames;          // number of available frames
+	SDL_atomic_t done;            // rendering finished
+	SDL_atomic_t cancel;
+	int loop_start, loop_end;     // sys35 loop in frames (loop_end == 0: none)
+	int in_use;
+	// Set if the track reached MAX_CHUNKS without ending or looping. Such a
+	// rendering is not cached; playback continues in real time with `rest`,
+	// the sequencer positioned at the end of the rendered PCM.
+	boolean truncated;
+	struct sequencer *rest;
+};
+
+struct render_job {
+	struct rendered *r;
+	struct sequencer seq;
+	char var[128];
+	char flag[128];
+	int no;
+	char *path;              // disk cache file to write, or NULL
+	SDL_Thread *thread;
+};
+
+struct player {
+	struct rendered *r;      // pre-rendered PCM, or NULL
+	struct sequencer *seq;   // real-time synthesis (when r == NULL)
+	int pos;                 // next frame in r
+	boolean owns_r;          // r is not in the cache and is freed with the player
+	int loops_left;          // -1: forever
+	SDL_atomic_t paused;
+	SDL_atomic_t finished;
+	SDL_atomic_t played;     // number of frames played
+
+	SDL_mutex *lock;         // protects the volume and fade state
+	int vol;                 // 0-MIX_MAX_VOLUME
+	int fade_from, fade_to;
+	int fade_pos, fade_len;
+	boolean stop_after_fade;
+
+	int16_t buf[FEED_FRAMES * 2];
+};
+
+static struct player *player;
+static struct render_job *job;
+static int volume = MIX_MAX_VOLUME;
+
+void midi_synth_set_cachedir(const char *dir) {
+	free(cache_dir);
+	cache_dir = dir && *dir ? strdup(dir) : NULL;
+}
+
+/*
+ * Rendered PCM
+ */
+
+static struct rendered *rendered_new(void) {
+	struct rendered *r = calloc(1, sizeof(struct rendered));
+	if (!r)
+		NOMEMERR();
+	return r;
+}
+
+static void rendered_free(struct rendered *r) {
+	if (r->rest) {
+		seq_free(r->rest);
+		mf_remove_midifile(r->rest->midi);
+		free(r->rest);
+	}
+	if (r->map) {
+		unmap_file(r->map);
+	} else {
+		for (int i = 0; i < MAX_CHUNKS && r->chunks[i]; i++)
+			free(r->chunks[i]);
+	}
+	free(r);
+}
+
+static char *cache_path(int no) {
+	if (!cache_dir)
+		return NULL;
+	char *path = malloc(strlen(cache_dir) + 64);
+	if (!path)
+		NOMEMERR();
+	sprintf(path, "%s/%08x_%d_%d_%08x.wav", cache_dir, ald_get_signature(DRIFILE_MIDI), no, out_rate, soundbank_id(bank));
+	return path;
+}
+
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+
+static void put_dw(uint8_t *p, uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* Write the PCM as a WAVE file, with the loop in a "smpl" chunk. */
+static void save_rendered(struct rendered *r, const char *path) {
+	int frames = SDL_AtomicGet(&r->frames);
+	uint32_t data_size = frames * 4;
+	uint8_t hdr[112];
+	int smpl_size = r->loop_end ? 60 : 0;
+	int hdr_size = 12 + 24 + (smpl_size ? 8 + smpl_size : 0) + 8;
+	memset(hdr, 0, sizeof(hdr));
+
+	memcpy(hdr, "RIFF", 4);
+	put_dw(hdr + 4, hdr_size - 8 + data_size);
+	memcpy(hdr + 8, "WAVE", 4);
+	uint8_t *p = hdr + 12;
+	memcpy(p, "fmt ", 4);
+	put_dw(p + 4, 16);
+	put_dw(p + 8, 1 | 2 << 16);           // PCM, stereo
+	put_dw(p + 12, out_rate);
+	put_dw(p + 16, out_rate * 4);
+	put_dw(p + 20, 4 | 16 << 16);         // block align, bits per sample
+	p += 24;
+	if (smpl_size) {
+		memcpy(p, "smpl", 4);
+		put_dw(p + 4, smpl_size);
+		put_dw(p + 8 + 8, 1000000000 / out_rate);  // sample period
+		put_dw(p + 8 + 12, 60);                    // MIDI unity note
+		put_dw(p + 8 + 28, 1);                     // number of loops
+		put_dw(p + 8 + 44, r->loop_start);
+		put_dw(p + 8 + 48, r->loop_end - 1);       // inclusive
+		p += 8 + smpl_size;
+	}
+	memcpy(p, "data", 4);
+	put_dw(p + 4, data_size);
+
+	char *tmp = malloc(strlen(path) + 5);
+	if (!tmp)
+		NOMEMERR();
+	sprintf(tmp, "%s.tmp", path);
+	FILE *fp = fopen(tmp, "wb");
+	if (!fp) {
+		WARNING("%s: cannot create", tmp);
+		free(tmp);
+		return;
+	}
+	boolean ok = fwrite(hdr, hdr_size, 1, fp) == 1;
+	for (int i = 0; ok && i * CHUNK_FRAMES < frames; i++) {
+		int n = min(frames - i * CHUNK_FRAMES, CHUNK_FRAMES);
+		ok = fwrite(r->chunks[i], n * 4, 1, fp) == 1;
+	}
+	if (fclose(fp) != 0)
+		ok = FALSE;
+	if (!ok || rename(tmp, path) != 0) {
+		WARNING("%s: write error", path);
+		remove(tmp);
+	}
+	free(tmp);
+}
+
+/* Load a WAVE file written by save_rendered(). */
+static struct rendered *load_rendered(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fclose(fp);
+
+	mmap_t *map = map_file(path);
+	if (!map)
+		return NULL;
+	const uint8_t *p = map->addr;
+	const uint8_t *end = p + size;
+	if (size < 12 || memcmp(p, "RIFF", 4) || memcmp(p + 8, "WAVE", 4)) {
+		unmap_file(map);
+		return NULL;
+	}
+	struct rendered *r = rendered_new();
+	r->map = map;
+	boolean fmt_ok = FALSE;
+	const uint8_t *data = NULL;
+	uint32_t data_size = 0;
+	for (p += 12; p + 8 <= end; ) {
+		uint32_t len = LittleEndian_getDW(p, 4);
+		if (len > end - p - 8)
+			break;
+		if (!memcmp(p, "fmt ", 4) && len >= 16) {
+			fmt_ok = LittleEndian_getW(p, 8) == 1 && LittleEndian_getW(p, 10) == 2 &&
+				LittleEndian_getDW(p, 12) == out_rate && LittleEndian_getW(p, 22) == 16;
+		} else if (!memcmp(p, "smpl", 4) && len >= 60 && LittleEndian_getDW(p, 8 + 28) > 0) {
+			r->loop_start = LittleEndian_getDW(p, 8 + 44);
+			r->loop_end = LittleEndian_getDW(p, 8 + 48) + 1;
+		} else if (!memcmp(p, "data", 4)) {
+			data = p + 8;
+			data_size = len;
+		}
+		p += 8 + len + (len & 1);
+	}
+	int frames = data_size / 4;
+	if (!fmt_ok || !data || frames > MAX_CHUNKS * CHUNK_FRAMES) {
+		rendered_free(r);
+		return NULL;
+	}
+	if (r->loop_start < 0 || r->loop_end > frames || r->loop_start >= r->loop_end)
+		r->loop_start = r->loop_end = 0;
+	for (int i = 0; i * CHUNK_FRAMES < frames; i++)
+		r->chunks[i] = (int16_t *)data + i * CHUNK_FRAMES * 2;
+	SDL_AtomicSet(&r->frames, frames);
+	SDL_AtomicSet(&r->done, 1);
+	return r;
+}
+
+#else  // Disk cache is not supported on big-endian machines.
+
+static void save_rendered(struct rendered *r, const char *path) {}
+static struct rendered *load_rendered(const char *path) { return NULL; }
+
+#endif
+
+/*
+ * Move the sequencer of a render job to its own allocation (with copies of
+ * the flags and variables), so that it can outlive the job.
+ */
+static struct sequencer *seq_detach(struct render_job *j) {
+	struct sequencer *q = malloc(sizeof(struct sequencer) + 256);
+	if (!q)
+		NOMEMERR();
+	*q = j->seq;
+	q->var = (char *)(q + 1);
+	q->flag = q->var + 128;
+	memcpy(q->var, j->var, 128);
+	memcpy(q->flag, j->flag, 128);
+	q->detect_loop = FALSE;
+	memset(&j->seq, 0, sizeof(struct sequencer));
+	return q;
+}
+
+static int render_thread(void *data) {
+	struct render_job *j = data;
+	struct rendered *r = j->r;
+	uint32_t start = SDL_GetTicks();
+	int frames = 0;
+	boolean ended = FALSE;
+	for (int i = 0; i < MAX_CHUNKS && !SDL_AtomicGet(&r->cancel); i++) {
+		int16_t *chunk = malloc(CHUNK_FRAMES * 4);
+		if (!chunk)
+			NOMEMERR();
+		int n = seq_render(&j->seq, chunk, CHUNK_FRAMES);
+		r->chunks[i] = chunk;
+		frames += n;
+		SDL_AtomicSet(&r->frames, frames);
+		if (n < CHUNK_FRAMES) {
+			ended = TRUE;
+			break;
+		}
+	}
+	if (SDL_AtomicGet(&r->cancel))
+		return 0;
+	if (!ended) {
+		r->truncated = TRUE;
+		r->rest = seq_detach(j);
+		SDL_AtomicSet(&r->done, 1);
+		NOTICE("midi %d: no loop in the first %ds, continuing in real time",
+			   j->no, frames / out_rate);
+		return 0;
+	}
+	r->loop_start = j->seq.loop_start;
+	r->loop_end = j->seq.loop_end;
+	SDL_AtomicSet(&r->done, 1);
+	NOTICE("midi %d: rendered %d.%02ds in %dms (loop %d-%d)", j->no,
+		   frames / out_rate, frames % out_rate * 100 / out_rate,
+		   SDL_GetTicks() - start, r->loop_start, r->loop_end);
+	if (j->path)
+		save_rendered(r, j->path);
+	return 0;
+}
+
+static struct render_job *start_render(int no, struct midiinfo *m) {
+	struct render_job *j = calloc(1, sizeof(struct render_job));
+	if (!j)
+		NOMEMERR();
+	j->r = rendered_new();
+	j->no = no;
+	j->path = cache_path(no);
+	seq_init(&j->seq, m, bank, out_rate, j->flag, j->var);
+	j->seq.detect_loop = TRUE;
+	j->thread = SDL_CreateThread(render_thread, "MIDI render", j);
+	if (!j->thread) {
+		WARNING("SDL_CreateThread: %s", SDL_GetError());
+		rendered_free(j->r);
+		seq_free(&j->seq);
+		free(j->path);
+		free(j);
+		return NULL;
+	}
+	return j;
+}
+
+/*
+ * Wait for the render job (or cancel it), and move the result into the cache.
+ * Must be called on the main thread.
+ */
+static void finish_render(boolean cancel) {
+	if (!job)
+		return;
+	if (cancel)
+		SDL_AtomicSet(&job->r->cancel, 1);
+	SDL_WaitThread(job->thread, NULL);
+	struct rendered *r = job->r;
+	if (SDL_AtomicGet(&r->done) && !r->truncated)
+		cache_insert(render_cache, job->no, r, SDL_AtomicGet(&r->frames) * 4, &r->in_use);
+	else if (SDL_AtomicGet(&r->done) && player && player->r == r)
+		player->owns_r = TRUE;
+	else
+		rendered_free(r);
+	seq_free(&job->seq);
+	if (job->seq.midi)
+		mf_remove_midifile(job->seq.midi);
+	free(job->path);
+	free(job);
+	job = NULL;
+}
+
+/*
+ * Playback
+ */
+
+// Fill p->buf with up to n frames. Returns the number of frames.
+static int player_fill(struct player *p, int n) {
+	int filled = 0;
+	while (filled < n) {
+		int16_t *out = p->buf + filled * 2;
+		if (p->seq) {
+			int m = seq_render(p->seq, out, n - filled);
+			filled += m;
+			if (filled < n) {
+				if (p->loops_left == 0)
+					break;
+				if (p->loops_left > 0)
+					p->loops_left--;
+				seq_rewind(p->seq);
+			}
+			continue;
+		}
+
+		struct rendered *r = p->r;
+		int avail = SDL_AtomicGet(&r->frames);
+		boolean done = SDL_AtomicGet(&r->done);
+		int end = done && r->loop_end ? r->loop_end : avail;
+		if (p->pos >= end) {
+			if (!done)
+				break;  // the renderer is behind
+			if (r->rest) {
+				// Continue the truncated rendering in real time.
+				p->seq = r->rest;
+				r->rest = NULL;
+				continue;
+			}
+			if (r->loop_end) {
+				p->pos = r->loop_start;
+			} else if (p->loops_left != 0 && avail > 0) {
+				if (p->loops_left > 0)
+					p->loops_left--;
+				p->pos = 0;
+			} else {
+				SDL_AtomicSet(&p->finished, 1);
+				break;
+			}
+			continue;
+		}
+		int chunk = p->pos / CHUNK_FRAMES;
+		int ofs = p->pos % CHUNK_FRAMES;
+		int m = min(min(n - filled, end - p->pos), CHUNK_FRAMES - ofs);
+		memcpy(out, r->chunks[chunk] + ofs * 2, m * 4);
+		p->pos += m;
+		filled += m;
+	}
+	if (p->seq && filled < n)
+		SDL_AtomicSet(&p->finished, 1);
+	return filled;
+}
+
+static void player_apply_volume(struct player *p, int16_t *samples, int frames) {
+	SDL_LockMutex(p->lock);
+	for (int i = 0; i < frames; i++) {
+		if (p->fade_pos < p->fade_len) {
+			p->fade_pos++;
+			p->vol = p->fade_from + (p->fade_to - p->fade_from) * p->fade_pos / p->fade_len;
+		} else if (p->stop_after_fade) {
+			SDL_AtomicSet(&p->finished, 1);
+			memset(samples, 0, (frames - i) * 4);
+			break;
+		}
+		samples[0] = samples[0] * p->vol / MIX_MAX_VOLUME;
+		samples[1] = samples[1] * p->vol / MIX_MAX_VOLUME;
+		samples += 2;
+	}
+	SDL_UnlockMutex(p->lock);
+}
+
+// Called on the audio thread
+static void player_callback(void *udata, Uint8 *stream, int len) {
+	struct player *p = udata;
+	int16_t *out = (int16_t *)stream;
+	int frames = len / (out_channels * sizeof(int16_t));
+	memset(stream, 0, len);
+
+	while (frames > 0 && !SDL_AtomicGet(&p->paused) && !SDL_AtomicGet(&p->finished)) {
+		int n = player_fill(p, min(frames, FEED_FRAMES));
+		if (n == 0)
+			break;
+		player_apply_volume(p, p->buf, n);
+		SDL_AtomicAdd(&p->played, n);
+		for (int i = 0; i < n; i++) {
+			if (out_channels == 1) {
+				*out++ = (p->buf[i * 2] + p->buf[i * 2 + 1]) / 2;
+			} else {
+				out[0] = p->buf[i * 2];
+				out[1] = p->buf[i * 2 + 1];
+				out += out_channels;
+			}
+		}
+		frames -= n;
+	}
+}
+
+static struct player *player_new(int loop) {
+	struct player *p = calloc(1, sizeof(struct player));
+	if (!p)
+		NOMEMERR();
+	p->lock = SDL_CreateMutex();
+	if (!p->lock) {
+		WARNING("SDL_CreateMutex: %s", SDL_GetError());
+		free(p);
+		return NULL;
+	}
+	p->loops_left = loop ? loop - 1 : -1;
+	p->vol = volume;
+	return p;
+}
+
+static void player_free(struct player *p) {
+	if (p->seq) {
+		seq_free(p->seq);
+		mf_remove_midifile(p->seq->midi);
+		free(p->seq);
+	}
+	if (p->owns_r)
+		rendered_free(p->r);
+	SDL_DestroyMutex(p->lock);
+	free(p);
+}
+
+/*
+ * Device interface
+ */
+
+static int midi_initilize(char *pname, int subdev) {
+	bank = soundbank_load(pname);
+	if (!bank) {
+		WARNING("Cannot load SoundFont %s, using the built-in sounds", pname);
+		bank = soundbank_load(NULL);
+	}
+	if (!render_cache) {
+		render_cache = cache_new("midi", rendered_free);
+		cache_set_budget(render_cache, RENDER_CACHE_SIZE);
+	}
+	return OK;
+}
+
+static int midi_exit(void) {
+	midi_stop();
+	if (bank) {
+		soundbank_free(bank);
+		bank = NULL;
+	}
+	return OK;
+}
+
+static int midi_reset(void) {
+	midi_stop();
+	return OK;
+}
+
+static int midi_start(int no, int loop, char *data, int datalen) {
+	midi_stop();
+
+	Uint16 format;
+	if (!Mix_QuerySpec(&out_rate, &format, &out_channels) || format != AUDIO_S16SYS)
+		return NG;
+
+	struct rendered *r = cache_lookup(render_cache, no);
+	if (!r) {
+		char *path = cache_path(no);
+		if (path && (r = load_rendered(path)) != NULL)
+			cache_insert(render_cache, no, r, SDL_AtomicGet(&r->frames) * 4, &r->in_use);
+		free(path);
+	}
+
+	struct player *p = player_new(loop);
+	if (!p)
+		return NG;
+	if (r) {
+		p->r = r;
+	} else {
+		struct midiinfo *m = mf_read_midifile((uint8_t *)data, datalen);
+		if (!m) {
+			WARNING("error reading midi file");
+			player_free(p);
+			return NG;
+		}
+		if (seq_is_deterministic(m))
+			job = start_render(no, m);
+		if (job) {
+			p->r = job->r;
+		} else {
+			p->seq = calloc(1, sizeof(struct sequencer));
+			if (!p->seq)
+				NOMEMERR();
+			seq_init(p->seq, m, bank, out_rate, flags.midi_flag, flags.midi_variable);
+		}
+	}
+	if (p->r)
+		p->r->in_use = 1;
+
+	player = p;
+	Mix_HookMusic(player_callback, p);
+	return OK;
+}
+
+static int midi_stop() {
+	if (!player)
+		return OK;
+	Mix_HookMusic(NULL, NULL);
+	if (player->r)
+		player->r->in_use = 0;
+	finish_render(TRUE);
+	player_free(player);
+	player = NULL;
+	return OK;
+}
+
+static int midi_pause(void) {
+	if (player)
+		SDL_AtomicSet(&player->paused, 1);
+	return OK;
+}
+
+static int midi_unpause(void) {
+	if (player)
+		SDL_AtomicSet(&player->paused, 0);
+	return OK;
+}
+
+static int midi_get_playing_info(midiplaystate *st) {
+	if (job && SDL_AtomicGet(&job->r->done))
+		finish_render(FALSE);
+
+	if (!player || SDL_AtomicGet(&player->finished)) {
+		st->in_play = FALSE;
+		st->loc_ms  = 0;
+		return OK;
+	}
+
+	st->in_play = TRUE;
+	st->loc_ms = (int64_t)SDL_AtomicGet(&player->played) * 1000 / out_rate;
+	return OK;
+}
+
+/*
+ * Pre-rendered tracks keep their variables to themselves; only tracks
+ * played in real time read and write these.
+ */
+static int midi_getflag(int mode, int index) {
+	if (mode == 0) {
+		/* flag */
+		return flags.midi_flag[index];
+	} else {
+		/* variable */
+		return flags.midi_variable[index];
+	}
+}
+
+static int midi_setflag(int mode, int index, int val) {
+	if (mode == 0) {
+		/* flag */
+		flags.midi_flag[index] = val;
+	} else {
+		/* variable */
+		flags.midi_variable[index] = val;
+	}
+	return OK;
+}
+
+static void set_fade(struct player *p, int time, int vol, boolean stop) {
+	SDL_LockMutex(p->lock);
+	p->fade_from = p->vol;
+	p->fade_to = vol;
+	p->fade_pos = 0;
+	p->fade_len = (int64_t)time * out_rate / 1000;  // time is in ms
+	if (!p->fade_len)
+		p->vol = vol;
+	p->stop_after_fade = stop;
+	SDL_UnlockMutex(p->lock);
+}
+
+static int midi_setvol(int vol) {
+	volume = vol * MIX_MAX_VOLUME / 100;
+	if (player)
+		set_fade(player, 0, volume, FALSE);
+	return OK;
+}
+
+static int midi_getvol() {
+	return volume * 100 / MIX_MAX_VOLUME;
+}
+
+static int midi_fadestart(int time, int vol, int stop) {
+	if (!player) {
+		volume = vol * MIX_MAX_VOLUME / 100;
+		return OK;
+	}
+	if (time == 0 && stop) {
+		midi_stop();
+		return OK;
+	}
+	set_fade(player, time, vol * MIX_MAX_VOLUME / 100, stop);
+	return OK;
+}
+
+static boolean midi_fading() {
+	if (!player)
+		return FALSE;
+	SDL_LockMutex(player->lock);
+	boolean fading = player->fade_pos < player->fade_len;
+	SDL_UnlockMutex(player->lock);
+	return fading;
+}
@@ -562,6 +562,7 @@ struct midiinfo *mf_read_midifile(uint8_t *stream, off_t len) {
 	
 	midi->msgsize = 128; /* Initial msg buffer size */
 	midi->msgbuffer = calloc(midi->msgsize, sizeof(unsigned char));
+	memset(midi->sys35_label, -1, sizeof(midi->sys35_label)); /* 未定義のラベル */
 	
 	if (0 > read_header(stream, len)) {
 		return NULL;
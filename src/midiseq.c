@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "portab.h"
+#include "system.h"
+#include "midiseq.h"
+
+#define MAX_JUMPS 256      // jumps without advancing time
+
+void seq_init(struct sequencer *q, struct midiinfo *m, struct soundbank *bank, int rate, char *flag, char *var) {
+	memset(q, 0, sizeof(struct sequencer));
+	q->midi = m;
+	q->synth = midisynth_new(bank, rate);
+	q->rate = rate;
+	q->flag = flag;
+	q->var = var;
+	q->tempo = 500000;
+	q->ended = m->eventsize == 0;
+}
+
+void seq_rewind(struct sequencer *q) {
+	midisynth_reset(q->synth);
+	q->ev = 0;
+	q->ctick = 0;
+	q->tempo = 500000;
+	q->wait = 0;
+	q->jumps = 0;
+	q->ended = q->midi->eventsize == 0;
+}
+
+void seq_free(struct sequencer *q) {
+	midisynth_free(q->synth);
+	free(q->labels);
+}
+
+static uint32_t hash_bytes(const char *p, int n) {
+	uint32_t h = 2166136261u;  // FNV-1a
+	while (n--)
+		h = (h ^ (uint8_t)*p++) * 16777619u;
+	return h;
+}
+
+/*
+ * Called at a label. If the sequencer has been here before in the same
+ * state, everything from that point repeats forever.
+ */
+static boolean seq_check_loop(struct sequencer *q) {
+	uint32_t vars = hash_bytes(q->var, 128);
+	uint32_t synth = midisynth_state_hash(q->synth);
+	for (int i = 0; i < q->nr_labels; i++) {
+		struct label_state *l = &q->labels[i];
+		if (l->ev == q->ev && l->vars == vars && l->synth == synth && l->frame < q->frame) {
+			q->loop_start = l->frame;
+			q->loop_end = q->frame;
+			return TRUE;
+		}
+	}
+	q->labels = realloc(q->labels, (q->nr_labels + 1) * sizeof(struct label_state));
+	if (!q->labels)
+		NOMEMERR();
+	q->labels[q->nr_labels++] = (struct label_state){q->ev, vars, synth, q->frame};
+	return FALSE;
+}
+
+/* system35 marker (see check_sys35mark() in midifile.c) */
+static void seq_sys35(struct sequencer *q) {
+	struct midiinfo *m = q->midi;
+	int i = q->ev;
+	if (i + 6 > m->eventsize) {
+		q->ev = m->eventsize;
+		return;
+	}
+	int vn1 = m->event[i + 1].data[2];
+	int vn2 = m->event[i + 2].data[2];
+	int vn3 = m->event[i + 3].data[2];
+
+	int target = -1;
+	switch (vn1) {
+	case 0:
+		/* set label */
+		if (q->detect_loop && seq_check_loop(q)) {
+			q->ended = TRUE;
+			return;
+		}
+		break;
+	case 1:
+		/* jump */
+		target = vn2;
+		break;
+	case 2:
+		/* set flag */
+		q->flag[vn2] = vn3;
+		break;
+	case 3:
+		/* flag jump */
+		if (q->flag[vn2] == 1)
+			target = vn3;
+		break;
+	case 4:
+		/* set variable */
+		q->var[vn2] = vn3;
+		break;
+	case 5:
+		/* variable jump */
+		if (--q->var[vn2] == 0)
+			target = vn3;
+		break;
+	}
+	if (target < 0) {
+		q->ev += 6;
+		return;
+	}
+	int label = target < 127 ? m->sys35_label[target] : -1;
+	if (label < 0 || label >= m->eventsize || ++q->jumps > MAX_JUMPS) {
+		WARNING("bad sys35 jump to label %d", target);
+		q->ev = m->eventsize;
+		return;
+	}
+	midisynth_all_notes_off(q->synth);
+	q->ev = label;
+	q->ctick = m->event[label].ctime;
+}
+
+/* Process the events at the current tick. */
+static void seq_dispatch(struct sequencer *q) {
+	struct midiinfo *m = q->midi;
+	while (!q->ended && q->ev < m->eventsize && m->event[q->ev].ctime <= q->ctick) {
+		struct midievent *e = &m->event[q->ev];
+		switch (e->type) {
+		case MIDI_EVENT_NORMAL:
+			midisynth_event(q->synth, e->data, e->n);
+			q->ev++;
+			break;
+		case MIDI_EVENT_TEMPO:
+			q->tempo = *(int *)e->data;
+			q->ev++;
+			break;
+		case MIDI_EVENT_SYS35:
+			seq_sys35(q);
+			break;
+		default:
+			q->ev++;
+			break;
+		}
+	}
+	if (q->ev >= m->eventsize)
+		q->ended = TRUE;
+}
+
+/*
+ * Render up to `frames` stereo frames. Returns the number of rendered frames,
+ * which is less than `frames` only at the end of the track (or the loop end).
+ */
+int seq_render(struct sequencer *q, int16_t *out, int frames) {
+	struct midiinfo *m = q->midi;
+	int division = m->division > 0 ? m->division : 480;
+	int done = 0;
+	while (done < frames) {
+		if (!q->ended && q->wait < 1.0) {
+			q->ctick = m->event[q->ev].ctime;
+			seq_dispatch(q);
+			if (q->ended) {
+				if (!q->loop_end)
+					midisynth_all_notes_off(q->synth);
+				continue;
+			}
+			q->wait += (double)(m->event[q->ev].ctime - q->ctick) * q->tempo / 1e6 / division * q->rate;
+			continue;
+		}
+		int n;
+		if (q->ended) {
+			// Let the released notes fade out, except at the loop end.
+			if (q->loop_end || midisynth_is_silent(q->synth))
+				break;
+			n = min(frames - done, q->rate / 100);
+		} else {
+			n = min(frames - done, (int)q->wait);
+		}
+		midisynth_render(q->synth, out + done * 2, n);
+		q->wait -= n;
+		q->frame += n;
+		q->jumps = 0;
+		done += n;
+	}
+	return done;
+}
+
+/*
+ * A track can be pre-rendered if its playback doesn't depend on the game:
+ * no flags, and every variable is set by the track before it is tested.
+ */
+boolean seq_is_deterministic(struct midiinfo *m) {
+	boolean var_set[128] = {FALSE};
+	for (int i = 0; i + 3 < m->eventsize; i++) {
+		if (m->event[i].type != MIDI_EVENT_SYS35)
+			continue;
+		int vn1 = m->event[i + 1].data[2];
+		int vn2 = m->event[i + 2].data[2];
+		switch (vn1) {
+		case 2:
+		case 3:
+			return FALSE;
+		case 4:
+			var_set[vn2] = TRUE;
+			break;
+		case 5:
+			if (!var_set[vn2])
+				return FALSE;
+			break;
+		}
+	}
+	return TRUE;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __MIDISEQ_H__
+#define __MIDISEQ_H__
+
+#include <stdint.h>
+#include "portab.h"
+#include "midifile.h"
+#include "midisynth.h"
+
+/*
+ * Plays a parsed MIDI file (with system35 jump markers) on a midisynth.
+ */
+
+/* sys35 label passed during pre-rendering, used for loop detection */
+struct label_state {
+	int ev;
+	uint32_t vars;
+	uint32_t synth;
+	int frame;
+};
+
+struct sequencer {
+	struct midiinfo *midi;
+	struct midisynth *synth;
+	int rate;
+	char *flag, *var;        // sys35 flags and variables
+	int ev;                  // next event
+	unsigned long ctick;
+	int tempo;               // microseconds per quarter note
+	double wait;             // frames until the next event
+	int jumps;
+	boolean ended;
+	int frame;
+	// loop detection (pre-rendering only)
+	boolean detect_loop;
+	struct label_state *labels;
+	int nr_labels;
+	int loop_start, loop_end;
+};
+
+void seq_init(struct sequencer *q, struct midiinfo *m, struct soundbank *bank, int rate, char *flag, char *var);
+void seq_rewind(struct sequencer *q);
+void seq_free(struct sequencer *q);
+// Renders interleaved 16-bit stereo samples.
+int seq_render(struct sequencer *q, int16_t *out, int frames);
+// TRUE if the track can be pre-rendered (doesn't depend on the game).
+boolean seq_is_deterministic(struct midiinfo *m);
+
+#endif /* __MIDISEQ_H__ */
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "midiseq.h"
+#include "unittest.h"
+
+#define RATE 44100
+#define BEAT 480           // one beat is 22050 frames at the default tempo
+#define BEAT_FRAMES (RATE / 2)
+
+// sys35 markers
+enum { LABEL, JUMP, SET_FLAG, FLAG_JUMP, SET_VAR, VAR_JUMP };
+
+static struct soundbank *bank;
+
+struct smf {
+	uint8_t data[1024];
+	int len;
+	unsigned long tick;
+};
+
+static void put_delta(struct smf *f, unsigned long tick) {
+	unsigned long d = tick - f->tick;
+	if (d >= 0x80)
+		f->data[f->len++] = 0x80 | (d >> 7);
+	f->data[f->len++] = d & 0x7f;
+	f->tick = tick;
+}
+
+static void put_event(struct smf *f, unsigned long tick, int status, int d1, int d2) {
+	put_delta(f, tick);
+	f->data[f->len++] = status;
+	f->data[f->len++] = d1;
+	f->data[f->len++] = d2;
+}
+
+static void smf_begin(struct smf *f) {
+	static const uint8_t header[] = {
+		'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, BEAT >> 8, BEAT & 0xff,
+		'M', 'T', 'r', 'k', 0, 0, 0, 0,
+	};
+	memcpy(f->data, header, sizeof(header));
+	f->len = sizeof(header);
+	f->tick = 0;
+}
+
+static struct midiinfo *smf_end(struct smf *f) {
+	put_delta(f, f->tick);
+	f->data[f->len++] = 0xff;
+	f->data[f->len++] = 0x2f;
+	f->data[f->len++] = 0x00;
+	int tracklen = f->len - 22;
+	f->data[20] = tracklen >> 8;
+	f->data[21] = tracklen & 0xff;
+	struct midiinfo *m = mf_read_midifile(f->data, f->len);
+	ASSERT_TRUE(m != NULL);
+	return m;
+}
+
+static void marker(struct smf *f, unsigned long tick, int vn1, int vn2, int vn3) {
+	put_event(f, tick, 0xb0, 101, 100);
+	put_event(f, tick, 0xb0, 100, vn1);
+	put_event(f, tick, 0xb0, 6, vn2);
+	put_event(f, tick, 0xb0, 38, vn3);
+	put_event(f, tick, 0xb0, 101, 127);
+	put_event(f, tick, 0xb0, 100, 127);
+}
+
+static void note(struct smf *f, unsigned long tick, int key) {
+	put_event(f, tick, 0x90, key, 100);
+	put_event(f, tick + BEAT / 2, 0x80, key, 0);
+}
+
+// Pre-renders the track and returns the number of rendered frames.
+static int render(struct midiinfo *m, struct sequencer *q, char *var) {
+	static int16_t buf[BEAT_FRAMES * 2];
+	char flag[128] = {0};
+	seq_init(q, m, bank, RATE, flag, var);
+	q->detect_loop = TRUE;
+	int frames = 0;
+	for (int i = 0; i < 100; i++) {
+		int n = seq_render(q, buf, BEAT_FRAMES);
+		frames += n;
+		if (n < BEAT_FRAMES)
+			break;
+	}
+	return frames;
+}
+
+static void loop_test(void) {
+	struct smf f;
+	smf_begin(&f);
+	marker(&f, 0, LABEL, 0, 0);
+	note(&f, 0, 60);
+	note(&f, BEAT, 64);
+	marker(&f, 2 * BEAT, JUMP, 0, 0);
+	struct midiinfo *m = smf_end(&f);
+	ASSERT_TRUE(seq_is_deterministic(m));
+
+	struct sequencer q;
+	char var[128] = {0};
+	ASSERT_EQUAL(render(m, &q, var), 2 * BEAT_FRAMES);
+	ASSERT_EQUAL(q.loop_start, 0);
+	ASSERT_EQUAL(q.loop_end, 2 * BEAT_FRAMES);
+	seq_free(&q);
+	mf_remove_midifile(m);
+}
+
+static void intro_test(void) {
+	// The loop starts after a one-beat intro.
+	struct smf f;
+	smf_begin(&f);
+	note(&f, 0, 48);
+	marker(&f, BEAT, LABEL, 1, 0);
+	note(&f, BEAT, 60);
+	marker(&f, 2 * BEAT, JUMP, 1, 0);
+	struct midiinfo *m = smf_end(&f);
+
+	struct sequencer q;
+	char var[128] = {0};
+	ASSERT_EQUAL(render(m, &q, var), 2 * BEAT_FRAMES);
+	ASSERT_EQUAL(q.loop_start, BEAT_FRAMES);
+	ASSERT_EQUAL(q.loop_end, 2 * BEAT_FRAMES);
+	seq_free(&q);
+	mf_remove_midifile(m);
+}
+
+static void variable_test(void) {
+	// Label 1 is visited with different counter values before the track
+	// jumps back to label 0, so the loop is the whole three-beat pass.
+	struct smf f;
+	smf_begin(&f);
+	marker(&f, 0, LABEL, 0, 0);
+	marker(&f, 0, SET_VAR, 5, 2);
+	marker(&f, 0, LABEL, 1, 0);
+	note(&f, 0, 60);
+	marker(&f, BEAT, VAR_JUMP, 5, 2);
+	marker(&f, BEAT, JUMP, 1, 0);
+	marker(&f, BEAT, LABEL, 2, 0);
+	note(&f, BEAT, 67);
+	marker(&f, 2 * BEAT, JUMP, 0, 0);
+	struct midiinfo *m = smf_end(&f);
+	ASSERT_TRUE(seq_is_deterministic(m));
+
+	struct sequencer q;
+	char var[128] = {0};
+	ASSERT_EQUAL(render(m, &q, var), 3 * BEAT_FRAMES);
+	ASSERT_EQUAL(q.loop_start, 0);
+	ASSERT_EQUAL(q.loop_end, 3 * BEAT_FRAMES);
+	ASSERT_EQUAL(var[5], 0);
+	seq_free(&q);
+	mf_remove_midifile(m);
+}
+
+static void no_loop_test(void) {
+	struct smf f;
+	smf_begin(&f);
+	marker(&f, 0, LABEL, 0, 0);
+	note(&f, 0, 60);
+	note(&f, BEAT, 64);
+	struct midiinfo *m = smf_end(&f);
+	ASSERT_TRUE(seq_is_deterministic(m));
+
+	struct sequencer q;
+	char var[128] = {0};
+	int frames = render(m, &q, var);
+	ASSERT_TRUE(frames > BEAT_FRAMES + BEAT_FRAMES / 2);
+	ASSERT_TRUE(frames < 3 * BEAT_FRAMES);
+	ASSERT_EQUAL(q.loop_end, 0);
+	seq_free(&q);
+	mf_remove_midifile(m);
+}
+
+static void nondeterministic_test(void) {
+	struct smf f;
+	struct midiinfo *m;
+
+	// Flags are set by the game.
+	smf_begin(&f);
+	marker(&f, 0, LABEL, 0, 0);
+	note(&f, 0, 60);
+	marker(&f, BEAT, FLAG_JUMP, 3, 0);
+	m = smf_end(&f);
+	ASSERT_FALSE(seq_is_deterministic(m));
+	mf_remove_midifile(m);
+
+	smf_begin(&f);
+	marker(&f, 0, SET_FLAG, 3, 1);
+	note(&f, 0, 60);
+	m = smf_end(&f);
+	ASSERT_FALSE(seq_is_deterministic(m));
+	mf_remove_midifile(m);
+
+	// The variable is tested before the track sets it.
+	smf_begin(&f);
+	marker(&f, 0, LABEL, 0, 0);
+	note(&f, 0, 60);
+	marker(&f, BEAT, VAR_JUMP, 7, 0);
+	marker(&f, BEAT, SET_VAR, 7, 3);
+	marker(&f, BEAT, JUMP, 0, 0);
+	m = smf_end(&f);
+	ASSERT_FALSE(seq_is_deterministic(m));
+	mf_remove_midifile(m);
+}
+
+void midiseq_test(void) {
+	bank = soundbank_load(NULL);
+	loop_test();
+	intro_test();
+	variable_test();
+	no_loop_test();
+	nondeterministic_test();
+	soundbank_free(bank);
+}
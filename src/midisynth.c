@@ -0,0 +1,985 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_endian.h>
+
+#include "portab.h"
+#include "system.h"
+#include "mmap.h"
+#include "LittleEndian.h"
+#include "midisynth.h"
+
+#define MAX_VOICES 64
+#define NR_CHANNELS 16
+#define DRUM_CHANNEL 9
+#define DRUM_BANK 128
+#define BLOCK_FRAMES 256
+#define MASTER_GAIN 0.6f
+#define SILENCE 0.0001f  // -80dB
+
+/* SoundFont 2 generators */
+enum {
+	GEN_START_OFS = 0,
+	GEN_END_OFS = 1,
+	GEN_LOOP_START_OFS = 2,
+	GEN_LOOP_END_OFS = 3,
+	GEN_START_COARSE_OFS = 4,
+	GEN_END_COARSE_OFS = 12,
+	GEN_PAN = 17,
+	GEN_DELAY_VOL_ENV = 33,
+	GEN_ATTACK_VOL_ENV = 34,
+	GEN_HOLD_VOL_ENV = 35,
+	GEN_DECAY_VOL_ENV = 36,
+	GEN_SUSTAIN_VOL_ENV = 37,
+	GEN_RELEASE_VOL_ENV = 38,
+	GEN_INSTRUMENT = 41,
+	GEN_KEY_RANGE = 43,
+	GEN_VEL_RANGE = 44,
+	GEN_LOOP_START_COARSE_OFS = 45,
+	GEN_ATTENUATION = 48,
+	GEN_LOOP_END_COARSE_OFS = 50,
+	GEN_COARSE_TUNE = 51,
+	GEN_FINE_TUNE = 52,
+	GEN_SAMPLE_ID = 53,
+	GEN_SAMPLE_MODES = 54,
+	GEN_SCALE_TUNING = 56,
+	GEN_EXCLUSIVE_CLASS = 57,
+	GEN_ROOT_KEY = 58,
+	NR_GENS = 61
+};
+
+/* generators that are added to the instrument's value at the preset level */
+static const boolean additive_gen[NR_GENS] = {
+	[GEN_PAN] = TRUE,
+	[GEN_DELAY_VOL_ENV] = TRUE,
+	[GEN_ATTACK_VOL_ENV] = TRUE,
+	[GEN_HOLD_VOL_ENV] = TRUE,
+	[GEN_DECAY_VOL_ENV] = TRUE,
+	[GEN_SUSTAIN_VOL_ENV] = TRUE,
+	[GEN_RELEASE_VOL_ENV] = TRUE,
+	[GEN_ATTENUATION] = TRUE,
+	[GEN_COARSE_TUNE] = TRUE,
+	[GEN_FINE_TUNE] = TRUE,
+	[GEN_SCALE_TUNING] = TRUE,
+};
+
+struct zone {
+	uint8_t key_lo, key_hi, vel_lo, vel_hi;
+	uint32_t start, end, loop_start, loop_end;  // positions in the sample pool
+	int loop_mode;      // 0: no loop, 1: loop, 3: loop until released
+	int root_key;
+	int tune;           // in cents
+	int scale_tuning;   // in cents per key
+	int sample_rate;
+	float gain;
+	float pan;          // -1 (left) to 1 (right)
+	float delay, attack, hold, decay, release;  // in seconds
+	float sustain;      // sustain level (amplitude)
+	int exclusive_class;
+};
+
+struct preset {
+	int bank, program;
+	struct zone *zones;
+	int nr_zones;
+};
+
+struct soundbank {
+	mmap_t *file;          // SoundFont file (NULL for the built-in bank)
+	const int16_t *pool;   // sample data, little endian
+	int16_t *pool_buf;     // sample data of the built-in bank
+	uint32_t pool_len;
+	struct preset *presets;
+	int nr_presets;
+	uint32_t id;
+};
+
+enum env_stage { ENV_DELAY, ENV_ATTACK, ENV_HOLD, ENV_DECAY, ENV_SUSTAIN, ENV_RELEASE };
+
+struct voice {
+	boolean active;
+	int channel;
+	int key;
+	const struct zone *zone;
+	double pos;
+	double base_inc;     // sample increment without pitch bend
+	double inc;
+	float vel_gain;
+	float gain_l, gain_r;
+	enum env_stage stage;
+	float level;
+	int stage_left;      // remaining frames in the delay and hold stages
+	float attack_step;
+	float decay_mul;
+	float release_mul;
+	boolean released;
+	boolean sustained;   // note off received while the sustain pedal is down
+};
+
+struct channel {
+	int program;
+	int bank;
+	const struct preset *preset;
+	uint8_t volume, expression, pan, sustain;
+	int bend;            // -8192 to 8191
+	int bend_range;      // in cents
+	uint8_t rpn_msb, rpn_lsb;
+};
+
+struct midisynth {
+	struct soundbank *bank;
+	int rate;
+	struct channel channels[NR_CHANNELS];
+	struct voice voices[MAX_VOICES];
+	float mix[BLOCK_FRAMES * 2];
+};
+
+/*
+ * Sound bank
+ */
+
+static float timecents_to_sec(int tc) {
+	return powf(2.0f, tc / 1200.0f);
+}
+
+static float centibels_to_gain(int cb) {
+	return powf(10.0f, -cb / 200.0f);
+}
+
+static const struct preset *find_preset(struct soundbank *bank, int bank_no, int program) {
+	for (int i = 0; i < bank->nr_presets; i++) {
+		if (bank->presets[i].bank == bank_no && bank->presets[i].program == program)
+			return &bank->presets[i];
+	}
+	return NULL;
+}
+
+static struct zone *add_zone(struct preset *p) {
+	p->zones = realloc(p->zones, (p->nr_zones + 1) * sizeof(struct zone));
+	if (!p->zones)
+		NOMEMERR();
+	struct zone *z = &p->zones[p->nr_zones++];
+	memset(z, 0, sizeof(struct zone));
+	return z;
+}
+
+static void default_gens(int16_t *gen) {
+	memset(gen, 0, NR_GENS * sizeof(int16_t));
+	gen[GEN_KEY_RANGE] = 127 << 8;
+	gen[GEN_VEL_RANGE] = 127 << 8;
+	gen[GEN_DELAY_VOL_ENV] = -12000;
+	gen[GEN_ATTACK_VOL_ENV] = -12000;
+	gen[GEN_HOLD_VOL_ENV] = -12000;
+	gen[GEN_DECAY_VOL_ENV] = -12000;
+	gen[GEN_RELEASE_VOL_ENV] = -12000;
+	gen[GEN_SCALE_TUNING] = 100;
+	gen[GEN_ROOT_KEY] = -1;
+}
+
+/* SoundFont chunk tables */
+struct sf2 {
+	const uint8_t *phdr, *pbag, *pgen, *inst, *ibag, *igen, *shdr;
+	int nr_phdr, nr_pbag, nr_pgen, nr_inst, nr_ibag, nr_igen, nr_shdr;
+};
+
+/* Apply the generators of a bag; returns the value of the terminal generator or -1 */
+static int apply_gens(int16_t *gen, const uint8_t *gens, int first, int last, int terminal) {
+	for (int i = first; i < last; i++) {
+		int oper = LittleEndian_getW(gens, i * 4);
+		int16_t amount = LittleEndian_getW(gens, i * 4 + 2);
+		if (oper == terminal)
+			return (uint16_t)amount;
+		if (oper < NR_GENS)
+			gen[oper] = amount;
+	}
+	return -1;
+}
+
+static boolean intersect_range(int16_t a, int16_t b, uint8_t *lo, uint8_t *hi) {
+	*lo = max(a & 0xff, b & 0xff);
+	*hi = min((a >> 8) & 0xff, (b >> 8) & 0xff);
+	return *lo <= *hi;
+}
+
+static void add_sf2_zone(struct soundbank *bank, struct preset *p, const struct sf2 *sf, const int16_t *pgen, const int16_t *igen, int sample_id) {
+	if (sample_id >= sf->nr_shdr - 1)
+		return;
+	const uint8_t *sh = sf->shdr + sample_id * 46;
+	int type = LittleEndian_getW(sh, 44);
+	if (type & 0x8000)  // ROM sample
+		return;
+
+	int16_t gen[NR_GENS];
+	memcpy(gen, igen, sizeof(gen));
+	for (int i = 0; i < NR_GENS; i++) {
+		if (additive_gen[i])
+			gen[i] += pgen[i];
+	}
+
+	struct zone tmp;
+	if (!intersect_range(pgen[GEN_KEY_RANGE], igen[GEN_KEY_RANGE], &tmp.key_lo, &tmp.key_hi) ||
+		!intersect_range(pgen[GEN_VEL_RANGE], igen[GEN_VEL_RANGE], &tmp.vel_lo, &tmp.vel_hi))
+		return;
+
+	int64_t start = (uint32_t)LittleEndian_getDW(sh, 20) + gen[GEN_START_OFS] + 32768 * gen[GEN_START_COARSE_OFS];
+	int64_t end = (uint32_t)LittleEndian_getDW(sh, 24) + gen[GEN_END_OFS] + 32768 * gen[GEN_END_COARSE_OFS];
+	int64_t loop_start = (uint32_t)LittleEndian_getDW(sh, 28) + gen[GEN_LOOP_START_OFS] + 32768 * gen[GEN_LOOP_START_COARSE_OFS];
+	int64_t loop_end = (uint32_t)LittleEndian_getDW(sh, 32) + gen[GEN_LOOP_END_OFS] + 32768 * gen[GEN_LOOP_END_COARSE_OFS];
+	end = min(end, (int64_t)bank->pool_len - 1);
+	if (start < 0 || start >= end)
+		return;
+
+	struct zone *z = add_zone(p);
+	z->key_lo = tmp.key_lo;
+	z->key_hi = tmp.key_hi;
+	z->vel_lo = tmp.vel_lo;
+	z->vel_hi = tmp.vel_hi;
+	z->start = start;
+	z->end = end;
+	z->loop_mode = gen[GEN_SAMPLE_MODES] & 3;
+	if (z->loop_mode == 2 || loop_start < start || loop_end > end || loop_end - loop_start < 2)
+		z->loop_mode = 0;
+	z->loop_start = z->loop_mode ? loop_start : start;
+	z->loop_end = z->loop_mode ? loop_end : end;
+	int orig_pitch = sh[40];
+	z->root_key = gen[GEN_ROOT_KEY] >= 0 ? gen[GEN_ROOT_KEY] : orig_pitch <= 127 ? orig_pitch : 60;
+	z->tune = gen[GEN_COARSE_TUNE] * 100 + gen[GEN_FINE_TUNE] + (int8_t)sh[41];
+	z->scale_tuning = gen[GEN_SCALE_TUNING];
+	z->sample_rate = LittleEndian_getDW(sh, 36);
+	if (z->sample_rate <= 0)
+		z->sample_rate = 44100;
+	z->gain = centibels_to_gain(max(gen[GEN_ATTENUATION], 0));
+	z->pan = max(-500, min(500, gen[GEN_PAN])) / 500.0f;
+	z->delay = timecents_to_sec(gen[GEN_DELAY_VOL_ENV]);
+	z->attack = timecents_to_sec(gen[GEN_ATTACK_VOL_ENV]);
+	z->hold = timecents_to_sec(gen[GEN_HOLD_VOL_ENV]);
+	z->decay = timecents_to_sec(gen[GEN_DECAY_VOL_ENV]);
+	z->release = timecents_to_sec(gen[GEN_RELEASE_VOL_ENV]);
+	int sustain_cb = max(0, min(1440, gen[GEN_SUSTAIN_VOL_ENV]));
+	z->sustain = sustain_cb >= 1440 ? 0.0f : centibels_to_gain(sustain_cb);
+	z->exclusive_class = gen[GEN_EXCLUSIVE_CLASS];
+}
+
+static void add_sf2_instrument(struct soundbank *bank, struct preset *p, const struct sf2 *sf, const int16_t *pgen, int inst) {
+	if (inst >= sf->nr_inst - 1)
+		return;
+	int bag_first = LittleEndian_getW(sf->inst, inst * 22 + 20);
+	int bag_last = LittleEndian_getW(sf->inst, (inst + 1) * 22 + 20);
+	int16_t global[NR_GENS];
+	default_gens(global);
+	for (int b = bag_first; b < bag_last && b < sf->nr_ibag - 1; b++) {
+		int gen_first = LittleEndian_getW(sf->ibag, b * 4);
+		int gen_last = LittleEndian_getW(sf->ibag, (b + 1) * 4);
+		int16_t gen[NR_GENS];
+		memcpy(gen, global, sizeof(gen));
+		int sample_id = apply_gens(gen, sf->igen, gen_first, min(gen_last, sf->nr_igen), GEN_SAMPLE_ID);
+		if (sample_id >= 0)
+			add_sf2_zone(bank, p, sf, pgen, gen, sample_id);
+		else if (b == bag_first)
+			memcpy(global, gen, sizeof(gen));
+	}
+}
+
+static const uint8_t *find_chunk(const uint8_t *p, const uint8_t *end, const char *id, const char *list_type, uint32_t *size) {
+	while (p + 8 <= end) {
+		uint32_t len = LittleEndian_getDW(p, 4);
+		if (len > end - p - 8)
+			return NULL;
+		if (!memcmp(p, id, 4) && (!list_type || (len >= 4 && !memcmp(p + 8, list_type, 4)))) {
+			*size = len;
+			return p + 8;
+		}
+		p += 8 + len + (len & 1);
+	}
+	return NULL;
+}
+
+static boolean load_sf2(struct soundbank *bank, const uint8_t *data, size_t size) {
+	const uint8_t *end = data + size;
+	uint32_t len;
+	if (size < 12 || memcmp(data, "RIFF", 4) || memcmp(data + 8, "sfbk", 4))
+		return FALSE;
+	const uint8_t *riff = data + 12;
+
+	const uint8_t *sdta = find_chunk(riff, end, "LIST", "sdta", &len);
+	if (!sdta)
+		return FALSE;
+	const uint8_t *smpl = find_chunk(sdta + 4, sdta + len, "smpl", NULL, &len);
+	if (!smpl)
+		return FALSE;
+	bank->pool = (const int16_t *)smpl;
+	bank->pool_len = len / 2;
+
+	const uint8_t *pdta = find_chunk(riff, end, "LIST", "pdta", &len);
+	if (!pdta)
+		return FALSE;
+	const uint8_t *pdta_end = pdta + len;
+
+	// The id names the cached renderings of this bank (-midicache). It is a
+	// FNV-1a hash of the preset, instrument and sample headers and the sample
+	// pool size, so that a replaced file gets a new id even if its size is
+	// unchanged.
+	uint32_t h = 2166136261u;
+	for (const uint8_t *p = pdta; p < pdta_end; p++)
+		h = (h ^ *p) * 16777619u;
+	bank->id = (h ^ (uint32_t)bank->pool_len) * 16777619u;
+
+	struct sf2 sf;
+#define TABLE(name, recsize) \
+	if (!(sf.name = find_chunk(pdta + 4, pdta_end, #name, NULL, &len))) \
+		return FALSE; \
+	sf.nr_##name = len / recsize;
+	TABLE(phdr, 38);
+	TABLE(pbag, 4);
+	TABLE(pgen, 4);
+	TABLE(inst, 22);
+	TABLE(ibag, 4);
+	TABLE(igen, 4);
+	TABLE(shdr, 46);
+#undef TABLE
+
+	bank->nr_presets = max(sf.nr_phdr - 1, 0);
+	bank->presets = calloc(bank->nr_presets, sizeof(struct preset));
+	if (!bank->presets)
+		NOMEMERR();
+	for (int i = 0; i < bank->nr_presets; i++) {
+		const uint8_t *ph = sf.phdr + i * 38;
+		struct preset *p = &bank->presets[i];
+		p->program = LittleEndian_getW(ph, 20);
+		p->bank = LittleEndian_getW(ph, 22);
+		int bag_first = LittleEndian_getW(ph, 24);
+		int bag_last = LittleEndian_getW(ph + 38, 24);
+		int16_t global[NR_GENS] = {0};
+		global[GEN_KEY_RANGE] = 127 << 8;
+		global[GEN_VEL_RANGE] = 127 << 8;
+		for (int b = bag_first; b < bag_last && b < sf.nr_pbag - 1; b++) {
+			int gen_first = LittleEndian_getW(sf.pbag, b * 4);
+			int gen_last = LittleEndian_getW(sf.pbag, (b + 1) * 4);
+			int16_t gen[NR_GENS];
+			memcpy(gen, global, sizeof(gen));
+			int inst = apply_gens(gen, sf.pgen, gen_first, min(gen_last, sf.nr_pgen), GEN_INSTRUMENT);
+			if (inst >= 0)
+				add_sf2_instrument(bank, p, &sf, gen, inst);
+			else if (b == bag_first)
+				memcpy(global, gen, sizeof(gen));
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * Built-in bank: single-cycle waveforms for the 16 GM instrument families
+ * and a few synthesized drum sounds.
+ */
+
+enum wave { WAVE_SINE, WAVE_TRIANGLE, WAVE_SAW, WAVE_SQUARE, WAVE_ORGAN, WAVE_PIANO, NR_WAVES };
+
+#define WAVE_LEN 256
+#define WAVE_ROOT_KEY 60
+#define WAVE_ROOT_FREQ 261.6256
+#define DRUM_RATE 44100
+
+/* band limits: highest key and number of harmonics of each table */
+static const struct { int key_hi; int harmonics; } wave_bands[] = {
+	{71, 16}, {95, 6}, {107, 3}, {127, 1}
+};
+#define NR_BANDS (sizeof(wave_bands) / sizeof(wave_bands[0]))
+
+static const struct family {
+	enum wave wave;
+	float attack, decay, sustain, release, gain;
+} families[16] = {
+	{WAVE_PIANO,    0.002f, 5.0f, 0.0f, 0.25f, 1.0f},  // Piano
+	{WAVE_TRIANGLE, 0.001f, 2.0f, 0.0f, 0.20f, 1.0f},  // Chromatic Percussion
+	{WAVE_ORGAN,    0.010f, 1.0f, 1.0f, 0.08f, 0.7f},  // Organ
+	{WAVE_PIANO,    0.002f, 3.0f, 0.0f, 0.15f, 1.0f},  // Guitar
+	{WAVE_TRIANGLE, 0.005f, 4.0f, 0.3f, 0.08f, 1.0f},  // Bass
+	{WAVE_SAW,      0.080f, 1.0f, 1.0f, 0.30f, 0.6f},  // Strings
+	{WAVE_SAW,      0.150f, 1.0f, 1.0f, 0.40f, 0.6f},  // Ensemble
+	{WAVE_SAW,      0.040f, 1.0f, 0.8f, 0.15f, 0.6f},  // Brass
+	{WAVE_SQUARE,   0.030f, 1.0f, 0.9f, 0.10f, 0.5f},  // Reed
+	{WAVE_SINE,     0.050f, 1.0f, 1.0f, 0.15f, 1.0f},  // Pipe
+	{WAVE_SQUARE,   0.005f, 1.0f, 1.0f, 0.10f, 0.5f},  // Synth Lead
+	{WAVE_TRIANGLE, 0.300f, 1.0f, 1.0f, 0.80f, 1.0f},  // Synth Pad
+	{WAVE_SAW,      0.200f, 1.0f, 0.8f, 1.00f, 0.6f},  // Synth Effects
+	{WAVE_PIANO,    0.003f, 2.5f, 0.0f, 0.20f, 1.0f},  // Ethnic
+	{WAVE_SINE,     0.001f, 0.8f, 0.0f, 0.10f, 1.0f},  // Percussive
+	{WAVE_SAW,      0.010f, 1.0f, 0.0f, 0.20f, 0.6f},  // Sound Effects
+};
+
+enum drum_sound { DRUM_KICK, DRUM_SNARE, DRUM_TOM, DRUM_NOISE, NR_DRUM_SOUNDS };
+#define DRUM_LEN (DRUM_RATE / 2)
+
+static float harmonic(enum wave w, int n) {
+	switch (w) {
+	case WAVE_SINE:     return n == 1 ? 1.0f : 0.0f;
+	case WAVE_TRIANGLE: return n & 1 ? ((n >> 1) & 1 ? -1.0f : 1.0f) / (n * n) : 0.0f;
+	case WAVE_SAW:      return 1.0f / n;
+	case WAVE_SQUARE:   return n & 1 ? 1.0f / n : 0.0f;
+	case WAVE_ORGAN:
+		switch (n) {
+		case 1: return 1.0f;
+		case 2: return 0.8f;
+		case 3: return 0.6f;
+		case 4: return 0.5f;
+		case 6: return 0.3f;
+		case 8: return 0.25f;
+		default: return 0.0f;
+		}
+	case WAVE_PIANO:    return powf(n, -1.6f);
+	default:            return 0.0f;
+	}
+}
+
+static void generate_wave(int16_t *out, enum wave w, int harmonics) {
+	float buf[WAVE_LEN];
+	float peak = 0.0f;
+	for (int i = 0; i < WAVE_LEN; i++) {
+		float v = 0.0f;
+		for (int n = 1; n <= harmonics; n++)
+			v += harmonic(w, n) * sinf(2.0f * (float)M_PI * n * i / WAVE_LEN);
+		buf[i] = v;
+		peak = max(peak, fabsf(v));
+	}
+	for (int i = 0; i < WAVE_LEN; i++)
+		out[i] = SDL_SwapLE16((int16_t)lrintf(buf[i] / peak * 16000.0f));
+}
+
+static void generate_drum(int16_t *out, enum drum_sound d) {
+	uint32_t seed = 12345;
+	double phase = 0.0;
+	for (int i = 0; i < DRUM_LEN; i++) {
+		float t = (float)i / DRUM_RATE;
+		seed = seed * 1103515245 + 12345;
+		float noise = ((seed >> 16) & 0x7fff) / 16384.0f - 1.0f;
+		float v;
+		switch (d) {
+		case DRUM_KICK:
+			phase += 2.0 * M_PI * (50.0 + 100.0 * exp(-t * 30.0)) / DRUM_RATE;
+			v = sinf(phase) * expf(-t * 8.0f);
+			break;
+		case DRUM_SNARE:
+			phase += 2.0 * M_PI * 180.0 / DRUM_RATE;
+			v = (0.4f * sinf(phase) + 0.6f * noise) * expf(-t * 15.0f);
+			break;
+		case DRUM_TOM:
+			phase += 2.0 * M_PI * (120.0 + 40.0 * exp(-t * 20.0)) / DRUM_RATE;
+			v = sinf(phase) * expf(-t * 6.0f);
+			break;
+		default:
+			v = noise;
+			break;
+		}
+		out[i] = SDL_SwapLE16((int16_t)lrintf(v * 16000.0f));
+	}
+}
+
+static void add_drum_zone(struct preset *p, int key_lo, int key_hi, enum drum_sound d, float decay, int exclusive_class) {
+	struct zone *z = add_zone(p);
+	z->key_lo = key_lo;
+	z->key_hi = key_hi;
+	z->vel_hi = 127;
+	z->start = WAVE_LEN * NR_WAVES * NR_BANDS + d * DRUM_LEN;
+	z->end = z->start + DRUM_LEN - 1;
+	z->loop_start = z->start;
+	z->loop_end = z->end;
+	z->root_key = d == DRUM_TOM ? 45 : key_lo;
+	z->scale_tuning = d == DRUM_TOM ? 50 : 0;
+	z->sample_rate = DRUM_RATE;
+	z->gain = 1.0f;
+	z->attack = 0.001f;
+	z->decay = decay;
+	z->release = 0.05f;
+	z->exclusive_class = exclusive_class;
+}
+
+static void load_builtin(struct soundbank *bank) {
+	bank->pool_len = WAVE_LEN * NR_WAVES * NR_BANDS + DRUM_LEN * NR_DRUM_SOUNDS;
+	bank->pool_buf = malloc(bank->pool_len * sizeof(int16_t));
+	if (!bank->pool_buf)
+		NOMEMERR();
+	for (int w = 0; w < NR_WAVES; w++) {
+		for (int b = 0; b < NR_BANDS; b++)
+			generate_wave(bank->pool_buf + (w * NR_BANDS + b) * WAVE_LEN, w, wave_bands[b].harmonics);
+	}
+	for (int d = 0; d < NR_DRUM_SOUNDS; d++)
+		generate_drum(bank->pool_buf + WAVE_LEN * NR_WAVES * NR_BANDS + d * DRUM_LEN, d);
+	bank->pool = bank->pool_buf;
+
+	bank->nr_presets = 129;
+	bank->presets = calloc(bank->nr_presets, sizeof(struct preset));
+	if (!bank->presets)
+		NOMEMERR();
+	for (int prog = 0; prog < 128; prog++) {
+		struct preset *p = &bank->presets[prog];
+		p->program = prog;
+		const struct family *f = &families[prog / 8];
+		int key_lo = 0;
+		for (int b = 0; b < NR_BANDS; b++) {
+			struct zone *z = add_zone(p);
+			z->key_lo = key_lo;
+			z->key_hi = wave_bands[b].key_hi;
+			z->vel_hi = 127;
+			z->start = (f->wave * NR_BANDS + b) * WAVE_LEN;
+			z->end = z->start + WAVE_LEN;
+			z->loop_start = z->start;
+			z->loop_end = z->end;
+			z->loop_mode = 1;
+			z->root_key = WAVE_ROOT_KEY;
+			z->scale_tuning = 100;
+			z->sample_rate = lrint(WAVE_ROOT_FREQ * WAVE_LEN);
+			z->gain = f->gain;
+			z->attack = f->attack;
+			z->decay = f->decay;
+			z->sustain = f->sustain;
+			z->release = f->release;
+			key_lo = wave_bands[b].key_hi + 1;
+		}
+	}
+	struct preset *drums = &bank->presets[128];
+	drums->bank = DRUM_BANK;
+	add_drum_zone(drums, 35, 36, DRUM_KICK, 0.5f, 0);
+	add_drum_zone(drums, 37, 37, DRUM_NOISE, 0.05f, 0);  // side stick
+	add_drum_zone(drums, 38, 40, DRUM_SNARE, 0.4f, 0);
+	add_drum_zone(drums, 41, 41, DRUM_TOM, 0.8f, 0);
+	add_drum_zone(drums, 42, 42, DRUM_NOISE, 0.08f, 1);  // closed hi-hat
+	add_drum_zone(drums, 43, 43, DRUM_TOM, 0.8f, 0);
+	add_drum_zone(drums, 44, 44, DRUM_NOISE, 0.08f, 1);  // pedal hi-hat
+	add_drum_zone(drums, 45, 45, DRUM_TOM, 0.8f, 0);
+	add_drum_zone(drums, 46, 46, DRUM_NOISE, 0.5f, 1);   // open hi-hat
+	add_drum_zone(drums, 47, 48, DRUM_TOM, 0.8f, 0);
+	add_drum_zone(drums, 49, 49, DRUM_NOISE, 2.0f, 0);   // crash
+	add_drum_zone(drums, 50, 50, DRUM_TOM, 0.8f, 0);
+	add_drum_zone(drums, 51, 59, DRUM_NOISE, 1.5f, 0);   // ride, cymbals
+	add_drum_zone(drums, 60, 81, DRUM_NOISE, 0.15f, 0);  // latin percussion
+	bank->id = 0x5b1d0001;
+}
+
+struct soundbank *soundbank_load(const char *path) {
+	struct soundbank *bank = calloc(1, sizeof(struct soundbank));
+	if (!bank)
+		NOMEMERR();
+	if (!path) {
+		load_builtin(bank);
+		return bank;
+	}
+
+	bank->file = map_file(path);
+	if (!bank->file) {
+		free(bank);
+		return NULL;
+	}
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		unmap_file(bank->file);
+		free(bank);
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	size_t size = ftell(fp);
+	fclose(fp);
+
+	if (!load_sf2(bank, bank->file->addr, size)) {
+		WARNING("%s: not a SoundFont 2 file", path);
+		soundbank_free(bank);
+		return NULL;
+	}
+	NOTICE("SoundFont %s: %d presets", path, bank->nr_presets);
+	return bank;
+}
+
+void soundbank_free(struct soundbank *bank) {
+	for (int i = 0; i < bank->nr_presets; i++)
+		free(bank->presets[i].zones);
+	free(bank->presets);
+	free(bank->pool_buf);
+	if (bank->file)
+		unmap_file(bank->file);
+	free(bank);
+}
+
+uint32_t soundbank_id(struct soundbank *bank) {
+	return bank->id;
+}
+
+/*
+ * Synthesizer
+ */
+
+static void reset_controllers(struct channel *ch) {
+	ch->expression = 127;
+	ch->sustain = 0;
+	ch->bend = 0;
+	ch->rpn_msb = ch->rpn_lsb = 127;
+}
+
+static void set_program(struct midisynth *s, int c) {
+	struct channel *ch = &s->channels[c];
+	int bank = c == DRUM_CHANNEL ? DRUM_BANK : ch->bank;
+	ch->preset = find_preset(s->bank, bank, ch->program);
+	if (!ch->preset)
+		ch->preset = find_preset(s->bank, bank, 0);
+	if (!ch->preset && bank != DRUM_BANK)
+		ch->preset = find_preset(s->bank, 0, ch->program);
+}
+
+struct midisynth *midisynth_new(struct soundbank *bank, int rate) {
+	struct midisynth *s = calloc(1, sizeof(struct midisynth));
+	if (!s)
+		NOMEMERR();
+	s->bank = bank;
+	s->rate = rate;
+	midisynth_reset(s);
+	return s;
+}
+
+void midisynth_free(struct midisynth *s) {
+	free(s);
+}
+
+void midisynth_reset(struct midisynth *s) {
+	for (int i = 0; i < MAX_VOICES; i++)
+		s->voices[i].active = FALSE;
+	for (int c = 0; c < NR_CHANNELS; c++) {
+		struct channel *ch = &s->channels[c];
+		ch->program = 0;
+		ch->bank = 0;
+		ch->volume = 100;
+		ch->pan = 64;
+		ch->bend_range = 200;
+		reset_controllers(ch);
+		set_program(s, c);
+	}
+}
+
+static void update_gain(struct midisynth *s, struct voice *v) {
+	const struct channel *ch = &s->channels[v->channel];
+	float vol = (ch->volume / 127.0f) * (ch->expression / 127.0f);
+	float gain = v->zone->gain * v->vel_gain * vol * vol;
+	float pan = v->zone->pan + (ch->pan - 64) / 64.0f;
+	pan = max(-1.0f, min(1.0f, pan));
+	float angle = (pan + 1.0f) * (float)M_PI / 4.0f;
+	v->gain_l = gain * cosf(angle);
+	v->gain_r = gain * sinf(angle);
+}
+
+static void update_pitch(struct midisynth *s, struct voice *v) {
+	const struct channel *ch = &s->channels[v->channel];
+	v->inc = v->base_inc * pow(2.0, ch->bend * ch->bend_range / (8192.0 * 1200.0));
+}
+
+static float decay_multiplier(float sec, int rate) {
+	// Time constant for a 96dB drop in `sec` seconds.
+	return expf(logf(10.0f) * -4.8f / max(sec * rate, 1.0f));
+}
+
+static void release_voice(struct midisynth *s, struct voice *v) {
+	v->released = TRUE;
+	v->sustained = FALSE;
+	v->stage = ENV_RELEASE;
+}
+
+static struct voice *alloc_voice(struct midisynth *s) {
+	struct voice *best = NULL;
+	for (int i = 0; i < MAX_VOICES; i++) {
+		struct voice *v = &s->voices[i];
+		if (!v->active)
+			return v;
+		// Steal the quietest voice, preferring released ones.
+		if (!best || (v->released && !best->released) ||
+			(v->released == best->released && v->level < best->level))
+			best = v;
+	}
+	return best;
+}
+
+static void note_on(struct midisynth *s, int c, int key, int vel) {
+	const struct preset *p = s->channels[c].preset;
+	if (!p)
+		return;
+	for (int i = 0; i < p->nr_zones; i++) {
+		const struct zone *z = &p->zones[i];
+		if (key < z->key_lo || key > z->key_hi || vel < z->vel_lo || vel > z->vel_hi)
+			continue;
+		if (z->exclusive_class) {
+			for (int j = 0; j < MAX_VOICES; j++) {
+				struct voice *o = &s->voices[j];
+				if (o->active && o->channel == c && o->zone->exclusive_class == z->exclusive_class) {
+					release_voice(s, o);
+					o->release_mul = decay_multiplier(0.005f, s->rate);
+				}
+			}
+		}
+		struct voice *v = alloc_voice(s);
+		memset(v, 0, sizeof(struct voice));
+		v->active = TRUE;
+		v->channel = c;
+		v->key = key;
+		v->zone = z;
+		v->pos = z->start;
+		v->base_inc = pow(2.0, ((key - z->root_key) * z->scale_tuning + z->tune) / 1200.0) * z->sample_rate / s->rate;
+		v->vel_gain = (vel / 127.0f) * (vel / 127.0f);
+		v->stage = ENV_DELAY;
+		v->stage_left = z->delay * s->rate;
+		v->attack_step = 1.0f / max(z->attack * s->rate, 1.0f);
+		v->decay_mul = decay_multiplier(z->decay, s->rate);
+		v->release_mul = decay_multiplier(z->release, s->rate);
+		update_gain(s, v);
+		update_pitch(s, v);
+	}
+}
+
+static void note_off(struct midisynth *s, int c, int key) {
+	if (c == DRUM_CHANNEL)
+		return;  // drum sounds play to the end
+	for (int i = 0; i < MAX_VOICES; i++) {
+		struct voice *v = &s->voices[i];
+		if (!v->active || v->channel != c || v->key != key || v->released)
+			continue;
+		if (s->channels[c].sustain >= 64)
+			v->sustained = TRUE;
+		else
+			release_voice(s, v);
+	}
+}
+
+void midisynth_all_notes_off(struct midisynth *s) {
+	for (int i = 0; i < MAX_VOICES; i++) {
+		if (s->voices[i].active)
+			release_voice(s, &s->voices[i]);
+	}
+}
+
+static void control_change(struct midisynth *s, int c, int cc, int val) {
+	struct channel *ch = &s->channels[c];
+	switch (cc) {
+	case 0:  // bank select
+		ch->bank = val;
+		return;
+	case 6:  // data entry
+		if (ch->rpn_msb == 0 && ch->rpn_lsb == 0)
+			ch->bend_range = val * 100 + ch->bend_range % 100;
+		return;
+	case 38:  // data entry LSB
+		if (ch->rpn_msb == 0 && ch->rpn_lsb == 0)
+			ch->bend_range = ch->bend_range / 100 * 100 + val;
+		return;
+	case 7:
+		ch->volume = val;
+		break;
+	case 10:
+		ch->pan = val;
+		break;
+	case 11:
+		ch->expression = val;
+		break;
+	case 64:
+		ch->sustain = val;
+		if (val < 64) {
+			for (int i = 0; i < MAX_VOICES; i++) {
+				struct voice *v = &s->voices[i];
+				if (v->active && v->channel == c && v->sustained)
+					release_voice(s, v);
+			}
+		}
+		return;
+	case 100:
+		ch->rpn_lsb = val;
+		return;
+	case 101:
+		ch->rpn_msb = val;
+		return;
+	case 120:  // all sound off
+		for (int i = 0; i < MAX_VOICES; i++) {
+			if (s->voices[i].channel == c)
+				s->voices[i].active = FALSE;
+		}
+		return;
+	case 121:
+		reset_controllers(ch);
+		break;
+	case 123:  // all notes off
+		for (int i = 0; i < MAX_VOICES; i++) {
+			struct voice *v = &s->voices[i];
+			if (v->active && v->channel == c)
+				release_voice(s, v);
+		}
+		return;
+	default:
+		return;
+	}
+	for (int i = 0; i < MAX_VOICES; i++) {
+		struct voice *v = &s->voices[i];
+		if (v->active && v->channel == c) {
+			update_gain(s, v);
+			update_pitch(s, v);
+		}
+	}
+}
+
+void midisynth_event(struct midisynth *s, const uint8_t *data, int n) {
+	if (n < 2)
+		return;
+	int c = data[0] & 0x0f;
+	switch (data[0] & 0xf0) {
+	case 0x80:
+		if (n >= 3)
+			note_off(s, c, data[1]);
+		break;
+	case 0x90:
+		if (n >= 3) {
+			if (data[2])
+				note_on(s, c, data[1], data[2]);
+			else
+				note_off(s, c, data[1]);
+		}
+		break;
+	case 0xb0:
+		if (n >= 3)
+			control_change(s, c, data[1], data[2]);
+		break;
+	case 0xc0:
+		s->channels[c].program = data[1];
+		set_program(s, c);
+		break;
+	case 0xe0:
+		if (n >= 3) {
+			s->channels[c].bend = (data[1] | data[2] << 7) - 8192;
+			for (int i = 0; i < MAX_VOICES; i++) {
+				struct voice *v = &s->voices[i];
+				if (v->active && v->channel == c)
+					update_pitch(s, v);
+			}
+		}
+		break;
+	}
+}
+
+boolean midisynth_is_silent(struct midisynth *s) {
+	for (int i = 0; i < MAX_VOICES; i++) {
+		if (s->voices[i].active)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static inline float pool_sample(const int16_t *pool, uint32_t i) {
+	return (int16_t)SDL_SwapLE16(pool[i]);
+}
+
+static void render_voice(struct midisynth *s, struct voice *v, float *mix, int frames) {
+	const struct zone *z = v->zone;
+	const int16_t *pool = s->bank->pool;
+	for (int i = 0; i < frames; i++) {
+		switch (v->stage) {
+		case ENV_DELAY:
+			if (v->stage_left-- > 0)
+				continue;
+			v->stage = ENV_ATTACK;
+			// fall through
+		case ENV_ATTACK:
+			v->level += v->attack_step;
+			if (v->level >= 1.0f) {
+				v->level = 1.0f;
+				v->stage = ENV_HOLD;
+				v->stage_left = z->hold * s->rate;
+			}
+			break;
+		case ENV_HOLD:
+			if (v->stage_left-- <= 0)
+				v->stage = ENV_DECAY;
+			break;
+		case ENV_DECAY:
+			v->level *= v->decay_mul;
+			if (v->level <= z->sustain) {
+				v->level = z->sustain;
+				v->stage = ENV_SUSTAIN;
+			}
+			if (v->level < SILENCE) {
+				v->active = FALSE;
+				return;
+			}
+			break;
+		case ENV_SUSTAIN:
+			break;
+		case ENV_RELEASE:
+			v->level *= v->release_mul;
+			if (v->level < SILENCE) {
+				v->active = FALSE;
+				return;
+			}
+			break;
+		}
+
+		boolean looping = z->loop_mode == 1 || (z->loop_mode == 3 && !v->released);
+		uint32_t idx = (uint32_t)v->pos;
+		float frac = v->pos - idx;
+		uint32_t next = idx + 1;
+		if (looping && next >= z->loop_end)
+			next = z->loop_start;
+		float smp = pool_sample(pool, idx);
+		smp += (pool_sample(pool, next) - smp) * frac;
+		smp *= v->level;
+		mix[i * 2] += smp * v->gain_l;
+		mix[i * 2 + 1] += smp * v->gain_r;
+
+		v->pos += v->inc;
+		if (looping) {
+			while (v->pos >= z->loop_end)
+				v->pos -= z->loop_end - z->loop_start;
+		} else if (v->pos >= z->end) {
+			v->active = FALSE;
+			return;
+		}
+	}
+}
+
+void midisynth_render(struct midisynth *s, int16_t *out, int frames) {
+	while (frames > 0) {
+		int n = min(frames, BLOCK_FRAMES);
+		memset(s->mix, 0, n * 2 * sizeof(float));
+		for (int i = 0; i < MAX_VOICES; i++) {
+			if (s->voices[i].active)
+				render_voice(s, &s->voices[i], s->mix, n);
+		}
+		for (int i = 0; i < n * 2; i++) {
+			float x = s->mix[i] * MASTER_GAIN;
+			out[i] = x >= 32767.0f ? 32767 : x <= -32768.0f ? -32768 : (int16_t)x;
+		}
+		out += n * 2;
+		frames -= n;
+	}
+}
+
+uint32_t midisynth_state_hash(struct midisynth *s) {
+	uint32_t h = 2166136261u;
+	for (int c = 0; c < NR_CHANNELS; c++) {
+		const struct channel *ch = &s->channels[c];
+		int vals[] = {
+			ch->program, ch->bank, ch->volume, ch->expression, ch->pan,
+			ch->sustain, ch->bend, ch->bend_range, ch->rpn_msb, ch->rpn_lsb
+		};
+		for (int i = 0; i < sizeof(vals) / sizeof(vals[0]); i++)
+			h = (h ^ (uint32_t)vals[i]) * 16777619u;
+	}
+	return h;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __MIDISYNTH_H__
+#define __MIDISYNTH_H__
+
+#include <stdint.h>
+#include "portab.h"
+
+/*
+ * Software wavetable synthesizer for MIDI playback. Instruments come from
+ * a SoundFont 2 file, or from a small built-in bank if none is given.
+ */
+
+struct soundbank;
+struct midisynth;
+
+struct soundbank *soundbank_load(const char *path);  // NULL: built-in bank
+void soundbank_free(struct soundbank *bank);
+uint32_t soundbank_id(struct soundbank *bank);  // identifies the bank contents
+
+struct midisynth *midisynth_new(struct soundbank *bank, int rate);
+void midisynth_free(struct midisynth *s);
+void midisynth_reset(struct midisynth *s);
+void midisynth_event(struct midisynth *s, const uint8_t *data, int n);
+void midisynth_all_notes_off(struct midisynth *s);
+boolean midisynth_is_silent(struct midisynth *s);
+// Renders interleaved 16-bit stereo samples.
+void midisynth_render(struct midisynth *s, int16_t *out, int frames);
+// Hash of the channel state, used to detect loops in the sequence.
+uint32_t midisynth_state_hash(struct midisynth *s);
+
+#endif /* __MIDISYNTH_H__ */
@@ -18,6 +18,7 @@
  */
 
 #include <stdlib.h>
+#include <SDL_timer.h>
 #include "msgqueue.h"
 
 struct msgq_elem {
@@ -93,3 +94,87 @@ void *msgq_dequeue_timeout(struct msgq *q, uint32_t timeout_ms) {
 	free(e);
 	return msg;
 }
+
+struct spscq *spscq_new(unsigned capacity) {
+	struct spscq *q = calloc(1, sizeof(struct spscq));
+	q->capacity = 1;
+	while (q->capacity < capacity)
+		q->capacity <<= 1;
+	q->buf = calloc(q->capacity, sizeof(void *));
+	q->mutex = SDL_CreateMutex();
+	q->cond = SDL_CreateCond();
+	return q;
+}
+
+void spscq_free(struct spscq *q) {
+	SDL_DestroyMutex(q->mutex);
+	SDL_DestroyCond(q->cond);
+	free(q->buf);
+	free(q);
+}
+
+// Wake up the other side if it is (about to go) sleeping. The flag is set
+// before the sleeper re-checks the indices, and the indices are updated
+// before the flag is checked here, so a wakeup cannot be lost.
+static void wake(struct spscq *q, SDL_atomic_t *waiting) {
+	if (!SDL_AtomicGet(waiting))
+		return;
+	SDL_LockMutex(q->mutex);
+	SDL_CondBroadcast(q->cond);
+	SDL_UnlockMutex(q->mutex);
+}
+
+void spscq_enqueue(struct spscq *q, void *msg) {
+	unsigned tail = SDL_AtomicGet(&q->tail);
+	if (tail - (unsigned)SDL_AtomicGet(&q->head) == q->capacity) {
+		// Full; wait for the consumer.
+		SDL_LockMutex(q->mutex);
+		SDL_AtomicSet(&q->producer_waiting, 1);
+		while (tail - (unsigned)SDL_AtomicGet(&q->head) == q->capacity)
+			SDL_CondWait(q->cond, q->mutex);
+		SDL_AtomicSet(&q->producer_waiting, 0);
+		SDL_UnlockMutex(q->mutex);
+	}
+	q->buf[tail & (q->capacity - 1)] = msg;
+	SDL_AtomicSet(&q->tail, tail + 1);
+	wake(q, &q->consumer_waiting);
+}
+
+static void *take(struct spscq *q, unsigned head) {
+	void *msg = q->buf[head & (q->capacity - 1)];
+	SDL_AtomicSet(&q->head, head + 1);
+	wake(q, &q->producer_waiting);
+	return msg;
+}
+
+void *spscq_dequeue(struct spscq *q) {
+	unsigned head = SDL_AtomicGet(&q->head);
+	if (head == (unsigned)SDL_AtomicGet(&q->tail)) {
+		SDL_LockMutex(q->mutex);
+		SDL_AtomicSet(&q->consumer_waiting, 1);
+		while (head == (unsigned)SDL_AtomicGet(&q->tail))
+			SDL_CondWait(q->cond, q->mutex);
+		SDL_AtomicSet(&q->consumer_waiting, 0);
+		SDL_UnlockMutex(q->mutex);
+	}
+	return take(q, head);
+}
+
+void *spscq_dequeue_timeout(struct spscq *q, uint32_t timeout_ms) {
+	unsigned head = SDL_AtomicGet(&q->head);
+	if (head == (unsigned)SDL_AtomicGet(&q->tail)) {
+		uint32_t deadline = SDL_GetTicks() + timeout_ms;
+		SDL_LockMutex(q->mutex);
+		SDL_AtomicSet(&q->consumer_waiting, 1);
+		while (head == (unsigned)SDL_AtomicGet(&q->tail)) {
+			int32_t remaining = (int32_t)(deadline - SDL_GetTicks());
+			if (remaining <= 0 || SDL_CondWaitTimeout(q->cond, q->mutex, remaining) == SDL_MUTEX_TIMEDOUT)
+				break;
+		}
+		SDL_AtomicSet(&q->consumer_waiting, 0);
+		SDL_UnlockMutex(q->mutex);
+		if (head == (unsigned)SDL_AtomicGet(&q->tail))
+			return NULL;  // timed out
+	}
+	return take(q, head);
+}
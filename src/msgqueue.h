@@ -21,6 +21,7 @@
 #define __MSGQUEUE_H__
 
 #include <stdbool.h>
+#include <SDL_atomic.h>
 #include <SDL_mutex.h>
 
 struct msgq_elem;
@@ -42,4 +43,28 @@ void msgq_enqueue(struct msgq *q, void *msg);
 void *msgq_dequeue(struct msgq *q);
 void *msgq_dequeue_timeout(struct msgq *q, uint32_t timeout_ms);
 
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. The mutex and condition variable are only used when one side has
+// to sleep (consumer on an empty queue, producer on a full queue).
+struct spscq {
+	void **buf;
+	unsigned capacity;  // power of 2
+	SDL_atomic_t head;  // next slot to read, written by the consumer
+	SDL_atomic_t tail;  // next slot to write, written by the producer
+	SDL_atomic_t consumer_waiting;
+	SDL_atomic_t producer_waiting;
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+};
+
+static inline bool spscq_isempty(struct spscq *q) {
+	return SDL_AtomicGet(&q->head) == SDL_AtomicGet(&q->tail);
+}
+
+struct spscq *spscq_new(unsigned capacity);
+void spscq_free(struct spscq *q);
+void spscq_enqueue(struct spscq *q, void *msg);
+void *spscq_dequeue(struct spscq *q);
+void *spscq_dequeue_timeout(struct spscq *q, uint32_t timeout_ms);
+
 #endif // __MSGQUEUE_H__
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+#include "msgqueue.h"
+#include "unittest.h"
+
+#define NR_MESSAGES 20000
+#define NR_BENCHMARK_MESSAGES 200000
+
+struct producer_arg {
+	void *queue;
+	int count;
+};
+
+static int spsc_producer(void *data) {
+	struct producer_arg *arg = data;
+	for (intptr_t i = 1; i <= arg->count; i++)
+		spscq_enqueue(arg->queue, (void *)i);
+	return 0;
+}
+
+static int msgq_producer(void *data) {
+	struct producer_arg *arg = data;
+	for (intptr_t i = 1; i <= arg->count; i++)
+		msgq_enqueue(arg->queue, (void *)i);
+	return 0;
+}
+
+static void spscq_basic_test(void) {
+	struct spscq *q = spscq_new(3);
+	ASSERT_EQUAL(q->capacity, 4);
+	ASSERT_TRUE(spscq_isempty(q));
+	for (intptr_t i = 1; i <= 4; i++)
+		spscq_enqueue(q, (void *)i);
+	ASSERT_FALSE(spscq_isempty(q));
+	for (intptr_t i = 1; i <= 4; i++)
+		ASSERT_EQUAL_PTR(spscq_dequeue(q), (void *)i);
+	ASSERT_TRUE(spscq_isempty(q));
+	ASSERT_NULL(spscq_dequeue_timeout(q, 10));
+	spscq_enqueue(q, (void *)5);
+	ASSERT_EQUAL_PTR(spscq_dequeue_timeout(q, 10), (void *)5);
+	spscq_free(q);
+}
+
+// The small capacity makes both sides block frequently.
+static void spscq_thread_test(void) {
+	struct spscq *q = spscq_new(8);
+	struct producer_arg arg = { q, NR_MESSAGES };
+	SDL_Thread *t = SDL_CreateThread(spsc_producer, "producer", &arg);
+	for (intptr_t i = 1; i <= NR_MESSAGES; i++) {
+		void *msg = i % 3 ? spscq_dequeue(q) : spscq_dequeue_timeout(q, 1000);
+		if (msg != (void *)i)
+			ASSERT_EQUAL_PTR(msg, (void *)i);
+	}
+	SDL_WaitThread(t, NULL);
+	ASSERT_TRUE(spscq_isempty(q));
+	spscq_free(q);
+}
+
+// Throughput of the two queues with one producer and one consumer thread.
+// Run with "src_tests --benchmark".
+void msgqueue_benchmark(void) {
+	double freq = SDL_GetPerformanceFrequency();
+
+	struct msgq *mq = msgq_new();
+	struct producer_arg arg = { mq, NR_BENCHMARK_MESSAGES };
+	uint64_t start = SDL_GetPerformanceCounter();
+	SDL_Thread *t = SDL_CreateThread(msgq_producer, "producer", &arg);
+	for (int i = 0; i < NR_BENCHMARK_MESSAGES; i++)
+		msgq_dequeue(mq);
+	SDL_WaitThread(t, NULL);
+	double msgq_sec = (SDL_GetPerformanceCounter() - start) / freq;
+	msgq_free(mq);
+
+	struct spscq *sq = spscq_new(256);
+	arg.queue = sq;
+	start = SDL_GetPerformanceCounter();
+	t = SDL_CreateThread(spsc_producer, "producer", &arg);
+	for (int i = 0; i < NR_BENCHMARK_MESSAGES; i++)
+		spscq_dequeue(sq);
+	SDL_WaitThread(t, NULL);
+	double spscq_sec = (SDL_GetPerformanceCounter() - start) / freq;
+	spscq_free(sq);
+
+	printf("msgqueue benchmark: msgq %.0f msgs/sec, spscq %.0f msgs/sec\n",
+		   NR_BENCHMARK_MESSAGES / msgq_sec, NR_BENCHMARK_MESSAGES / spscq_sec);
+}
+
+void msgqueue_test(void) {
+	spscq_basic_test();
+	spscq_thread_test();
+}
@@ -27,8 +27,17 @@
 
 struct _musprvdat musprv;
 
+static boolean disabled;
+
+/* 音源を一切使わない (headless 実行用)。mus_init() より前に呼ぶこと */
+void mus_disable(void) {
+	disabled = TRUE;
+}
+
 int mus_init(int audio_buffer_size) {
 	musbgm_init(DRIFILE_BGM, 0);
+	if (disabled)
+		return OK;
 	muscd_init();
 	musmidi_init();
 	prv.pcm_valid = muspcm_init(audio_buffer_size) == OK;
@@ -283,6 +292,17 @@ int mus_wav_load_data(int ch, uint8_t *buf, uint32_t len) {
 	return muspcm_load_data(ch + 1, buf, len);
 }
 
+/*
+ * wave file をバックグラウンドでデコードしておく
+ * (後で mus_wav_load / mus_pcm_start などでロードする際に待たずに済む)
+ *   num: ファイル番号 (1-65535)
+ */
+int mus_wav_prefetch(int num) {
+	if (!prv.pcm_valid) return NG;
+
+	return muspcm_prefetch(num);
+}
+
 /*
  * 指定のチャンネルから wave file を破棄
  *   ch : channel
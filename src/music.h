@@ -37,6 +37,7 @@ enum MixDevice {
 };
 
 /* init and exit */
+extern void mus_disable(void);
 extern int mus_init(int audio_buffer_size);
 extern void mus_exit(void);
 extern void mus_reset(void);
@@ -70,6 +71,7 @@ extern bool mus_mixer_set_level(int device, int level);
 /* wav (command2F) / ShSound related function */
 extern int mus_wav_load(int ch, int num);
 extern int mus_wav_load_data(int ch, uint8_t *buf, uint32_t len);
+extern int mus_wav_prefetch(int num);
 extern int mus_wav_unload(int ch);
 extern int mus_wav_play(int ch, int loop);
 extern int mus_wav_stop(int ch);
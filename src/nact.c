@@ -41,6 +41,7 @@
 #include "input.h"
 #include "menu.h"
 #include "hankaku.h"
+#include "profiler.h"
 
 /*
 
@@ -118,7 +119,11 @@ void nact_main() {
 		if (dbg_trapped())
 			dbg_main(0);
 
+		if (prof_active)
+			prof_begin_command();
 		exec_command();
+		if (prof_active)
+			prof_end_command();
 		nact->cmd_count++;
 
 		if (++cnt >= 10000 || nact->wait_vsync || nact->popupmenu_opened || dbg_trapped()) {
@@ -128,6 +133,8 @@ void nact_main() {
 			nact->frame_count++;
 			nact->wait_vsync = FALSE;
 			cnt = 0;
+			if (prof_active)
+				prof_vsync();
 		}
 	}
 }
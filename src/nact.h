@@ -54,9 +54,16 @@ int getCaliValue(void);
 int *getCaliVariable(void);
 bool getCaliArray(struct VarRef *ref);
 int *getVariable(void);
+int interpretCaliValue(void);
+int cali_decodeValue(int addr, int *end);
+int cali_decodeVariable(int addr, int *end);
+int cali_value(int handle);
+int *cali_variable(int handle);
+void cali_reset(void);
 
 // cmd_check.c
 extern void exec_command(void);
+void cmd_check_reset(void);
 
 // cmdv.c
 void va_animation(void);
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <SDL.h>
 #include <SDL_mixer.h>
 
 #include "portab.h"
@@ -38,6 +39,8 @@
 #include "nact.h"
 #include "LittleEndian.h"
 #include "mmap.h"
+#include "cache.h"
+#include "msgqueue.h"
 
 #define SAMPLE_RATE 44100
 #define BYTES_PER_SAMPLE 4
@@ -47,11 +50,43 @@
 // 1-128: wavXXX 用
 #define PCM_SLOTS (128 + 1)
 
+// デコード済みの .WAV|.OGG データ。cache に保持され、スロットからは
+// Mix_QuickLoad_RAW() で作ったチャンクを通して参照される。
+struct pcm_data {
+	Mix_Chunk *chunk;
+	int refcnt;  // このデータを参照しているスロットの数
+};
+
 static struct {
 	Mix_Chunk* chunk;
+	struct pcm_data *data;  // chunk が cache 上のデータを参照している場合
 	uint32_t start_time;
 } slots[PCM_SLOTS];
 
+static cacher *pcm_cache;    // key: DRIファイル番号
+static cacher *mixlr_cache;  // key: noL << 16 | noR
+
+/*
+ * バックグラウンドデコード
+ *
+ * muspcm_prefetch() で要求された番号を worker thread がデコードする。
+ * 結果を cache に登録するのはメインスレッドだけである。
+ */
+#define MAX_PENDING 16
+
+struct decode_job {
+	int no;
+	Mix_Chunk *chunk;
+};
+
+static struct spscq *requests;  // main -> worker
+static struct spscq *results;   // worker -> main
+static SDL_Thread *worker_thread;
+
+// 要求済みでまだ結果を受け取っていない番号。メインスレッドのみが触る。
+static int pending[MAX_PENDING];
+static int nr_pending;
+
 static int load_wai();
 static mmap_t *wai_map;
 
@@ -80,6 +115,77 @@ static Mix_Chunk *load_asset(int no) {
 	return chunk;
 }
 
+static void pcm_data_free(void *data) {
+	struct pcm_data *d = data;
+	Mix_FreeChunk(d->chunk);
+	free(d);
+}
+
+static struct pcm_data *cache_chunk(cacher *cache, int key, Mix_Chunk *chunk) {
+	struct pcm_data *d = calloc(1, sizeof(struct pcm_data));
+	if (!d)
+		NOMEMERR();
+	d->chunk = chunk;
+	cache_insert(cache, key, d, sizeof(struct pcm_data) + chunk->alen, &d->refcnt);
+	return d;
+}
+
+static int decode_worker(void *unused) {
+	for (;;) {
+		struct decode_job *job = spscq_dequeue(requests);
+		if (job->no < 0) {  // 終了要求
+			free(job);
+			return 0;
+		}
+		job->chunk = load_asset(job->no);
+		spscq_enqueue(results, job);
+	}
+}
+
+static int find_pending(int no) {
+	for (int i = 0; i < nr_pending; i++) {
+		if (pending[i] == no)
+			return i;
+	}
+	return -1;
+}
+
+static void receive_result(struct decode_job *job) {
+	int i = find_pending(job->no);
+	assert(i >= 0);
+	pending[i] = pending[--nr_pending];
+	if (job->chunk)
+		cache_chunk(pcm_cache, job->no, job->chunk);
+	free(job);
+}
+
+static void poll_results(void) {
+	while (!spscq_isempty(results))
+		receive_result(spscq_dequeue(results));
+}
+
+/**
+ * 指定の番号のデコード済みデータを cache から得る。
+ * cache に無ければデコードする (バックグラウンドでデコード中ならその完了を待つ)。
+ * @param no: DRIファイル番号
+ */
+static struct pcm_data *get_asset(int no) {
+	if (worker_thread) {
+		poll_results();
+		while (find_pending(no) >= 0)
+			receive_result(spscq_dequeue(results));
+	}
+
+	struct pcm_data *d = cache_lookup(pcm_cache, no);
+	if (d)
+		return d;
+
+	Mix_Chunk *chunk = load_asset(no);
+	if (!chunk)
+		return NULL;
+	return cache_chunk(pcm_cache, no, chunk);
+}
+
 static int load_chunk(int slot, Mix_Chunk *chunk) {
 	if ((unsigned)slot >= PCM_SLOTS)
 		return NG;
@@ -91,47 +197,64 @@ static int load_chunk(int slot, Mix_Chunk *chunk) {
 	return OK;
 }
 
+// cache 上のデータをコピーせずにスロットに割り当てる
+static int load_data(int slot, struct pcm_data *d) {
+	Mix_Chunk *chunk = Mix_QuickLoad_RAW(d->chunk->abuf, d->chunk->alen);
+	if (!chunk)
+		return NG;
+	if (load_chunk(slot, chunk) != OK) {
+		Mix_FreeChunk(chunk);
+		return NG;
+	}
+	slots[slot].data = d;
+	d->refcnt++;
+	return OK;
+}
+
 /**
  * noL と noR の .WAV をロードし、左右合成
  *
  * @param noL: 左の WAV ファイルの番号
  * @param noR: 右の WAV ファイルの番号
- * @return   : 合成後の Mix_Chunk
+ * @return   : 合成後のデータ
  */
-static Mix_Chunk *pcm_mixlr(int noL, int noR) {
-	Mix_Chunk *chunkL = load_asset(noL);
-	Mix_Chunk *chunkR = load_asset(noR);
-	if (chunkL == NULL || chunkR == NULL) {
-		if (chunkL)
-			Mix_FreeChunk(chunkL);
-		if (chunkR)
-			Mix_FreeChunk(chunkR);
+static struct pcm_data *pcm_mixlr(int noL, int noR) {
+	int key = (int)((unsigned)noL << 16 | (noR & 0xffff));
+	struct pcm_data *d = cache_lookup(mixlr_cache, key);
+	if (d)
+		return d;
+
+	struct pcm_data *dataL = get_asset(noL);
+	if (!dataL)
+		return NULL;
+	dataL->refcnt++;  // noR のロードで追い出されないように
+	struct pcm_data *dataR = get_asset(noR);
+	dataL->refcnt--;
+	if (!dataR)
 		return NULL;
-	}
 
+	Mix_Chunk *chunkL = dataL->chunk;
+	Mix_Chunk *chunkR = dataR->chunk;
+	int nL = chunkL->alen / 4;
+	int nR = chunkR->alen / 4;
+	int n = max(nL, nR);
+	short *buf = SDL_malloc(n * 4);
+	if (!buf)
+		NOMEMERR();
 	short *lbuf = (short*)chunkL->abuf;
 	short *rbuf = (short*)chunkR->abuf;
-	if (chunkL->alen >= chunkR->alen) {
-		int i;
-		for (i = 0; i < chunkR->alen / 4; i++) {
-			lbuf[i * 2 + 1] = rbuf[i * 2 + 1];
-		}
-		for (; i < chunkL->alen / 4; i++) {
-			lbuf[i * 2 + 1] = 0;
-		}
-		Mix_FreeChunk(chunkR);
-		return chunkL;
-	} else {
-		int i;
-		for (i = 0; i < chunkL->alen / 4; i++) {
-			rbuf[i * 2] = lbuf[i * 2];
-		}
-		for (; i < chunkR->alen / 4; i++) {
-			rbuf[i * 2] = 0;
-		}
-		Mix_FreeChunk(chunkL);
-		return chunkR;
+	for (int i = 0; i < n; i++) {
+		buf[i * 2]     = i < nL ? lbuf[i * 2] : 0;
+		buf[i * 2 + 1] = i < nR ? rbuf[i * 2 + 1] : 0;
 	}
+
+	Mix_Chunk *chunk = Mix_QuickLoad_RAW((Uint8 *)buf, n * 4);
+	if (!chunk) {
+		SDL_free(buf);
+		return NULL;
+	}
+	chunk->allocated = 1;  // Mix_FreeChunk() で buf も解放させる
+	return cache_chunk(mixlr_cache, key, chunk);
 }
 
 int muspcm_init(int audio_buffer_size) {
@@ -143,10 +266,37 @@ int muspcm_init(int audio_buffer_size) {
 		return NG;
 	Mix_AllocateChannels(PCM_SLOTS);
 	load_wai();
+
+	if (!pcm_cache) {
+		pcm_cache = cache_new("pcm", pcm_data_free);
+		mixlr_cache = cache_new("pcm mixlr", pcm_data_free);
+	}
+	requests = spscq_new(MAX_PENDING + 1);
+	results = spscq_new(MAX_PENDING + 1);
+	worker_thread = SDL_CreateThread(decode_worker, "PCM decode", NULL);
+	if (!worker_thread) {
+		WARNING("SDL_CreateThread failed: %s", SDL_GetError());
+		spscq_free(requests);
+		spscq_free(results);
+	}
 	return OK;
 }
 
 int muspcm_exit(void) {
+	if (worker_thread) {
+		// デコード中のデータを受け取ってから worker を止める
+		while (nr_pending)
+			receive_result(spscq_dequeue(results));
+		struct decode_job *quit = calloc(1, sizeof(struct decode_job));
+		if (!quit)
+			NOMEMERR();
+		quit->no = -1;
+		spscq_enqueue(requests, quit);
+		SDL_WaitThread(worker_thread, NULL);
+		worker_thread = NULL;
+		spscq_free(requests);
+		spscq_free(results);
+	}
 	Mix_CloseAudio();
 	Mix_Quit();
 	return OK;
@@ -163,8 +313,8 @@ int muspcm_load_no(int slot, int no) {
 	if ((unsigned)slot >= PCM_SLOTS)
 		return NG;
 
-	Mix_Chunk *chunk = load_asset(no);
-	if (chunk == NULL) {
+	struct pcm_data *d = get_asset(no);
+	if (d == NULL) {
 		return NG;
 	}
 	
@@ -176,7 +326,7 @@ int muspcm_load_no(int slot, int no) {
 		prv.vol_pcm_sub[slot] = 0;
 	}
 
-	return load_chunk(slot, chunk);
+	return load_data(slot, d);
 }
 
 int muspcm_load_mixlr(int slot, int noL, int noR) {
@@ -184,12 +334,32 @@ int muspcm_load_mixlr(int slot, int noL, int noR) {
 		return NG;
 
 	/* mix 2 wave files */
-	Mix_Chunk* chunk = pcm_mixlr(noL, noR);
-	if (chunk == NULL) {
+	struct pcm_data *d = pcm_mixlr(noL, noR);
+	if (d == NULL) {
 		return NG;
 	}
 
-	return load_chunk(slot, chunk);
+	return load_data(slot, d);
+}
+
+// 番号指定のPCMファイルをバックグラウンドでデコードしておく
+int muspcm_prefetch(int no) {
+	if (!worker_thread || no <= 0)
+		return NG;
+
+	poll_results();
+	if (find_pending(no) >= 0 || cache_contains(pcm_cache, no))
+		return OK;
+	if (nr_pending == MAX_PENDING)
+		return NG;  // worker is busy
+
+	struct decode_job *job = calloc(1, sizeof(struct decode_job));
+	if (!job)
+		NOMEMERR();
+	job->no = no;
+	pending[nr_pending++] = no;
+	spscq_enqueue(requests, job);
+	return OK;
 }
 
 int muspcm_load_data(int slot, uint8_t *buf, uint32_t len) {
@@ -214,6 +384,10 @@ int muspcm_unload(int slot) {
 	Mix_HaltChannel(slot);
 	Mix_FreeChunk(slots[slot].chunk);
 	slots[slot].chunk = NULL;
+	if (slots[slot].data) {
+		slots[slot].data->refcnt--;
+		slots[slot].data = NULL;
+	}
 
 	return OK;
 }
@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_atomic.h>
+#include <SDL_timer.h>
+#include "profiler.h"
+#include "system.h"
+#include "scenario.h"
+#include "nact.h"
+#include "debugger.h"
+#ifdef ENABLE_DEBUGGER
+#include "debugger_private.h"
+#include "debug_symbol.h"
+#else
+#define dsym_page2src(dsym, page) ((void)(dsym), NULL)
+#define dsym_addr2line(dsym, page, addr) ((void)(dsym), -1)
+#define dsym_addr2func(dsym, page, addr) ((void)(dsym), NULL)
+#endif
+
+#define SAMPLE_INTERVAL 1  // ms
+#define MAX_DEPTH 64
+#define OP_VSYNC (-1)
+#define OP_WAIT (-2)
+
+struct frame {
+	int page;
+	int addr;
+};
+
+// A distinct call stack and the number of ticks charged to it.
+struct sample {
+	struct sample *next;  // next sample in the same hash bucket
+	uint32_t hash;
+	unsigned long count;
+	int op;               // first two bytes of the command, OP_VSYNC or OP_WAIT
+	int depth;
+	struct frame frames[];  // [0] is the command, the rest are return addresses
+};
+
+boolean prof_active;
+
+static SDL_TimerID timer;
+static SDL_atomic_t ticks;  // ticks not charged to any command yet
+
+// The command being executed
+static boolean in_command;
+static int cur_page, cur_addr, cur_op;
+
+static struct sample **buckets;
+static int nr_buckets;  // power of 2
+static int nr_samples;
+static unsigned long total_count;
+
+static Uint32 timer_callback(Uint32 interval, void *param) {
+	SDL_AtomicAdd(&ticks, 1);
+	return interval;
+}
+
+static void reset(void) {
+	for (int i = 0; i < nr_buckets; i++) {
+		struct sample *s = buckets[i];
+		while (s) {
+			struct sample *next = s->next;
+			free(s);
+			s = next;
+		}
+	}
+	free(buckets);
+	buckets = NULL;
+	nr_buckets = nr_samples = 0;
+	total_count = 0;
+}
+
+// Starts a new profile. Samples from the previous run are discarded.
+void prof_start(void) {
+	if (prof_active)
+		return;
+	reset();
+	in_command = false;
+	SDL_AtomicSet(&ticks, 0);
+	timer = SDL_AddTimer(SAMPLE_INTERVAL, timer_callback, NULL);
+	if (!timer) {
+		WARNING("profiler: cannot start timer: %s", SDL_GetError());
+		return;
+	}
+	prof_active = true;
+}
+
+void prof_stop(void) {
+	if (!prof_active)
+		return;
+	SDL_RemoveTimer(timer);
+	prof_active = false;
+}
+
+void prof_begin_command(void) {
+	cur_page = sl_getPage();
+	cur_addr = sl_getIndex();
+	int size = sl_getPageSize();
+	cur_op = cur_addr < size ? sl_getcAt(cur_addr) : 0;
+	if (cur_addr + 1 < size)
+		cur_op |= sl_getcAt(cur_addr + 1) << 8;
+	in_command = true;
+
+	// Ticks that elapsed outside of commands (e.g. while stopped in the
+	// debugger) are not charged to anyone.
+	if (SDL_AtomicGet(&ticks))
+		SDL_AtomicSet(&ticks, 0);
+}
+
+static uint32_t mix(uint32_t h, uint32_t v) {
+	return (h ^ v) * 16777619u;  // FNV-1a prime
+}
+
+static void grow_buckets(void) {
+	int n = nr_buckets ? nr_buckets * 2 : 256;
+	struct sample **b = calloc(n, sizeof(struct sample *));
+	if (!b)
+		NOMEMERR();
+	for (int i = 0; i < nr_buckets; i++) {
+		struct sample *s = buckets[i];
+		while (s) {
+			struct sample *next = s->next;
+			s->next = b[s->hash & (n - 1)];
+			b[s->hash & (n - 1)] = s;
+			s = next;
+		}
+	}
+	free(buckets);
+	buckets = b;
+	nr_buckets = n;
+}
+
+static void record(int op, int count) {
+	struct frame frames[MAX_DEPTH];
+	int depth = 0;
+	frames[depth++] = (struct frame){cur_page, cur_addr};
+
+	// Note that the stack is walked after the command has finished, so a
+	// sample taken right after a call or return command has one frame more
+	// or less than the command itself had. The outermost frames are dropped
+	// if the stack is deeper than MAX_DEPTH.
+	int page = cur_page;
+	struct stack_frame_info *sfi = NULL;
+	while (depth < MAX_DEPTH && (sfi = sl_next_stack_frame(sfi)) != NULL) {
+		if (sfi->tag != STACK_NEARCALL && sfi->tag != STACK_FARCALL)
+			continue;
+		if (sfi->tag == STACK_FARCALL)
+			page = sfi->page;
+		frames[depth++] = (struct frame){page, sfi->addr};
+	}
+
+	uint32_t hash = mix(2166136261u, op);
+	for (int i = 0; i < depth; i++)
+		hash = mix(mix(hash, frames[i].page), frames[i].addr);
+
+	if (nr_samples >= nr_buckets)
+		grow_buckets();
+	struct sample **head = &buckets[hash & (nr_buckets - 1)];
+	struct sample *s;
+	for (s = *head; s; s = s->next) {
+		if (s->hash == hash && s->op == op && s->depth == depth &&
+			!memcmp(s->frames, frames, depth * sizeof(struct frame)))
+			break;
+	}
+	if (!s) {
+		s = calloc(1, sizeof(struct sample) + depth * sizeof(struct frame));
+		if (!s)
+			NOMEMERR();
+		s->hash = hash;
+		s->op = op;
+		s->depth = depth;
+		memcpy(s->frames, frames, depth * sizeof(struct frame));
+		s->next = *head;
+		*head = s;
+		nr_samples++;
+	}
+	s->count += count;
+	total_count += count;
+}
+
+void prof_end_command(void) {
+	in_command = false;
+	if (!SDL_AtomicGet(&ticks))
+		return;
+	record(cur_op, SDL_AtomicSet(&ticks, 0));
+}
+
+// sdl_sleep() and sdl_wait_vsync() call these around the actual sleep, so
+// that commands waiting for keys or timers are not charged for the time
+// they spend sleeping. The sleep is recorded as a "(wait)" leaf instead.
+void prof_begin_wait(void) {
+	if (!in_command || !SDL_AtomicGet(&ticks))
+		return;
+	record(cur_op, SDL_AtomicSet(&ticks, 0));
+}
+
+void prof_end_wait(void) {
+	if (!in_command || !SDL_AtomicGet(&ticks))
+		return;
+	record(OP_WAIT, SDL_AtomicSet(&ticks, 0));
+}
+
+// Charges the time spent in the vsync wait of nact_main() to the last command.
+void prof_vsync(void) {
+	if (!SDL_AtomicGet(&ticks))
+		return;
+	record(OP_VSYNC, SDL_AtomicSet(&ticks, 0));
+}
+
+struct strbuf {
+	char *buf;
+	size_t len;
+	size_t cap;
+};
+
+static void sb_reserve(struct strbuf *sb, size_t n) {
+	if (sb->len + n < sb->cap)
+		return;
+	while (sb->len + n >= sb->cap)
+		sb->cap = sb->cap ? sb->cap * 2 : 4096;
+	sb->buf = realloc(sb->buf, sb->cap);
+	if (!sb->buf)
+		NOMEMERR();
+}
+
+// Appends a frame name. ';' separates frames in the folded format, so it
+// must not appear in a name.
+static void sb_put_frame(struct strbuf *sb, const char *fmt, ...) {
+	char name[256];
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(name, sizeof(name), fmt, ap);
+	va_end(ap);
+
+	size_t n = strlen(name);
+	sb_reserve(sb, n + 1);
+	if (sb->len)
+		sb->buf[sb->len++] = ';';
+	for (char *p = name; *p; p++)
+		sb->buf[sb->len++] = *p == ';' || *p == '\n' ? '_' : *p;
+	sb->buf[sb->len] = '\0';
+}
+
+static void put_op(struct strbuf *sb, int op) {
+	int c0 = op & 0xff;
+	int c1 = op >> 8 & 0xff;
+
+	if (op == OP_VSYNC)
+		sb_put_frame(sb, "(vsync)");
+	else if (op == OP_WAIT)
+		sb_put_frame(sb, "(wait)");
+	else if (c0 == 0x20 || c0 >= 0x80)
+		sb_put_frame(sb, "(message)");
+	else if (c0 == BREAKPOINT)
+		sb_put_frame(sb, "(breakpoint)");
+	else if (c0 == '!' || (c0 >= 0x10 && c0 <= 0x17))
+		sb_put_frame(sb, "(assign)");
+	else if (c0 == '/')
+		sb_put_frame(sb, "/%02x", c1);
+	else if (c0 >= 'A' && c0 <= 'Z' && c1 < 0x20 && strchr("BGJ", c0))
+		sb_put_frame(sb, "%c%d", c0, c1);
+	else if (c0 >= 'A' && c0 <= 'Z' && c1 > 0x20 && c1 < 0x7f && strchr("CDEGIKLMNPQSUVWZ", c0))
+		sb_put_frame(sb, "%c%c", c0, c1);
+	else if (c0 > 0x20 && c0 < 0x7f)
+		sb_put_frame(sb, "%c", c0);
+	else
+		sb_put_frame(sb, "0x%02x", c0);
+}
+
+#ifdef ENABLE_DEBUGGER
+static struct debug_symbols *get_symbols(void) {
+	static struct debug_symbols *dsym;
+	static boolean loaded;
+
+	if (symbols)
+		return symbols;  // loaded by the debugger
+	if (!loaded) {
+		loaded = true;
+		char path[500];
+		snprintf(path, sizeof(path), "%s.symbols", nact->files.game_fname[DRIFILE_SCO][0]);
+		FILE *fp = fopen(path, "rb");
+		if (fp) {
+			fclose(fp);
+			dsym = dsym_load(path);
+		}
+	}
+	return dsym;
+}
+#else
+#define get_symbols() NULL
+#endif
+
+static char *fold(struct sample *s) {
+	struct debug_symbols *dsym = get_symbols();
+	struct strbuf sb = {0};
+
+	// Callers, from the outermost one.
+	for (int i = s->depth - 1; i > 0; i--) {
+		struct frame *f = &s->frames[i];
+		// Search with (addr - 1) to get the function that made the call.
+		const char *func = dsym_addr2func(dsym, f->page, f->addr - 1);
+		if (func)
+			sb_put_frame(&sb, "%s", func);
+		else
+			sb_put_frame(&sb, "%d:%x", f->page, f->addr);
+	}
+
+	struct frame *f = &s->frames[0];
+	const char *func = dsym_addr2func(dsym, f->page, f->addr);
+	if (func)
+		sb_put_frame(&sb, "%s", func);
+	const char *src = dsym_page2src(dsym, f->page);
+	int line = dsym_addr2line(dsym, f->page, f->addr);
+	if (src && line > 0)
+		sb_put_frame(&sb, "%s:%d", src, line);
+	else
+		sb_put_frame(&sb, "%d:%x", f->page, f->addr);
+	put_op(&sb, s->op);
+
+	sb_reserve(&sb, 32);
+	sb.len += sprintf(sb.buf + sb.len, " %lu\n", s->count);
+	return sb.buf;
+}
+
+static int compare_lines(const void *a, const void *b) {
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+// Returns the profile in the folded stacks format, one line per distinct
+// stack: "caller;...;callee;file:line;command count". The caller must free
+// the returned string.
+char *prof_folded(void) {
+	char **lines = calloc(nr_samples + 1, sizeof(char *));
+	if (!lines)
+		NOMEMERR();
+	int n = 0;
+	for (int i = 0; i < nr_buckets; i++) {
+		for (struct sample *s = buckets[i]; s; s = s->next)
+			lines[n++] = fold(s);
+	}
+	qsort(lines, n, sizeof(char *), compare_lines);
+
+	struct strbuf sb = {0};
+	sb_reserve(&sb, 1);
+	sb.buf[0] = '\0';
+	for (int i = 0; i < n; i++) {
+		size_t len = strlen(lines[i]);
+		sb_reserve(&sb, len);
+		memcpy(sb.buf + sb.len, lines[i], len + 1);
+		sb.len += len;
+		free(lines[i]);
+	}
+	free(lines);
+	return sb.buf;
+}
+
+boolean prof_write(const char *path) {
+	FILE *fp = fopen(path, "w");
+	if (!fp) {
+		WARNING("Cannot open %s: %s", path, strerror(errno));
+		return false;
+	}
+	char *folded = prof_folded();
+	fputs(folded, fp);
+	free(folded);
+	fclose(fp);
+	NOTICE("profile: %lu samples (%d stacks) written to %s", total_count, nr_samples, path);
+	return true;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "portab.h"
+
+/*
+ * Sampling profiler for scenario code.
+ *
+ * While active, a timer thread counts ticks and nact_main() charges them to
+ * the command being executed, together with the call stack of the scenario.
+ * The result is written in the "folded stacks" format that flamegraph.pl and
+ * speedscope can read.
+ */
+
+extern boolean prof_active;
+
+void prof_start(void);
+void prof_stop(void);
+void prof_begin_command(void);
+void prof_end_command(void);
+void prof_vsync(void);
+void prof_begin_wait(void);
+void prof_end_wait(void);
+char *prof_folded(void);
+boolean prof_write(const char *path);
+
+#endif /* __PROFILER_H__ */
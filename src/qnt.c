@@ -32,7 +32,14 @@
 /* $Id: qnt.c,v 1.4 2003/04/22 16:34:28 chikama Exp $ */
 
 #include <stdlib.h>
+#include <string.h>
 #include <zlib.h>
+#include <SDL_thread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "portab.h"
 #include "LittleEndian.h"
@@ -41,10 +48,24 @@
 #include "system.h"
 
 /*
-  zlib の展開バッファで、幅×高さ×３に、さらにどれくらい余裕をとるか
-   (リクルスで 1164バイトというのがあった)
+  一度に展開する 2x2 ブロックの行数
 */
-#define ZLIBBUF_MARGIN 5*1024
+#define CHUNK_BLOCK_ROWS 16
+
+/*
+  色プレーンを別スレッドで復元する最小の画素数
+*/
+#define PARALLEL_MIN_PIXELS (128 * 128)
+
+/*
+  An 8-bit image plane
+*/
+typedef struct {
+	uint8_t *buf;
+	int width;
+	int height;
+	int stride;
+} qnt_plane;
 
 /*
   Get information from header
@@ -77,134 +98,224 @@ static void extract_header(uint8_t *b, qnt_header *qnt) {
 	}
 }
 
+/*
+  Inflate up to len bytes from zlib stream
+
+    z  : zlib stream
+    dst: output buffer
+    len: number of bytes to be read
+
+    return: FALSE if the stream ended before len bytes. The rest of dst
+            is filled with zero in that case.
+*/
+static boolean inflate_read(z_stream *z, uint8_t *dst, int len) {
+	z->next_out = dst;
+	z->avail_out = len;
+	while (z->avail_out > 0) {
+		int rv = inflate(z, Z_SYNC_FLUSH);
+		if (rv != Z_OK) {
+			if (rv != Z_STREAM_END)
+				WARNING("inflate failed: %s", z->msg ? z->msg : "");
+			memset(z->next_out, 0, z->avail_out);
+			z->avail_out = 0;
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/*
+  Split interleaved bytes into even and odd ones
+
+    even: even bytes are stored
+    odd : odd bytes are stored
+    src : source bytes (n * 2 bytes)
+    n   : number of bytes for each output
+*/
+static void split_even_odd(uint8_t *even, uint8_t *odd, const uint8_t *src, int n) {
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+	for (; i + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i * 2 + 16));
+		_mm_storeu_si128((__m128i *)(even + i),
+				 _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+		_mm_storeu_si128((__m128i *)(odd + i),
+				 _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 16 <= n; i += 16) {
+		uint8x16x2_t v = vld2q_u8(src + i * 2);
+		vst1q_u8(even + i, v.val[0]);
+		vst1q_u8(odd + i, v.val[1]);
+	}
+#endif
+	for (; i < n; i++) {
+		even[i] = src[i * 2];
+		odd[i]  = src[i * 2 + 1];
+	}
+}
+
+/*
+  Read one color plane from zlib stream
+
+    Each plane is a sequence of 2x2 blocks, stored in the order of
+    (x,y), (x,y+1), (x+1,y), (x+1,y+1). So the even bytes of a block row
+    are the upper pixel row and the odd bytes are the lower one.
+    plane->buf must have room for rounded-up-to-even width and height.
+
+    z    : zlib stream
+    plane: plane to be stored
+    chunk: work buffer (CHUNK_BLOCK_ROWS block rows)
+*/
+static void read_color_plane(z_stream *z, qnt_plane *plane, uint8_t *chunk) {
+	int stride = plane->stride;
+	int block_rows = (plane->height + 1) / 2;
+	
+	for (int by = 0; by < block_rows; by += CHUNK_BLOCK_ROWS) {
+		int n = min(CHUNK_BLOCK_ROWS, block_rows - by);
+		inflate_read(z, chunk, n * stride * 2);
+		for (int i = 0; i < n; i++) {
+			uint8_t *row = plane->buf + (by + i) * 2 * stride;
+			split_even_odd(row, row + stride, chunk + i * stride * 2, stride);
+		}
+	}
+}
+
+/*
+  Undo the prediction filter in place
+
+    The first row and column are predicted from the left / upper pixel,
+    and the others from the average of the left and upper pixels.
+    Each stored value is (prediction - actual value).
+*/
+static void unfilter_plane(qnt_plane *plane) {
+	int w = plane->width;
+	int h = plane->height;
+	int stride = plane->stride;
+	uint8_t *p = plane->buf;
+	
+	for (int x = 1; x < w; x++)
+		p[x] = p[x - 1] - p[x];
+	
+	for (int y = 1; y < h; y++) {
+		uint8_t *up = p;
+		p += stride;
+		uint8_t left = p[0] = up[0] - p[0];
+		for (int x = 1; x < w; x++)
+			left = p[x] = ((up[x] + left) >> 1) - p[x];
+	}
+}
+
+static int unfilter_thread(void *data) {
+	unfilter_plane(data);
+	return 0;
+}
+
 /*
   Do extract qnt pixel image
 
+    The three color planes are reconstructed in parallel while the
+    following planes are being inflated.
+
     qnt: qnt header information
     pic: pixel to be stored
     b  : raw data (pointer to pixel)
 */
 static void extract_pixel(qnt_header *qnt, uint8_t *pic, uint8_t *b) {
-	int i, j, x, y, w, h;
-	long ucbuf = (qnt->width+1) * (qnt->height+1) * 3 + ZLIBBUF_MARGIN;
-	uint8_t *raw = malloc(sizeof(uint8_t) * ucbuf);
+	int w = qnt->width;
+	int h = qnt->height;
+	int stride = (w + 1) & ~1;
+	int padded_h = (h + 1) & ~1;
+	qnt_plane planes[3];
+	SDL_Thread *threads[3] = {NULL, NULL, NULL};
+	boolean parallel = w * h >= PARALLEL_MIN_PIXELS;
+#ifdef __EMSCRIPTEN__
+	parallel = FALSE;
+#endif
 	
-	if (Z_OK != uncompress(raw, &ucbuf, b, qnt->pixel_size)) {
-		WARNING("uncompress failed");
-		free(raw);
+	z_stream z = { .next_in = b, .avail_in = qnt->pixel_size };
+	if (inflateInit(&z) != Z_OK) {
+		WARNING("inflateInit failed");
 		return;
 	}
 	
-	w = qnt->width;
-	h = qnt->height;
-	
-	j = 0;
-	for (i = 2; i >= 0; i--) {
-		for (y = 0; y < (h -1); y+=2) {
-			for (x = 0; x < (w -1); x+=2) {
-				pic[( y   *w+x)  *3 +i] = raw[j];
-				pic[((y+1)*w+x)  *3 +i] = raw[j+1];
-				pic[( y   *w+x+1)*3 +i] = raw[j+2];
-				pic[((y+1)*w+x+1)*3 +i] = raw[j+3];
-				j+=4;
-			}
-			if (x != w) {
-				pic[( y   *w+x)*3 +i] = raw[j];
-				pic[((y+1)*w+x)*3 +i] = raw[j+1];
-				j+=4;
-			}
-		}
-		if (y != h) {
-			for (x = 0; x < (w -1); x+=2) {
-				pic[(y*w+x  )*3+i] = raw[j];
-				pic[(y*w+x+1)*3+i] = raw[j+2];
-				j+=4;
-			}
-			if (x != w) {
-				pic[( y   *w+x)*3 +i] = raw[j];
-				j+=4;
-			}
-		}
+	uint8_t *bufs = malloc(stride * padded_h * 3);
+	uint8_t *chunk = malloc(stride * 2 * CHUNK_BLOCK_ROWS);
+	if (!bufs || !chunk)
+		NOMEMERR();
+	
+	/* planes are stored in the order of B, G, R */
+	for (int i = 2; i >= 0; i--) {
+		qnt_plane *plane = &planes[i];
+		plane->buf = bufs + stride * padded_h * i;
+		plane->width = w;
+		plane->height = h;
+		plane->stride = stride;
+		read_color_plane(&z, plane, chunk);
+		if (parallel && i > 0)
+			threads[i] = SDL_CreateThread(unfilter_thread, "QNT", plane);
+		if (!threads[i])
+			unfilter_plane(plane);
 	}
+	inflateEnd(&z);
+	free(chunk);
 	
-	if (w > 1) {
-		for (x = 1; x < w; x++) {
-			pic[x*3  ] = pic[(x-1)*3  ] - pic[x*3  ];
-			pic[x*3+1] = pic[(x-1)*3+1] - pic[x*3+1];
-			pic[x*3+2] = pic[(x-1)*3+2] - pic[x*3+2];
-		}
+	for (int i = 0; i < 3; i++) {
+		if (threads[i])
+			SDL_WaitThread(threads[i], NULL);
 	}
 	
-	if (h > 1) {
-		for (y = 1; y < h; y++) {
-			pic[(y*w)*3  ] = pic[((y-1)*w)*3  ] - pic[(y*w)*3  ];
-			pic[(y*w)*3+1] = pic[((y-1)*w)*3+1] - pic[(y*w)*3+1];
-			pic[(y*w)*3+2] = pic[((y-1)*w)*3+2] - pic[(y*w)*3+2];
-			
-			for (x = 1; x < w; x++) {
-				int px, py;
-				py = pic[((y-1)*w+x  )*3];
-				px = pic[( y   *w+x-1)*3];
-				pic[(y*w+x)*3] = ((py+px)>>1) - pic[(y*w+x)*3];
-				py = pic[((y-1)*w+x  )*3+1];
-				px = pic[( y   *w+x-1)*3+1];
-				pic[(y*w+x)*3+1] = ((py+px)>>1) - pic[(y*w+x)*3+1];
-				py = pic[((y-1)*w+x  )*3+2];
-				px = pic[( y   *w+x-1)*3+2];
-				pic[(y*w+x)*3+2] = ((py+px)>>1) - pic[(y*w+x)*3+2];
-			}
+	const uint8_t *red = planes[0].buf, *green = planes[1].buf, *blue = planes[2].buf;
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			*pic++ = red[x];
+			*pic++ = green[x];
+			*pic++ = blue[x];
 		}
+		red += stride;
+		green += stride;
+		blue += stride;
 	}
-	
-	free(raw);
+	free(bufs);
 }
 
 /*
   Do extract qnt alpha image
 
+    Alpha pixels are stored row by row, with rows padded to even width.
+
     qnt: qnt header information
     pic: pixel to be stored
     b  : raw data (pointer to alpha pixel)
 */
 static void extract_alpha(qnt_header *qnt, uint8_t *pic, uint8_t *b) {
-	int i, x, y, w, h;
-	long ucbuf = (qnt->width+1) * (qnt->height+1) + ZLIBBUF_MARGIN;
-	uint8_t *raw = malloc(sizeof(uint8_t) * ucbuf);
-
-	if (Z_OK != uncompress(raw, &ucbuf, b, qnt->alpha_size)) {
-		WARNING("uncompress failed");
-		free(raw);
+	int w = qnt->width;
+	int h = qnt->height;
+	qnt_plane plane = {
+		.width = w,
+		.height = h,
+		.stride = (w + 1) & ~1,
+	};
+	
+	z_stream z = { .next_in = b, .avail_in = qnt->alpha_size };
+	if (inflateInit(&z) != Z_OK) {
+		WARNING("inflateInit failed");
 		return;
 	}
 	
-	w = qnt->width;
-	h = qnt->height;
+	plane.buf = malloc(plane.stride * h);
+	if (!plane.buf)
+		NOMEMERR();
+	inflate_read(&z, plane.buf, plane.stride * h);
+	inflateEnd(&z);
 	
-	i = 1;
-	if (w > 1) {
-		pic[0] = raw[0];
-		for (x = 1; x < w; x++) {
-			pic[x] = pic[x-1] - raw[i];
-			i++;
-		}
-		if (w%2) i++;
-	}
-	
-	if (h > 1) {
-		for (y = 1; y < h; y++) {
-			pic[y*w] = pic[(y-1) *w] - raw[i]; i++;
-			for (x = 1; x < w; x++) {
-				int pax, pay;
-				pax = pic[ y   * w + x -1];
-				pay = pic[(y-1)* w + x   ];
-				pic[y*w+x] = ((pax+pay) >> 1) - raw[i];
-				i++;
-			}
-			if (w%2) i++;
-		}
-	}
+	unfilter_plane(&plane);
 	
-	free(raw);
+	for (int y = 0; y < h; y++)
+		memcpy(pic + y * w, plane.buf + y * plane.stride, w);
+	free(plane.buf);
 }
 
 /*
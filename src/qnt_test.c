@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "qnt.h"
+#include "unittest.h"
+
+/*
+  testdata/test.qnt is a 181x93 (odd sized, large enough for the
+  threaded path) version 1 QNT with an alpha plane, encoding the image
+  below. The pre-rewrite decoder produces exactly this image from it.
+*/
+#define WIDTH 181
+#define HEIGHT 93
+
+static void expected_pixel(int x, int y, uint8_t *rgba) {
+	rgba[0] = x * 255 / (WIDTH - 1);
+	rgba[1] = y * 255 / (HEIGHT - 1);
+	rgba[2] = (x + 2 * y) * 2 + ((x / 8 + y / 8) % 2 ? 16 : 0);
+	rgba[3] = (x - 90) * (x - 90) + (y - 46) * (y - 46) < 40 * 40 ? 255 : x * 2 + y;
+}
+
+static uint8_t *read_file(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	ASSERT_TRUE(fp != NULL);
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	uint8_t *buf = malloc(size);
+	ASSERT_EQUAL(fread(buf, 1, size, fp), size);
+	fclose(fp);
+	return buf;
+}
+
+static void extract_test(void) {
+	uint8_t *data = read_file("testdata/test.qnt");
+	ASSERT_TRUE(qnt_checkfmt(data));
+
+	cgdata *cg = qnt_extract(data);
+	ASSERT_EQUAL(cg->type, ALCG_QNT);
+	ASSERT_EQUAL(cg->x, 12);
+	ASSERT_EQUAL(cg->y, 34);
+	ASSERT_EQUAL(cg->width, WIDTH);
+	ASSERT_EQUAL(cg->height, HEIGHT);
+	ASSERT_TRUE(cg->alpha != NULL);
+
+	const uint8_t *pic = cg->pic;
+	const uint8_t *alpha = cg->alpha;
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			uint8_t expected[4];
+			expected_pixel(x, y, expected);
+			ASSERT_EQUAL(*pic++, expected[0]);
+			ASSERT_EQUAL(*pic++, expected[1]);
+			ASSERT_EQUAL(*pic++, expected[2]);
+			ASSERT_EQUAL(*alpha++, expected[3]);
+		}
+	}
+
+	free(cg->pic);
+	free(cg->alpha);
+	free(cg);
+	free(data);
+}
+
+void qnt_test(void) {
+	extract_test();
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/*
+ * Input replay files.
+ *
+ * A replay file is a list of lines of the form
+ *
+ *   <delay> <action> [arguments]
+ *
+ * where <delay> is the time in milliseconds (on the sdl_getTicks() clock)
+ * since the previous line. Empty lines and lines starting with '#' are
+ * ignored. Actions:
+ *
+ *   key NAME        press and release a key (SDL key name, e.g. "Return")
+ *   keydown NAME    press a key
+ *   keyup NAME      release a key
+ *   move X Y        move the mouse cursor
+ *   click X Y [BTN] move, press and release a mouse button (left/middle/right)
+ *   wheel N         scroll the mouse wheel (N > 0: forward)
+ *   skip on|off     activate/deactivate message skipping
+ *   quit            quit the game
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_keyboard.h>
+#include <SDL_mouse.h>
+
+#include "portab.h"
+#include "system.h"
+#include "replay.h"
+
+static void add_event(struct replay *r, uint32_t time, enum replay_action action, int a, int b) {
+	if (r->nr_events == r->max_events) {
+		r->max_events = r->max_events ? r->max_events * 2 : 64;
+		r->events = realloc(r->events, r->max_events * sizeof(struct replay_event));
+		if (!r->events)
+			NOMEMERR();
+	}
+	struct replay_event *ev = &r->events[r->nr_events];
+	ev->time = time;
+	ev->seq = r->nr_events++;
+	ev->action = action;
+	ev->a = a;
+	ev->b = b;
+}
+
+static int compare_events(const void *a, const void *b) {
+	const struct replay_event *e1 = a, *e2 = b;
+	if (e1->time != e2->time)
+		return e1->time < e2->time ? -1 : 1;
+	return e1->seq - e2->seq;
+}
+
+static int parse_button(const char *s) {
+	if (!*s || !strcmp(s, "left"))
+		return SDL_BUTTON_LEFT;
+	if (!strcmp(s, "middle"))
+		return SDL_BUTTON_MIDDLE;
+	if (!strcmp(s, "right"))
+		return SDL_BUTTON_RIGHT;
+	return -1;
+}
+
+static char *trim(char *s) {
+	while (*s == ' ' || *s == '\t')
+		s++;
+	char *end = s + strlen(s);
+	while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+		*--end = '\0';
+	return s;
+}
+
+boolean replay_parse_line(struct replay *r, char *line, uint32_t *time) {
+	int delay, n;
+	char action[16];
+	if (sscanf(line, "%d %15s %n", &delay, action, &n) != 2 || delay < 0)
+		return FALSE;
+	char *args = trim(line + n);
+	*time += delay;
+
+	if (!strcmp(action, "key") || !strcmp(action, "keydown") || !strcmp(action, "keyup")) {
+		SDL_Scancode sc = SDL_GetScancodeFromName(args);
+		if (sc == SDL_SCANCODE_UNKNOWN)
+			return FALSE;
+		if (strcmp(action, "keyup"))
+			add_event(r, *time, REPLAY_KEYDOWN, sc, 0);
+		if (strcmp(action, "keydown"))
+			add_event(r, *time + (action[3] ? 0 : REPLAY_HOLD_MS), REPLAY_KEYUP, sc, 0);
+	} else if (!strcmp(action, "move") || !strcmp(action, "click")) {
+		int x, y, m = 0;
+		if (sscanf(args, "%d %d %n", &x, &y, &m) != 2)
+			return FALSE;
+		add_event(r, *time, REPLAY_MOVE, x, y);
+		if (action[0] == 'c') {
+			int button = parse_button(args + m);
+			if (button < 0)
+				return FALSE;
+			add_event(r, *time, REPLAY_BUTTONDOWN, button, 0);
+			add_event(r, *time + REPLAY_HOLD_MS, REPLAY_BUTTONUP, button, 0);
+		}
+	} else if (!strcmp(action, "wheel")) {
+		int y;
+		if (sscanf(args, "%d", &y) != 1)
+			return FALSE;
+		add_event(r, *time, REPLAY_WHEEL, y, 0);
+	} else if (!strcmp(action, "skip")) {
+		if (strcmp(args, "on") && strcmp(args, "off"))
+			return FALSE;
+		add_event(r, *time, REPLAY_SKIP, !strcmp(args, "on"), 0);
+	} else if (!strcmp(action, "quit")) {
+		add_event(r, *time, REPLAY_QUIT, 0, 0);
+	} else {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+struct replay *replay_load(const char *path) {
+	FILE *fp = fopen(path, "r");
+	if (!fp) {
+		WARNING("%s: cannot open", path);
+		return NULL;
+	}
+
+	struct replay *r = calloc(1, sizeof(struct replay));
+	if (!r)
+		NOMEMERR();
+	char line[256];
+	int lineno = 0;
+	uint32_t time = 0;
+	while (fgets(line, sizeof line, fp)) {
+		lineno++;
+		char *p = trim(line);
+		if (!*p || *p == '#')
+			continue;
+		if (!replay_parse_line(r, p, &time)) {
+			WARNING("%s:%d: invalid replay entry '%s'", path, lineno, p);
+			fclose(fp);
+			replay_free(r);
+			return NULL;
+		}
+	}
+	fclose(fp);
+
+	qsort(r->events, r->nr_events, sizeof(struct replay_event), compare_events);
+	return r;
+}
+
+void replay_free(struct replay *r) {
+	if (!r)
+		return;
+	free(r->events);
+	free(r);
+}
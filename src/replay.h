@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdint.h>
+#include "portab.h"
+
+/*
+ * Replay file parser. See replay.c for the file format; sdl_replay.c feeds
+ * the events to the SDL event handler.
+ */
+
+// How long "key" and "click" keep the key/button down.
+#define REPLAY_HOLD_MS 50
+
+enum replay_action {
+	REPLAY_KEYDOWN,
+	REPLAY_KEYUP,
+	REPLAY_MOVE,
+	REPLAY_BUTTONDOWN,
+	REPLAY_BUTTONUP,
+	REPLAY_WHEEL,
+	REPLAY_SKIP,
+	REPLAY_QUIT,
+};
+
+struct replay_event {
+	uint32_t time;
+	int seq;
+	enum replay_action action;
+	int a, b;
+};
+
+struct replay {
+	struct replay_event *events;  // sorted by time after replay_load()
+	int nr_events, max_events;
+};
+
+// Parses a non-empty, non-comment line. `time` is the time of the previous
+// line, and is advanced by the delay of this line.
+boolean replay_parse_line(struct replay *r, char *line, uint32_t *time);
+struct replay *replay_load(const char *path);
+void replay_free(struct replay *r);
+
+#endif /* __REPLAY_H__ */
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <SDL_keyboard.h>
+#include <SDL_mouse.h>
+#include "replay.h"
+#include "unittest.h"
+
+static boolean parse(struct replay *r, const char *line, uint32_t *time) {
+	char buf[256];
+	strcpy(buf, line);
+	return replay_parse_line(r, buf, time);
+}
+
+static void check_event(struct replay_event *ev, uint32_t time, enum replay_action action, int a, int b) {
+	ASSERT_EQUAL(ev->time, time);
+	ASSERT_EQUAL(ev->action, action);
+	ASSERT_EQUAL(ev->a, a);
+	ASSERT_EQUAL(ev->b, b);
+}
+
+static void key_test(void) {
+	struct replay r = {0};
+	uint32_t time = 0;
+	ASSERT_TRUE(parse(&r, "100 key Return", &time));
+	ASSERT_EQUAL(time, 100);
+	ASSERT_EQUAL(r.nr_events, 2);
+	check_event(&r.events[0], 100, REPLAY_KEYDOWN, SDL_SCANCODE_RETURN, 0);
+	check_event(&r.events[1], 100 + REPLAY_HOLD_MS, REPLAY_KEYUP, SDL_SCANCODE_RETURN, 0);
+
+	ASSERT_TRUE(parse(&r, "20 keydown Space", &time));
+	ASSERT_TRUE(parse(&r, "0 keyup Space", &time));
+	ASSERT_EQUAL(time, 120);
+	ASSERT_EQUAL(r.nr_events, 4);
+	check_event(&r.events[2], 120, REPLAY_KEYDOWN, SDL_SCANCODE_SPACE, 0);
+	check_event(&r.events[3], 120, REPLAY_KEYUP, SDL_SCANCODE_SPACE, 0);
+
+	ASSERT_FALSE(parse(&r, "0 key NoSuchKey", &time));
+	free(r.events);
+}
+
+static void mouse_test(void) {
+	struct replay r = {0};
+	uint32_t time = 1000;
+	ASSERT_TRUE(parse(&r, "5 move 10 20", &time));
+	ASSERT_TRUE(parse(&r, "5 click 30 40", &time));
+	ASSERT_TRUE(parse(&r, "5 click 50 60 right", &time));
+	ASSERT_TRUE(parse(&r, "5 wheel -2", &time));
+	ASSERT_EQUAL(time, 1020);
+	ASSERT_EQUAL(r.nr_events, 8);
+	check_event(&r.events[0], 1005, REPLAY_MOVE, 10, 20);
+	check_event(&r.events[1], 1010, REPLAY_MOVE, 30, 40);
+	check_event(&r.events[2], 1010, REPLAY_BUTTONDOWN, SDL_BUTTON_LEFT, 0);
+	check_event(&r.events[3], 1010 + REPLAY_HOLD_MS, REPLAY_BUTTONUP, SDL_BUTTON_LEFT, 0);
+	check_event(&r.events[5], 1015, REPLAY_BUTTONDOWN, SDL_BUTTON_RIGHT, 0);
+	check_event(&r.events[7], 1020, REPLAY_WHEEL, -2, 0);
+
+	ASSERT_FALSE(parse(&r, "0 move 10", &time));
+	ASSERT_FALSE(parse(&r, "0 click 1 2 up", &time));
+	ASSERT_FALSE(parse(&r, "0 wheel", &time));
+	free(r.events);
+}
+
+static void misc_test(void) {
+	struct replay r = {0};
+	uint32_t time = 0;
+	ASSERT_TRUE(parse(&r, "0 skip on", &time));
+	ASSERT_TRUE(parse(&r, "0   skip   off  ", &time));
+	ASSERT_TRUE(parse(&r, "3000 quit", &time));
+	ASSERT_EQUAL(r.nr_events, 3);
+	check_event(&r.events[0], 0, REPLAY_SKIP, 1, 0);
+	check_event(&r.events[1], 0, REPLAY_SKIP, 0, 0);
+	check_event(&r.events[2], 3000, REPLAY_QUIT, 0, 0);
+
+	ASSERT_FALSE(parse(&r, "0 skip maybe", &time));
+	ASSERT_FALSE(parse(&r, "-1 quit", &time));
+	ASSERT_FALSE(parse(&r, "quit", &time));
+	ASSERT_FALSE(parse(&r, "0 jump", &time));
+	free(r.events);
+}
+
+void replay_test(void) {
+	key_test();
+	mouse_test();
+	misc_test();
+}
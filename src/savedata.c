@@ -27,6 +27,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #else
@@ -42,6 +45,8 @@ typedef int emscripten_align1_int;
 #include "windowframe.h"
 #include "selection.h"
 #include "message.h"
+#include "msgqueue.h"
+#include "mmap.h"
 
 const char *save_signature[] = {
 	[SAVEFMT_XSYS35] = "System3.5 SavaData(c)ALICE-SOFT",
@@ -132,14 +137,256 @@ static void fputw(uint16_t n, FILE *fp) {
 	fputc(n >> 8, fp);
 }
 
-static int saveStack(enum save_format format, FILE *fp) {
+/* in-memory save image */
+struct savebuf {
+	uint8_t *data;
+	size_t len;
+	size_t cap;
+};
+
+/* size of the last save image, used as the initial buffer size */
+static size_t last_save_size = 64 * 1024;
+
+/* append n bytes to the buffer and return the pointer to them */
+static void *sb_reserve(struct savebuf *b, size_t n) {
+	if (b->len + n > b->cap) {
+		while (b->len + n > b->cap)
+			b->cap = b->cap ? b->cap * 2 : last_save_size;
+		b->data = realloc(b->data, b->cap);
+		if (!b->data)
+			NOMEMERR();
+	}
+	void *p = b->data + b->len;
+	b->len += n;
+	return p;
+}
+
+static void sb_write(struct savebuf *b, const void *data, size_t n) {
+	memcpy(sb_reserve(b, n), data, n);
+}
+
+/* save statistics */
+static struct {
+	int saves;
+	int partial_saves;
+	int errors;
+	uint64_t serialize_time;  // in performance counter ticks
+	uint64_t write_time;
+	uint64_t max_write_time;
+	uint64_t partial_time;
+} stats;
+
+/* background writer */
+struct save_job {
+	char *fname;  // NULL: quit
+	int no;
+	struct savebuf buf;
+};
+
+static struct {
+	SDL_Thread *thread;
+	struct spscq *jobs;
+	SDL_mutex *mutex;   // protects pending, failed, nr_failed and stats
+	SDL_cond *idle;
+	int pending;        // number of jobs not written yet
+	boolean failed[SAVE_MAXNUMBER];  // the last background write to the slot failed
+	int nr_failed;
+} writer;
+
+/*
+ * Write a file atomically: the data goes to a temporary file, which then
+ * replaces the original.
+ */
+static boolean write_file(const char *fname, const void *data, size_t size) {
+	char *tmpname = malloc(strlen(fname) + 5);
+	if (!tmpname)
+		NOMEMERR();
+	sprintf(tmpname, "%s.tmp", fname);
+
+	FILE *fp = fopen(tmpname, "wb");
+	if (!fp) {
+		WARNING("%s: cannot open", tmpname);
+		free(tmpname);
+		return FALSE;
+	}
+	boolean ok = fwrite(data, size, 1, fp) == 1;
+	if (fclose(fp) != 0)
+		ok = FALSE;
+	if (ok) {
+		fc_backup_oldfile(fname);
+		if (rename(tmpname, fname) != 0) {
+			// Windows cannot rename over an existing file.
+			remove(fname);
+			ok = rename(tmpname, fname) == 0;
+		}
+	}
+	if (!ok) {
+		WARNING("%s: write error", fname);
+		remove(tmpname);
+	}
+	free(tmpname);
+	return ok;
+}
+
+static int writer_main(void *data) {
+	for (;;) {
+		struct save_job *job = spscq_dequeue(writer.jobs);
+		if (!job->fname) {
+			free(job);
+			return 0;
+		}
+		uint64_t start = SDL_GetPerformanceCounter();
+		boolean ok = write_file(job->fname, job->buf.data, job->buf.len);
+		uint64_t elapsed = SDL_GetPerformanceCounter() - start;
+		int no = job->no;
+
+		free(job->fname);
+		free(job->buf.data);
+		free(job);
+
+		SDL_LockMutex(writer.mutex);
+		stats.write_time += elapsed;
+		stats.max_write_time = max(stats.max_write_time, elapsed);
+		if (!ok)
+			stats.errors++;
+		if (writer.failed[no] != !ok) {
+			writer.failed[no] = !ok;
+			writer.nr_failed += ok ? -1 : 1;
+		}
+		if (--writer.pending == 0)
+			SDL_CondBroadcast(writer.idle);
+		SDL_UnlockMutex(writer.mutex);
+	}
+}
+
+static void writer_init(void) {
+#ifndef __EMSCRIPTEN__
+	if (writer.thread)
+		return;
+	writer.jobs = spscq_new(8);
+	writer.mutex = SDL_CreateMutex();
+	writer.idle = SDL_CreateCond();
+	writer.thread = SDL_CreateThread(writer_main, "save writer", NULL);
+	if (!writer.thread)
+		WARNING("SDL_CreateThread failed: %s", SDL_GetError());
+#endif
+}
+
+/*
+ * Returns TRUE if a background write has failed and its slot has not been
+ * written successfully since.
+ */
+static boolean has_write_error(void) {
+	if (!writer.thread)
+		return FALSE;
+	SDL_LockMutex(writer.mutex);
+	boolean failed = writer.nr_failed > 0;
+	SDL_UnlockMutex(writer.mutex);
+	return failed;
+}
+
+/*
+ * Returns TRUE if the last background write to the slot failed, i.e. the
+ * file does not hold what the game saved last. Call after save_flush().
+ */
+static boolean slot_write_failed(int no) {
+	return writer.thread && writer.failed[no];
+}
+
+/*
+ * Write a save image to a file. The buffer is owned by the writer from now
+ * on, and the file is written in the background if possible.
+ *
+ * A background write cannot report its result to the game. Once one has
+ * failed, saves are written synchronously again (so that the game sees
+ * SAVE_SAVEERR if the problem persists) until the failed slot is written
+ * successfully, and loading that slot fails.
+ */
+static int write_savebuf(int no, struct savebuf *buf) {
+	const char *fname = nact->files.save_fname[no];
+	last_save_size = max(buf->len, 1024);
+
+	writer_init();
+	if (!writer.thread || has_write_error()) {
+		save_flush();
+		uint64_t start = SDL_GetPerformanceCounter();
+		boolean ok = write_file(fname, buf->data, buf->len);
+		uint64_t elapsed = SDL_GetPerformanceCounter() - start;
+		free(buf->data);
+		stats.write_time += elapsed;
+		stats.max_write_time = max(stats.max_write_time, elapsed);
+		if (!ok) {
+			stats.errors++;
+			return SAVE_SAVEERR;
+		}
+		if (slot_write_failed(no)) {
+			writer.failed[no] = FALSE;
+			writer.nr_failed--;
+		}
+		scheduleSync();
+		return SAVE_SAVEOK1;
+	}
+
+	struct save_job *job = malloc(sizeof(struct save_job));
+	if (!job)
+		NOMEMERR();
+	job->fname = strdup(fname);
+	job->no = no;
+	job->buf = *buf;
+	SDL_LockMutex(writer.mutex);
+	writer.pending++;
+	SDL_UnlockMutex(writer.mutex);
+	spscq_enqueue(writer.jobs, job);
+	return SAVE_SAVEOK1;
+}
+
+/* Wait until all queued saves are written. */
+void save_flush(void) {
+	if (!writer.thread)
+		return;
+	SDL_LockMutex(writer.mutex);
+	while (writer.pending > 0)
+		SDL_CondWait(writer.idle, writer.mutex);
+	SDL_UnlockMutex(writer.mutex);
+}
+
+void save_remove(void) {
+	if (!writer.thread)
+		return;
+	struct save_job *job = calloc(1, sizeof(struct save_job));
+	if (!job)
+		NOMEMERR();
+	spscq_enqueue(writer.jobs, job);
+	SDL_WaitThread(writer.thread, NULL);
+	writer.thread = NULL;
+	spscq_free(writer.jobs);
+	SDL_DestroyCond(writer.idle);
+	SDL_DestroyMutex(writer.mutex);
+}
+
+void save_print_stats(void) {
+	if (!stats.saves && !stats.partial_saves)
+		return;
+	double ms = 1000.0 / SDL_GetPerformanceFrequency();
+	if (stats.saves) {
+		NOTICE("savedata: %d saves, %.2fms serialize / %.2fms write on average, %.2fms max write, %d errors",
+			   stats.saves, stats.serialize_time * ms / stats.saves,
+			   stats.write_time * ms / stats.saves, stats.max_write_time * ms, stats.errors);
+	}
+	if (stats.partial_saves) {
+		NOTICE("savedata: %d partial saves, %.3fms on average",
+			   stats.partial_saves, stats.partial_time * ms / stats.partial_saves);
+	}
+}
+
+static int saveStack(enum save_format format, struct savebuf *b) {
 	int size;
 	uint8_t *data = sl_saveStack(format, &size);
 
 	asd_stackHdr head = { .size = size };
-	fwrite(&head, sizeof(head), 1, fp);
+	sb_write(b, &head, sizeof(head));
 	if (size > 0)
-		fwrite(data, size, 1, fp);
+		sb_write(b, data, size);
 	free(data);
 	return sizeof(head) + size;
 }
@@ -150,26 +397,23 @@ static void loadStack(enum save_format format, char *buf) {
 	sl_loadStack(format, data, head->size);
 }
 
-static int saveStrVars(enum save_format format, FILE *fp) {
+static int saveStrVars(enum save_format format, struct savebuf *b) {
 	const int base = format == SAVEFMT_XSYS35 ? 1 : 0;
 	asd_strVarHdr head = {
 		.size   = 0,
 		.count  = svar_maxindex() + (1 - base),
 		.maxlen = (format == SAVEFMT_XSYS35 ? 101 : 0)  // so that old versions of xystem35 can read this save file
 	};
-	fseek(fp, sizeof(head), SEEK_CUR);
+	size_t head_pos = b->len;
+	sb_reserve(b, sizeof(head));
 
 	for (int i = base; i <= svar_maxindex(); i++) {
 		const char *s = svar_get(i);
 		int len = strlen(s) + 1;
-		fwrite(s, len, 1, fp);
+		sb_write(b, s, len);
 		head.size += len;
 	}
-	if (ferror(fp))
-		return 0;
-	fseek(fp, -(sizeof(head) + head.size), SEEK_CUR);
-	fwrite(&head, sizeof(head), 1, fp);
-	fseek(fp, head.size, SEEK_CUR);
+	memcpy(b->data + head_pos, &head, sizeof(head));
 
 	return sizeof(head) + head.size;
 }
@@ -190,7 +434,7 @@ static void loadStrVars(enum save_format format, char *buf) {
 	}
 }
 
-static int saveVarPage(int page, FILE *fp) {
+static int saveVarPage(int page, struct savebuf *b) {
 	if (!varPage[page].saveflag)
 		return 0;
 	int cnt = varPage[page].size;
@@ -201,9 +445,12 @@ static int saveVarPage(int page, FILE *fp) {
 		.size   = cnt * sizeof(uint16_t),
 		.pageNo = page
 	};
-	fwrite(&head, sizeof(head), 1, fp);
-	for (int i = 0; i < cnt; i++)
-		fputw(var[i], fp);
+	sb_write(b, &head, sizeof(head));
+	uint8_t *p = sb_reserve(b, head.size);
+	for (int i = 0; i < cnt; i++) {
+		*p++ = var[i] & 0xff;
+		*p++ = (var[i] >> 8) & 0xff;
+	}
 
 	return sizeof(head) + head.size;
 }
@@ -227,13 +474,12 @@ static int loadVarPage(char *buf) {
 	return SAVE_LOADOK;
 }
 
-static void writeAsdFooter(enum save_format format, FILE *fp) {
+static void writeAsdFooter(enum save_format format, struct savebuf *b) {
 	if (format != SAVEFMT_XSYS35) {
 		// Padding(?)
-		for (int i = 0; i < 256; i++)
-			fputc(0xff, fp);
+		memset(sb_reserve(b, 256), 0xff, 256);
 		// Write a mark to indicate that this file was created by xsystem35.
-		fputs("XS35", fp);
+		sb_write(b, "XS35", 4);
 	}
 	if (format == SAVEFMT_SYS38) {
 		// Stack info
@@ -264,10 +510,10 @@ static void writeAsdFooter(enum save_format format, FILE *fp) {
 		}
 		// Note that only the first `size` byte of the `size` words data is
 		// written, so information is lost.
-		fwrite(ptr, size, 1, fp);
-		fwrite(&size, 4, 1, fp);
+		sb_write(b, ptr, size);
+		sb_write(b, &size, 4);
 		free(buf);
-		fputs("INFS", fp);
+		sb_write(b, "INFS", 4);
 	}
 }
 
@@ -280,7 +526,13 @@ static void writeAsdFooter(enum save_format format, FILE *fp) {
 あとで free(*buf)するのを忘れないように
 */
 static void* loadGameData(int no, int *status, int *size) {
-	FILE *fp = fopen(nact->files.save_fname[no], "rb");
+	save_flush();
+	FILE *fp = NULL;
+	if (slot_write_failed(no)) {
+		WARNING("%s: the last save could not be written", nact->files.save_fname[no]);
+		goto errexit;
+	}
+	fp = fopen(nact->files.save_fname[no], "rb");
 	if (!fp)
 		goto errexit;
 	fseek(fp, 0L, SEEK_END);
@@ -308,20 +560,11 @@ static void* loadGameData(int no, int *status, int *size) {
 }
 
 static int saveGameData(int no, char *buf, int size) {
-	FILE *fp;
-	int status = SAVE_SAVEOK1;
-
-	fc_backup_oldfile(nact->files.save_fname[no]);
-	fp = fopen(nact->files.save_fname[no], "wb");
-	if (fp == NULL) {
-		return SAVE_SAVEERR;
-	}
-	if (1 != fwrite(buf, size, 1, fp)) {
-		status = SAVE_SAVEERR;
-	}
-	fclose(fp);
-	scheduleSync();
-	return status;
+	struct savebuf b = { .data = malloc(size), .len = size, .cap = size };
+	if (!b.data)
+		NOMEMERR();
+	memcpy(b.data, buf, size);
+	return write_savebuf(no, &b);
 }
 
 int save_setFormat(const char *format_name) {
@@ -342,11 +585,13 @@ int save_setFormat(const char *format_name) {
 
 /* savefile を参照 */
 const char *save_get_file(int index) {
+	save_flush();
 	return nact->files.save_fname[index];
 }
 
 /* savefile を削除 */
 int save_delete_file(int index) {
+	save_flush();
 	int ret = unlink(nact->files.save_fname[index]);
 	
 	if (ret == 0) {
@@ -525,6 +770,38 @@ int save_savePartial(int no, struct VarRef *vref, int cnt) {
 	cnt = min(cnt, v_sliceSize(vref));
 	int *var = v_resolveRef(vref);
 	
+#ifdef HAVE_MEMORY_MAPPED_FILE
+	// Patch the variables in place, without rewriting the whole file.
+	save_flush();
+	uint64_t start = SDL_GetPerformanceCounter();
+	struct stat st;
+	const char *fname = nact->files.save_fname[no];
+	if (!slot_write_failed(no) && stat(fname, &st) == 0 && st.st_size > sizeof(asd_baseHdr)) {
+		mmap_t *m = map_file_readwrite(fname, st.st_size);
+		if (m) {
+			int status = SAVE_SAVEERR;
+			asd_baseHdr *save_base = m->addr;
+			int offset = save_base->varSys[vref->page];
+			size_t end = offset + sizeof(asd_varPageHdr) + (vref->index + cnt) * sizeof(uint16_t);
+			if (save_base->version != SAVE_DATAVERSION) {
+				WARNING("endian mismatch");
+			} else if (offset > 0 && end <= st.st_size) {
+				uint8_t *p = (uint8_t *)m->addr + offset + sizeof(asd_varPageHdr) + vref->index * sizeof(uint16_t);
+				for (int i = 0; i < cnt; i++) {
+					*p++ = var[i] & 0xff;
+					*p++ = (var[i] >> 8) & 0xff;
+				}
+				status = SAVE_SAVEOK1;
+			}
+			unmap_file(m);
+			scheduleSync();
+			stats.partial_saves++;
+			stats.partial_time += SDL_GetPerformanceCounter() - start;
+			return status;
+		}
+	}
+#endif
+
 	int status, filesize;
 	char *saveTop = loadGameData(no, &status, &filesize);
 	if (saveTop == NULL)
@@ -642,10 +919,9 @@ int save_saveAll(int no) {
 	if (no >= SAVE_MAXNUMBER)
 		return SAVE_SAVEERR;
 	
-	fc_backup_oldfile(nact->files.save_fname[no]);
-	FILE *fp = fopen(nact->files.save_fname[no], "wb");
-	if (!fp)
-		return SAVE_SAVEERR;
+	uint64_t start = SDL_GetPerformanceCounter();
+	struct savebuf b = {};
+	sb_reserve(&b, sizeof(asd_baseHdr));
 	
 	/* 各種データのセーブ */
 	strncpy(save_base.ID, save_signature[format], 32);
@@ -681,48 +957,30 @@ int save_saveAll(int no) {
 		save_base.msgWinInfo[i].height = (uint16_t)nact->msg.wininfo[j].height;
 	}
 
-	fseek(fp, sizeof(asd_baseHdr), SEEK_SET);
-	
 	/* スタック情報 */
 	save_base.stackinfo = totalsize;
-	totalsize += saveStack(format, fp);
-	if (ferror(fp))
-		goto errexit;
+	totalsize += saveStack(format, &b);
 	
 	/* 文字列変数 */
 	save_base.varStr = totalsize;
-	totalsize += saveStrVars(format, fp);
-	if (ferror(fp))
-		goto errexit;
+	totalsize += saveStrVars(format, &b);
 	
 	/* 数値変数・配列変数 */
 	for (int i = 0; i < 256; i++) {
-		int size = saveVarPage(i, fp);
+		int size = saveVarPage(i, &b);
 		if (size) {
 			save_base.varSys[i] = totalsize;
 			totalsize += size;
 		} else {
 			save_base.varSys[i] = 0;
 		}
-		if (ferror(fp))
-			goto errexit;
 	}
 	
-	fseek(fp, 0, SEEK_SET);
-	
-	if (1 != fwrite(&save_base, sizeof(asd_baseHdr), 1, fp))
-		goto errexit;
-	
-	fseek(fp, 0L, SEEK_END);
-	writeAsdFooter(format, fp);
-
-	fclose(fp);
-	scheduleSync();
+	memcpy(b.data, &save_base, sizeof(asd_baseHdr));
+	writeAsdFooter(format, &b);
 
-	return SAVE_SAVEOK1;
-	
- errexit:
-	fclose(fp);
-	return SAVE_SAVEERR;
+	stats.saves++;
+	stats.serialize_time += SDL_GetPerformanceCounter() - start;
+	return write_savebuf(no, &b);
 }
 
@@ -56,5 +56,8 @@ int save_strs_to_file(char *fname_utf8, int start, int cnt);
 int load_strs_from_file(char *fname_utf8, int start, int cnt);
 const char *save_get_file(int index);
 int save_delete_file(int index);
+void save_flush(void);
+void save_remove(void);
+void save_print_stats(void);
 
 #endif /* __SAVEDATA__ */
@@ -27,6 +27,8 @@
 
 #include "portab.h"
 #include "ald_manager.h"
+#include "cache.h"
+#include "cg.h"
 #include "variable.h"
 #include "scenario.h"
 #include "LittleEndian.h"
@@ -44,8 +46,29 @@ static int stack_size = 1024;
 
 static char strbuf[512];
 
-static dridata *dfile;   // dri object for current page
-static dridata *datatbl; // dri object for data table
+/* scenario page */
+struct sco_page {
+	const uint8_t *data;
+	int size;
+	dridata *dfile;  // NULL if the page lives in the preload arena
+	int pinned;      // nonzero while the page must not be evicted
+};
+
+#define SCO_CACHE_SIZE 4  // MB
+
+static struct sco_page *cur_page;  // current page
+static struct sco_page *datatbl;   // page of the data table
+
+/* recently used pages, kept for page calls and returns */
+static cacher *sco_cache;
+
+/* all pages loaded at startup into one buffer (-scopreload) */
+static boolean preload;
+static struct {
+	uint8_t *buf;
+	struct sco_page *pages;
+	int nr_pages;
+} arena;
 
 static void stack_reserve(int size) {
 	if (stack_top + size < stack_buf + stack_size)
@@ -93,6 +116,102 @@ static int stack_pop_dword(void) {
 	return LittleEndian_getDW(stack_top, 0);
 }
 
+static void free_page(struct sco_page *p) {
+	ald_freedata(p->dfile);
+	free(p);
+}
+
+/*
+ * Load all scenario pages into a single buffer, so that page transitions
+ * never touch the archive or allocate memory.
+ */
+static void preload_pages(void) {
+	int nr = ald_get_maxno(DRIFILE_SCO);
+	size_t *offsets = calloc(nr, sizeof(size_t));
+	arena.pages = calloc(nr, sizeof(struct sco_page));
+	if (!offsets || !arena.pages)
+		NOMEMERR();
+
+	size_t total = 0, capacity = 0;
+	for (int i = 0; i < nr; i++) {
+		dridata *d = ald_getdata(DRIFILE_SCO, i);
+		if (!d)
+			continue;
+		if (total + d->size > capacity) {
+			capacity = (total + d->size) * 2;
+			arena.buf = realloc(arena.buf, capacity);
+			if (!arena.buf)
+				NOMEMERR();
+		}
+		memcpy(arena.buf + total, d->data, d->size);
+		offsets[i] = total;
+		arena.pages[i].size = d->size;
+		total += d->size;
+		ald_freedata(d);
+	}
+	for (int i = 0; i < nr; i++) {
+		if (arena.pages[i].size)
+			arena.pages[i].data = arena.buf + offsets[i];
+	}
+	arena.nr_pages = nr;
+	free(offsets);
+	NOTICE("preloaded %d scenario pages (%zu bytes)", nr, total);
+}
+
+/*
+ * Mark (or unmark) the pages that must survive cache eviction: the current
+ * page, the data table, and the callers on the page call stack.
+ */
+static void pin_pages(int pinned) {
+	if (cur_page)
+		cur_page->pinned = pinned;
+	if (datatbl)
+		datatbl->pinned = pinned;
+	struct stack_frame_info sfi = { .p = stack_top };
+	for (struct stack_frame_info *f = sl_next_stack_frame(&sfi); f; f = sl_next_stack_frame(f)) {
+		if (f->tag != STACK_FARCALL)
+			continue;
+		struct sco_page *p = cache_peek(sco_cache, f->page);
+		if (p)
+			p->pinned = pinned;
+	}
+}
+
+/*
+ * Get a scenario page
+ *   page: page number (0-based)
+ *   return: page object, or NULL if the page does not exist
+ */
+static struct sco_page *get_page(int page) {
+	if (page < 0)
+		return NULL;
+	if (arena.buf)
+		return page < arena.nr_pages && arena.pages[page].data ? &arena.pages[page] : NULL;
+
+	struct sco_page *p = cache_lookup(sco_cache, page);
+	if (p)
+		return p;
+
+	dridata *d = ald_getdata(DRIFILE_SCO, page);
+	if (!d)
+		return NULL;
+	p = calloc(1, sizeof(struct sco_page));
+	if (!p)
+		NOMEMERR();
+	p->data = (const uint8_t *)d->data;
+	p->size = d->size;
+	p->dfile = d;
+
+	pin_pages(1);
+	cache_insert(sco_cache, page, p, p->size, &p->pinned);
+	pin_pages(0);
+	return p;
+}
+
+void sl_set_preload(boolean enable) {
+	preload = enable;
+}
+
 /* initilize stack and load first scenario data */
 boolean sl_init(void) {
 	stack_buf = malloc(stack_size);
@@ -100,6 +219,12 @@ boolean sl_init(void) {
 		NOMEMERR();
 	
 	stack_top = stack_buf;
+	if (!sco_cache) {
+		sco_cache = cache_new("sco", free_page);
+		cache_set_budget(sco_cache, (size_t)SCO_CACHE_SIZE << 20);
+	}
+	if (preload && !arena.buf)
+		preload_pages();
 	sl_jmpFar(0);
 
 	return TRUE;
@@ -108,6 +233,8 @@ boolean sl_init(void) {
 /* UD 0 command, reinitilized scenario loader */
 boolean sl_reinit(void) {
 	free(stack_buf);
+	cmd_check_reset();
+	cali_reset();
 	return sl_init();
 }
 
@@ -133,6 +260,10 @@ int sl_getdAt(int adr) {
 	return c0 + (c1 << 16);
 }
 
+int sl_getPageSize(void) {
+	return cur_page ? cur_page->size : 0;
+}
+
 int sl_getaddr(void) {
 	int c0 = sl_getw();
 	int c1 = sl_getw();
@@ -175,18 +306,16 @@ void sl_jmpNear(int address) {
    page = 0~
 */
 boolean sl_jmpFar(int page) {
-	if (dfile) {
-		ald_freedata(dfile);
-	}
-	
-	dfile = ald_getdata(DRIFILE_SCO, page);
-	if (dfile == NULL) {
+	struct sco_page *p = get_page(page);
+	if (p == NULL) {
 		return FALSE;
 	}
 		
-	sl_sco   = dfile->data;
+	cur_page = p;
+	sl_sco   = p->data;
 	sl_page  = page;
 	sl_index = LittleEndian_getDW(sl_sco, 4);
+	cg_prefetch_scan();
 	return TRUE;
 }
 
@@ -195,18 +324,16 @@ boolean sl_jmpFar(int page) {
    page = 1~
 */
 boolean sl_jmpFar2(int page, int address) {
-	if (dfile) {
-		ald_freedata(dfile);
-	}
-	
-	dfile = ald_getdata(DRIFILE_SCO, page);
-	if (dfile == NULL) {
+	struct sco_page *p = get_page(page);
+	if (p == NULL) {
 		DEBUG_MESSAGE("ald_getdata fail\n");
 		return FALSE;
 	}
-	sl_sco   = dfile->data;
+	cur_page = p;
+	sl_sco   = p->data;
 	sl_page  = page;
 	sl_index = address;
+	cg_prefetch_scan();
 	return TRUE;
 }
 
@@ -740,10 +867,11 @@ struct stack_frame_info *sl_next_stack_frame(struct stack_frame_info *sfi) {
 }
 
 void *sl_setDataTable(int page, int index) {
-	if (datatbl) {
-		ald_freedata(datatbl);
+	datatbl = get_page(page);
+	if (datatbl == NULL) {
+		WARNING("cannot load data table page %d", page);
+		return NULL;
 	}
-	datatbl = ald_getdata(DRIFILE_SCO, page);
 	return (void *)(datatbl->data + index);
 }
 
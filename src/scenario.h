@@ -61,12 +61,14 @@ extern int sl_index;       // cureent scenario address
 
 boolean sl_init(void);
 boolean sl_reinit(void);
+void sl_set_preload(boolean enable);
 int sl_getw(void);
 #define sl_getdw sl_getaddr
 int sl_getdAt(int address);
 int sl_getwAt(int address);
 int sl_getcAt(int address);
 int sl_getaddr(void);
+int sl_getPageSize(void);
 void sl_ungetc(void);
 const char *sl_getString(char term);
 const char *sl_getConstString(void);
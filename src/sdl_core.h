@@ -48,6 +48,8 @@ extern boolean sdl_isFullscreen(void);
 extern void sdl_raiseWindow(void);
 extern agsurface_t *sdl_getDIB(void);
 extern void sdl_setIntegerScaling(boolean enable);
+extern void sdl_setHeadless(boolean enable);
+extern boolean sdl_isHeadless(void);
 
 /* 画面更新 */
 extern void sdl_updateArea(MyRectangle *src, MyPoint *dst);
@@ -111,7 +113,10 @@ extern uint32_t sdl_getTicks(void);
 extern void sdl_sleep(int msec);
 extern void sdl_wait_vsync();
 extern boolean sdl_inputString(struct inputstring_param *);
-extern void sdl_post_debugger_command(void *data);
+extern void sdl_post_debugger_command(void);
 extern void sdl_handle_event(SDL_Event *e);
 
+/* 入力のリプレイ */
+extern boolean sdl_replay_open(const char *path);
+
 #endif /* !__SDL_CORE__ */
@@ -41,6 +41,17 @@
 #include "image.h"
 #include "nact.h"
 #include "debugger.h"
+#include "profiler.h"
+
+/*
+ * Inverse palette: an RGB cube with 6 bits per channel that maps a color to
+ * the nearest palette index. Cells are filled on first use and the whole
+ * cube is invalidated when the palette changes.
+ */
+#define INVPAL_BITS 6
+#define INVPAL_SIZE (1 << (INVPAL_BITS * 3))
+static uint8_t invpal[INVPAL_SIZE];
+static uint8_t invpal_valid[INVPAL_SIZE / 8];
 
 static void sdl_pal_check(void) {
 	if (nact->ags.pal_changed) {
@@ -55,28 +66,151 @@ static Uint32 palette_color(uint8_t c) {
 	return SDL_MapRGB(sdl_dib->format, sdl_col[c].r, sdl_col[c].g, sdl_col[c].b);
 }
 
+static int rect_area(const SDL_Rect *r) {
+	return r->w * r->h;
+}
+
+static SDL_Rect rect_union(const SDL_Rect *a, const SDL_Rect *b) {
+	SDL_Rect u;
+	SDL_UnionRect(a, b, &u);
+	return u;
+}
+
+/*
+ * 二つの矩形をまとめて転送した方が得かどうか。
+ * 重なっている / 隣接している場合の他、まとめることで増える無駄な
+ * 領域が元の面積の合計以下ならまとめる (転送一回あたりのコストがあるため)
+*/
+static boolean should_merge(const SDL_Rect *a, const SDL_Rect *b) {
+	SDL_Rect u = rect_union(a, b);
+	return rect_area(&u) <= 2 * (rect_area(a) + rect_area(b));
+}
+
+/* display の更新領域を登録 */
+void sdl_addDamage(const SDL_Rect *r) {
+	sdl_dirty = TRUE;
+	if (sdl_videodev->damage_all)
+		return;
+
+	SDL_Rect screen = {0, 0, sdl_display->w, sdl_display->h};
+	SDL_Rect rect;
+	if (!SDL_IntersectRect(r, &screen, &rect))
+		return;
+
+	// 既存の矩形とまとめられる限りまとめる
+	for (int i = 0; i < sdl_videodev->nr_damage; ) {
+		SDL_Rect *d = &sdl_videodev->damage[i];
+		if (!should_merge(d, &rect)) {
+			i++;
+			continue;
+		}
+		rect = rect_union(d, &rect);
+		*d = sdl_videodev->damage[--sdl_videodev->nr_damage];
+		i = 0;
+	}
+
+	if (sdl_videodev->nr_damage == SDL_DAMAGE_MAX
+		|| rect_area(&rect) * 4 >= rect_area(&screen) * 3) {
+		sdl_damageAll();
+		return;
+	}
+	sdl_videodev->damage[sdl_videodev->nr_damage++] = rect;
+}
+
+/* display 全体を更新領域とする */
+void sdl_damageAll(void) {
+	sdl_dirty = TRUE;
+	sdl_videodev->damage_all = TRUE;
+	sdl_videodev->nr_damage = 0;
+}
+
+static void upload_damage(void) {
+	SDL_Surface *s = sdl_display;
+	int fullframe = s->h * s->pitch;
+	int uploaded = 0;
+
+	if (sdl_videodev->damage_all) {
+		SDL_UpdateTexture(sdl_texture, NULL, s->pixels, s->pitch);
+		uploaded = fullframe;
+	} else {
+		for (int i = 0; i < sdl_videodev->nr_damage; i++) {
+			SDL_Rect *r = &sdl_videodev->damage[i];
+			uint8_t *p = (uint8_t *)s->pixels + r->y * s->pitch + r->x * s->format->BytesPerPixel;
+			SDL_UpdateTexture(sdl_texture, r, p, s->pitch);
+			uploaded += r->w * r->h * s->format->BytesPerPixel;
+		}
+	}
+	sdl_videodev->damage_all = FALSE;
+	sdl_videodev->nr_damage = 0;
+
+	if (uploaded) {
+		sdl_videodev->upload_stats.frames++;
+		sdl_videodev->upload_stats.uploaded_bytes += uploaded;
+		sdl_videodev->upload_stats.fullframe_bytes += fullframe;
+	}
+}
+
+/* 未転送の display 領域を texture へ反映する (present はしない) */
+void sdl_flushDamage(void) {
+	if (sdl_isHeadless())
+		return;
+	upload_damage();
+}
+
+void sdl_printUploadStats(void) {
+	unsigned frames = sdl_videodev->upload_stats.frames;
+	uint64_t uploaded = sdl_videodev->upload_stats.uploaded_bytes;
+	uint64_t fullframe = sdl_videodev->upload_stats.fullframe_bytes;
+	if (!frames)
+		return;
+	NOTICE("display upload: %u frames, %llu KB uploaded / %llu KB full-frame (%.1f%%), %llu bytes/frame",
+		   frames, (unsigned long long)(uploaded / 1024), (unsigned long long)(fullframe / 1024),
+		   fullframe ? uploaded * 100.0 / fullframe : 0.0,
+		   (unsigned long long)(uploaded / frames));
+}
+
 void sdl_updateScreen(void) {
 	if (!sdl_dirty)
 		return;
-	SDL_UpdateTexture(sdl_texture, NULL, sdl_display->pixels, sdl_display->pitch);
+	if (sdl_isHeadless()) {
+		sdl_videodev->damage_all = FALSE;
+		sdl_videodev->nr_damage = 0;
+		sdl_dirty = false;
+		return;
+	}
+	upload_damage();
 	SDL_RenderClear(sdl_renderer);
 	SDL_RenderCopy(sdl_renderer, sdl_texture, NULL, NULL);
 	SDL_RenderPresent(sdl_renderer);
 	sdl_dirty = false;
 }
 
+// headless モードでの仮想時計。sleep/vsync 待ちで即座に進む。
+static uint32_t virtual_ticks;
+
 uint32_t sdl_getTicks(void) {
+	if (sdl_isHeadless())
+		return virtual_ticks;
 	return SDL_GetTicks();
 }
 
 void sdl_sleep(int msec) {
 	sdl_updateScreen();
 	dbg_onsleep();
+	if (sdl_isHeadless()) {
+		if (msec > 0)
+			virtual_ticks += msec;
+		return;
+	}
+	if (prof_active)
+		prof_begin_wait();
 #ifdef __EMSCRIPTEN__
 	emscripten_sleep(msec);
 #else
 	SDL_Delay(msec);
 #endif
+	if (prof_active)
+		prof_end_wait();
 }
 
 #ifdef __EMSCRIPTEN__
@@ -92,11 +226,19 @@ EM_JS(void, wait_vsync, (void), {
 void sdl_wait_vsync() {
 	sdl_updateScreen();
 	dbg_onsleep();
+	if (sdl_isHeadless()) {
+		virtual_ticks += 16;
+		return;
+	}
+	if (prof_active)
+		prof_begin_wait();
 #ifdef __EMSCRIPTEN__
 	wait_vsync();
 #else
 	SDL_Delay(16);
 #endif
+	if (prof_active)
+		prof_end_wait();
 }
 
 /* off-screen の指定領域を Main Window へ転送 */
@@ -105,7 +247,7 @@ void sdl_updateArea(MyRectangle *src, MyPoint *dst) {
 	
 	SDL_BlitSurface(sdl_dib, src, sdl_display, &rect_d);
 	
-	sdl_dirty = TRUE;
+	sdl_addDamage(&rect_d);
 }
 
 /* 全画面更新 */
@@ -114,7 +256,7 @@ void sdl_updateAll(MyRectangle *view_rect) {
 	
 	SDL_BlitSurface(sdl_dib, view_rect, sdl_display, &rect);
 
-	sdl_dirty = TRUE;
+	sdl_damageAll();
 }
 
 /* Color の複数個指定 */
@@ -124,6 +266,7 @@ void sdl_setPalette(Palette256 *pal, int first, int count) {
 		sdl_col[first + i].g = pal->green[first + i];
 		sdl_col[first + i].b = pal->blue [first + i];
 	}
+	memset(invpal_valid, 0, sizeof(invpal_valid));
 	if (sdl_dib->format->BitsPerPixel == 8)
 		SDL_SetPaletteColors(sdl_dib->format->palette, &sdl_col[first], first, count);
 }
@@ -290,7 +433,7 @@ SDL_Surface *com2surface(agsurface_t *s) {
 		s->pixel, s->width, s->height, s->depth, s->bytes_per_line, 0, 0, 0, 0);
 }
 
-int sdl_nearest_color(int r, int g, int b) {
+static int search_nearest_color(int r, int g, int b) {
 	int i, col, mind = INT_MAX;
 	for (i = 0; i < 256; i++) {
 		int dr = r - sdl_col[i].r;
@@ -305,6 +448,20 @@ int sdl_nearest_color(int r, int g, int b) {
 	return col;
 }
 
+int sdl_nearest_color(int r, int g, int b) {
+	const int shift = 8 - INVPAL_BITS;
+	int idx = (r >> shift) << (INVPAL_BITS * 2) | (g >> shift) << INVPAL_BITS | b >> shift;
+	if (!(invpal_valid[idx >> 3] & 1 << (idx & 7))) {
+		// Search for the color at the center of the cell.
+		const int half = 1 << (shift - 1);
+		invpal[idx] = search_nearest_color((r >> shift << shift) | half,
+		                                   (g >> shift << shift) | half,
+		                                   (b >> shift << shift) | half);
+		invpal_valid[idx >> 3] |= 1 << (idx & 7);
+	}
+	return invpal[idx];
+}
+
 SDL_Rect sdl_drawString(int x, int y, const char *str_utf8, uint8_t col) {
 	sdl_pal_check();
 	return font_draw_glyph(x, y, str_utf8, col);
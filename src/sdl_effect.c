@@ -21,6 +21,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 #include <SDL.h>
 
 #include "system.h"
@@ -119,19 +120,66 @@ struct sdl_effect {
 	SDL_Texture *tx_old, *tx_new;
 };
 
-static void effect_init(struct sdl_effect *eff, SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+// エフェクト用のテクスチャは解放せずにプールしておき、次のエフェクトで再利用する。
+#define TEXTURE_POOL_SIZE 8
+
+static struct {
+	SDL_Texture *pool[TEXTURE_POOL_SIZE];  // 古いものから順に並ぶ
+	int count;
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	SDL_ScaleMode default_scale_mode;
+#endif
+} textures;
+
+static SDL_Texture *acquire_texture(Uint32 format, int access, int w, int h) {
+	for (int i = textures.count - 1; i >= 0; i--) {
+		SDL_Texture *tx = textures.pool[i];
+		Uint32 f;
+		int a, tw, th;
+		SDL_QueryTexture(tx, &f, &a, &tw, &th);
+		if (f != format || a != access || tw != w || th != h)
+			continue;
+		textures.pool[i] = textures.pool[--textures.count];
+		// 新規に作成したテクスチャと同じ状態に戻す
+		SDL_SetTextureBlendMode(tx, SDL_ISPIXELFORMAT_ALPHA(format) ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+		SDL_SetTextureAlphaMod(tx, 255);
+		SDL_SetTextureColorMod(tx, 255, 255, 255);
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+		SDL_SetTextureScaleMode(tx, textures.default_scale_mode);
+#endif
+		return tx;
+	}
+	SDL_Texture *tx = SDL_CreateTexture(sdl_renderer, format, access, w, h);
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	if (tx)
+		SDL_GetTextureScaleMode(tx, &textures.default_scale_mode);
+#endif
+	return tx;
+}
+
+static void release_texture(SDL_Texture *tx) {
+	if (!tx)
+		return;
+	if (textures.count == TEXTURE_POOL_SIZE) {
+		SDL_DestroyTexture(textures.pool[0]);
+		memmove(textures.pool, textures.pool + 1, --textures.count * sizeof(SDL_Texture *));
+	}
+	textures.pool[textures.count++] = tx;
+}
+
+void sdl_effect_free_textures(void) {
+	for (int i = 0; i < textures.count; i++)
+		SDL_DestroyTexture(textures.pool[i]);
+	textures.count = 0;
+}
+
+static void effect_init(struct sdl_effect *eff, SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	eff->type = type;
 	eff->dst_rect = *rect;
 	eff->is_fullscreen = rect->x == 0 && rect->y == 0
 		&& rect->w == sdl_display->w && rect->h == sdl_display->h;
-	if (old) {
-		eff->tx_old = SDL_CreateTextureFromSurface(sdl_renderer, old);
-		SDL_FreeSurface(old);
-	}
-	if (new) {
-		eff->tx_new = SDL_CreateTextureFromSurface(sdl_renderer, new);
-		SDL_FreeSurface(new);
-	}
+	eff->tx_old = old;
+	eff->tx_new = new;
 
 	if (!eff->is_fullscreen)
 		sdl_updateScreen();  // Flush pending display changes.
@@ -145,10 +193,8 @@ static void effect_finish(struct sdl_effect *eff, bool present) {
 		SDL_RenderCopy(sdl_renderer, eff->tx_new, NULL, &eff->dst_rect);
 		SDL_RenderPresent(sdl_renderer);
 	}
-	if (eff->tx_old)
-		SDL_DestroyTexture(eff->tx_old);
-	if (eff->tx_new)
-		SDL_DestroyTexture(eff->tx_new);
+	release_texture(eff->tx_old);
+	release_texture(eff->tx_new);
 }
 
 static inline void flip_rect_h(SDL_Rect *r, int w) {
@@ -178,7 +224,7 @@ static inline void move_rect(SDL_Rect *r, int off_x, int off_y) {
 static void crossfade_step(struct sdl_effect *eff, double progress);
 static void crossfade_free(struct sdl_effect *eff);
 
-static struct sdl_effect *crossfade_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new) {
+static struct sdl_effect *crossfade_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -202,7 +248,7 @@ static void crossfade_free(struct sdl_effect *eff) {
 	free(eff);
 }
 
-static struct sdl_effect *fallback_effect_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *fallback_effect_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	WARNING("Effect %d is not supported in this system. Falling back to crossfade.", type);
 	return crossfade_new(rect, old, new);
 }
@@ -212,7 +258,7 @@ static struct sdl_effect *fallback_effect_new(SDL_Rect *rect, SDL_Surface *old,
 static void crossfade_animation_step(struct sdl_effect *eff, double progress);
 static void crossfade_animation_free(struct sdl_effect *eff);
 
-static struct sdl_effect *crossfade_animation_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *crossfade_animation_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -327,7 +373,7 @@ struct mosaic_effect {
 static void mosaic_step(struct sdl_effect *eff, double progress);
 static void mosaic_free(struct sdl_effect *eff);
 
-static struct sdl_effect *mosaic_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *mosaic_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	if (!SDL_RenderTargetSupported(sdl_renderer))
 		return fallback_effect_new(rect, old, new, type);
 
@@ -335,9 +381,9 @@ static struct sdl_effect *mosaic_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surfa
 	if (!eff)
 		NOMEMERR();
 	effect_init(&eff->eff, rect, old, new, type);
-	eff->tmp_old = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
-	eff->tmp_new = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
-	eff->tx_mosaic = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
+	eff->tmp_old = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
+	eff->tmp_new = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
+	eff->tx_mosaic = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
 	eff->eff.step = mosaic_step;
 	eff->eff.finish = mosaic_free;
 	return &eff->eff;
@@ -399,9 +445,9 @@ static void mosaic_step(struct sdl_effect *eff, double progress) {
 
 static void mosaic_free(struct sdl_effect *eff) {
 	struct mosaic_effect *this = (struct mosaic_effect *)eff;
-	SDL_DestroyTexture(this->tmp_old);
-	SDL_DestroyTexture(this->tmp_new);
-	SDL_DestroyTexture(this->tx_mosaic);
+	release_texture(this->tmp_old);
+	release_texture(this->tmp_new);
+	release_texture(this->tx_mosaic);
 	effect_finish(&this->eff, true);
 	free(this);
 }
@@ -411,7 +457,7 @@ static void mosaic_free(struct sdl_effect *eff) {
 static void brightness_step(struct sdl_effect *eff, double progress);
 static void brightness_free(struct sdl_effect *eff);
 
-static struct sdl_effect *brightness_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *brightness_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -492,35 +538,35 @@ static SDL_Texture *create_dither_pattern_texture(int w, int h, int val) {
 			row[x] = col;
 	}
 
-	SDL_Texture *tx = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, w, h);
+	SDL_Texture *tx = acquire_texture(SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, w, h);
 	SDL_UpdateTexture(tx, NULL, pixels, w * 4);
 	free(pixels);
 	SDL_SetTextureBlendMode(tx, SDL_BLENDMODE_BLEND);
 	return tx;
 }
 
-static struct sdl_effect *dithering_fade_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *dithering_fade_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
 	switch (type) {
 	case EFFECT_DITHERING_FADEOUT:
-		SDL_FreeSurface(new);
+		release_texture(new);
 		effect_init(eff, rect, old, NULL, type);
 		eff->tx_new = create_dither_pattern_texture(rect->w, rect->h, 0);
 		break;
 	case EFFECT_DITHERING_FADEIN:
-		SDL_FreeSurface(old);
+		release_texture(old);
 		effect_init(eff, rect, new, NULL, type);
 		eff->tx_new = create_dither_pattern_texture(rect->w, rect->h, 0);
 		break;
 	case EFFECT_DITHERING_WHITEOUT:
-		SDL_FreeSurface(new);
+		release_texture(new);
 		effect_init(eff, rect, old, NULL, type);
 		eff->tx_new = create_dither_pattern_texture(rect->w, rect->h, 255);
 		break;
 	case EFFECT_DITHERING_WHITEIN:
-		SDL_FreeSurface(old);
+		release_texture(old);
 		effect_init(eff, rect, new, NULL, type);
 		eff->tx_new = create_dither_pattern_texture(rect->w, rect->h, 255);
 		break;
@@ -558,6 +604,7 @@ static void dithering_fade_free(struct sdl_effect *eff) {
 		SDL_FillRect(sdl_display, &eff->dst_rect, SDL_MapRGB(sdl_display->format, 0, 0, 0));
 	else if (eff->type == EFFECT_DITHERING_WHITEOUT)
 		SDL_FillRect(sdl_display, &eff->dst_rect, SDL_MapRGB(sdl_display->format, 255, 255, 255));
+	sdl_addDamage(&eff->dst_rect);
 	effect_finish(eff, false);
 	free(eff);
 }
@@ -567,7 +614,7 @@ static void dithering_fade_free(struct sdl_effect *eff) {
 static void wipe_step(struct sdl_effect *eff, double progress);
 static void wipe_free(struct sdl_effect *eff);
 
-static struct sdl_effect *wipe_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *wipe_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -641,7 +688,7 @@ static void wipe_free(struct sdl_effect *eff) {
 static void circle_wipe_step(struct sdl_effect *eff, double progress);
 static void circle_wipe_free(struct sdl_effect *eff);
 
-static struct sdl_effect *circle_wipe_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *circle_wipe_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -691,7 +738,7 @@ static void circle_wipe_free(struct sdl_effect *eff) {
 static void blind_step(struct sdl_effect *eff, double progress);
 static void blind_free(struct sdl_effect *eff);
 
-static struct sdl_effect *blind_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *blind_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -793,7 +840,7 @@ static void blind_free(struct sdl_effect *eff) {
 static void blend_animation_step(struct sdl_effect *eff, double progress);
 static void blend_animation_free(struct sdl_effect *eff);
 
-static struct sdl_effect *blend_animation_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *blend_animation_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -860,7 +907,7 @@ struct zoom_blend_blur_effect {
 static void zoom_blend_blur_step(struct sdl_effect *eff, double progress);
 static void zoom_blend_blur_free(struct sdl_effect *eff);
 
-static struct sdl_effect *zoom_blend_blur_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new) {
+static struct sdl_effect *zoom_blend_blur_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new) {
 	if (!SDL_RenderTargetSupported(sdl_renderer))
 		return fallback_effect_new(rect, old, new, EFFECT_ZOOM_BLEND_BLUR);
 
@@ -877,7 +924,7 @@ static void zoom_blend_blur_step(struct sdl_effect *eff, double progress) {
 	struct zoom_blend_blur_effect *this = (struct zoom_blend_blur_effect *)eff;
 
 	if (!this->tx[this->index]) {
-		this->tx[this->index] = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, eff->dst_rect.w, eff->dst_rect.h);
+		this->tx[this->index] = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, eff->dst_rect.w, eff->dst_rect.h);
 	}
 
 	double scale = (progress < 0.5 ? 1 - progress * 2 : (progress - 0.5) * 2) * 0.9 + 0.1;  // 0.1 - 1.0
@@ -911,7 +958,7 @@ static void zoom_blend_blur_free(struct sdl_effect *eff) {
 	struct zoom_blend_blur_effect *this = (struct zoom_blend_blur_effect *)eff;
 	for (int i = 0; i < ZOOM_BLEND_BLUR_STEPS; i++) {
 		if (this->tx[i])
-			SDL_DestroyTexture(this->tx[i]);
+			release_texture(this->tx[i]);
 	}
 	effect_finish(&this->eff, true);
 	free(this);
@@ -930,7 +977,7 @@ struct linear_blur_effect {
 static void linear_blur_step(struct sdl_effect *eff, double progress);
 static void linear_blur_free(struct sdl_effect *eff);
 
-static struct sdl_effect *linear_blur_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *linear_blur_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	if (!SDL_RenderTargetSupported(sdl_renderer))
 		return fallback_effect_new(rect, old, new, type);
 
@@ -947,7 +994,7 @@ static SDL_Texture *blur(struct linear_blur_effect *this, SDL_Texture *src, int
 	bool vertical = this->eff.type == EFFECT_LINEAR_BLUR_VERT;
 	int w = this->eff.dst_rect.w;
 	int h = this->eff.dst_rect.h;
-	SDL_Texture *dst = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, w, h);
+	SDL_Texture *dst = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, w, h);
 
 	SDL_SetRenderTarget(sdl_renderer, dst);
 	SDL_RenderClear(sdl_renderer);
@@ -1014,9 +1061,9 @@ static void linear_blur_free(struct sdl_effect *eff) {
 	struct linear_blur_effect *this = (struct linear_blur_effect *)eff;
 	for (int i = 0; i < LINEAR_BLUR_STEPS; i++) {
 		if (this->blurred_old[i])
-			SDL_DestroyTexture(this->blurred_old[i]);
+			release_texture(this->blurred_old[i]);
 		if (this->blurred_new[i])
-			SDL_DestroyTexture(this->blurred_new[i]);
+			release_texture(this->blurred_new[i]);
 	}
 	effect_finish(&this->eff, true);
 	free(this);
@@ -1032,14 +1079,14 @@ struct polygon_mask_effect {
 static void polygon_mask_step(struct sdl_effect *eff, double progress);
 static void polygon_mask_free(struct sdl_effect *eff);
 
-static struct sdl_effect *polygon_mask_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *polygon_mask_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 #if HAS_SDL_RenderGeometry
 	if (SDL_RenderTargetSupported(sdl_renderer)) {
 		struct polygon_mask_effect *pmf = calloc(1, sizeof(struct polygon_mask_effect));
 		if (!pmf)
 			NOMEMERR();
 		effect_init(&pmf->f, rect, old, new, type);
-		pmf->tx_tmp = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
+		pmf->tx_tmp = acquire_texture(SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
 		pmf->f.step = polygon_mask_step;
 		pmf->f.finish = polygon_mask_free;
 		return &pmf->f;
@@ -1275,7 +1322,7 @@ static void polygon_mask_step(struct sdl_effect *eff, double progress) {
 
 static void polygon_mask_free(struct sdl_effect *eff) {
 	struct polygon_mask_effect *this = (struct polygon_mask_effect *)eff;
-	SDL_DestroyTexture(this->tx_tmp);
+	release_texture(this->tx_tmp);
 	effect_finish(&this->f, true);
 	free(this);
 }
@@ -1287,7 +1334,7 @@ static void polygon_mask_free(struct sdl_effect *eff) {
 static void rotate_step(struct sdl_effect *eff, double progress);
 static void rotate_free(struct sdl_effect *eff);
 
-static struct sdl_effect *rotate_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *rotate_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -1350,7 +1397,7 @@ static void rotate_free(struct sdl_effect *eff) {
 static void polygon_rotate_step(struct sdl_effect *eff, double progress);
 static void polygon_rotate_free(struct sdl_effect *eff);
 
-static struct sdl_effect *polygon_rotate_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new, enum sdl_effect_type type) {
+static struct sdl_effect *polygon_rotate_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new, enum sdl_effect_type type) {
 	struct sdl_effect *eff = calloc(1, sizeof(struct sdl_effect));
 	if (!eff)
 		NOMEMERR();
@@ -1415,7 +1462,7 @@ struct zigzag_crossfade_effect {
 static void zigzag_crossfade_step(struct sdl_effect *eff, double progress);
 static void zigzag_crossfade_free(struct sdl_effect *eff);
 
-static struct sdl_effect *zigzag_crossfade_new(SDL_Rect *rect, SDL_Surface *old, SDL_Surface *new) {
+static struct sdl_effect *zigzag_crossfade_new(SDL_Rect *rect, SDL_Texture *old, SDL_Texture *new) {
 	if (!SDL_RenderTargetSupported(sdl_renderer))
 		return fallback_effect_new(rect, old, new, EFFECT_ZIGZAG_CROSSFADE);
 
@@ -1423,8 +1470,8 @@ static struct sdl_effect *zigzag_crossfade_new(SDL_Rect *rect, SDL_Surface *old,
 	if (!eff)
 		NOMEMERR();
 	effect_init(&eff->eff, rect, old, new, EFFECT_ZIGZAG_CROSSFADE);
-	eff->tmp1 = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
-	eff->tmp2 = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
+	eff->tmp1 = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
+	eff->tmp2 = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
 	eff->eff.step = zigzag_crossfade_step;
 	eff->eff.finish = zigzag_crossfade_free;
 	return &eff->eff;
@@ -1479,8 +1526,8 @@ static void zigzag_crossfade_step(struct sdl_effect *eff, double progress) {
 
 static void zigzag_crossfade_free(struct sdl_effect *eff) {
 	struct zigzag_crossfade_effect *this = (struct zigzag_crossfade_effect *)eff;
-	SDL_DestroyTexture(this->tmp1);
-	SDL_DestroyTexture(this->tmp2);
+	release_texture(this->tmp1);
+	release_texture(this->tmp2);
 	effect_finish(&this->eff, true);
 	free(this);
 }
@@ -1495,11 +1542,11 @@ struct magnify_effect {
 static void magnify_step(struct sdl_effect *eff, double progress);
 static void magnify_free(struct sdl_effect *eff);
 
-static struct sdl_effect *magnify_new(SDL_Surface *sf, SDL_Rect *old_rect, SDL_Rect *new_rect) {
+static struct sdl_effect *magnify_new(SDL_Texture *tx, SDL_Rect *old_rect, SDL_Rect *new_rect) {
 	struct magnify_effect *eff = calloc(1, sizeof(struct magnify_effect));
 	if (!eff)
 		NOMEMERR();
-	effect_init(&eff->eff, old_rect, sf, NULL, EFFECT_MAGNIFY);
+	effect_init(&eff->eff, old_rect, tx, NULL, EFFECT_MAGNIFY);
 	eff->new_rect = *new_rect;
 	eff->eff.step = magnify_step;
 	eff->eff.finish = magnify_free;
@@ -1542,35 +1589,125 @@ static SDL_Surface *create_surface(agsurface_t *as, int x, int y, int w, int h)
 	return sf;
 }
 
+static inline void *pixel_at(SDL_Surface *sf, int x, int y) {
+	return (uint8_t *)sf->pixels + y * sf->pitch + x * sf->format->BytesPerPixel;
+}
+
+#define DIFF_TILE 32
+
+// src の (sx,sy) から w x h の領域を tx へ転送する。base が NULL でなければ、
+// tx は既に base の (bx,by) からの内容を持っているものとし、異なるタイルのみ転送する。
+static void upload_region(SDL_Texture *tx, SDL_Surface *src, int sx, int sy, SDL_Surface *base, int bx, int by, int w, int h) {
+	if (!base) {
+		SDL_UpdateTexture(tx, NULL, pixel_at(src, sx, sy), src->pitch);
+		return;
+	}
+	int bpp = src->format->BytesPerPixel;
+	for (int y0 = 0; y0 < h; y0 += DIFF_TILE) {
+		int th = min(DIFF_TILE, h - y0);
+		int run = -1;  // 転送待ちのタイル列の開始 x
+		for (int x0 = 0; ; x0 += DIFF_TILE) {
+			bool dirty = false;
+			if (x0 < w) {
+				int tw = min(DIFF_TILE, w - x0);
+				for (int y = y0; y < y0 + th && !dirty; y++)
+					dirty = memcmp(pixel_at(src, sx + x0, sy + y), pixel_at(base, bx + x0, by + y), tw * bpp) != 0;
+			}
+			if (dirty && run < 0) {
+				run = x0;
+			} else if (!dirty && run >= 0) {
+				SDL_Rect r = { run, y0, min(x0, w) - run, th };
+				SDL_UpdateTexture(tx, &r, pixel_at(src, sx + run, sy + y0), src->pitch);
+				run = -1;
+			}
+			if (x0 >= w)
+				break;
+		}
+	}
+}
+
+// as の (x,y) から w x h の領域をテクスチャにする。base_tx が与えられた場合、
+// その内容 (sdl_display の (bx,by) からの領域と同じもの) を GPU 上でコピーし、
+// 差分のあるタイルだけを転送する。
+static SDL_Texture *create_texture(agsurface_t *as, int x, int y, int w, int h, SDL_Texture *base_tx, int bx, int by) {
+	bool render_target = SDL_RenderTargetSupported(sdl_renderer);
+	SDL_Texture *tx = acquire_texture(SDL_PIXELFORMAT_RGB888, render_target ? SDL_TEXTUREACCESS_TARGET : SDL_TEXTUREACCESS_STATIC, w, h);
+
+	SDL_Surface *base = NULL;
+	if (base_tx && render_target) {
+		SDL_SetRenderTarget(sdl_renderer, tx);
+		SDL_RenderCopy(sdl_renderer, base_tx, NULL, NULL);
+		SDL_SetRenderTarget(sdl_renderer, NULL);
+		base = sdl_display;
+	}
+
+	// 同じ形式で領域がはみ出さなければ、中間サーフェスを作らずに直接転送する
+	SDL_Surface *src = !as ? sdl_display : as == sdl_dibinfo ? sdl_dib : NULL;
+	if (src && src->format->format == SDL_PIXELFORMAT_RGB888
+		&& x >= 0 && y >= 0 && x + w <= src->w && y + h <= src->h) {
+		upload_region(tx, src, x, y, base, bx, by, w, h);
+	} else {
+		src = create_surface(as, x, y, w, h);
+		upload_region(tx, src, 0, 0, base, bx, by, w, h);
+		SDL_FreeSurface(src);
+	}
+	return tx;
+}
+
+// 表示中の画面の rect の部分を、アップロード済みの sdl_texture から GPU 上でコピーする。
+static SDL_Texture *copy_display_texture(SDL_Rect *rect) {
+	if (sdl_isHeadless() || !SDL_RenderTargetSupported(sdl_renderer))
+		return NULL;  // sdl_texture が最新とは限らない
+	SDL_Rect screen = {0, 0, sdl_display->w, sdl_display->h};
+	SDL_Rect clipped;
+	if (!SDL_IntersectRect(rect, &screen, &clipped) || !SDL_RectEquals(rect, &clipped))
+		return NULL;
+
+	sdl_flushDamage();
+	SDL_Texture *tx = acquire_texture(SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_TARGET, rect->w, rect->h);
+	SDL_SetRenderTarget(sdl_renderer, tx);
+	SDL_RenderCopy(sdl_renderer, sdl_texture, rect, NULL);
+	SDL_SetRenderTarget(sdl_renderer, NULL);
+	return tx;
+}
+
 struct sdl_effect *sdl_effect_init(SDL_Rect *rect, agsurface_t *old, int ox, int oy, agsurface_t *new, int nx, int ny, enum sdl_effect_type type) {
-	SDL_Surface *sf_old = create_surface(old, ox, oy, rect->w, rect->h);
-	SDL_Surface *sf_new = create_surface(new, nx, ny, rect->w, rect->h);
+	SDL_Rect old_rect = { ox, oy, rect->w, rect->h };
+	SDL_Texture *tx_old = old ? NULL : copy_display_texture(&old_rect);
+	SDL_Texture *tx_new;
+	if (tx_old) {
+		// 新しい画面は古い画面から変化した部分だけを転送する
+		tx_new = create_texture(new, nx, ny, rect->w, rect->h, tx_old, ox, oy);
+	} else {
+		tx_old = create_texture(old, ox, oy, rect->w, rect->h, NULL, 0, 0);
+		tx_new = create_texture(new, nx, ny, rect->w, rect->h, NULL, 0, 0);
+	}
 
 	switch (type) {
 	case EFFECT_CROSSFADE:
-		return crossfade_new(rect, sf_old, sf_new);
+		return crossfade_new(rect, tx_old, tx_new);
 	case EFFECT_CROSSFADE_DOWN:
 	case EFFECT_CROSSFADE_UP:
 	case EFFECT_CROSSFADE_LR:
 	case EFFECT_CROSSFADE_RL:
 	case EFFECT_CROSSFADE_LR_RL:
 	case EFFECT_CROSSFADE_UP_DOWN:
-		return crossfade_animation_new(rect, sf_old, sf_new, type);
+		return crossfade_animation_new(rect, tx_old, tx_new, type);
 	case EFFECT_MOSAIC:
 	case EFFECT_CROSSFADE_MOSAIC:
-		return mosaic_new(rect, sf_old, sf_new, type);
+		return mosaic_new(rect, tx_old, tx_new, type);
 	case EFFECT_FADEOUT:
 	case EFFECT_FADEOUT_FROM_NEW:
 	case EFFECT_FADEIN:
 	case EFFECT_WHITEOUT:
 	case EFFECT_WHITEOUT_FROM_NEW:
 	case EFFECT_WHITEIN:
-		return brightness_new(rect, sf_old, sf_new, type);
+		return brightness_new(rect, tx_old, tx_new, type);
 	case EFFECT_DITHERING_FADEOUT:
 	case EFFECT_DITHERING_FADEIN:
 	case EFFECT_DITHERING_WHITEOUT:
 	case EFFECT_DITHERING_WHITEIN:
-		return dithering_fade_new(rect, sf_old, sf_new, type);
+		return dithering_fade_new(rect, tx_old, tx_new, type);
 	case EFFECT_WIPE_IN:
 	case EFFECT_WIPE_OUT:
 	case EFFECT_WIPE_LR:
@@ -1581,25 +1718,25 @@ struct sdl_effect *sdl_effect_init(SDL_Rect *rect, agsurface_t *old, int ox, int
 	case EFFECT_WIPE_IN_V:
 	case EFFECT_WIPE_OUT_H:
 	case EFFECT_WIPE_IN_H:
-		return wipe_new(rect, sf_old, sf_new, type);
+		return wipe_new(rect, tx_old, tx_new, type);
 	case EFFECT_CIRCLE_WIPE_OUT:
 	case EFFECT_CIRCLE_WIPE_IN:
-		return circle_wipe_new(rect, sf_old, sf_new, type);
+		return circle_wipe_new(rect, tx_old, tx_new, type);
 	case EFFECT_BLIND_DOWN:
 	case EFFECT_BLIND_UP:
 	case EFFECT_BLIND_LR:
 	case EFFECT_BLIND_RL:
 	case EFFECT_BLIND_UP_DOWN:
 	case EFFECT_BLIND_DOWN_LR:
-		return blind_new(rect, sf_old, sf_new, type);
+		return blind_new(rect, tx_old, tx_new, type);
 	case EFFECT_BLEND_UP_DOWN:
 	case EFFECT_BLEND_LR_RL:
-		return blend_animation_new(rect, sf_old, sf_new, type);
+		return blend_animation_new(rect, tx_old, tx_new, type);
 	case EFFECT_ZOOM_BLEND_BLUR:
-		return zoom_blend_blur_new(rect, sf_old, sf_new);
+		return zoom_blend_blur_new(rect, tx_old, tx_new);
 	case EFFECT_LINEAR_BLUR:
 	case EFFECT_LINEAR_BLUR_VERT:
-		return linear_blur_new(rect, sf_old, sf_new, type);
+		return linear_blur_new(rect, tx_old, tx_new, type);
 	case EFFECT_PENTAGRAM_IN_OUT:
 	case EFFECT_PENTAGRAM_OUT_IN:
 	case EFFECT_HEXAGRAM_IN_OUT:
@@ -1607,29 +1744,29 @@ struct sdl_effect *sdl_effect_init(SDL_Rect *rect, agsurface_t *old, int ox, int
 	case EFFECT_WINDMILL:
 	case EFFECT_WINDMILL_180:
 	case EFFECT_WINDMILL_360:
-		return polygon_mask_new(rect, sf_old, sf_new, type);
+		return polygon_mask_new(rect, tx_old, tx_new, type);
 	case EFFECT_ZOOM_IN:
 	case EFFECT_ROTATE_OUT:
 	case EFFECT_ROTATE_IN:
 	case EFFECT_ROTATE_OUT_CW:
 	case EFFECT_ROTATE_IN_CW:
-		return rotate_new(rect, sf_old, sf_new, type);
+		return rotate_new(rect, tx_old, tx_new, type);
 	case EFFECT_POLYGON_ROTATE_Y:
 	case EFFECT_POLYGON_ROTATE_Y_CW:
 	case EFFECT_POLYGON_ROTATE_X:
 	case EFFECT_POLYGON_ROTATE_X_CW:
-		return polygon_rotate_new(rect, sf_old, sf_new, type);
+		return polygon_rotate_new(rect, tx_old, tx_new, type);
 	case EFFECT_ZIGZAG_CROSSFADE:
-		return zigzag_crossfade_new(rect, sf_old, sf_new);
+		return zigzag_crossfade_new(rect, tx_old, tx_new);
 	default:
 		WARNING("Unknown effect %d", type);
-		return crossfade_new(rect, sf_old, sf_new);
+		return crossfade_new(rect, tx_old, tx_new);
 	}
 }
 
 struct sdl_effect *sdl_effect_magnify_init(agsurface_t *surface, SDL_Rect *view_rect, SDL_Rect *target_rect) {
-	SDL_Surface *sf = create_surface(surface, view_rect->x, view_rect->y, view_rect->w, view_rect->h);
-	return magnify_new(sf, view_rect, target_rect);
+	SDL_Texture *tx = create_texture(surface, view_rect->x, view_rect->y, view_rect->w, view_rect->h, NULL, 0, 0);
+	return magnify_new(tx, view_rect, target_rect);
 }
 
 void sdl_effect_step(struct sdl_effect *eff, double progress) {
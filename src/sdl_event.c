@@ -257,7 +257,7 @@ void sdl_handle_event(SDL_Event *e) {
 		break;
 #endif
 	case SDL_APP_DIDENTERFOREGROUND:
-		sdl_dirty = TRUE;
+		sdl_damageAll();
 		break;
 	case SDL_KEYDOWN:
 		keyEventProsess(&e->key, TRUE);
@@ -407,7 +407,8 @@ void sdl_handle_event(SDL_Event *e) {
 				}
 				break;
 			case DEBUGGER_COMMAND:
-				dbg_post_command(e->user.data1);
+				// Nothing to do; the debugger reads its queue after
+				// SDL_WaitEvent() returns.
 				break;
 			}
 		}
@@ -420,6 +421,9 @@ static void sdl_getEvent(void) {
 	static int cmd_count_of_prev_input = -1;
 	boolean had_input = false;
 
+	if (sdl_replay_poll())
+		had_input = true;
+
 	SDL_Event e;
 	while (SDL_PollEvent(&e)) {
 		had_input = true;
@@ -489,12 +493,12 @@ int sdl_getJoyInfo(void) {
 	return joyinfo;
 }
 
-void sdl_post_debugger_command(void *data) {
+/* Wake up the main thread when a debugger command has been queued. */
+void sdl_post_debugger_command(void) {
 	SDL_Event event = {
 		.user = {
 			.type = custom_event_type,
 			.code = DEBUGGER_COMMAND,
-			.data1 = data
 		}
 	};
 	SDL_PushEvent(&event);
@@ -30,6 +30,8 @@
 #include "portab.h"
 #include "ags.h"
 
+#define SDL_DAMAGE_MAX 16
+
 struct sdl_private_data {
 	SDL_Window *window;
 	SDL_Renderer *renderer;
@@ -45,7 +47,18 @@ struct sdl_private_data {
 	int     view_w;
 	int     view_h;
 	
-	boolean dirty;
+	boolean dirty;  /* needs RenderPresent */
+
+	/* display の領域のうち texture へ未転送のもの */
+	SDL_Rect damage[SDL_DAMAGE_MAX];
+	int nr_damage;
+	boolean damage_all;
+
+	struct {
+		unsigned frames;
+		uint64_t uploaded_bytes;
+		uint64_t fullframe_bytes;
+	} upload_stats;
 
 	boolean fs_on;
 
@@ -56,6 +69,12 @@ void sdl_event_init(void);
 void sdl_cursor_init(void);
 int sdl_nearest_color(int r, int g, int b);
 boolean sdl_joy_open(int index);
+void sdl_addDamage(const SDL_Rect *r);
+void sdl_damageAll(void);
+void sdl_flushDamage(void);
+void sdl_printUploadStats(void);
+boolean sdl_replay_poll(void);
+void sdl_effect_free_textures(void);
 
 extern struct sdl_private_data *sdl_videodev;
 
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Input replay for headless runs. The events of a replay file (see
+ * replay.c) are passed to sdl_handle_event() when the virtual clock reaches
+ * their time.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "portab.h"
+#include "system.h"
+#include "nact.h"
+#include "msgskip.h"
+#include "sdl_core.h"
+#include "sdl_private.h"
+#include "replay.h"
+
+// In headless mode, quit with an error if the game is still running this
+// long (on the virtual clock) after the last replay event. Otherwise a
+// replay without "quit" would wait for input forever.
+#define REPLAY_IDLE_TIMEOUT 60000
+
+static struct replay *replay;
+static int next_event;
+static boolean started;
+static uint32_t base_time;
+
+boolean sdl_replay_open(const char *path) {
+	replay_free(replay);
+	replay = replay_load(path);
+	next_event = 0;
+	started = FALSE;
+	return replay != NULL;
+}
+
+static void dispatch(struct replay_event *ev) {
+	SDL_Event e = {0};
+	switch (ev->action) {
+	case REPLAY_KEYDOWN:
+	case REPLAY_KEYUP:
+		e.type = ev->action == REPLAY_KEYDOWN ? SDL_KEYDOWN : SDL_KEYUP;
+		e.key.state = ev->action == REPLAY_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+		e.key.keysym.scancode = ev->a;
+		e.key.keysym.sym = SDL_GetKeyFromScancode(ev->a);
+		break;
+	case REPLAY_MOVE:
+		e.type = SDL_MOUSEMOTION;
+		e.motion.x = ev->a;
+		e.motion.y = ev->b;
+		break;
+	case REPLAY_BUTTONDOWN:
+	case REPLAY_BUTTONUP:
+		e.type = ev->action == REPLAY_BUTTONDOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+		e.button.state = ev->action == REPLAY_BUTTONDOWN ? SDL_PRESSED : SDL_RELEASED;
+		e.button.button = ev->a;
+		break;
+	case REPLAY_WHEEL:
+		e.type = SDL_MOUSEWHEEL;
+		e.wheel.y = ev->a;
+		e.wheel.direction = SDL_MOUSEWHEEL_NORMAL;
+		break;
+	case REPLAY_SKIP:
+		msgskip_activate(ev->a);
+		return;
+	case REPLAY_QUIT:
+		NOTICE("replay: quit");
+		nact_quit(FALSE);
+		return;
+	}
+	sdl_handle_event(&e);
+}
+
+/* 時刻に達したリプレイ入力を処理する。入力があれば TRUE */
+boolean sdl_replay_poll(void) {
+	if (!replay)
+		return FALSE;
+	uint32_t now = sdl_getTicks();
+	if (!started) {
+		started = TRUE;
+		base_time = now;
+	}
+	struct replay_event *events = replay->events;
+	int nr_events = replay->nr_events;
+	if (next_event >= nr_events) {
+		uint32_t last = nr_events ? events[nr_events - 1].time : 0;
+		if (sdl_isHeadless() && now - base_time > last + REPLAY_IDLE_TIMEOUT) {
+			WARNING("replay: no input left for %d seconds; giving up", REPLAY_IDLE_TIMEOUT / 1000);
+			sys_exit(1);
+		}
+		return FALSE;
+	}
+	boolean dispatched = FALSE;
+	while (next_event < nr_events && events[next_event].time <= now - base_time) {
+		// dispatch() may re-enter the event loop via agsevent callbacks.
+		struct replay_event ev = events[next_event++];
+		dispatch(&ev);
+		dispatched = TRUE;
+	}
+	return dispatched;
+}
@@ -42,6 +42,7 @@ static void makeDIB(int width, int height, int depth);
 struct sdl_private_data *sdl_videodev;
 static int joy_device_index = -1;
 static boolean integer_scaling = FALSE;
+static boolean headless = FALSE;
 
 static SDL_Joystick *js;
 
@@ -99,10 +100,12 @@ void sdl_Remove(void) {
 	if (sdl_videodev == NULL) return;
 
 	if (sdl_display) {
+		sdl_printUploadStats();
 		NOTICE("Now SDL shutdown ... ");
 		
 		SDL_FreeSurface(sdl_dib);
 
+		sdl_effect_free_textures();
 		SDL_DestroyRenderer(sdl_renderer);
 		
 		SDL_JoystickClose(js);
@@ -129,6 +132,8 @@ static void window_init(const char *render_driver) {
 		SDL_SetHint(SDL_HINT_RENDER_DRIVER, render_driver);
 	SDL_SetHint(SDL_HINT_TOUCH_MOUSE_EVENTS, "0");
 	SDL_SetHint(SDL_HINT_ACCELEROMETER_AS_JOYSTICK, "0");
+	if (headless)
+		SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
 
 	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK);
 	
@@ -263,6 +268,7 @@ void sdl_setWindowSize(int w, int h) {
 	sdl_display = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGB888);
 	sdl_texture = SDL_CreateTexture(sdl_renderer, sdl_display->format->format,
 									SDL_TEXTUREACCESS_STATIC, w, h);
+	sdl_damageAll();
 
 #ifdef __EMSCRIPTEN__
 	EM_ASM( xsystem35.shell.windowSizeChanged(); );
@@ -277,6 +283,20 @@ void sdl_setIntegerScaling(boolean enable) {
 	integer_scaling = enable;
 }
 
+/*
+ * headless モード: ダミーの video ドライバを使い、sdl_getTicks() は仮想時計
+ * を返す。sdl_Initialize() より前に呼ぶこと。
+ */
+void sdl_setHeadless(boolean enable) {
+	headless = enable;
+	if (enable)
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+}
+
+boolean sdl_isHeadless(void) {
+	return headless;
+}
+
 #ifdef __EMSCRIPTEN__
 
 void* EMSCRIPTEN_KEEPALIVE sdl_getDisplaySurface() {
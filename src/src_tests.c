@@ -19,9 +19,19 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+void cache_test(void);
+void cali_test(void);
+void debugger_expr_test(void);
 void gameresource_test(void);
 void hankaku_test(void);
+void midiseq_test(void);
+void msgqueue_test(void);
+void msgqueue_benchmark(void);
+void qnt_test(void);
+void replay_test(void);
+void utfsjis_test(void);
 
 void sys_error(char *format, ...) {
 	va_list args;
@@ -31,8 +41,27 @@ void sys_error(char *format, ...) {
 	exit(1);
 }
 
-int main() {
+void sys_message(int lv, char *format, ...) {
+}
+
+void sys_exit(int code) {
+	exit(code);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && !strcmp(argv[1], "--benchmark")) {
+		msgqueue_benchmark();
+		return 0;
+	}
+	cache_test();
+	cali_test();
+	debugger_expr_test();
 	gameresource_test();
 	hankaku_test();
+	midiseq_test();
+	msgqueue_test();
+	qnt_test();
+	replay_test();
+	utfsjis_test();
 	return 0;
 }
@@ -32,6 +32,7 @@
 #include "portab.h"
 #include "utfsjis.h"
 #include "s2utbl.h"
+#include "u2stbl.h"
 
 char* codeconv(CharacterEncoding tocode,
 			   CharacterEncoding fromcode,
@@ -80,20 +81,9 @@ uint8_t *sjis2utf(const uint8_t *src) {
 }
 
 static int unicode_to_sjis(int u) {
-	// U+30FB (KATAKANA MIDDLE DOT) is used as replacement character in
-	// s2utbl.h, so needs special treatment.
-	if (u == 0x30fb)
-		return 0x8145;
-
-	for (int b1 = 0x80; b1 <= 0xff; b1++) {
-		if (b1 >= 0xa0 && b1 <= 0xdf)
-			continue;
-		for (int b2 = 0x40; b2 <= 0xff; b2++) {
-			if (u == s2u[b1 - 0x80][b2 - 0x40])
-				return b1 << 8 | b2;
-		}
-	}
-	return 0;
+	if (u > 0xffff)
+		return 0;
+	return u2s[u >> 8][u & 0xff];
 }
 
 uint8_t *utf2sjis(const uint8_t *src) {
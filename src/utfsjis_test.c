@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdlib.h>
+#include "utfsjis.h"
+#include "unittest.h"
+
+static void ascii_hankaku_test(void) {
+	ASSERT_STRCMP(utf2sjis("abc ~"), "abc ~");
+	ASSERT_STRCMP(sjis2utf(utf2sjis("ｱｲｳｴｵﾞﾟ｡")), "ｱｲｳｴｵﾞﾟ｡");
+	ASSERT_STRCMP(utf2sjis("\xf0\x9f\x98\x80"), "?");  // U+1F600
+	ASSERT_STRCMP(utf2sjis("\xe2\x82\xac"), "?");  // U+20AC (EURO SIGN)
+}
+
+// Converts every entry of the SJIS->Unicode table back to SJIS.
+static void roundtrip_test(void) {
+	static boolean seen[0x10000];
+	for (int b1 = 0x80; b1 <= 0xff; b1++) {
+		if (b1 >= 0xa0 && b1 <= 0xdf)
+			continue;
+		for (int b2 = 0x40; b2 <= 0xff; b2++) {
+			uint8_t sjis[3] = {b1, b2, 0};
+			uint8_t *utf = sjis2utf(sjis);
+			const char *p = (const char *)utf;
+			int u = utf8_next_codepoint(&p);
+			ASSERT_EQUAL(*p, '\0');
+
+			uint8_t *back = utf2sjis(utf);
+			uint8_t *utf2 = sjis2utf(back);
+			ASSERT_STRCMP((char *)utf2, (char *)utf);
+
+			// For characters with multiple SJIS codes (NEC/IBM extensions),
+			// the first one is chosen. U+30FB is the replacement character
+			// in the table and maps to 0x8145.
+			int expected_first = u == 0x30fb ? b1 == 0x81 && b2 == 0x45 : !seen[u];
+			if (expected_first)
+				ASSERT_EQUAL(back[0] << 8 | back[1], b1 << 8 | b2);
+			seen[u] = TRUE;
+
+			free(utf);
+			free(back);
+			free(utf2);
+		}
+	}
+}
+
+void utfsjis_test(void) {
+	ascii_hankaku_test();
+	roundtrip_test();
+}
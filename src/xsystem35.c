@@ -72,6 +72,9 @@
 #include "filecheck.h"
 #include "s39init.h"
 #include "msgskip.h"
+#include "cg.h"
+#include "cache.h"
+#include "profiler.h"
 
 static char *gameResourceFile = "xsystem35.gr";
 static void    sys35_usage(boolean verbose);
@@ -92,12 +95,25 @@ enum {
 
 static int audio_buffer_size = 0;
 
+/* load all scenario pages at startup */
+static boolean scopreload = FALSE;
+
+/* headless (turbo) mode */
+static boolean headless = FALSE;
+static uint32_t headless_start_ticks;
+static uint64_t headless_cmd_count;
+
+/* scenario profiler output */
+static char *profile_path;
+
 /* font name from rcfile */
 static char *fontname_tt[FONTTYPEMAX] = {DEFAULT_GOTHIC_TTF, DEFAULT_MINCHO_TTF};
 static char fontface[FONTTYPEMAX];
 
 static boolean font_noantialias;
 
+static enum stretch_filter stretch_filter = STRETCH_NEAREST;
+
 /* fullscreen on from command line */
 static boolean fs_on;
 
@@ -128,6 +144,10 @@ static void sys35_usage(boolean verbose) {
 #endif
 #ifdef ENABLE_MIDI_PORTMIDI
 	puts(" -Mp?            : ALSA (via PortMidi) (?:devicenumber)");
+#endif
+#ifdef ENABLE_MIDI_SYNTH
+	puts(" -Mw             : built-in software synthesizer (-devmidi: SoundFont file)");
+	puts(" -midicache dir  : save the MIDI tracks rendered by -Mw in 'dir'");
 #endif
 	puts(" -M0             : Disable MIDI output");
 	
@@ -146,7 +166,15 @@ static void sys35_usage(boolean verbose) {
 	puts(" -noantialias    : never use antialiased string");
 	puts(" -fullscreen     : start with fullscreen");
 	puts(" -integerscale   : use integer scaling when resizing");
+	puts(" -stretchfilter F: filter for scaled CGs (nearest, bilinear, area)");
 	puts(" -noimagecursor  : disable image cursor");
+	puts(" -cgcache MB     : size of extracted CG cache in MB");
+	puts(" -aldcache MB    : size of archive data cache in MB");
+	puts(" -cgdiskcache DIR: cache extracted CGs on disk in DIR (up to 512MB)");
+	puts(" -scopreload     : load all scenario pages into memory at startup");
+	puts(" -headless       : run without window and sound, on a virtual clock");
+	puts(" -profile file   : write a scenario profile (folded stacks) to 'file'");
+	puts(" -replay file    : feed input events from 'file'");
 	puts(" -version        : show version");
 	puts(" -h              : show this message");
 	puts(" --help          : show this message");
@@ -185,7 +213,10 @@ void sys_error(char *format, ...) {
 	va_start(args, format);
 	vsnprintf(buf, sizeof buf, format, args);
 	va_end(args);
-	SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "xsystem35", buf, NULL);
+	if (headless)
+		fprintf(stderr, "%s\n", buf);
+	else
+		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "xsystem35", buf, NULL);
 
 	sys35_remove();
 	exit(1);
@@ -217,6 +248,7 @@ static void sys35_init() {
 	
 	sdl_setFullscreen(fs_on);
 	nact->ags.noantialias = font_noantialias;
+	nact->ags.stretch_filter = stretch_filter;
 	ags_setAntialiasedStringMode(!font_noantialias);
 
 	sgenrand(getpid());
@@ -226,7 +258,25 @@ static void sys35_init() {
 	msgskip_init(nact->files.msgskip);
 }
 
+static void print_headless_stats(void) {
+	uint64_t cmds = headless_cmd_count + nact->cmd_count;
+	double secs = (SDL_GetTicks() - headless_start_ticks) / 1000.0;
+	sys_message(0, "headless: %llu commands in %.1fs (%.0f commands/sec), %.1fs of game time\n",
+				(unsigned long long)cmds, secs, secs > 0 ? cmds / secs : 0.0,
+				sdl_getTicks() / 1000.0);
+}
+
 static void sys35_remove() {
+	if (headless)
+		print_headless_stats();
+	if (profile_path) {
+		prof_stop();
+		prof_write(profile_path);
+	}
+	save_remove();
+	cache_print_stats();
+	font_print_stats();
+	save_print_stats();
 	dbg_quit();
 	mus_exit(); 
 	ags_remove();
@@ -242,6 +292,18 @@ static void sys_reset(void) {
 	s39ain_reset(&nact->ain);
 }
 
+static boolean set_stretch_filter(const char *name) {
+	if (!strcmp(name, "nearest"))
+		stretch_filter = STRETCH_NEAREST;
+	else if (!strcmp(name, "bilinear"))
+		stretch_filter = STRETCH_BILINEAR;
+	else if (!strcmp(name, "area"))
+		stretch_filter = STRETCH_AREA;
+	else
+		return FALSE;
+	return TRUE;
+}
+
 static void sys35_ParseOption(int *argc, char **argv) {
 	int i;
 	FILE *fp;
@@ -279,6 +341,10 @@ static void sys35_ParseOption(int *argc, char **argv) {
 			if (argv[i + 1] != NULL) {
 				midi_set_devicename(argv[i + 1]);
 			}
+		} else if (0 == strcmp(argv[i], "-midicache")) {
+			if (argv[i + 1] != NULL) {
+				midi_set_cachedir(argv[i + 1]);
+			}
 		} else if (0 == strncmp(argv[i], "-M", 2)) {
 			int subdev = 0;
 			if (argv[i][3] != '\0') {
@@ -312,6 +378,11 @@ static void sys35_ParseOption(int *argc, char **argv) {
 			exit(0);
 		} else if (0 == strcmp(argv[i], "-integerscale")) {
 			sdl_setIntegerScaling(TRUE);
+		} else if (0 == strcmp(argv[i], "-stretchfilter")) {
+			if (argv[i + 1] != NULL && !set_stretch_filter(argv[i + 1])) {
+				fprintf(stderr, "xsystem35: unknown stretch filter '%s'\n\n", argv[i + 1]);
+				sys35_usage(FALSE);
+			}
 		} else if (0 == strcmp(argv[i], "-game")) {
 			if (argv[i + 1] != NULL) {
 				enable_hack_by_gameid(argv[i + 1]);
@@ -320,6 +391,35 @@ static void sys35_ParseOption(int *argc, char **argv) {
 			if (argv[i + 1] != NULL) {
 				save_setFormat(argv[i + 1]);
 			}
+		} else if (0 == strcmp(argv[i], "-cgcache")) {
+			if (argv[i + 1] != NULL) {
+				cg_set_cache_size(atoi(argv[i + 1]));
+			}
+		} else if (0 == strcmp(argv[i], "-aldcache")) {
+			if (argv[i + 1] != NULL) {
+				ald_set_cache_size(atoi(argv[i + 1]));
+			}
+		} else if (0 == strcmp(argv[i], "-cgdiskcache")) {
+			if (argv[i + 1] != NULL) {
+				cg_diskcache_set_dir(argv[i + 1]);
+			}
+		} else if (0 == strcmp(argv[i], "-scopreload")) {
+			scopreload = TRUE;
+		} else if (0 == strcmp(argv[i], "-headless")) {
+			headless = TRUE;
+		} else if (0 == strcmp(argv[i], "-profile")) {
+			if (argv[i + 1] != NULL) {
+				profile_path = argv[i + 1];
+			}
+		} else if (0 == strcmp(argv[i], "-replay")) {
+			if (i == *argc - 1) {
+				fprintf(stderr, "xsystem35: The -replay option requires file value\n\n");
+				sys35_usage(FALSE);
+			}
+			if (!sdl_replay_open(argv[i + 1])) {
+				fprintf(stderr, "xsystem35: cannot load replay file '%s'\n\n", argv[i + 1]);
+				sys35_usage(FALSE);
+			}
 		}
 	}
 }
@@ -409,11 +509,29 @@ static void check_profile() {
 	if (param) {
 		enable_hack_by_gameid(param);
 	}
+	/* Stretch filter */
+	param = get_profile("stretch_filter");
+	if (param && !set_stretch_filter(param)) {
+		WARNING("unknown stretch_filter '%s'", param);
+	}
 	/* Save file format */
 	param = get_profile("saveformat");
 	if (param) {
 		save_setFormat(param);
 	}
+	/* Cache sizes */
+	param = get_profile("cg_cache_size");
+	if (param) {
+		cg_set_cache_size(atoi(param));
+	}
+	param = get_profile("ald_cache_size");
+	if (param) {
+		ald_set_cache_size(atoi(param));
+	}
+	param = get_profile("cg_disk_cache");
+	if (param) {
+		cg_diskcache_set_dir(param);
+	}
 }
 
 #ifdef HAVE_SIGACTION
@@ -462,6 +580,13 @@ static void registerGameFiles(void) {
 		}
 		ald_init(type, nact->files.game_fname[type], nact->files.cnt[type], use_mmap);
 	}
+	if (scopreload && debugger_mode != DEBUGGER_DISABLED) {
+		// The debugger writes BREAKPOINT instructions into the archive data,
+		// which the preloaded copy would not see.
+		NOTICE("-scopreload is ignored while the debugger is enabled");
+		scopreload = FALSE;
+	}
+	sl_set_preload(scopreload);
 	if (nact->files.save_path)
 		fc_init(nact->files.save_path);
 }
@@ -501,6 +626,10 @@ int main(int argc, char **argv) {
 	init_signalhandler();
 #endif
 
+	if (headless) {
+		sdl_setHeadless(TRUE);
+		mus_disable();
+	}
 	mus_init(audio_buffer_size);
 
 #ifdef ENABLE_NLS
@@ -522,12 +651,16 @@ int main(int argc, char **argv) {
 		dbg_init(symbols_path, debugger_mode == DEBUGGER_DAP);
 	}
 
+	if (profile_path)
+		prof_start();
+	headless_start_ticks = SDL_GetTicks();
 	for (;;) {
 		nact_main();
 #ifndef __EMSCRIPTEN__
 		if (!nact->restart)
 			break;
 #endif
+		headless_cmd_count += nact->cmd_count;
 		sys_reset();
 	}
 
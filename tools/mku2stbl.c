@@ -0,0 +1,51 @@
+// Generates src/u2stbl.h (Unicode -> Shift_JIS table) from src/s2utbl.h.
+// Usage: mku2stbl > ../src/u2stbl.h
+#include <stdio.h>
+#include "../src/s2utbl.h"
+
+static unsigned short u2s[0x10000];
+
+int main() {
+	for (int b1 = 0x80; b1 <= 0xff; b1++) {
+		if (b1 >= 0xa0 && b1 <= 0xdf)
+			continue;
+		for (int b2 = 0x40; b2 <= 0xff; b2++) {
+			int u = s2u[b1 - 0x80][b2 - 0x40];
+			// The first (smallest) SJIS code wins for duplicated mappings
+			// such as NEC/IBM extended characters.
+			if (!u2s[u])
+				u2s[u] = b1 << 8 | b2;
+		}
+	}
+	// U+30FB (KATAKANA MIDDLE DOT) is used as replacement character in
+	// s2utbl.h.
+	u2s[0x30fb] = 0x8145;
+
+	printf("/* Generated by tools/mku2stbl.c from s2utbl.h. DO NOT EDIT. */\n");
+	printf("static const unsigned short u2s_none[256] = {0};\n");
+	for (int hi = 0; hi < 256; hi++) {
+		int used = 0;
+		for (int lo = 0; lo < 256; lo++)
+			used |= u2s[hi << 8 | lo];
+		if (!used)
+			continue;
+		printf("static const unsigned short u2s_%02x[]={\n", hi);
+		for (int lo = 0; lo < 256; lo++)
+			printf("%s0x%04X,%s", lo % 8 ? "" : "\t", u2s[hi << 8 | lo], lo % 8 == 7 ? "\n" : "");
+		printf("};\n");
+	}
+	printf("static const unsigned short *const u2s[256] ={\n");
+	for (int hi = 0; hi < 256; hi++) {
+		int used = 0;
+		for (int lo = 0; lo < 256; lo++)
+			used |= u2s[hi << 8 | lo];
+		if (used)
+			printf("%su2s_%02x,", hi % 8 ? "" : "\t", hi);
+		else
+			printf("%su2s_none,", hi % 8 ? "" : "\t");
+		if (hi % 8 == 7)
+			printf("\n");
+	}
+	printf("};\n");
+	return 0;
+}